@@ -5,6 +5,14 @@ ifeq ($(BOARD_HAVE_LIMITED_POWERON_FEATURES),true)
 	EFILINUX_CFLAGS += -DDISABLE_SECURE_BOOT
 endif
 
+ifeq ($(BOARD_EFILINUX_EFI_HANDOVER),true)
+	EFILINUX_CFLAGS += -DCONFIG_EFI_HANDOVER
+endif
+
+ifeq ($(BOARD_EFILINUX_NO_OSNIB_VARIABLES),true)
+	EFILINUX_CFLAGS += -DCONFIG_NO_OSNIB_VARIABLES
+endif
+
 OSLOADER_EM_POLICY ?= uefi
 EFILINUX_CFLAGS += -DOSLOADER_EM_POLICY_OPS=$(OSLOADER_EM_POLICY)_em_ops
 
@@ -38,6 +46,7 @@ endif
 
 EFILINUX_SRC_FILES := \
 	stack_chk.c \
+	mem.c \
 	malloc.c \
 	config.c \
 	log.c \
@@ -46,6 +55,12 @@ EFILINUX_SRC_FILES := \
 	utils.c \
 	acpi.c \
 	bootlogic.c \
+	boot_inputs.c \
+	boot_plan.c \
+	crc32c.c \
+	loader_state.c \
+	cpio.c \
+	cmdline.c \
 	intel_partitions.c \
 	uefi_osnib.c \
 	platform/platform.c \
@@ -53,6 +68,7 @@ EFILINUX_SRC_FILES := \
 	platform/airmont.c \
 	platform/x86.c \
 	platform/pmic.c \
+	platform/smbios.c \
 	uefi_keys.c \
 	uefi_boot.c \
 	uefi_utils.c \
@@ -60,6 +76,7 @@ EFILINUX_SRC_FILES := \
 	em.c \
 	fake_em.c \
 	uefi_em.c \
+	io_stats.c \
 	$(security_src_files) \
 	$(watchdog_src_files) \
 	fs/fs.c
@@ -78,15 +95,50 @@ EFILINUX_CFLAGS +=  -DWARMDUMP_FILE_PATH='L"$(WARMDUMP_FILE_PATH)"'
 
 EFILINUX_DEBUG_CFFLAGS := -DRUNTIME_SETTINGS -DCONFIG_LOG_LEVEL=4 \
 	-DCONFIG_LOG_FLUSH_TO_VARIABLE -DCONFIG_LOG_BUF_SIZE=51200 \
-	-DCONFIG_LOG_TIMESTAMP -DCONFIG_ENABLE_FACTORY_MODES
+	-DCONFIG_LOG_TIMESTAMP -DCONFIG_ENABLE_FACTORY_MODES \
+	-DCONFIG_PHASE_PROFILER
+
+EFILINUX_DEBUG_SRC_FILES := bench.c phase_profiler.c
+
+# Ramoops layout of the kernel, walked by warmdump to only dump the used
+# part of each pstore zone
+WARMDUMP_CFLAGS :=
+ifneq ($(BOARD_RAMOOPS_RECORD_SIZE),)
+	WARMDUMP_CFLAGS += -DCONFIG_PSTORE_RECORD_SIZE=$(BOARD_RAMOOPS_RECORD_SIZE)
+endif
+ifneq ($(BOARD_RAMOOPS_CONSOLE_SIZE),)
+	WARMDUMP_CFLAGS += -DCONFIG_PSTORE_CONSOLE_SIZE=$(BOARD_RAMOOPS_CONSOLE_SIZE)
+endif
+ifneq ($(BOARD_RAMOOPS_FTRACE_SIZE),)
+	WARMDUMP_CFLAGS += -DCONFIG_PSTORE_FTRACE_SIZE=$(BOARD_RAMOOPS_FTRACE_SIZE)
+endif
+ifneq ($(BOARD_RAMOOPS_PMSG_SIZE),)
+	WARMDUMP_CFLAGS += -DCONFIG_PSTORE_PMSG_SIZE=$(BOARD_RAMOOPS_PMSG_SIZE)
+endif
+ifneq ($(BOARD_RAMOOPS_ECC_SIZE),)
+	WARMDUMP_CFLAGS += -DCONFIG_PSTORE_ECC_SIZE=$(BOARD_RAMOOPS_ECC_SIZE)
+endif
 
 ifeq ($(BOARD_USE_WARMDUMP),true)
-	EFILINUX_DEBUG_CFFLAGS += -DCONFIG_HAS_WARMDUMP
+	EFILINUX_DEBUG_CFFLAGS += -DCONFIG_HAS_WARMDUMP $(WARMDUMP_CFLAGS)
+ifeq ($(BOARD_USE_WARMDUMP_IMAGE),true)
+	EFILINUX_DEBUG_CFFLAGS += -DCONFIG_WARMDUMP_IMAGE
+else
+	EFILINUX_DEBUG_SRC_FILES += warmdump.c lz4.c
+endif
 endif
 
-EFILINUX_PROFILING_CFLAGS := -finstrument-functions -finstrument-functions-exclude-file-list=stack_chk.c,profiling.c,efilinux.h,malloc.c,stdlib.h,boot.c,log.c,platform/silvermont.c,platform/airmont.c,loaders/ -finstrument-functions-exclude-function-list=handover_kernel,checkpoint,exit_boot_services,setup_efi_memory_map,Print,SPrint,VSPrint,memory_map,stub_get_current_time_us,rdtsc,rdmsr
+EFILINUX_PROFILING_CFLAGS := -finstrument-functions -finstrument-functions-exclude-file-list=stack_chk.c,mem.c,profiling.c,phase_profiler.c,alloc_tracker.c,efilinux.h,malloc.c,stdlib.h,boot.c,log.c,platform/silvermont.c,platform/airmont.c,loaders/ -finstrument-functions-exclude-function-list=handover_kernel,checkpoint,exit_boot_services,setup_efi_memory_map,Print,SPrint,VSPrint,memory_map,stub_get_current_time_us,rdtsc,rdmsr
 EFILINUX_PROFILING_SRC_FILES := profiling.c
 
+# Firmware call trace, written to the ESP at handover, see fw_trace_format.h
+EFILINUX_ENG_CFLAGS := -DCONFIG_FW_TRACE
+EFILINUX_ENG_SRC_FILES := fw_trace.c
+
+# Allocation and stack usage report logged at handover
+EFILINUX_ENG_CFLAGS += -DCONFIG_ALLOC_TRACKER
+EFILINUX_ENG_SRC_FILES += alloc_tracker.c
+
 ################################################################################
 
 include $(CLEAR_VARS)
@@ -107,8 +159,10 @@ include $(CLEAR_VARS)
 LOCAL_MODULE := efilinux-eng
 LOCAL_MODULE_TAGS := optional
 LOCAL_MODULE_PATH := $(PRODUCT_OUT)
-LOCAL_CFLAGS += $(EFILINUX_CFLAGS) $(EFILINUX_DEBUG_CFFLAGS) $(EFILINUX_PROFILING_CFLAGS)
-LOCAL_SRC_FILES := $(EFILINUX_SRC_FILES) $(EFILINUX_PROFILING_SRC_FILES)
+LOCAL_CFLAGS += $(EFILINUX_CFLAGS) $(EFILINUX_DEBUG_CFFLAGS) $(EFILINUX_PROFILING_CFLAGS) \
+	$(EFILINUX_ENG_CFLAGS)
+LOCAL_SRC_FILES := $(EFILINUX_SRC_FILES) $(EFILINUX_DEBUG_SRC_FILES) $(EFILINUX_PROFILING_SRC_FILES) \
+	$(EFILINUX_ENG_SRC_FILES)
 LOCAL_C_INCLUDES := $(EFILINUX_C_INCLUDES)
 
 include $(LOCAL_PATH)/uefi_executable.mk
@@ -121,7 +175,7 @@ LOCAL_MODULE := efilinux-userdebug
 LOCAL_MODULE_TAGS := optional
 LOCAL_MODULE_PATH := $(PRODUCT_OUT)
 LOCAL_CFLAGS += $(EFILINUX_CFLAGS) $(EFILINUX_DEBUG_CFFLAGS) $(EFILINUX_PROFILING_CFLAGS)
-LOCAL_SRC_FILES := $(EFILINUX_SRC_FILES) $(EFILINUX_PROFILING_SRC_FILES)
+LOCAL_SRC_FILES := $(EFILINUX_SRC_FILES) $(EFILINUX_DEBUG_SRC_FILES) $(EFILINUX_PROFILING_SRC_FILES)
 LOCAL_C_INCLUDES := $(EFILINUX_C_INCLUDES)
 
 include $(LOCAL_PATH)/uefi_executable.mk
@@ -129,7 +183,7 @@ include $(LOCAL_PATH)/uefi_executable.mk
 ################################################################################
 
 include $(CLEAR_VARS)
-LOCAL_COPY_HEADERS := bootlogic.h
+LOCAL_COPY_HEADERS := bootlogic.h boot_state.h
 LOCAL_COPY_HEADERS_TO := efilinux
 include $(BUILD_COPY_HEADERS)
 
@@ -146,6 +200,7 @@ LOCAL_C_INCLUDES := \
 
 LOCAL_SRC_FILES := \
 	stack_chk.c \
+	mem.c \
 	malloc.c \
 	utils.c \
 	acpi.c \
@@ -153,7 +208,11 @@ LOCAL_SRC_FILES := \
 	fs/fs.c \
 	log.c \
 	config.c \
-	warmdump.c
+	lz4.c \
+	crc32c.c \
+	warmdump.c \
+	io_stats.c \
+	warmdump_entry.c
 
 WARMDUMP_VERSION_STRING := $(shell cd $(LOCAL_PATH) ; git describe --abbrev=12 --dirty --always)
 WARMDUMP_VERSION_DATE := $(shell cd $(LOCAL_PATH) ; git log --pretty=%cD HEAD^..HEAD)
@@ -161,5 +220,6 @@ LOCAL_CFLAGS += -DWARMDUMP_VERSION_STRING='L"$(WARMDUMP_VERSION_STRING)"'
 LOCAL_CFLAGS += -DWARMDUMP_VERSION_DATE='L"$(WARMDUMP_VERSION_DATE)"'
 LOCAL_CFLAGS += -DWARMDUMP_BUILD_STRING='L"$(BUILD_NUMBER) $(PRODUCT_NAME)"'
 LOCAL_CFLAGS += -DCONFIG_LOG_TAG='L"WARMDUMP"' -DCONFIG_LOG_LEVEL=4
+LOCAL_CFLAGS += $(WARMDUMP_CFLAGS)
 
 include $(LOCAL_PATH)/uefi_executable.mk
@@ -33,6 +33,7 @@
 #include "utils.h"
 #include "efilinux.h"
 #include "uefi_utils.h"
+#include "acpi_archive.h"
 
 static struct RSCI_TABLE *RSCI_table = NULL;
 static struct OEM1_TABLE *OEM1_table = NULL;
@@ -135,11 +136,30 @@ out:
 	return ret;
 }
 
+#define ACPI_ARCHIVE_FILE	L"acpi_tables.bin"
+#define ACPI_ARCHIVE_MAX_TABLES	64
+#define ACPI_ARCHIVE_WRITE_SIZE	(256 * 1024)
+
+static struct ACPI_DESC_HEADER *facp_get_dsdt(struct FACP_TABLE *facp)
+{
+	if (facp->header.length >= offsetof(struct FACP_TABLE, x_dsdt) + sizeof(facp->x_dsdt)
+	    && facp->x_dsdt)
+		return (struct ACPI_DESC_HEADER *)(UINTN)facp->x_dsdt;
+
+	return (struct ACPI_DESC_HEADER *)(UINTN)facp->dsdt;
+}
+
+/* Write all the tables to a single archive, see acpi_archive.h */
 void dump_acpi_tables(void)
 {
 	struct RSDT_TABLE *rsdt;
 	EFI_STATUS ret;
 	EFI_FILE_IO_INTERFACE *io;
+	struct ACPI_DESC_HEADER *tables[ACPI_ARCHIVE_MAX_TABLES];
+	struct acpi_archive_entry entries[ACPI_ARCHIVE_MAX_TABLES];
+	struct acpi_archive_header header;
+	struct uefi_stream stream;
+	UINTN count = 0, offset;
 
 	ret = get_rsdt_table(&rsdt);
 	if (EFI_ERROR(ret)) {
@@ -158,46 +178,58 @@ void dump_acpi_tables(void)
 	}
 
 	int i;
-	for (i = 0 ; i < nb_acpi_tables; i++) {
-		CHAR8 *s = ((struct ACPI_DESC_HEADER *)rsdt->entry[i])->signature;
-		CHAR8 signature[5];
-		CHAR16 *tmp;
-		CHAR16 filename[11 * sizeof(CHAR16)];
-		UINTN size = ((struct ACPI_DESC_HEADER *)s)->length;
-		UINTN written_size = size;
+	for (i = 0 ; i < nb_acpi_tables && count < ACPI_ARCHIVE_MAX_TABLES; i++) {
+		struct ACPI_DESC_HEADER *table = (struct ACPI_DESC_HEADER *)rsdt->entry[i];
+		CHAR8 *s = table->signature;
+
 		info(L"RSDT[%d] = %c%c%c%c\n", i, s[0], s[1], s[2], s[3]);
+		tables[count++] = table;
 
-		memcpy(signature, s, 4);
-		signature[4] = 0;
+		if (!strncmpa(s, (CHAR8 *)"FACP", 4) && count < ACPI_ARCHIVE_MAX_TABLES) {
+			table = facp_get_dsdt((struct FACP_TABLE *)table);
+			if (table)
+				tables[count++] = table;
+		}
+	}
 
-		tmp = stra_to_str(signature);
-		SPrint(filename, 0, L"ACPI\\%s", tmp);
-		free(tmp);
+	if (i < nb_acpi_tables)
+		warning(L"Only the first %d tables are dumped\n", count);
+
+	offset = sizeof(header) + count * sizeof(*entries);
+	for (i = 0; i < count; i++) {
+		memcpy(entries[i].signature, tables[i]->signature, sizeof(entries[i].signature));
+		memcpy(entries[i].oem_id, tables[i]->oem_id, sizeof(entries[i].oem_id));
+		memcpy(entries[i].oem_table_id, tables[i]->oem_table_id,
+		       sizeof(entries[i].oem_table_id));
+		entries[i].checksum = tables[i]->checksum;
+		entries[i].reserved = 0;
+		entries[i].offset = offset;
+		entries[i].length = tables[i]->length;
+		offset += tables[i]->length;
+	}
 
-		ret = uefi_write_file(io, filename, s, &written_size);
-		if (size != written_size)
-			error(L"Written %d/%d bytes\n", written_size, size);
-		if (EFI_ERROR(ret)) {
-			error(L"Failed to write file %s: %r\n", filename, ret);
-			goto out;
-		}
+	header.magic = ACPI_ARCHIVE_MAGIC;
+	header.version = ACPI_ARCHIVE_VERSION;
+	header.header_size = sizeof(header);
+	header.count = count;
+	header.size = offset;
 
-		if (!strncmpa(signature, (CHAR8 *)"FACP", 4)) {
-			s = s + 0x28;
-			s = (CHAR8 *) (*((UINT32 *)s));
-			written_size = ((struct ACPI_DESC_HEADER *)s)->length;;
-			size = written_size;
-
-			CHAR16 *dsdt_filename = L"ACPI\\DSDT";
-			ret = uefi_write_file(io, dsdt_filename, s, &written_size);
-			if (size != written_size)
-				error(L"Written %d/%d bytes\n", written_size, size);
-			if (EFI_ERROR(ret)) {
-				error(L"Failed to write file %s: %r\n", dsdt_filename, ret);
-				goto out;
-			}
-		}
+	ret = uefi_stream_open(&stream, io, ACPI_ARCHIVE_FILE, ACPI_ARCHIVE_WRITE_SIZE);
+	if (EFI_ERROR(ret))
+		goto out;
+
+	uefi_stream_write(&stream, &header, sizeof(header));
+	uefi_stream_write(&stream, entries, count * sizeof(*entries));
+	for (i = 0; i < count; i++)
+		uefi_stream_write(&stream, tables[i], tables[i]->length);
+
+	ret = uefi_stream_close(&stream);
+	if (EFI_ERROR(ret)) {
+		error(L"Failed to write file %s: %r\n", ACPI_ARCHIVE_FILE, ret);
+		goto out;
 	}
+
+	info(L"Dumped %d tables, %d bytes to %s\n", count, offset, ACPI_ARCHIVE_FILE);
 out:
 	return;
 }
@@ -289,6 +321,11 @@ enum shutdown_sources rsci_get_shutdown_source(void)
         return get_acpi_field(RSCI, shutdown_source);
 }
 
+UINT32 rsci_get_indicators(void)
+{
+        return get_acpi_field(RSCI, indicators);
+}
+
 UINT16 oem1_get_ia_apps_run(void)
 {
 	return get_acpi_field(OEM1, ia_apps_run);
@@ -63,6 +63,16 @@ struct RSDT_TABLE {
 	UINT32 entry[1];		/* Table Entries */
 };
 
+/* Fixed ACPI Description Table, up to the 64 bits DSDT address */
+struct FACP_TABLE {
+	struct ACPI_DESC_HEADER header;	/* System Description Table Header */
+	UINT32 firmware_ctrl;		/* 32-bit FACS address */
+	UINT32 dsdt;			/* 32-bit DSDT address */
+	CHAR8 reserved[88];		/* Fields not used by the loader */
+	UINT64 x_firmware_ctrl;		/* 64-bit FACS address */
+	UINT64 x_dsdt;			/* 64-bit DSDT address, if not null */
+} __attribute__ ((packed));
+
 struct RSCI_TABLE {
 	struct ACPI_DESC_HEADER header;	/* System Description Table Header */
 	CHAR8 wake_source;		/* How system woken up from S4 or S5 */
@@ -149,6 +159,7 @@ enum reset_sources rsci_get_reset_source(void);
 EFI_STATUS rsci_set_reset_source(enum reset_sources);
 enum reset_types rsci_get_reset_type(void);
 enum shutdown_sources rsci_get_shutdown_source(void);
+UINT32 rsci_get_indicators(void);
 
 UINT16 oem1_get_ia_apps_run(void);
 UINT8 oem1_get_ia_apps_cap(void);
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file describes the ACPI tables archive written by the
+ * dump_acpi_tables command and read by the acpi_split host tool:
+ *
+ *   struct acpi_archive_header
+ *   struct acpi_archive_entry[count]
+ *   table bytes, at the offset of each entry
+ *
+ * All the fields are little endian.
+ */
+
+#ifndef __ACPI_ARCHIVE_H__
+#define __ACPI_ARCHIVE_H__
+
+#define ACPI_ARCHIVE_MAGIC	0x41495041	/* APIA */
+#define ACPI_ARCHIVE_VERSION	1
+
+struct acpi_archive_header {
+	UINT32 magic;
+	UINT16 version;
+	UINT16 header_size;
+	UINT32 count;
+	UINT32 size;		/* Size of the whole archive */
+} __attribute__((packed));
+
+struct acpi_archive_entry {
+	CHAR8 signature[4];
+	CHAR8 oem_id[6];
+	CHAR8 oem_table_id[8];
+	UINT8 checksum;		/* Checksum byte of the table header */
+	UINT8 reserved;
+	UINT32 offset;		/* Archive offset of the table */
+	UINT32 length;
+} __attribute__((packed));
+
+#endif	/* __ACPI_ARCHIVE_H__ */
@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file implements the allocation tracker: every live allocation
+ * is kept with its call site, frees are checked against the recorded
+ * allocation, and the live and peak usage is accounted per memory
+ * type. The stack below efi_main is painted at start to measure its
+ * high-water mark. Everything still live is reported at handover.
+ */
+
+#define ALLOC_TRACKER_NO_WRAP
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "stdlib.h"
+#include "alloc_tracker.h"
+
+#define ALLOC_TRACKER_MAX_RECORDS	1024
+
+/*
+ * Stack painted below efi_main. UEFI guarantees at least 128KB of
+ * stack at image entry. The margin keeps the painting clear of the
+ * frames in use.
+ */
+#define STACK_PAINT_SIZE	(64 * 1024)
+#define STACK_PAINT_MARGIN	4096
+#define STACK_PAINT_PATTERN	((UINTN)0x5354414b5354414bULL)	/* STAKSTAK */
+
+enum alloc_kind {
+	ALLOC_POOL,
+	ALLOC_PAGES,
+};
+
+struct alloc_record {
+	EFI_PHYSICAL_ADDRESS addr;
+	UINT64 size;
+	const char *file;
+	UINT16 line;
+	UINT8 type;
+	UINT8 kind;
+};
+
+static struct {
+	struct alloc_record records[ALLOC_TRACKER_MAX_RECORDS];
+	UINTN count;
+	UINTN allocs;
+	UINTN frees;
+	UINTN dropped;		/* Allocations not recorded, table full */
+	UINTN unknown_frees;	/* Frees of allocations not recorded */
+	UINTN mismatches;
+	UINT64 live[EfiMaxMemoryType];
+	UINT64 peak[EfiMaxMemoryType];
+	UINT64 live_total;
+	UINT64 peak_total;
+} tracker;
+
+static UINTN *stack_top;
+
+static void track(enum alloc_kind kind, EFI_MEMORY_TYPE type,
+		  EFI_PHYSICAL_ADDRESS addr, UINT64 size,
+		  const char *file, int line)
+{
+	struct alloc_record *r;
+
+	tracker.allocs++;
+	if (type >= EfiMaxMemoryType)
+		type = EfiReservedMemoryType;
+
+	tracker.live[type] += size;
+	if (tracker.live[type] > tracker.peak[type])
+		tracker.peak[type] = tracker.live[type];
+	tracker.live_total += size;
+	if (tracker.live_total > tracker.peak_total)
+		tracker.peak_total = tracker.live_total;
+
+	if (tracker.count == ALLOC_TRACKER_MAX_RECORDS) {
+		tracker.dropped++;
+		return;
+	}
+
+	r = &tracker.records[tracker.count++];
+	r->addr = addr;
+	r->size = size;
+	r->file = file;
+	r->line = line;
+	r->type = type;
+	r->kind = kind;
+}
+
+/*
+ * SIZE is the number of bytes a page free releases, 0 for pool frees
+ * which do not tell.
+ */
+static void untrack(enum alloc_kind kind, EFI_PHYSICAL_ADDRESS addr,
+		    UINT64 size, const char *file, int line)
+{
+	struct alloc_record *r;
+	UINTN i;
+
+	if (!addr)
+		return;
+
+	tracker.frees++;
+	for (i = tracker.count; i > 0; i--)
+		if (tracker.records[i - 1].addr == addr)
+			break;
+	if (!i) {
+		tracker.unknown_frees++;
+		return;
+	}
+	r = &tracker.records[i - 1];
+
+	if (r->kind != kind) {
+		tracker.mismatches++;
+		warning(L"%a:%d frees 0x%lx allocated from %a at %a:%d\n",
+			file, line, addr, r->kind == ALLOC_POOL ? "pool" : "pages",
+			r->file, r->line);
+	} else if (kind == ALLOC_PAGES && size != r->size) {
+		tracker.mismatches++;
+		warning(L"%a:%d frees %ld bytes at 0x%lx allocated as %ld bytes at %a:%d\n",
+			file, line, size, addr, r->size, r->file, r->line);
+	}
+
+	tracker.live[r->type] -= r->size;
+	tracker.live_total -= r->size;
+	*r = tracker.records[--tracker.count];
+}
+
+/* Out of line so that its frame is below the efi_main one */
+static void __attribute__((noinline)) stack_paint(void)
+{
+	volatile UINTN *p;
+
+	stack_top = (UINTN *)((UINT8 *)__builtin_frame_address(0) - STACK_PAINT_MARGIN);
+	for (p = stack_top - STACK_PAINT_SIZE / sizeof(UINTN); p < stack_top; p++)
+		*p = STACK_PAINT_PATTERN;
+}
+
+static UINTN stack_high_water(void)
+{
+	UINTN *p;
+
+	for (p = stack_top - STACK_PAINT_SIZE / sizeof(UINTN); p < stack_top; p++)
+		if (*p != STACK_PAINT_PATTERN)
+			break;
+	return (stack_top - p) * sizeof(UINTN);
+}
+
+/**
+ * alloc_tracker_start - paint the stack, to be called first thing in
+ * efi_main
+ */
+void alloc_tracker_start(void)
+{
+	stack_paint();
+}
+
+/**
+ * alloc_tracker_report - log the memory usage and every allocation
+ * still live, before exiting boot services
+ */
+void alloc_tracker_report(void)
+{
+	struct alloc_record *r;
+	UINTN i, high_water;
+
+	info(L"Allocations: %d, frees: %d, live: %d (%ld bytes), peak %ld bytes\n",
+	     tracker.allocs, tracker.frees, tracker.allocs - tracker.frees,
+	     tracker.live_total, tracker.peak_total);
+	if (tracker.dropped)
+		warning(L"%d allocations not recorded\n", tracker.dropped);
+	if (tracker.unknown_frees)
+		info(L"%d frees of memory not allocated by the loader\n",
+		     tracker.unknown_frees);
+	if (tracker.mismatches)
+		warning(L"%d mismatched frees\n", tracker.mismatches);
+
+	for (i = 0; i < EfiMaxMemoryType; i++) {
+		if (!tracker.peak[i])
+			continue;
+		info(L"  %s: live %ld bytes, peak %ld bytes\n",
+		     memory_type_to_str(i), tracker.live[i], tracker.peak[i]);
+	}
+
+	for (i = 0; i < tracker.count; i++) {
+		r = &tracker.records[i];
+		info(L"  live %a 0x%lx %ld bytes %s from %a:%d\n",
+		     r->kind == ALLOC_POOL ? "pool" : "pages", r->addr, r->size,
+		     memory_type_to_str(r->type), r->file, r->line);
+	}
+
+	if (!stack_top)
+		return;
+	high_water = stack_high_water();
+	if (high_water >= STACK_PAINT_SIZE) {
+		warning(L"Stack usage beyond the %d painted bytes\n", STACK_PAINT_SIZE);
+	} else {
+		info(L"Stack high-water mark: %d bytes below efi_main\n",
+		     high_water + STACK_PAINT_MARGIN);
+	}
+}
+
+void *alloc_tracker_malloc(UINTN size, const char *file, int line)
+{
+	void *buffer = malloc(size);
+
+	if (buffer)
+		track(ALLOC_POOL, EfiLoaderData, (UINTN)buffer, size, file, line);
+	return buffer;
+}
+
+void alloc_tracker_free(void *buffer, const char *file, int line)
+{
+	untrack(ALLOC_POOL, (UINTN)buffer, 0, file, line);
+	free(buffer);
+}
+
+EFI_STATUS alloc_tracker_emalloc(UINTN size, UINTN align, EFI_PHYSICAL_ADDRESS *addr,
+				 const char *file, int line)
+{
+	EFI_STATUS ret = emalloc(size, align, addr);
+
+	if (!EFI_ERROR(ret))
+		track(ALLOC_PAGES, EfiLoaderData, *addr,
+		      EFI_PAGES_TO_SIZE(EFI_SIZE_TO_PAGES(size)), file, line);
+	return ret;
+}
+
+void alloc_tracker_efree(EFI_PHYSICAL_ADDRESS memory, UINTN size,
+			 const char *file, int line)
+{
+	untrack(ALLOC_PAGES, memory, EFI_PAGES_TO_SIZE(EFI_SIZE_TO_PAGES(size)),
+		file, line);
+	efree(memory, size);
+}
+
+EFI_STATUS alloc_tracker_allocate_pages(EFI_ALLOCATE_TYPE atype, EFI_MEMORY_TYPE mtype,
+					UINTN num_pages, EFI_PHYSICAL_ADDRESS *memory,
+					const char *file, int line)
+{
+	EFI_STATUS ret = allocate_pages(atype, mtype, num_pages, memory);
+
+	if (!EFI_ERROR(ret))
+		track(ALLOC_PAGES, mtype, *memory, EFI_PAGES_TO_SIZE(num_pages),
+		      file, line);
+	return ret;
+}
+
+EFI_STATUS alloc_tracker_free_pages(EFI_PHYSICAL_ADDRESS memory, UINTN num_pages,
+				    const char *file, int line)
+{
+	untrack(ALLOC_PAGES, memory, EFI_PAGES_TO_SIZE(num_pages), file, line);
+	return free_pages(memory, num_pages);
+}
+
+EFI_STATUS alloc_tracker_allocate_pool(EFI_MEMORY_TYPE type, UINTN size, void **buffer,
+				       const char *file, int line)
+{
+	EFI_STATUS ret = allocate_pool(type, size, buffer);
+
+	if (!EFI_ERROR(ret))
+		track(ALLOC_POOL, type, (UINTN)*buffer, size, file, line);
+	return ret;
+}
+
+EFI_STATUS alloc_tracker_free_pool(void *buffer, const char *file, int line)
+{
+	untrack(ALLOC_POOL, (UINTN)buffer, 0, file, line);
+	return free_pool(buffer);
+}
+
+EFI_STATUS alloc_tracker_memory_map(EFI_MEMORY_DESCRIPTOR **map_buf, UINTN *map_size,
+				    UINTN *map_key, UINTN *desc_size, UINT32 *desc_version,
+				    const char *file, int line)
+{
+	EFI_STATUS ret = memory_map(map_buf, map_size, map_key, desc_size,
+				    desc_version);
+
+	if (!EFI_ERROR(ret))
+		track(ALLOC_POOL, EfiLoaderData, (UINTN)*map_buf, *map_size,
+		      file, line);
+	return ret;
+}
+
+VOID *alloc_tracker_lib_allocate_pool(UINTN size, BOOLEAN zero,
+				      const char *file, int line)
+{
+	VOID *buffer = zero ? AllocateZeroPool(size) : AllocatePool(size);
+
+	if (buffer)
+		track(ALLOC_POOL, PoolAllocationType, (UINTN)buffer, size,
+		      file, line);
+	return buffer;
+}
+
+VOID alloc_tracker_lib_free_pool(VOID *buffer, const char *file, int line)
+{
+	untrack(ALLOC_POOL, (UINTN)buffer, 0, file, line);
+	FreePool(buffer);
+}
+
+VOID *alloc_tracker_lib_get_variable(CHAR16 *name, EFI_GUID *guid, UINTN *size,
+				     const char *file, int line)
+{
+	UINTN var_size;
+	VOID *buffer;
+
+	buffer = LibGetVariableAndSize(name, guid, &var_size);
+	if (!buffer)
+		return NULL;
+
+	track(ALLOC_POOL, PoolAllocationType, (UINTN)buffer, var_size, file, line);
+	if (size)
+		*size = var_size;
+	return buffer;
+}
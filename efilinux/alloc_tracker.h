@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file declares the allocation tracker of CONFIG_ALLOC_TRACKER
+ * builds. efilinux.h and stdlib.h redirect the loader allocation
+ * functions to these wrappers, which record the call site of every
+ * live allocation. Files defining the wrapped functions set
+ * ALLOC_TRACKER_NO_WRAP.
+ */
+
+#ifndef __ALLOC_TRACKER_H__
+#define __ALLOC_TRACKER_H__
+
+void alloc_tracker_start(void);
+void alloc_tracker_report(void);
+
+void *alloc_tracker_malloc(UINTN size, const char *file, int line);
+void alloc_tracker_free(void *buffer, const char *file, int line);
+EFI_STATUS alloc_tracker_emalloc(UINTN size, UINTN align, EFI_PHYSICAL_ADDRESS *addr,
+				 const char *file, int line);
+void alloc_tracker_efree(EFI_PHYSICAL_ADDRESS memory, UINTN size,
+			 const char *file, int line);
+
+EFI_STATUS alloc_tracker_allocate_pages(EFI_ALLOCATE_TYPE atype, EFI_MEMORY_TYPE mtype,
+					UINTN num_pages, EFI_PHYSICAL_ADDRESS *memory,
+					const char *file, int line);
+EFI_STATUS alloc_tracker_free_pages(EFI_PHYSICAL_ADDRESS memory, UINTN num_pages,
+				    const char *file, int line);
+EFI_STATUS alloc_tracker_allocate_pool(EFI_MEMORY_TYPE type, UINTN size, void **buffer,
+				       const char *file, int line);
+EFI_STATUS alloc_tracker_free_pool(void *buffer, const char *file, int line);
+EFI_STATUS alloc_tracker_memory_map(EFI_MEMORY_DESCRIPTOR **map_buf, UINTN *map_size,
+				    UINTN *map_key, UINTN *desc_size, UINT32 *desc_version,
+				    const char *file, int line);
+
+/* gnu-efi library allocations */
+VOID *alloc_tracker_lib_allocate_pool(UINTN size, BOOLEAN zero,
+				      const char *file, int line);
+VOID alloc_tracker_lib_free_pool(VOID *buffer, const char *file, int line);
+VOID *alloc_tracker_lib_get_variable(CHAR16 *name, EFI_GUID *guid, UINTN *size,
+				     const char *file, int line);
+
+#endif /* __ALLOC_TRACKER_H__ */
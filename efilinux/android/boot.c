@@ -41,6 +41,12 @@
 #include "fs.h"
 #include "platform.h"
 #include "secure_boot.h"
+#include "loader_state.h"
+#include "cmdline.h"
+#include "uefi_utils.h"
+#include "boot_plan.h"
+#include "phase_profiler.h"
+#include "io_stats.h"
 
 #ifdef CONFIG_X86_64
 #include "bzimage/x86_64.h"
@@ -207,13 +213,21 @@ static EFI_STATUS verify_boot_image(UINT8 *bootimage)
 }
 
 
+/* The ramdisk allocation leaves room for the loader state cpio archive,
+ * 4 bytes aligned as required by the kernel initramfs unpacker */
+static UINTN ramdisk_alloc_size(struct boot_img_hdr *aosp_header)
+{
+        return ((aosp_header->ramdisk_size + 3) & ~3) + LOADER_CPIO_MAX_SIZE;
+}
+
 static EFI_STATUS setup_ramdisk(CHAR8 *bootimage)
 {
         struct boot_img_hdr *aosp_header;
         struct boot_params *buf;
-        UINT32 roffset, rsize;
+        UINT32 roffset, rsize, cpio_offset;
         EFI_PHYSICAL_ADDRESS ramdisk_addr;
-        EFI_STATUS ret;
+        UINTN cpio_len, alloc_size;
+        EFI_STATUS ret = EFI_NOT_FOUND;
 
         aosp_header = (struct boot_img_hdr *)bootimage;
         buf = (struct boot_params *)(bootimage + aosp_header->page_size);
@@ -222,9 +236,17 @@ static EFI_STATUS setup_ramdisk(CHAR8 *bootimage)
                         * aosp_header->page_size;
         rsize = aosp_header->ramdisk_size;
         buf->hdr.ramdisk_size = rsize;
-        ret = emalloc(rsize, 0x1000, &ramdisk_addr);
-        if (EFI_ERROR(ret))
-                return ret;
+        alloc_size = ramdisk_alloc_size(aosp_header);
+        ramdisk_addr = boot_plan_get_placement(BOOT_PLAN_RAMDISK, alloc_size);
+        if (ramdisk_addr)
+                ret = allocate_pages(AllocateAddress, EfiLoaderData,
+                                     EFI_SIZE_TO_PAGES(alloc_size), &ramdisk_addr);
+        if (EFI_ERROR(ret)) {
+                ret = emalloc(alloc_size, 0x1000, &ramdisk_addr);
+                if (EFI_ERROR(ret))
+                        return ret;
+        }
+        boot_plan_set_placement(BOOT_PLAN_RAMDISK, ramdisk_addr, alloc_size);
 
         if ((UINTN)ramdisk_addr > buf->hdr.initrd_addr_max) {
                 error(L"Ramdisk address is too high!\n");
@@ -234,9 +256,21 @@ static EFI_STATUS setup_ramdisk(CHAR8 *bootimage)
         memcpy((VOID *)(UINTN)ramdisk_addr, bootimage + roffset, rsize);
         buf->hdr.ramdisk_image = (UINT32)(UINTN)ramdisk_addr;
 	debug(L"Ramdisk copied into address 0x%x\n", ramdisk_addr);
+
+        /* Append the loader state right after the ramdisk, the kernel
+         * unpacks concatenated archives and skips the zero padding */
+        cpio_offset = (rsize + 3) & ~3;
+        memset((CHAR8 *)(UINTN)ramdisk_addr + rsize, 0, cpio_offset - rsize);
+        ret = loader_state_cpio((CHAR8 *)(UINTN)ramdisk_addr + cpio_offset,
+                                LOADER_CPIO_MAX_SIZE, &cpio_len);
+        if (EFI_ERROR(ret)) {
+                warning(L"Loader state not appended to the ramdisk: %r\n", ret);
+        } else
+                buf->hdr.ramdisk_size = cpio_offset + cpio_len;
+
         return EFI_SUCCESS;
 out_error:
-        efree(ramdisk_addr, rsize);
+        efree(ramdisk_addr, alloc_size);
         return ret;
 }
 
@@ -248,7 +282,7 @@ static void setup_screen_info_from_gop(struct screen_info *pinfo)
 	EFI_GRAPHICS_OUTPUT_PROTOCOL *gop;
 	EFI_STATUS ret;
 
-	ret = LibLocateProtocol(&GraphicsOutputProtocol, (void **)&gop);
+	ret = uefi_locate_protocol(&GraphicsOutputProtocol, (void **)&gop);
 	if (EFI_ERROR(ret) || gop == NULL || gop->Mode == NULL) {
 		warning(L"Failed to locate GOP\n");
 		return;
@@ -263,50 +297,18 @@ static void setup_screen_info_from_gop(struct screen_info *pinfo)
 }
 
 static EFI_STATUS setup_command_line(UINT8 *bootimage,
-                CHAR8 *append)
+                struct cmdline *cmdline)
 {
         EFI_PHYSICAL_ADDRESS cmdline_addr;
-        CHAR8 *full_cmdline;
         UINTN cmdlen;
         EFI_STATUS ret;
         struct boot_img_hdr *aosp_header;
         struct boot_params *buf;
-	UINTN cmdline_pool_size = BOOT_ARGS_SIZE + BOOT_EXTRA_ARGS_SIZE;
 
         aosp_header = (struct boot_img_hdr *)bootimage;
         buf = (struct boot_params *)(bootimage + aosp_header->page_size);
 
-        full_cmdline = AllocatePool(cmdline_pool_size);
-        if (!full_cmdline) {
-                ret = EFI_OUT_OF_RESOURCES;
-                goto out;
-        }
-        memcpy(full_cmdline, aosp_header->cmdline, (BOOT_ARGS_SIZE - 1));
-        if (aosp_header->cmdline[BOOT_ARGS_SIZE - 2]) {
-                memcpy(full_cmdline + (BOOT_ARGS_SIZE - 1),
-                                aosp_header->extra_cmdline,
-                                BOOT_EXTRA_ARGS_SIZE);
-        }
-	cmdlen = strlena(full_cmdline);
-
-        if (append) {
-		UINTN append_len = strlena(append);
-		UINTN new_size = cmdlen + append_len + 2;
-		if (new_size >= cmdline_pool_size) {
-			full_cmdline = ReallocatePool(full_cmdline, cmdline_pool_size, new_size);
-			if (!full_cmdline) {
-				error(L"Failed to reallocate cmdline\n");
-				ret = EFI_OUT_OF_RESOURCES;
-				goto out;
-			}
-			cmdline_pool_size = new_size;
-		}
-
-		full_cmdline[cmdlen] = ' ';
-                memcpy(full_cmdline + cmdlen + 1, append, append_len + 1);
-		cmdlen = strlena(full_cmdline);
-		free(append);
-        }
+        cmdlen = cmdline_length(cmdline);
 
         /* Documentation/x86/boot.txt: "The kernel command line can be located
          * anywhere between the end of the setup heap and 0xA0000" */
@@ -314,18 +316,15 @@ static EFI_STATUS setup_command_line(UINT8 *bootimage,
         ret = allocate_pages(AllocateMaxAddress, EfiLoaderData,
                              EFI_SIZE_TO_PAGES(cmdlen + 1),
                              &cmdline_addr);
-        if (!cmdline_addr || EFI_ERROR(ret))
-                goto out;
+        if (EFI_ERROR(ret))
+                return ret;
 
-        memcpy((CHAR8 *)(UINTN)cmdline_addr, full_cmdline, cmdlen + 1);
+        cmdline_write(cmdline, (CHAR8 *)(UINTN)cmdline_addr);
+        debug(L"cmdline = %a\n", (CHAR8 *)(UINTN)cmdline_addr);
 
         buf->hdr.cmd_line_ptr = (UINT32) cmdline_addr;
-	buf->hdr.cmdline_size = cmdlen + 1;
-        ret = EFI_SUCCESS;
-out:
-        FreePool(full_cmdline);
-
-        return ret;
+        buf->hdr.cmdline_size = cmdlen + 1;
+        return EFI_SUCCESS;
 }
 
 static EFI_STATUS setup_idt_gdt(void)
@@ -457,10 +456,173 @@ out:
 	return ret;
 }
 
-static EFI_STATUS handover_kernel(CHAR8 *bootimage, EFI_HANDLE parent_image, BOOLEAN watchdog_en)
+#ifdef CONFIG_X86_64
+#define XLF_EFI_HANDOVER	XLF_EFI_HANDOVER_64
+#else
+#define XLF_EFI_HANDOVER	XLF_EFI_HANDOVER_32
+#endif
+
+#ifdef CONFIG_EFI_HANDOVER
+static BOOLEAN use_efi_handover = TRUE;
+#else
+static BOOLEAN use_efi_handover = FALSE;
+#endif
+
+EFI_STATUS kernel_handover_from_name(const CHAR16 *name,
+				     enum kernel_handover *handover)
+{
+	if (!StrCmp(name, L"efi"))
+		*handover = KERNEL_HANDOVER_EFI;
+	else if (!StrCmp(name, L"legacy"))
+		*handover = KERNEL_HANDOVER_LEGACY;
+	else
+		return EFI_INVALID_PARAMETER;
+
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS set_kernel_handover(const CHAR16 *name)
+{
+	enum kernel_handover handover;
+	EFI_STATUS ret;
+
+	ret = kernel_handover_from_name(name, &handover);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	use_efi_handover = handover == KERNEL_HANDOVER_EFI;
+	return EFI_SUCCESS;
+}
+
+static BOOLEAN has_efi_handover(struct boot_params *buf)
+{
+	/* xloadflags appeared with the 2.12 boot protocol */
+	return buf->hdr.version >= 0x20c && buf->hdr.handover_offset &&
+		(buf->hdr.xloadflags & XLF_EFI_HANDOVER);
+}
+
+/*
+ * Copy the kernel to init_size bytes below 4GB, where it runs and
+ * decompresses itself: where it landed on the previous boot, else at
+ * its preferred address, else anywhere kernel_alignment aligned.
+ */
+static EFI_STATUS place_kernel(struct boot_params *buf, CHAR8 *kernel, UINT32 ksize,
+                               EFI_PHYSICAL_ADDRESS *kernel_start)
+{
+        UINT64 init_size = buf->hdr.init_size;
+        EFI_STATUS ret = EFI_NOT_FOUND;
+
+        /* Where the kernel landed on the previous boot, if nothing changed */
+        *kernel_start = boot_plan_get_placement(BOOT_PLAN_KERNEL, init_size);
+        if (*kernel_start)
+                ret = allocate_pages(AllocateAddress, EfiLoaderData,
+                                     EFI_SIZE_TO_PAGES(init_size), kernel_start);
+        if (EFI_ERROR(ret)) {
+                *kernel_start = buf->hdr.pref_address;
+                ret = allocate_pages(AllocateAddress, EfiLoaderData,
+                                     EFI_SIZE_TO_PAGES(init_size), kernel_start);
+        }
+        if (EFI_ERROR(ret)) {
+                /*
+                 * We failed to allocate the preferred address, so
+                 * just allocate some memory and hope for the best.
+                 */
+                ret = emalloc(init_size, buf->hdr.kernel_alignment, kernel_start);
+                if (EFI_ERROR(ret))
+                        return ret;
+                /* code32_start is only 32 bits wide */
+                if (*kernel_start + init_size > 0x100000000ULL) {
+                        efree(*kernel_start, init_size);
+                        return EFI_OUT_OF_RESOURCES;
+                }
+        }
+        boot_plan_set_placement(BOOT_PLAN_KERNEL, *kernel_start, init_size);
+
+        memcpy((CHAR8 *)(UINTN)*kernel_start, kernel, ksize);
+        return EFI_SUCCESS;
+}
+
+/*
+ * Enter the kernel through its EFI stub while boot services are still
+ * running. The stub fills the screen info from GOP, builds the memory
+ * map and calls ExitBootServices, so we only hand it a boot_params with
+ * the command line and the ramdisk. The kernel is placed as for the
+ * legacy boot: the stub may decompress it in place, which needs
+ * init_size bytes at code32_start.
+ */
+static EFI_STATUS efi_handover_kernel(CHAR8 *bootimage, BOOLEAN watchdog_en)
+{
+	EFI_PHYSICAL_ADDRESS kernel_start;
+	EFI_PHYSICAL_ADDRESS boot_addr;
+	EFI_PHYSICAL_ADDRESS state_addr = 0;
+	struct boot_params *boot_params;
+	struct boot_img_hdr *aosp_header;
+	struct boot_params *buf;
+	UINT32 setup_size;
+	UINT32 ksize;
+	EFI_STATUS ret;
+
+	aosp_header = (struct boot_img_hdr *)bootimage;
+	buf = (struct boot_params *)(bootimage + aosp_header->page_size);
+
+	setup_size = ((UINT32)buf->hdr.setup_sects + 1) * 512;
+	ksize = aosp_header->kernel_size - setup_size;
+	buf->hdr.type_of_loader = 0xff;
+
+	ret = place_kernel(buf, bootimage + aosp_header->page_size + setup_size,
+			   ksize, &kernel_start);
+	if (EFI_ERROR(ret))
+		return ret;
+	debug(L"EFI handover, kernel_start = 0x%x\n", kernel_start);
+
+	boot_addr = 0x3fffffff;
+	ret = allocate_pages(AllocateMaxAddress, EfiLoaderData,
+			     EFI_SIZE_TO_PAGES(16384), &boot_addr);
+	if (EFI_ERROR(ret))
+		goto out;
+
+	boot_params = (struct boot_params *)(UINTN)boot_addr;
+	memset((void *)boot_params, 0x0, 16384);
+
+	/* Copy first two sectors to boot_params */
+	memcpy((CHAR8 *)boot_params, (CHAR8 *)buf, 2 * 512);
+	boot_params->hdr.code32_start = (UINT32)kernel_start;
+
+	ret = loader_state_setup_data(boot_params, &state_addr);
+	if (EFI_ERROR(ret))
+		warning(L"Loader state not handed over: %r\n", ret);
+
+	fs_close();
+
+	if (watchdog_en) {
+		ret = watchdog->ops.start(watchdog);
+		if (EFI_ERROR(ret))
+			warning(L"watchdog not started: %r\n", ret);
+	}
+
+	boot_plan_commit();
+	loader_ops.hook_before_exit();
+	loader_ops.hook_before_jump();
+
+	handover_jump(buf->hdr.version, main_image_handle, boot_params, kernel_start);
+	/* Shouldn't get here */
+
+	if (state_addr)
+		free_pages(state_addr, 1);
+	free_pages(boot_addr, EFI_SIZE_TO_PAGES(16384));
+	ret = EFI_LOAD_ERROR;
+out:
+	efree(kernel_start, buf->hdr.init_size);
+	return ret;
+}
+
+static EFI_STATUS handover_kernel(CHAR8 *bootimage, EFI_HANDLE parent_image,
+                                  BOOLEAN watchdog_en,
+                                  enum kernel_handover handover)
 {
         EFI_PHYSICAL_ADDRESS kernel_start;
         EFI_PHYSICAL_ADDRESS boot_addr;
+        EFI_PHYSICAL_ADDRESS state_addr = 0;
         struct boot_params *boot_params;
         UINT64 init_size;
         EFI_STATUS ret;
@@ -474,12 +636,22 @@ static EFI_STATUS handover_kernel(CHAR8 *bootimage, EFI_HANDLE parent_image, BOO
         aosp_header = (struct boot_img_hdr *)bootimage;
         buf = (struct boot_params *)(bootimage + aosp_header->page_size);
 
+        if (handover == KERNEL_HANDOVER_DEFAULT)
+                handover = use_efi_handover ? KERNEL_HANDOVER_EFI :
+                        KERNEL_HANDOVER_LEGACY;
+
+        /* The EFI stub runs the kernel from the image itself */
+        if (handover == KERNEL_HANDOVER_EFI) {
+                if (has_efi_handover(buf))
+                        return efi_handover_kernel(bootimage, watchdog_en);
+                warning(L"Kernel has no EFI handover support, using legacy boot\n");
+        }
+
         koffset = aosp_header->page_size;
         setup_sectors = buf->hdr.setup_sects;
         setup_sectors++; /* Add boot sector */
         setup_size = (UINT32)setup_sectors * 512;
         ksize = aosp_header->kernel_size - setup_size;
-        kernel_start = buf->hdr.pref_address;
         init_size = buf->hdr.init_size;
         buf->hdr.type_of_loader = 0xff;
 
@@ -487,17 +659,10 @@ static EFI_STATUS handover_kernel(CHAR8 *bootimage, EFI_HANDLE parent_image, BOO
 
 	setup_screen_info_from_gop(&buf->screen_info);
 
-        ret = allocate_pages(AllocateAddress, EfiLoaderData,
-                             EFI_SIZE_TO_PAGES(init_size), &kernel_start);
-        if (EFI_ERROR(ret)) {
-                /*
-                 * We failed to allocate the preferred address, so
-                 * just allocate some memory and hope for the best.
-                 */
-                ret = emalloc(init_size, buf->hdr.kernel_alignment, &kernel_start);
-                if (EFI_ERROR(ret))
-                        return ret;
-        }
+        ret = place_kernel(buf, bootimage + koffset + setup_size, ksize,
+                           &kernel_start);
+        if (EFI_ERROR(ret))
+                return ret;
 	debug(L"kernel_start = 0x%x\n", kernel_start);
 
 	if (!buf->hdr.relocatable_kernel && kernel_start != buf->hdr.pref_address) {
@@ -506,8 +671,6 @@ static EFI_STATUS handover_kernel(CHAR8 *bootimage, EFI_HANDLE parent_image, BOO
 		goto out;
 	}
 
-        memcpy((CHAR8 *)(UINTN)kernel_start, bootimage + koffset + setup_size, ksize);
-
         boot_addr = 0x3fffffff;
         ret = allocate_pages(AllocateMaxAddress, EfiLoaderData,
                              EFI_SIZE_TO_PAGES(16384), &boot_addr);
@@ -521,7 +684,9 @@ static EFI_STATUS handover_kernel(CHAR8 *bootimage, EFI_HANDLE parent_image, BOO
         memcpy((CHAR8 *)boot_params, (CHAR8 *)buf, 2 * 512);
         boot_params->hdr.code32_start = (UINT32)((UINT64)kernel_start);
 
-        ret = EFI_LOAD_ERROR;
+        ret = loader_state_setup_data(boot_params, &state_addr);
+        if (EFI_ERROR(ret))
+                warning(L"Loader state not handed over: %r\n", ret);
 
 	ret = setup_idt_gdt();
 	if (EFI_ERROR(ret))
@@ -535,6 +700,7 @@ static EFI_STATUS handover_kernel(CHAR8 *bootimage, EFI_HANDLE parent_image, BOO
 			warning(L"watchdog not started: %r\n", ret);
 	}
 
+	boot_plan_commit();
 	loader_ops.hook_before_exit();
 
 	UINTN map_key;
@@ -561,16 +727,118 @@ static EFI_STATUS handover_kernel(CHAR8 *bootimage, EFI_HANDLE parent_image, BOO
 
         free_pages(boot_addr, EFI_SIZE_TO_PAGES(16384));
 out:
+        if (state_addr)
+                free_pages(state_addr, 1);
 	debug(L"Can't boot kernel\n");
-        efree(kernel_start, ksize);
+        efree(kernel_start, init_size);
         return ret;
 }
 
 
+/* Partition opened by the last android_image_check_partition() call,
+ * reused by android_image_start_partition() if it loads the same one */
+static struct {
+        BOOLEAN valid;
+        EFI_GUID guid;
+        UINT32 MediaId;
+        EFI_BLOCK_IO *BlockIo;
+        EFI_DISK_IO *DiskIo;
+        struct boot_img_hdr header;
+} checked;
+
+static BOOLEAN is_power_of_2(UINT32 n)
+{
+        return n && !(n & (n - 1));
+}
+
+EFI_STATUS android_image_check_partition(
+                IN const EFI_GUID *guid)
+{
+        EFI_BLOCK_IO *BlockIo;
+        EFI_DISK_IO *DiskIo;
+        UINT32 MediaId;
+        EFI_STATUS ret;
+        struct boot_img_hdr *aosp_header = &checked.header;
+        struct setup_header setup;
+        UINT64 partition_size, img_size, page_size;
+
+        checked.valid = FALSE;
+
+        ret = boot_plan_open_partition(guid, &MediaId, &BlockIo, &DiskIo,
+                        aosp_header, sizeof(*aosp_header));
+        if (EFI_ERROR(ret))
+                return ret;
+
+        if (strncmpa((CHAR8 *)BOOT_MAGIC, aosp_header->magic, BOOT_MAGIC_SIZE)) {
+                error(L"This partition does not appear to contain an Android boot image\n");
+                return EFI_INVALID_PARAMETER;
+        }
+
+        page_size = aosp_header->page_size;
+        if (!is_power_of_2(page_size) || page_size < 2048 || page_size > 131072) {
+                error(L"Invalid boot image page size %d\n", page_size);
+                return EFI_INVALID_PARAMETER;
+        }
+
+        /* Computed on 64 bits, corrupted sizes must not wrap around */
+        img_size = page_size *
+                (1 + (UINT64)pages(aosp_header, aosp_header->kernel_size) +
+                 pages(aosp_header, aosp_header->ramdisk_size) +
+                 pages(aosp_header, aosp_header->second_size) +
+                 pages(aosp_header, aosp_header->sig_size));
+        partition_size = (BlockIo->Media->LastBlock + 1) *
+                BlockIo->Media->BlockSize;
+        if (img_size > partition_size) {
+                error(L"Boot image size %ld exceeds the partition size %ld\n",
+                      img_size, partition_size);
+                return EFI_INVALID_PARAMETER;
+        }
+
+#ifndef DISABLE_SECURE_BOOT
+        if (!aosp_header->sig_size && is_secure_boot_enabled()) {
+                error(L"Image is not signed\n");
+                return EFI_LOAD_ERROR;
+        }
+#endif
+
+        ret = io_read_disk(DiskIo, MediaId,
+                        page_size + offsetof(struct boot_params, hdr),
+                        sizeof(setup), &setup);
+        if (EFI_ERROR(ret)) {
+                error(L"ReadDisk (setup header) : %r\n", ret);
+                return ret;
+        }
+
+        if (setup.boot_flag != 0xAA55) {
+                error(L"bzImage kernel corrupt\n");
+                return EFI_INVALID_PARAMETER;
+        }
+        if (setup.header != SETUP_HDR) {
+                error(L"Setup code version is invalid\n");
+                return EFI_INVALID_PARAMETER;
+        }
+        if (((UINT32)setup.setup_sects + 1) * 512 >= aosp_header->kernel_size) {
+                error(L"Kernel setup code exceeds the kernel size\n");
+                return EFI_INVALID_PARAMETER;
+        }
+
+        memcpy(&checked.guid, guid, sizeof(checked.guid));
+        checked.MediaId = MediaId;
+        checked.BlockIo = BlockIo;
+        checked.DiskIo = DiskIo;
+        checked.valid = TRUE;
+        return EFI_SUCCESS;
+}
+
+static EFI_STATUS start_buffer(EFI_HANDLE parent_image, VOID *bootimage,
+                               struct cmdline *cmdline,
+                               enum kernel_handover handover);
+
 EFI_STATUS android_image_start_partition(
                 IN EFI_HANDLE parent_image,
                 IN const EFI_GUID *guid,
-                IN CHAR8 *cmdline)
+                IN struct cmdline *cmdline,
+                IN enum kernel_handover handover)
 {
         EFI_BLOCK_IO *BlockIo;
         EFI_DISK_IO *DiskIo;
@@ -580,18 +848,20 @@ EFI_STATUS android_image_start_partition(
         EFI_STATUS ret;
         struct boot_img_hdr aosp_header;
 
-        debug(L"Locating boot image\n");
-        ret = open_partition(guid, &MediaId, &BlockIo, &DiskIo);
-        if (EFI_ERROR(ret))
-                return ret;
-
-        debug(L"Reading boot image header\n");
-        ret = uefi_call_wrapper(DiskIo->ReadDisk, 5, DiskIo, MediaId, 0,
-                        sizeof(aosp_header), &aosp_header);
-        if (EFI_ERROR(ret)) {
-                error(L"ReadDisk (header) : %r\n", ret);
-                return ret;
+        phase_set(PHASE_LOAD_IMAGE);
+        if (checked.valid && !memcmp(&checked.guid, guid, sizeof(*guid))) {
+                MediaId = checked.MediaId;
+                BlockIo = checked.BlockIo;
+                DiskIo = checked.DiskIo;
+                memcpy(&aosp_header, &checked.header, sizeof(aosp_header));
+        } else {
+                debug(L"Locating boot image and reading its header\n");
+                ret = boot_plan_open_partition(guid, &MediaId, &BlockIo, &DiskIo,
+                                &aosp_header, sizeof(aosp_header));
+                if (EFI_ERROR(ret))
+                        return ret;
         }
+        checked.valid = FALSE;
         if (strncmpa((CHAR8 *)BOOT_MAGIC, aosp_header.magic, BOOT_MAGIC_SIZE)) {
                 error(L"This partition does not appear to contain an Android boot image\n");
                 return EFI_INVALID_PARAMETER;
@@ -603,14 +873,13 @@ EFI_STATUS android_image_start_partition(
                 return EFI_OUT_OF_RESOURCES;
 
         debug(L"Reading full boot image\n");
-        ret = uefi_call_wrapper(DiskIo->ReadDisk, 5, DiskIo, MediaId, 0,
-                        img_size, bootimage);
+        ret = io_read_disk(DiskIo, MediaId, 0, img_size, bootimage);
         if (EFI_ERROR(ret)) {
                 error(L"ReadDisk : %r\n", ret);
                 goto out;
         }
 
-        ret = android_image_start_buffer(parent_image, bootimage, cmdline);
+        ret = start_buffer(parent_image, bootimage, cmdline, handover);
 out:
         FreePool(bootimage);
         return ret;
@@ -621,7 +890,7 @@ EFI_STATUS android_image_start_file(
                 IN EFI_HANDLE parent_image,
                 IN EFI_HANDLE device,
                 IN CHAR16 *loader,
-                IN CHAR8 *cmdline)
+                IN struct cmdline *cmdline)
 {
         EFI_STATUS ret;
         VOID *bootimage;
@@ -664,6 +933,7 @@ EFI_STATUS android_image_start_file(
                 error(L"Open : %r\n", ret);
                 return ret;
         }
+        io_stats_open_file(imagefile, loader);
         fileinfo = AllocatePool(buffersize);
         if (!fileinfo)
                 return EFI_OUT_OF_RESOURCES;
@@ -692,8 +962,7 @@ EFI_STATUS android_image_start_file(
         }
 
         /* Read the file into the buffer */
-        ret = uefi_call_wrapper(imagefile->Read, 3, imagefile,
-                        &buffersize, bootimage);
+        ret = io_file_read(imagefile, &buffersize, bootimage);
         if (ret == EFI_BUFFER_TOO_SMALL) {
                 /* buffersize updated with the required space for
                  * the request. By the way it doesn't make any
@@ -706,8 +975,7 @@ EFI_STATUS android_image_start_file(
                         ret = EFI_OUT_OF_RESOURCES;
                         goto out;
                 }
-                ret = uefi_call_wrapper(imagefile->Read, 3, imagefile,
-                        &buffersize, bootimage);
+                ret = io_file_read(imagefile, &buffersize, bootimage);
         }
         if (EFI_ERROR(ret)) {
                 error(L"Read : %r\n", ret);
@@ -735,13 +1003,13 @@ free_info:
 }
 
 
-EFI_STATUS android_image_start_buffer(
-                IN EFI_HANDLE parent_image,
-                IN VOID *bootimage,
-                IN CHAR8 *cmdline)
+static EFI_STATUS start_buffer(EFI_HANDLE parent_image, VOID *bootimage,
+                               struct cmdline *cmdline,
+                               enum kernel_handover handover)
 {
         struct boot_img_hdr *aosp_header;
         struct boot_params *buf;
+        struct cmdline full_cmdline;
         EFI_STATUS ret;
         aosp_header = (struct boot_img_hdr *)bootimage;
         buf = (struct boot_params *)(bootimage + aosp_header->page_size);
@@ -751,58 +1019,79 @@ EFI_STATUS android_image_start_buffer(
         if (buf->hdr.boot_flag != 0xAA55) {
                 error(L"bzImage kernel corrupt\n");
                 ret = EFI_INVALID_PARAMETER;
-                goto out_bootimage;
+                goto out;
         }
 
         if (buf->hdr.header != SETUP_HDR) {
                 error(L"Setup code version is invalid\n");
                 ret = EFI_INVALID_PARAMETER;
-                goto out_bootimage;
+                goto out;
         }
 
 
 #ifndef DISABLE_SECURE_BOOT
         if (is_secure_boot_enabled()) {
                  debug(L"Verifying the boot image\n");
+                 phase_set(PHASE_VERIFY);
                  ret = verify_boot_image(bootimage);
                  if (EFI_ERROR(ret)) {
                          error(L"boot image digital signature verification failed : %r\n", ret);
-                         goto out_bootimage;
+                         goto out;
                  }
          }
 #endif
 
 
+        loader_state_mark((CHAR8 *)"image_ready");
+
         debug(L"Creating command line\n");
-        ret = setup_command_line(bootimage, cmdline);
+        cmdline_init(&full_cmdline);
+        ret = cmdline_add_split(&full_cmdline,
+                                aosp_header->cmdline, BOOT_ARGS_SIZE - 1,
+                                aosp_header->extra_cmdline, BOOT_EXTRA_ARGS_SIZE);
+        if (!EFI_ERROR(ret))
+                ret = cmdline_append(&full_cmdline, cmdline);
+        if (!EFI_ERROR(ret))
+                ret = setup_command_line(bootimage, &full_cmdline);
         if (EFI_ERROR(ret)) {
                 error(L"setup_command_line : %r\n", ret);
-                goto out_bootimage;
+                goto out;
         }
 
         debug(L"Loading the ramdisk\n");
+        phase_set(PHASE_RAMDISK);
         ret = setup_ramdisk(bootimage);
         if (EFI_ERROR(ret)) {
                 error(L"setup_ramdisk : %r\n", ret);
                 goto out_cmdline;
         }
 
-        if (buf->hdr.cmd_line_ptr)
-                watchdog_en = strstr((CHAR8 *)buf->hdr.cmd_line_ptr, "disable_kernel_watchdog=1") ? FALSE : TRUE;
+        watchdog_en = !cmdline_has_value(&full_cmdline,
+                                         (CHAR8 *)"disable_kernel_watchdog",
+                                         (CHAR8 *)"1");
 
         debug(L"Loading the kernel\n");
-        ret = handover_kernel(bootimage, parent_image, watchdog_en);
+        phase_set(PHASE_HANDOVER);
+        ret = handover_kernel(bootimage, parent_image, watchdog_en, handover);
         error(L"handover_kernel %r", ret);
 
-        efree(buf->hdr.ramdisk_image, buf->hdr.ramdisk_size);
+        efree(buf->hdr.ramdisk_image, ramdisk_alloc_size(aosp_header));
 out_cmdline:
         if (buf->hdr.cmd_line_ptr)
             free_pages(buf->hdr.cmd_line_ptr,
-                strlena((CHAR8 *)(UINTN)buf->hdr.cmd_line_ptr) + 1);
-out_bootimage:
-        FreePool(bootimage);
+                EFI_SIZE_TO_PAGES(buf->hdr.cmdline_size));
+out:
         return ret;
 }
 
+EFI_STATUS android_image_start_buffer(
+                IN EFI_HANDLE parent_image,
+                IN VOID *bootimage,
+                IN struct cmdline *cmdline)
+{
+        return start_buffer(parent_image, bootimage, cmdline,
+                            KERNEL_HANDOVER_DEFAULT);
+}
+
 /* vim: softtabstop=8:shiftwidth=8:expandtab
  */
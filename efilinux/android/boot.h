@@ -18,28 +18,58 @@
 
 #include <efi.h>
 #include <efilib.h>
+#include "cmdline.h"
 
 #define XLF_EFI_HANDOVER_32     (1<<2)
 #define XLF_EFI_HANDOVER_64     (1<<3)
 
+/* How the kernel is entered, KERNEL_HANDOVER_DEFAULT follows
+ * set_kernel_handover() */
+enum kernel_handover {
+        KERNEL_HANDOVER_DEFAULT,
+        KERNEL_HANDOVER_EFI,
+        KERNEL_HANDOVER_LEGACY,
+};
+
 /* Functions to load an Android boot image.
  * You can do this from a file, a partition GUID, or
  * from a RAM buffer */
 EFI_STATUS android_image_start_buffer(
                 IN EFI_HANDLE parent_image,
                 IN VOID *bootimage,
-                IN CHAR8 *install_id);
+                IN struct cmdline *cmdline);
 
 EFI_STATUS android_image_start_file(
                 IN EFI_HANDLE parent_image,
                 IN EFI_HANDLE device,
                 IN CHAR16 *loader,
-                IN CHAR8 *install_id);
+                IN struct cmdline *cmdline);
 
 EFI_STATUS android_image_start_partition(
                 IN EFI_HANDLE parent_image,
                 IN const EFI_GUID *guid,
-                IN CHAR8 *install_id);
+                IN struct cmdline *cmdline,
+                IN enum kernel_handover handover);
+
+/* Check from the image headers alone that the boot image of partition
+ * GUID is not bound to fail loading: magic, page size, section sizes
+ * against the partition size, signature presence and kernel setup
+ * header. A following android_image_start_partition() call on the same
+ * partition reuses what was read. */
+EFI_STATUS android_image_check_partition(
+                IN const EFI_GUID *guid);
+
+/* Select how the kernel is entered: "efi" goes through the kernel EFI
+ * stub (handover protocol), "legacy" exits boot services here and jumps
+ * to the 64/32-bit entry point. Kernels without handover support always
+ * use the legacy path. */
+EFI_STATUS set_kernel_handover(
+                IN const CHAR16 *name);
+
+/* Parse a handover name ("efi" or "legacy") */
+EFI_STATUS kernel_handover_from_name(
+                IN const CHAR16 *name,
+                OUT enum kernel_handover *handover);
 
 /* Load the next boot target if specified in the BCB partition,
  * which we specify by partition GUID. Place the value in var,
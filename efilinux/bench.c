@@ -0,0 +1,583 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "stdlib.h"
+#include "utils.h"
+#include "uefi_utils.h"
+#include "intel_partitions.h"
+#include "platform/x86.h"
+#include "bench.h"
+
+#define BENCH_MIN_CHUNK		(4 * 1024)
+#define BENCH_MAX_CHUNK		(8 * 1024 * 1024)
+/* Bytes read from the partition for each chunk size and method */
+#define BENCH_DISK_BYTES	(32 * 1024 * 1024)
+/* Bytes copied or set for each size and method */
+#define BENCH_MEM_BYTES		(64 * 1024 * 1024)
+#define BENCH_CSV_WRITE_SIZE	4096
+
+/* Each SetVariable on a non-volatile variable wears the flash */
+#define BENCH_VAR_VOLATILE_COUNT	100
+#define BENCH_VAR_NV_COUNT		8
+#define BENCH_VAR_MAX_SIZE		4096
+
+#define BENCH_GOP_COUNT		10
+#define BENCH_PROTOCOL_COUNT	1000
+#define BENCH_MEMMAP_COUNT	100
+
+extern EFI_GUID GraphicsOutputProtocol;
+
+static EFI_GUID bench_guid = { 0x5e9b6b0c, 0x62a1, 0x4d8a, { 0x9c, 0x13, 0x2f, 0x6e, 0x4a, 0x10, 0xbe, 0x8c } };
+
+struct bench_report {
+	struct uefi_stream stream;
+	BOOLEAN csv;
+};
+
+typedef EFI_STATUS (*bench_func)(struct bench_report *report, CHAR8 *args);
+
+static UINT64 tsc_khz;
+
+static UINT64 cycles_to_ns(UINT64 cycles)
+{
+	if (!tsc_khz) {
+		UINT64 start = rdtsc();
+
+		uefi_call_wrapper(BS->Stall, 1, 10000);
+		tsc_khz = (rdtsc() - start) / 10;
+	}
+
+	return cycles * 1000000 / tsc_khz;
+}
+
+/* Copy the next space separated word of *ARGS to WORD */
+static BOOLEAN next_word(CHAR8 **args, CHAR8 *word, UINTN size)
+{
+	CHAR8 *p = *args;
+	UINTN i = 0;
+
+	if (!p)
+		return FALSE;
+
+	while (*p == ' ')
+		p++;
+	while (*p && *p != ' ') {
+		if (i < size - 1)
+			word[i++] = *p;
+		p++;
+	}
+	word[i] = '\0';
+
+	*args = p;
+	return i != 0;
+}
+
+static BOOLEAN has_word(CHAR8 *args, const char *expected)
+{
+	CHAR8 word[32];
+
+	while (next_word(&args, word, sizeof(word)))
+		if (!strcmpa(word, (CHAR8 *)expected))
+			return TRUE;
+	return FALSE;
+}
+
+static void bench_result(struct bench_report *report, CHAR16 *test,
+			 UINTN size, UINTN count, UINT64 cycles)
+{
+	UINT64 ns = cycles_to_ns(cycles);
+	UINT64 per_op = count ? ns / count : 0;
+	UINT64 mbps = ns ? (UINT64)size * count * 1000 / ns : 0;
+	CHAR16 line[128];
+	CHAR8 line8[128];
+
+	info(L"%-22s %8d x %-5d %10ld ns/op %6ld MB/s\n", test, size, count,
+	     per_op, mbps);
+
+	if (!report->csv)
+		return;
+
+	SPrint(line, sizeof(line), L"%s,%d,%d,%ld,%ld,%ld\n", test, size,
+	       count, ns, per_op, mbps);
+	str_to_stra(line8, line, sizeof(line8));
+	uefi_stream_write(&report->stream, line8, strlena(line8));
+}
+
+static EFI_STATUS bench_disk_run(struct bench_report *report, CHAR8 *args)
+{
+	CHAR8 word[32];
+	CHAR16 *name = L"main", *arg = NULL;
+	EFI_GUID guid;
+	EFI_BLOCK_IO *block_io;
+	EFI_DISK_IO *disk_io;
+	EFI_PHYSICAL_ADDRESS buffer;
+	UINT32 media_id;
+	UINT64 part_size, total, block_base, start;
+	UINTN chunk, count, i;
+	EFI_STATUS ret;
+
+	while (next_word(&args, word, sizeof(word))) {
+		if (strcmpa(word, (CHAR8 *)"csv")) {
+			arg = stra_to_str(word);
+			if (!arg)
+				return EFI_OUT_OF_RESOURCES;
+			name = arg;
+			break;
+		}
+	}
+
+	ret = name_to_guid(name, &guid);
+	if (EFI_ERROR(ret)) {
+		error(L"Unknown target name %s\n", name);
+		goto out;
+	}
+
+	ret = open_partition(&guid, &media_id, &block_io, &disk_io);
+	if (EFI_ERROR(ret)) {
+		error(L"Failed to open partition %s: %r\n", name, ret);
+		goto out;
+	}
+
+	ret = emalloc(BENCH_MAX_CHUNK, EFI_PAGE_SIZE, &buffer);
+	if (EFI_ERROR(ret))
+		goto out;
+
+	part_size = MultU64x32(block_io->Media->LastBlock + 1,
+			       block_io->Media->BlockSize);
+	total = part_size < BENCH_DISK_BYTES ? part_size : BENCH_DISK_BYTES;
+	/* Read a different area with BlockIo in case the firmware caches */
+	block_base = part_size >= 2 * total ? total : 0;
+
+	info(L"Reading %ld bytes from partition %s\n", total, name);
+
+	for (chunk = BENCH_MIN_CHUNK; chunk <= BENCH_MAX_CHUNK && chunk <= total;
+	     chunk *= 2) {
+		count = total / chunk;
+
+		start = rdtsc();
+		for (i = 0; i < count; i++) {
+			ret = uefi_call_wrapper(disk_io->ReadDisk, 5, disk_io,
+						media_id, (UINT64)i * chunk,
+						chunk, (VOID *)(UINTN)buffer);
+			if (EFI_ERROR(ret))
+				goto free_buffer;
+		}
+		bench_result(report, L"diskio_read", chunk, count, rdtsc() - start);
+
+		if (chunk % block_io->Media->BlockSize)
+			continue;
+
+		start = rdtsc();
+		for (i = 0; i < count; i++) {
+			ret = uefi_call_wrapper(block_io->ReadBlocks, 5, block_io,
+						media_id,
+						(block_base + (UINT64)i * chunk) /
+						block_io->Media->BlockSize,
+						chunk, (VOID *)(UINTN)buffer);
+			if (EFI_ERROR(ret))
+				goto free_buffer;
+		}
+		bench_result(report, L"blockio_read", chunk, count, rdtsc() - start);
+	}
+
+free_buffer:
+	if (EFI_ERROR(ret))
+		error(L"Read of %d bytes failed: %r\n", chunk, ret);
+	efree(buffer, BENCH_MAX_CHUNK);
+out:
+	if (arg)
+		free(arg);
+	return ret;
+}
+
+static EFI_STATUS bench_mem_run(struct bench_report *report, CHAR8 *args)
+{
+	EFI_PHYSICAL_ADDRESS src, dst;
+	CHAR16 test[32];
+	UINT64 start;
+	UINTN size, count, i;
+	enum mem_method m;
+	EFI_STATUS ret;
+
+	ret = emalloc(BENCH_MAX_CHUNK, EFI_PAGE_SIZE, &src);
+	if (EFI_ERROR(ret))
+		return ret;
+	ret = emalloc(BENCH_MAX_CHUNK, EFI_PAGE_SIZE, &dst);
+	if (EFI_ERROR(ret))
+		goto free_src;
+
+	/* Touch the buffers so that the first run is not penalized */
+	mem_set((VOID *)(UINTN)src, 0x5a, BENCH_MAX_CHUNK);
+	mem_set((VOID *)(UINTN)dst, 0, BENCH_MAX_CHUNK);
+
+	for (m = 0; m < MEM_METHOD_MAX; m++) {
+		if (!mem_method_supported(m))
+			continue;
+
+		for (size = BENCH_MIN_CHUNK; size <= BENCH_MAX_CHUNK; size *= 2) {
+			count = BENCH_MEM_BYTES / size;
+			if (count < 4)
+				count = 4;
+
+			start = rdtsc();
+			for (i = 0; i < count; i++)
+				mem_copy_method(m, (VOID *)(UINTN)dst,
+						(VOID *)(UINTN)src, size);
+			SPrint(test, sizeof(test), L"memcpy_%s", mem_method_name(m));
+			bench_result(report, test, size, count, rdtsc() - start);
+
+			start = rdtsc();
+			for (i = 0; i < count; i++)
+				mem_set_method(m, (VOID *)(UINTN)dst, i, size);
+			SPrint(test, sizeof(test), L"memset_%s", mem_method_name(m));
+			bench_result(report, test, size, count, rdtsc() - start);
+		}
+	}
+
+	efree(dst, BENCH_MAX_CHUNK);
+free_src:
+	efree(src, BENCH_MAX_CHUNK);
+	return ret;
+}
+
+static EFI_STATUS bench_var_one(struct bench_report *report, CHAR16 *name,
+				UINT32 attributes, UINTN count)
+{
+	static const UINTN sizes[] = { 16, 256, 1024, BENCH_VAR_MAX_SIZE };
+	UINT8 *data;
+	CHAR16 test[32];
+	UINTN i, j, size;
+	UINT64 start;
+	EFI_STATUS ret = EFI_SUCCESS;
+
+	data = AllocateZeroPool(BENCH_VAR_MAX_SIZE);
+	if (!data)
+		return EFI_OUT_OF_RESOURCES;
+
+	for (i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+		start = rdtsc();
+		for (j = 0; j < count; j++) {
+			/* Firmwares may skip writes of identical content */
+			data[0] = j;
+			ret = uefi_call_wrapper(RT->SetVariable, 5, name,
+						&bench_guid, attributes,
+						sizes[i], data);
+			if (EFI_ERROR(ret))
+				goto out;
+		}
+		SPrint(test, sizeof(test), L"setvar_%s", name);
+		bench_result(report, test, sizes[i], count, rdtsc() - start);
+
+		start = rdtsc();
+		for (j = 0; j < count; j++) {
+			size = BENCH_VAR_MAX_SIZE;
+			ret = uefi_call_wrapper(RT->GetVariable, 5, name,
+						&bench_guid, NULL, &size, data);
+			if (EFI_ERROR(ret))
+				goto out;
+		}
+		SPrint(test, sizeof(test), L"getvar_%s", name);
+		bench_result(report, test, sizes[i], count, rdtsc() - start);
+	}
+
+out:
+	if (EFI_ERROR(ret))
+		error(L"Variable %s access failed: %r\n", name, ret);
+	uefi_call_wrapper(RT->SetVariable, 5, name, &bench_guid, attributes,
+			  0, NULL);
+	FreePool(data);
+	return ret;
+}
+
+static EFI_STATUS bench_var_run(struct bench_report *report, CHAR8 *args)
+{
+	EFI_STATUS ret;
+
+	ret = bench_var_one(report, L"volatile", EFI_VARIABLE_BOOTSERVICE_ACCESS |
+			    EFI_VARIABLE_RUNTIME_ACCESS, BENCH_VAR_VOLATILE_COUNT);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	return bench_var_one(report, L"nv", EFI_VARIABLE_NON_VOLATILE |
+			     EFI_VARIABLE_BOOTSERVICE_ACCESS |
+			     EFI_VARIABLE_RUNTIME_ACCESS, BENCH_VAR_NV_COUNT);
+}
+
+static EFI_STATUS bench_gop_run(struct bench_report *report, CHAR8 *args)
+{
+	EFI_GRAPHICS_OUTPUT_PROTOCOL *gop;
+	EFI_GRAPHICS_OUTPUT_BLT_PIXEL black = { 0, 0, 0, 0 };
+	EFI_GRAPHICS_OUTPUT_BLT_PIXEL *blt;
+	UINTN width, height, size, i;
+	UINT64 start;
+	EFI_STATUS ret;
+
+	ret = uefi_locate_protocol(&GraphicsOutputProtocol, (VOID **)&gop);
+	if (EFI_ERROR(ret) || !gop) {
+		error(L"No graphics output: %r\n", ret);
+		return ret;
+	}
+
+	width = gop->Mode->Info->HorizontalResolution;
+	height = gop->Mode->Info->VerticalResolution;
+	size = width * height * sizeof(*blt);
+	info(L"Graphics output %dx%d\n", width, height);
+
+	blt = AllocatePool(size);
+	if (!blt)
+		return EFI_OUT_OF_RESOURCES;
+	memset(blt, 0x80, size);
+
+	start = rdtsc();
+	for (i = 0; i < BENCH_GOP_COUNT; i++) {
+		ret = uefi_call_wrapper(gop->Blt, 10, gop, &black, EfiBltVideoFill,
+					0, 0, 0, 0, width, height, 0);
+		if (EFI_ERROR(ret))
+			goto out;
+	}
+	bench_result(report, L"blt_fill", size, BENCH_GOP_COUNT, rdtsc() - start);
+
+	start = rdtsc();
+	for (i = 0; i < BENCH_GOP_COUNT; i++) {
+		ret = uefi_call_wrapper(gop->Blt, 10, gop, blt, EfiBltBufferToVideo,
+					0, 0, 0, 0, width, height, 0);
+		if (EFI_ERROR(ret))
+			goto out;
+	}
+	bench_result(report, L"blt_buffer_to_video", size, BENCH_GOP_COUNT,
+		     rdtsc() - start);
+
+	start = rdtsc();
+	for (i = 0; i < BENCH_GOP_COUNT; i++) {
+		ret = uefi_call_wrapper(gop->Blt, 10, gop, NULL, EfiBltVideoToVideo,
+					0, 0, 0, height / 2, width, height / 2, 0);
+		if (EFI_ERROR(ret))
+			goto out;
+	}
+	bench_result(report, L"blt_video_to_video", size / 2, BENCH_GOP_COUNT,
+		     rdtsc() - start);
+
+	start = rdtsc();
+	for (i = 0; i < BENCH_GOP_COUNT; i++) {
+		ret = uefi_call_wrapper(gop->Blt, 10, gop, blt, EfiBltVideoToBltBuffer,
+					0, 0, 0, 0, width, height, 0);
+		if (EFI_ERROR(ret))
+			goto out;
+	}
+	bench_result(report, L"blt_video_to_buffer", size, BENCH_GOP_COUNT,
+		     rdtsc() - start);
+
+out:
+	if (EFI_ERROR(ret))
+		error(L"Blt failed: %r\n", ret);
+	uefi_call_wrapper(gop->Blt, 10, gop, &black, EfiBltVideoFill,
+			  0, 0, 0, 0, width, height, 0);
+	FreePool(blt);
+	return ret;
+}
+
+static EFI_STATUS bench_protocol_run(struct bench_report *report, CHAR8 *args)
+{
+	static struct {
+		CHAR16 *name;
+		EFI_GUID *guid;
+	} protocols[] = {
+		{ L"block_io", &BlockIoProtocol },
+		{ L"gop", &GraphicsOutputProtocol },
+		{ L"text_in", &TextInProtocol },
+	};
+	CHAR16 test[48];
+	VOID *interface;
+	UINT64 start;
+	UINTN i, j;
+
+	for (i = 0; i < sizeof(protocols) / sizeof(*protocols); i++) {
+		start = rdtsc();
+		for (j = 0; j < BENCH_PROTOCOL_COUNT; j++)
+			LibLocateProtocol(protocols[i].guid, &interface);
+		SPrint(test, sizeof(test), L"locate_%s", protocols[i].name);
+		bench_result(report, test, 0, BENCH_PROTOCOL_COUNT, rdtsc() - start);
+
+		start = rdtsc();
+		for (j = 0; j < BENCH_PROTOCOL_COUNT; j++)
+			uefi_locate_protocol(protocols[i].guid, &interface);
+		SPrint(test, sizeof(test), L"locate_cached_%s", protocols[i].name);
+		bench_result(report, test, 0, BENCH_PROTOCOL_COUNT, rdtsc() - start);
+	}
+
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS bench_memmap_run(struct bench_report *report, CHAR8 *args)
+{
+	EFI_MEMORY_DESCRIPTOR *map;
+	UINTN size = 0, alloc_size, key, desc_size, i;
+	UINT32 desc_version;
+	UINT64 start;
+	EFI_STATUS ret;
+
+	ret = get_memory_map(&size, NULL, &key, &desc_size, &desc_version);
+	if (ret != EFI_BUFFER_TOO_SMALL)
+		return EFI_ERROR(ret) ? ret : EFI_DEVICE_ERROR;
+
+	/* Room for the descriptors of the map allocation itself */
+	alloc_size = size + 8 * desc_size;
+	ret = allocate_pool(EfiLoaderData, alloc_size, (VOID **)&map);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	start = rdtsc();
+	for (i = 0; i < BENCH_MEMMAP_COUNT; i++) {
+		size = alloc_size;
+		ret = get_memory_map(&size, map, &key, &desc_size, &desc_version);
+		if (EFI_ERROR(ret))
+			goto out;
+	}
+	bench_result(report, L"get_memory_map", size, BENCH_MEMMAP_COUNT,
+		     rdtsc() - start);
+	info(L"%d descriptors\n", size / desc_size);
+
+	/* The loader helper also pays for the allocation */
+	start = rdtsc();
+	for (i = 0; i < BENCH_MEMMAP_COUNT; i++) {
+		EFI_MEMORY_DESCRIPTOR *buf;
+
+		ret = memory_map(&buf, &size, &key, &desc_size, &desc_version);
+		if (EFI_ERROR(ret))
+			goto out;
+		free_pool(buf);
+	}
+	bench_result(report, L"memory_map", size, BENCH_MEMMAP_COUNT,
+		     rdtsc() - start);
+
+out:
+	free_pool(map);
+	return ret;
+}
+
+static void bench_run(CHAR8 *args, CHAR16 *csv_file, bench_func *funcs,
+		      UINTN count)
+{
+	static const char csv_header[] = "test,size,count,total_ns,ns_per_op,mb_per_s\n";
+	struct bench_report report;
+	EFI_FILE_IO_INTERFACE *io;
+	EFI_STATUS ret;
+	UINTN i;
+
+	report.csv = has_word(args, "csv");
+	if (report.csv) {
+		ret = get_esp_fs(&io);
+		if (!EFI_ERROR(ret))
+			ret = uefi_stream_open(&report.stream, io, csv_file,
+					       BENCH_CSV_WRITE_SIZE);
+		if (EFI_ERROR(ret)) {
+			error(L"Failed to create %s: %r\n", csv_file, ret);
+			report.csv = FALSE;
+		} else {
+			uefi_stream_write(&report.stream, csv_header,
+					  sizeof(csv_header) - 1);
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		ret = funcs[i](&report, args);
+		if (EFI_ERROR(ret))
+			error(L"Benchmark failed: %r\n", ret);
+	}
+
+	if (!report.csv)
+		return;
+
+	ret = uefi_stream_close(&report.stream);
+	if (EFI_ERROR(ret)) {
+		error(L"Failed to write file %s: %r\n", csv_file, ret);
+	} else {
+		info(L"Results saved to %s\n", csv_file);
+	}
+}
+
+void bench_disk(CHAR8 *args)
+{
+	bench_func func = bench_disk_run;
+
+	bench_run(args, L"bench_disk.csv", &func, 1);
+}
+
+void bench_mem(CHAR8 *args)
+{
+	bench_func func = bench_mem_run;
+
+	bench_run(args, L"bench_mem.csv", &func, 1);
+}
+
+void bench_var(CHAR8 *args)
+{
+	bench_func func = bench_var_run;
+
+	bench_run(args, L"bench_var.csv", &func, 1);
+}
+
+void bench_gop(CHAR8 *args)
+{
+	bench_func func = bench_gop_run;
+
+	bench_run(args, L"bench_gop.csv", &func, 1);
+}
+
+void bench_protocol(CHAR8 *args)
+{
+	bench_func func = bench_protocol_run;
+
+	bench_run(args, L"bench_protocol.csv", &func, 1);
+}
+
+void bench_memmap(CHAR8 *args)
+{
+	bench_func func = bench_memmap_run;
+
+	bench_run(args, L"bench_memmap.csv", &func, 1);
+}
+
+void bench_all(CHAR8 *args)
+{
+	bench_func funcs[] = {
+		bench_mem_run,
+		bench_memmap_run,
+		bench_protocol_run,
+		bench_var_run,
+		bench_gop_run,
+		bench_disk_run,
+	};
+
+	bench_run(args, L"bench_all.csv", funcs, sizeof(funcs) / sizeof(*funcs));
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file collects the boot inputs snapshot. The boot decision used to
+ * query the firmware piecemeal, each energy management operation looking
+ * up the device info protocol and reading the battery status again.
+ * Everything is now read once, and the decision only looks at the
+ * snapshot.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "stdlib.h"
+#include "platform/platform.h"
+#include "uefi_osnib.h"
+#include "uefi_utils.h"
+#include "boot_inputs.h"
+
+static struct boot_inputs inputs;
+static BOOLEAN collected;
+
+static void collect_em(struct em_snapshot *s)
+{
+	struct energy_mgmt_ops *em = loader_ops.em_ops;
+
+	if (em->snapshot) {
+		em->snapshot(s);
+		return;
+	}
+
+	memset(s, 0, sizeof(*s));
+	s->status = em->get_battery_status(&s->battery);
+	s->level = em->get_battery_level();
+	s->battery_ok = em->is_battery_ok();
+	s->charger_present = em->is_charger_present();
+	s->below_vbattfreqlmt = em->is_battery_below_vbattfreqlmt();
+}
+
+/**
+ * boot_inputs_collect - take the snapshot of the boot inputs. The
+ * firmware calls are counted where they are issued, see uefi_fw_calls,
+ * the RSCI fields and the CMOS or OSNIB reads of other platforms are not
+ * firmware calls. The snapshot is never updated afterwards, it stays a
+ * record of what the firmware reported.
+ */
+void boot_inputs_collect(void)
+{
+	UINT64 start = loader_ops.get_current_time_us();
+	UINT32 fw_calls = uefi_fw_calls;
+
+	memset(&inputs, 0, sizeof(inputs));
+
+	inputs.wake_source = loader_ops.get_wake_source();
+	inputs.reset_source = loader_ops.get_reset_source();
+	inputs.reset_type = loader_ops.get_reset_type();
+	inputs.shutdown_source = loader_ops.get_shutdown_source();
+
+	collect_em(&inputs.em);
+
+	inputs.combo_fastboot = !!loader_ops.combo_key(COMBO_FASTBOOT_MODE);
+
+	inputs.target_mode = loader_ops.get_target_mode();
+	inputs.last_target_mode = loader_ops.get_last_target_mode();
+	inputs.wdt_counter = loader_ops.get_wdt_counter();
+	inputs.wd_cold_reset = uefi_get_wd_cold_reset();
+
+	inputs.fw_calls = uefi_fw_calls - fw_calls;
+	inputs.collect_time_us = loader_ops.get_current_time_us() - start;
+	collected = TRUE;
+
+	debug(L"Boot inputs collected in %ldus with %d firmware calls\n",
+	      inputs.collect_time_us, inputs.fw_calls);
+}
+
+struct boot_inputs *boot_inputs_get(void)
+{
+	if (!collected)
+		boot_inputs_collect();
+
+	return &inputs;
+}
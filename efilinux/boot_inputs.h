@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file defines the snapshot of all the inputs the boot decision is
+ * based on, collected once when the boot logic starts.
+ */
+
+#ifndef __BOOT_INPUTS_H__
+#define __BOOT_INPUTS_H__
+
+#include <efi.h>
+#include "bootlogic.h"
+#include "em.h"
+
+struct boot_inputs {
+	/* RSCI */
+	enum wake_sources wake_source;
+	enum reset_sources reset_source;
+	enum reset_types reset_type;
+	enum shutdown_sources shutdown_source;
+
+	/* Energy management */
+	struct em_snapshot em;
+
+	/* Keys */
+	BOOLEAN combo_fastboot;
+
+	/* OSNIB */
+	enum targets target_mode;
+	enum targets last_target_mode;
+	int wdt_counter;
+	int wd_cold_reset;
+
+	/* Cost of the collection */
+	UINT32 fw_calls;
+	UINT64 collect_time_us;
+};
+
+void boot_inputs_collect(void);
+struct boot_inputs *boot_inputs_get(void);
+
+#endif	/* __BOOT_INPUTS_H__ */
@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file implements the boot plan. On a normal boot the same
+ * partition is opened, the same boot image header read and the kernel and
+ * ramdisk end up at the same addresses every time. The plan of the last
+ * boot is kept in a non-volatile variable: when the partition behind the
+ * recorded device path still has the same MediaId and image header, the
+ * GUID lookup through all the handles of the system is skipped and the
+ * recorded placements are tried first. Any mismatch falls back to the
+ * full discovery and the record is rewritten once the new plan proved to
+ * work, that is right before the kernel is entered.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "stdlib.h"
+#include "utils.h"
+#include "config.h"
+#include "crc32c.h"
+#include "boot_plan.h"
+#include "io_stats.h"
+
+#define BOOT_PLAN_VARNAME	L"EfilinuxBootPlan"
+#define BOOT_PLAN_STATS_VARNAME	L"EfilinuxBootPlanStats"
+
+#define BOOT_PLAN_MAGIC		0x4e4c5042	/* "BPLN" */
+#define BOOT_PLAN_VERSION	1
+#define BOOT_PLAN_DEVPATH_MAX	256
+
+struct boot_plan_placement {
+	UINT64 addr;
+	UINT64 size;
+} __attribute__((packed));
+
+struct boot_plan {
+	UINT32 magic;
+	UINT16 version;
+	UINT16 size;			/* Size of this structure */
+	UINT32 crc;			/* CRC32C of the record, this field zeroed */
+	UINT32 rebuilds;		/* Number of times the record was rewritten */
+	EFI_GUID guid;			/* Partition the plan applies to */
+	UINT32 media_id;
+	UINT32 header_crc;		/* CRC32C of the boot image header */
+	struct boot_plan_placement placements[BOOT_PLAN_PLACEMENT_MAX];
+	UINT16 devpath_size;
+	UINT8 devpath[BOOT_PLAN_DEVPATH_MAX];
+} __attribute__((packed));
+
+/* Exported in a volatile variable so the OS can tell how the boot went */
+struct boot_plan_stats {
+	UINT32 hits;
+	UINT32 misses;
+	UINT32 rebuilds;
+} __attribute__((packed));
+
+static struct boot_plan stored;		/* Record of the previous boot */
+static BOOLEAN stored_loaded;
+static BOOLEAN stored_valid;
+
+static struct boot_plan plan;		/* Plan of the current boot */
+static BOOLEAN plan_active;
+static BOOLEAN plan_hit;
+
+static struct boot_plan_stats stats;
+
+static UINT32 plan_crc(struct boot_plan *p)
+{
+	UINT32 saved = p->crc;
+	UINT32 crc;
+
+	p->crc = 0;
+	crc = crc32c(0, p, sizeof(*p));
+	p->crc = saved;
+
+	return crc;
+}
+
+static void load_stored_plan(void)
+{
+	struct boot_plan *var;
+	UINTN size;
+
+	if (stored_loaded)
+		return;
+	stored_loaded = TRUE;
+
+	var = LibGetVariableAndSize(BOOT_PLAN_VARNAME, &osloader_guid, &size);
+	if (!var)
+		return;
+
+	if (size != sizeof(*var) || var->magic != BOOT_PLAN_MAGIC ||
+	    var->version != BOOT_PLAN_VERSION || var->size != sizeof(*var) ||
+	    var->devpath_size > BOOT_PLAN_DEVPATH_MAX ||
+	    plan_crc(var) != var->crc) {
+		warning(L"Discarding invalid boot plan\n");
+		goto out;
+	}
+
+	memcpy(&stored, var, sizeof(stored));
+	stored_valid = TRUE;
+out:
+	FreePool(var);
+}
+
+static EFI_STATUS read_header(EFI_DISK_IO *DiskIo, UINT32 MediaId,
+			      VOID *header, UINTN header_size)
+{
+	EFI_STATUS ret;
+
+	ret = io_read_disk(DiskIo, MediaId, 0, header_size, header);
+	if (EFI_ERROR(ret))
+		error(L"ReadDisk (header) : %r\n", ret);
+
+	return ret;
+}
+
+/* Open the partition from the recorded device path, only succeeds if
+ * nothing changed since the plan was recorded. */
+static EFI_STATUS open_from_plan(const EFI_GUID *guid, UINT32 *MediaIdPtr,
+				 EFI_BLOCK_IO **BlockIoPtr, EFI_DISK_IO **DiskIoPtr,
+				 VOID *header, UINTN header_size)
+{
+	EFI_DEVICE_PATH *path;
+	EFI_HANDLE handle;
+	EFI_STATUS ret;
+
+	load_stored_plan();
+	if (!stored_valid)
+		return EFI_NOT_FOUND;
+	if (memcmp(&stored.guid, guid, sizeof(stored.guid)))
+		return EFI_NOT_FOUND;
+
+	path = (EFI_DEVICE_PATH *)stored.devpath;
+	ret = uefi_call_wrapper(BS->LocateDevicePath, 3, &DevicePathProtocol,
+				&path, &handle);
+	if (EFI_ERROR(ret))
+		return ret;
+	if (!IsDevicePathEnd(path))
+		return EFI_NOT_FOUND;
+
+	ret = open_partition_handle(handle, MediaIdPtr, BlockIoPtr, DiskIoPtr);
+	if (EFI_ERROR(ret))
+		return ret;
+	if (*MediaIdPtr != stored.media_id)
+		return EFI_MEDIA_CHANGED;
+
+	ret = read_header(*DiskIoPtr, *MediaIdPtr, header, header_size);
+	if (EFI_ERROR(ret))
+		return ret;
+	if (crc32c(0, header, header_size) != stored.header_crc)
+		return EFI_NOT_FOUND;
+
+	return EFI_SUCCESS;
+}
+
+static void new_plan(const EFI_GUID *guid, EFI_HANDLE handle, UINT32 MediaId,
+		     VOID *header, UINTN header_size)
+{
+	EFI_DEVICE_PATH *path;
+	UINTN size;
+
+	path = DevicePathFromHandle(handle);
+	if (!path)
+		return;
+
+	size = DevicePathSize(path);
+	if (size > BOOT_PLAN_DEVPATH_MAX) {
+		debug(L"Device path too long for the boot plan\n");
+		return;
+	}
+
+	memset(&plan, 0, sizeof(plan));
+	plan.magic = BOOT_PLAN_MAGIC;
+	plan.version = BOOT_PLAN_VERSION;
+	plan.size = sizeof(plan);
+	memcpy(&plan.guid, guid, sizeof(plan.guid));
+	plan.media_id = MediaId;
+	plan.header_crc = crc32c(0, header, header_size);
+	plan.devpath_size = size;
+	memcpy(plan.devpath, path, size);
+	plan_active = TRUE;
+}
+
+/**
+ * boot_plan_open_partition - open the partition @guid and read the
+ * first @header_size bytes of it, through the recorded boot plan when
+ * it is still valid or with a full discovery otherwise.
+ * @guid: partition type GUID
+ * @MediaIdPtr: MediaId of the partition block device
+ * @BlockIoPtr: BlockIo protocol of the partition
+ * @DiskIoPtr: DiskIo protocol of the partition
+ * @header: where the header is read
+ * @header_size: size of @header
+ */
+EFI_STATUS boot_plan_open_partition(
+		IN const EFI_GUID *guid,
+		OUT UINT32 *MediaIdPtr,
+		OUT EFI_BLOCK_IO **BlockIoPtr,
+		OUT EFI_DISK_IO **DiskIoPtr,
+		OUT VOID *header,
+		IN UINTN header_size)
+{
+	EFI_HANDLE handle;
+	EFI_STATUS ret;
+
+	plan_active = FALSE;
+
+	ret = open_from_plan(guid, MediaIdPtr, BlockIoPtr, DiskIoPtr,
+			     header, header_size);
+	if (!EFI_ERROR(ret)) {
+		debug(L"Boot plan hit\n");
+		stats.hits++;
+		memcpy(&plan, &stored, sizeof(plan));
+		plan_active = TRUE;
+		plan_hit = TRUE;
+		return EFI_SUCCESS;
+	}
+
+	debug(L"Boot plan miss: %r\n", ret);
+	stats.misses++;
+	plan_hit = FALSE;
+
+	ret = locate_partition(guid, &handle);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	ret = open_partition_handle(handle, MediaIdPtr, BlockIoPtr, DiskIoPtr);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	ret = read_header(*DiskIoPtr, *MediaIdPtr, header, header_size);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	new_plan(guid, handle, *MediaIdPtr, header, header_size);
+	return EFI_SUCCESS;
+}
+
+/**
+ * boot_plan_get_placement - address where @placement landed on the
+ * previous boot, 0 if there is no valid plan for it.
+ * @placement: which allocation
+ * @size: size of the allocation, the hint is only valid for the same size
+ */
+EFI_PHYSICAL_ADDRESS boot_plan_get_placement(enum boot_plan_placements placement,
+					     UINT64 size)
+{
+	if (!plan_hit || placement >= BOOT_PLAN_PLACEMENT_MAX)
+		return 0;
+	if (stored.placements[placement].size != size)
+		return 0;
+
+	return stored.placements[placement].addr;
+}
+
+void boot_plan_set_placement(enum boot_plan_placements placement,
+			     EFI_PHYSICAL_ADDRESS addr, UINT64 size)
+{
+	if (!plan_active || placement >= BOOT_PLAN_PLACEMENT_MAX)
+		return;
+
+	plan.placements[placement].addr = addr;
+	plan.placements[placement].size = size;
+}
+
+/**
+ * boot_plan_commit - the plan led to a kernel start, record it if it
+ * differs from the stored one and publish the counters. The variable is
+ * left untouched on unchanged boots.
+ */
+void boot_plan_commit(void)
+{
+	EFI_STATUS ret;
+
+	if (plan_active) {
+		plan.rebuilds = stored_valid ? stored.rebuilds : 0;
+		plan.crc = plan_crc(&plan);
+
+		if (!stored_valid || memcmp(&plan, &stored, sizeof(plan))) {
+			plan.rebuilds++;
+			plan.crc = plan_crc(&plan);
+			ret = LibSetNVVariable(BOOT_PLAN_VARNAME, &osloader_guid,
+					       sizeof(plan), &plan);
+			if (EFI_ERROR(ret))
+				warning(L"Failed to record the boot plan: %r\n", ret);
+		}
+		stats.rebuilds = plan.rebuilds;
+		plan_active = FALSE;
+	}
+
+	if (!stats.hits && !stats.misses)
+		return;
+
+	debug(L"Boot plan: %d hits, %d misses, %d rebuilds\n",
+	      stats.hits, stats.misses, stats.rebuilds);
+	ret = LibSetVariable(BOOT_PLAN_STATS_VARNAME, &osloader_guid,
+			     sizeof(stats), &stats);
+	if (EFI_ERROR(ret))
+		warning(L"Failed to set %s: %r\n", BOOT_PLAN_STATS_VARNAME, ret);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file defines the boot plan, a record of how the last successful
+ * boot from a partition was set up, so that the next boot can skip the
+ * partition discovery and the memory placement searches.
+ */
+
+#ifndef __BOOT_PLAN_H__
+#define __BOOT_PLAN_H__
+
+#include <efi.h>
+#include <efilib.h>
+
+enum boot_plan_placements {
+	BOOT_PLAN_KERNEL,
+	BOOT_PLAN_RAMDISK,
+	BOOT_PLAN_PLACEMENT_MAX
+};
+
+EFI_STATUS boot_plan_open_partition(
+		IN const EFI_GUID *guid,
+		OUT UINT32 *MediaIdPtr,
+		OUT EFI_BLOCK_IO **BlockIoPtr,
+		OUT EFI_DISK_IO **DiskIoPtr,
+		OUT VOID *header,
+		IN UINTN header_size);
+EFI_PHYSICAL_ADDRESS boot_plan_get_placement(enum boot_plan_placements placement,
+					     UINT64 size);
+void boot_plan_set_placement(enum boot_plan_placements placement,
+			     EFI_PHYSICAL_ADDRESS addr, UINT64 size);
+void boot_plan_commit(void);
+
+#endif	/* __BOOT_PLAN_H__ */
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * This file defines the loader state record handed over to the kernel
+ * through the boot_params setup_data list. Keep it free of any external
+ * definition so that it can be exported to kernel and userspace users.
+ */
+
+#ifndef _BOOT_STATE_H_
+#define _BOOT_STATE_H_
+
+/* setup_data type of the record, "EFIL" in little endian */
+#define SETUP_EFILINUX_STATE	0x4c494645
+
+#define BOOT_STATE_MAGIC	0x54534c45	/* "ELST" */
+#define BOOT_STATE_VERSION	1
+
+/* Flags */
+#define BOOT_STATE_BATTERY_VALID	(1 << 0)
+#define BOOT_STATE_PMIC_VALID		(1 << 1)
+#define BOOT_STATE_RSCI_VALID		(1 << 2)
+
+/*
+ * All fields are little endian. New fields are only ever appended, a
+ * reader must check that size covers the fields it is interested in.
+ * Values of the *_source, reset_type and target fields are the ones of
+ * the enumerations defined in bootlogic.h.
+ */
+struct boot_state {
+	unsigned int magic;
+	unsigned short version;
+	unsigned short size;		/* Size of this structure */
+	unsigned int flags;
+
+	/* Boot logic */
+	signed char target;
+	signed char wake_source;
+	signed char reset_source;
+	signed char reset_type;
+	signed char shutdown_source;
+	unsigned char wdt_counter;
+	unsigned char reserved0[2];
+	unsigned int rsci_indicators;
+
+	/* Energy management */
+	unsigned char battery_present;
+	unsigned char battery_valid;
+	unsigned char capacity_readable;
+	unsigned char battery_capacity;	/* % */
+	unsigned short battery_voltage;	/* mV */
+	unsigned char charger_present;
+	unsigned char reserved1;
+
+	/* Platform */
+	signed char pmic_type;		/* enum pmic_types */
+	unsigned char reserved2[3];
+} __attribute__((packed));
+
+#endif /* _BOOT_STATE_H_ */
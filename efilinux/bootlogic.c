@@ -37,6 +37,12 @@
 #include "utils.h"
 #include "uefi_osnib.h"
 #include "pmic.h"
+#include "loader_state.h"
+#include "cmdline.h"
+#include "warmdump.h"
+#include "boot_inputs.h"
+#include "uefi_keys.h"
+#include "phase_profiler.h"
 
 static enum targets boot_bcb(int dummy)
 {
@@ -59,7 +65,14 @@ void forced_shutdown(void)
 
 enum targets boot_fastboot_combo(enum wake_sources ws)
 {
-	return loader_ops.combo_key(COMBO_FASTBOOT_MODE) ? TARGET_FASTBOOT : TARGET_UNKNOWN;
+	struct boot_inputs *inputs = boot_inputs_get();
+
+	/* The keys are latched in the background until the decision, the
+	 * snapshot only has the ones pressed before it was taken */
+	if (!inputs->combo_fastboot)
+		inputs->combo_fastboot = !!loader_ops.combo_key(COMBO_FASTBOOT_MODE);
+
+	return inputs->combo_fastboot ? TARGET_FASTBOOT : TARGET_UNKNOWN;
 }
 
 enum targets boot_power_key(enum wake_sources ws)
@@ -83,7 +96,7 @@ enum targets boot_battery_insertion(enum wake_sources ws)
 		/*TI PMIC reports BATTERY INSERTED when charging
 		 *from dead battery. Enter COS when charger present*/
 		if (pmic_get_type_from_smbios() == DOLLAR_TI &&
-			loader_ops.em_ops->is_charger_present())
+			boot_inputs_get()->em.charger_present)
 			return TARGET_CHARGING;
 		else
 			return TARGET_COLD_OFF;
@@ -96,7 +109,7 @@ enum targets boot_charger_insertion(enum wake_sources ws)
 {
 	if (ws == WAKE_USB_CHARGER_INSERTED ||
 	    ws == WAKE_ACDC_CHARGER_INSERTED)
-		return loader_ops.em_ops->is_charger_present() ?
+		return boot_inputs_get()->em.charger_present ?
 			TARGET_CHARGING : TARGET_COLD_OFF;
 	else
 		return TARGET_UNKNOWN;
@@ -106,7 +119,7 @@ enum targets target_from_off(enum wake_sources ws)
 {
 	enum targets target = TARGET_UNKNOWN;
 
-	if (loader_ops.get_shutdown_source() == SHTDWN_POWER_BUTTON_OVERRIDE)
+	if (boot_inputs_get()->shutdown_source == SHTDWN_POWER_BUTTON_OVERRIDE)
 		forced_shutdown();
 
 	enum targets (*boot_case[])(enum wake_sources wake_source) = {
@@ -136,7 +149,7 @@ enum targets boot_fw_update(enum reset_sources rs)
 enum targets boot_reset(enum reset_sources rs)
 {
 	if (rs == RESET_OS_INITIATED || rs == RESET_FORCED)
-		return loader_ops.get_target_mode();
+		return boot_inputs_get()->target_mode;
 	else
 		return TARGET_UNKNOWN;
 }
@@ -172,8 +185,24 @@ static inline EFI_STATUS call_warmdump(void)
 			       path, NULL, NULL);
 }
 
+static void run_warmdump(void)
+{
+	EFI_STATUS ret;
+
+#if defined(CONFIG_HAS_WARMDUMP) && !defined(CONFIG_WARMDUMP_IMAGE)
+	ret = warmdump_run();
+#else
+	ret = call_warmdump();
+#endif
+
+	if (EFI_ERROR(ret))
+		error(L"Warmdump error (%r)\n", ret);
+}
+
 enum targets boot_watchdog(enum reset_sources rs)
 {
+	struct boot_inputs *inputs = boot_inputs_get();
+
 	if (rs != RESET_KERNEL_WATCHDOG
 	    && rs != RESET_SECURITY_WATCHDOG
 	    && rs != RESET_SECURITY_INITIATED
@@ -182,18 +211,21 @@ enum targets boot_watchdog(enum reset_sources rs)
 	    && rs != RESET_PLATFORM_WATCHDOG)
 		return TARGET_UNKNOWN;
 
-	if (has_warmdump) {
-		EFI_STATUS ret = call_warmdump();
-		if (EFI_ERROR(ret))
-			error(L"Warmdump error (%r)\n", ret);
-	}
+	enum targets last_target = inputs->last_target_mode;
 
-	enum targets last_target = loader_ops.get_last_target_mode();
+	/*
+	 * Backup, or restore on the second pass of a cold reset recovery.
+	 * Without QUIRK_WATCHDOG_COLD_RESET the recovery is single pass:
+	 * the dumps are only backed up to the ESP, never restored nor
+	 * deleted, and each watchdog boot overwrites them.
+	 */
+	if (has_warmdump)
+		run_warmdump();
 
-	if (uefi_get_wd_cold_reset() == 1) {
+	if (inputs->wd_cold_reset == 1) {
 		if (EFI_ERROR(uefi_set_wd_cold_reset(0)))
 			error(L"Failed to set WDColdReset variable to 0\n");
-	} else {
+	} else if (loader_ops.quirks & QUIRK_WATCHDOG_COLD_RESET) {
 		// else branch for 0 and -1 when WDColdReset var is not yet initialized.
 		loader_ops.save_target_mode(last_target);
 		if (EFI_ERROR(uefi_set_wd_cold_reset(1)))
@@ -204,7 +236,7 @@ enum targets boot_watchdog(enum reset_sources rs)
 		error(L"Reset requested, this code should not be reached\n");
 	}
 
-	int wdt_counter = loader_ops.get_wdt_counter();
+	int wdt_counter = inputs->wdt_counter;
 
 	wdt_counter++;
 	debug(L"watchdog counter = %d\n", wdt_counter);
@@ -242,13 +274,14 @@ enum targets target_from_reset(enum reset_sources rs)
 
 enum targets target_from_inputs(enum flow_types flow_type)
 {
+	struct boot_inputs *inputs = boot_inputs_get();
 	enum wake_sources ws;
 	enum reset_sources rs;
 
-	if (!loader_ops.em_ops->is_battery_ok())
+	if (!inputs->em.battery_ok)
 		return TARGET_COLD_OFF;
 
-	ws = loader_ops.get_wake_source();
+	ws = inputs->wake_source;
 	debug(L"Wake source = 0x%x\n", ws);
 	if (ws == WAKE_ERROR) {
 		error(L"Wake source couldn't be retrieved. Falling back in TARGET_BOOT\n");
@@ -258,7 +291,7 @@ enum targets target_from_inputs(enum flow_types flow_type)
 	if (ws != WAKE_NOT_APPLICABLE)
 		return target_from_off(ws);
 
-	rs = loader_ops.get_reset_source();
+	rs = inputs->reset_source;
 	debug(L"Reset source = 0x%x\n", rs);
 	if (rs == RESET_ERROR) {
 		error(L"Reset source couldn't be retrieved. Falling back in TARGET_BOOT\n");
@@ -268,7 +301,7 @@ enum targets target_from_inputs(enum flow_types flow_type)
 	if (rs == RESET_NOT_APPLICABLE)
 		rs = RESET_OS_INITIATED;
 
-	if (uefi_get_wd_cold_reset() == 1) {
+	if (inputs->wd_cold_reset == 1) {
 		rs = RESET_KERNEL_WATCHDOG;
 		loader_ops.set_reset_source(RESET_KERNEL_WATCHDOG);
 		debug(L"Reset source changed to = 0x%x\n", rs);
@@ -277,36 +310,35 @@ enum targets target_from_inputs(enum flow_types flow_type)
 	return target_from_reset(rs);
 }
 
-CHAR8 *get_extra_cmdline(CHAR8 *cmdline)
+/* Return the buffer holding the extra command line, it must be freed
+ * once the command line has been written */
+CHAR8 *get_extra_cmdline(struct cmdline *cmdline)
 {
 	CHAR8 *extra_cmdline;
-	CHAR8 *updated_cmdline;
+	EFI_STATUS ret;
 
 	extra_cmdline = loader_ops.get_extra_cmdline();
 	debug(L"Getting extra commandline: %a\n", extra_cmdline ? extra_cmdline : (CHAR8 *)"");
 
-	updated_cmdline = append_strings(extra_cmdline, cmdline);
-
-	if (extra_cmdline)
-		free(extra_cmdline);
-	if (cmdline)
-		free(cmdline);
+	if (extra_cmdline) {
+		ret = cmdline_add(cmdline, extra_cmdline, strlena(extra_cmdline));
+		if (EFI_ERROR(ret))
+			error(L"Extra command line dropped: %r\n", ret);
+	}
 
-	return updated_cmdline;
+	return extra_cmdline;
 }
 
-CHAR8 *check_vbattfreqlmt(CHAR8 *cmdline)
+void check_vbattfreqlmt(struct cmdline *cmdline)
 {
-	CHAR8 *updated_cmdline = cmdline;
+	EFI_STATUS ret;
 
-	if (loader_ops.em_ops->is_battery_below_vbattfreqlmt()) {
+	if (boot_inputs_get()->em.below_vbattfreqlmt) {
 		debug(L"Battery voltage below vbattfreqlmt add battlow in cmdline\n");
-		updated_cmdline = append_strings("battlow ", cmdline);
-		if (cmdline)
-			free(cmdline);
+		ret = cmdline_add(cmdline, (CHAR8 *)"battlow", 7);
+		if (EFI_ERROR(ret))
+			error(L"battlow dropped from the command line: %r\n", ret);
 	}
-
-	return updated_cmdline;
 }
 
 void display_splash(void)
@@ -316,23 +348,24 @@ void display_splash(void)
 	return;
 }
 
+/* Only reads the target image headers, so that a target bound to fail
+ * is skipped without loading and verifying its whole image */
 EFI_STATUS check_target(enum targets target)
 {
-	/* TODO */
-	debug(L"TO BE IMPLEMENTED\n");
-	return EFI_SUCCESS;
+	return loader_ops.check_target(target);
 }
 
 enum targets em_fallback_target(enum targets target)
 {
+	struct em_snapshot *em = &boot_inputs_get()->em;
 	enum targets fallback = target;
 
-	if (loader_ops.em_ops->get_battery_level() == BATT_BOOT_CHARGING)
+	if (em->level == BATT_BOOT_CHARGING)
 		switch (target) {
 		case TARGET_BOOT:
 		case TARGET_FACTORY:
 		case TARGET_FACTORY2:
-			if (loader_ops.em_ops->is_charger_present())
+			if (em->charger_present)
 				fallback = TARGET_CHARGING;
 			else
 				fallback = TARGET_COLD_OFF;
@@ -344,18 +377,18 @@ enum targets em_fallback_target(enum targets target)
 	return fallback;
 }
 
-static EFI_STATUS launch_or_fallback(enum targets target, CHAR8 *cmdline)
+static EFI_STATUS launch_or_fallback(enum targets target, struct cmdline *cmdline)
 {
 	EFI_STATUS ret;
-	CHAR8 saved_cmdline[(cmdline ? strlena(cmdline) : 0) + 1];
-
-	if (cmdline) {
-		memcpy(saved_cmdline, cmdline, strlena(cmdline) + 1);
-		free(cmdline);
-	} else
-		saved_cmdline[0] = '\0';
 
 	do {
+		ret = check_target(target);
+		if (EFI_ERROR(ret)) {
+			warning(L"Target 0x%x can't be loaded: %r\n", target, ret);
+			target = fallback_target(target);
+			continue;
+		}
+
 		ret = loader_ops.populate_indicators();
 		if (EFI_ERROR(ret))
 			return ret;
@@ -364,7 +397,9 @@ static EFI_STATUS launch_or_fallback(enum targets target, CHAR8 *cmdline)
 		if (EFI_ERROR(ret))
 			warning(L"Failed to save the target_mode: %r\n", ret);
 
-		ret = loader_ops.load_target(target, saved_cmdline);
+		loader_state_set_target(target);
+		loader_state_mark((CHAR8 *)"load_target");
+		ret = loader_ops.load_target(target, cmdline);
 
 		target = fallback_target(target);
 	} while (target != TARGET_UNKNOWN);
@@ -377,14 +412,21 @@ EFI_STATUS start_boot_logic(CHAR8 *cmdline)
 	EFI_STATUS ret;
 	enum flow_types flow_type;
 	enum targets target;
-	CHAR8 *updated_cmdline = NULL;
+	struct cmdline boot_cmdline;
+	CHAR8 *extra_cmdline = NULL;
 
 	loader_ops.hook_bootlogic_begin();
+	loader_state_mark((CHAR8 *)"bootlogic_begin");
+	phase_set(PHASE_BOOT_INPUTS);
+	boot_inputs_collect();
 
+	phase_set(PHASE_PARTITIONS);
 	ret = loader_ops.check_partition_table();
 	if (EFI_ERROR(ret))
 		goto error;
 
+	phase_set(PHASE_BOOTLOGIC);
+
 	flow_type = loader_ops.read_flow_type();
 
 	target = target_from_inputs(flow_type);
@@ -398,22 +440,35 @@ EFI_STATUS start_boot_logic(CHAR8 *cmdline)
 
 	target = em_fallback_target(target);
 
+	/* The decision is made, the combo keys are not needed anymore */
+	uefi_keys_stop_sampling();
+
 	if (target == TARGET_COLD_OFF) {
 		debug(L"TARGET_COLD_OFF shutdown\n");
 		loader_ops.do_cold_off();
 	}
 
+	phase_set(PHASE_SPLASH);
 	loader_ops.display_splash();
+	phase_set(PHASE_BOOTLOGIC);
 
-	updated_cmdline = check_vbattfreqlmt(cmdline);
-
+	cmdline_init(&boot_cmdline);
 #ifdef RUNTIME_SETTINGS
-	updated_cmdline = get_extra_cmdline(updated_cmdline);
+	extra_cmdline = get_extra_cmdline(&boot_cmdline);
 #endif
+	check_vbattfreqlmt(&boot_cmdline);
+	if (cmdline) {
+		ret = cmdline_add(&boot_cmdline, cmdline, strlena(cmdline));
+		if (EFI_ERROR(ret))
+			error(L"Loader command line dropped: %r\n", ret);
+	}
 
 	loader_ops.hook_bootlogic_end();
 
-	ret = launch_or_fallback(target, updated_cmdline);
+	ret = launch_or_fallback(target, &boot_cmdline);
+
+	if (extra_cmdline)
+		free(extra_cmdline);
 
 error:
 	return ret;
@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "stdlib.h"
+#include "cmdline.h"
+
+/* Keys the kernel accepts several times, they are never de-duplicated */
+static const CHAR8 *multi_keys[] = {
+	(CHAR8 *)"console",
+	(CHAR8 *)"earlycon",
+	(CHAR8 *)"memmap",
+	(CHAR8 *)"hugepagesz",	/* Each size is followed by its hugepages= */
+	(CHAR8 *)"hugepages",
+	(CHAR8 *)"isolcpus",
+	(CHAR8 *)"crashkernel",	/* ,high and ,low reservations */
+	(CHAR8 *)"reserve",
+	(CHAR8 *)"efi_fake_mem",
+};
+
+static inline BOOLEAN is_space(CHAR8 c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+void cmdline_init(struct cmdline *cmdline)
+{
+	cmdline->count = 0;
+	cmdline->kernel_count = 0;
+	cmdline->raw = FALSE;
+	cmdline->scratch_used = 0;
+}
+
+static BOOLEAN same_key(const struct cmdline_token *a, const struct cmdline_token *b)
+{
+	if (a->key_len != b->key_len)
+		return FALSE;
+
+	/* Flags only match identical flags */
+	if (a->key_len == a->len || b->key_len == b->len)
+		return a->len == b->len && !memcmp(a->str, b->str, a->len);
+
+	return !memcmp(a->str, b->str, a->key_len);
+}
+
+static BOOLEAN is_multi_key(const struct cmdline_token *token)
+{
+	UINTN i;
+
+	for (i = 0; i < sizeof(multi_keys) / sizeof(*multi_keys); i++)
+		if (strlen((CHAR8 *)multi_keys[i]) == token->key_len &&
+		    !memcmp(multi_keys[i], token->str, token->key_len))
+			return TRUE;
+
+	return FALSE;
+}
+
+/* Extend the last token up to the end of str when only spaces lie in
+ * between, i.e. when both come from the same fragment */
+static BOOLEAN extend_raw_token(struct cmdline *cmdline, const CHAR8 *str, UINTN len)
+{
+	struct cmdline_token *last = &cmdline->tokens[cmdline->count - 1];
+	const CHAR8 *p;
+
+	if (str < last->str + last->len || str + len - last->str > 0xffff)
+		return FALSE;
+
+	for (p = last->str + last->len; p < str; p++)
+		if (!is_space(*p))
+			return FALSE;
+
+	last->len = str + len - last->str;
+	return TRUE;
+}
+
+/* Past CMDLINE_MAX_TOKENS - CMDLINE_RAW_TOKENS, tokens are not
+ * de-duplicated anymore: contiguous ones are merged into a single
+ * verbatim slice, so the table only runs out if the remaining slots
+ * are not enough for the fragments that follow */
+static EFI_STATUS add_raw_token(struct cmdline *cmdline, const CHAR8 *str, UINTN len)
+{
+	if (!cmdline->raw) {
+		warning(L"Too many kernel command line parameters, not de-duplicating the rest\n");
+		cmdline->raw = TRUE;
+	} else if (extend_raw_token(cmdline, str, len))
+		return EFI_SUCCESS;
+
+	if (cmdline->count == CMDLINE_MAX_TOKENS) {
+		error(L"Too many kernel command line parameters\n");
+		return EFI_BUFFER_TOO_SMALL;
+	}
+
+	cmdline->tokens[cmdline->count].str = str;
+	cmdline->tokens[cmdline->count].len = len;
+	cmdline->tokens[cmdline->count].key_len = 0;
+	cmdline->count++;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS add_token(struct cmdline *cmdline, const CHAR8 *str, UINTN len)
+{
+	struct cmdline_token token;
+	BOOLEAN kernel;
+	UINTN i;
+
+	if (len > 0xffff)
+		return EFI_INVALID_PARAMETER;
+
+	if (cmdline->raw ||
+	    cmdline->count == CMDLINE_MAX_TOKENS - CMDLINE_RAW_TOKENS)
+		return add_raw_token(cmdline, str, len);
+
+	token.str = str;
+	token.len = len;
+	for (token.key_len = 0; token.key_len < len; token.key_len++)
+		if (str[token.key_len] == '=')
+			break;
+
+	/* Everything from the first "--" on is for init, kept as is */
+	kernel = cmdline->kernel_count == cmdline->count &&
+		!(len == 2 && !memcmp(str, "--", 2));
+
+	if (kernel && !is_multi_key(&token)) {
+		for (i = 0; i < cmdline->count; i++)
+			if (same_key(&cmdline->tokens[i], &token))
+				break;
+		if (i < cmdline->count) {
+			for (; i < cmdline->count - 1; i++)
+				cmdline->tokens[i] = cmdline->tokens[i + 1];
+			cmdline->count--;
+			cmdline->kernel_count--;
+		}
+	}
+
+	cmdline->tokens[cmdline->count++] = token;
+	if (kernel)
+		cmdline->kernel_count++;
+	return EFI_SUCCESS;
+}
+
+/* Return the length of the token starting at str, double quotes
+ * protect spaces as they do for the kernel parser */
+static UINTN token_length(const CHAR8 *str, UINTN size)
+{
+	BOOLEAN quoted = FALSE;
+	UINTN len;
+
+	for (len = 0; len < size && str[len]; len++) {
+		if (str[len] == '"')
+			quoted = !quoted;
+		else if (!quoted && is_space(str[len]))
+			break;
+	}
+
+	return len;
+}
+
+/**
+ * cmdline_add - add the parameters of a fragment
+ * @cmdline: command line being built
+ * @fragment: parameters separated by spaces, must outlive @cmdline
+ * @size: maximum size of @fragment, parsing also stops at the first NUL
+ */
+EFI_STATUS cmdline_add(struct cmdline *cmdline, const CHAR8 *fragment, UINTN size)
+{
+	EFI_STATUS ret;
+	UINTN i, len;
+
+	if (!fragment)
+		return EFI_SUCCESS;
+
+	for (i = 0; i < size && fragment[i]; i += len) {
+		if (is_space(fragment[i])) {
+			len = 1;
+			continue;
+		}
+
+		len = token_length(fragment + i, size - i);
+		ret = add_token(cmdline, fragment + i, len);
+		if (EFI_ERROR(ret))
+			return ret;
+	}
+
+	return EFI_SUCCESS;
+}
+
+/**
+ * cmdline_add_split - add a fragment stored in two separate buffers
+ * (like the cmdline and extra_cmdline fields of an Android boot image
+ * header). The only token that may be copied is the one which
+ * straddles both buffers.
+ */
+EFI_STATUS cmdline_add_split(struct cmdline *cmdline,
+			     const CHAR8 *first, UINTN first_size,
+			     const CHAR8 *second, UINTN second_size)
+{
+	UINTN first_len, tail, head;
+	CHAR8 *joined;
+	EFI_STATUS ret;
+
+	for (first_len = 0; first_len < first_size && first[first_len]; first_len++)
+		;
+
+	if (!second || !second_size || !second[0] || first_len < first_size ||
+	    !first_len || is_space(first[first_len - 1]) || is_space(second[0])) {
+		ret = cmdline_add(cmdline, first, first_len);
+		if (EFI_ERROR(ret) || first_len < first_size)
+			return ret;
+		return cmdline_add(cmdline, second, second_size);
+	}
+
+	for (tail = 0; tail < first_len && !is_space(first[first_len - tail - 1]); tail++)
+		;
+	head = token_length(second, second_size);
+
+	if (cmdline->scratch_used + tail + head > CMDLINE_SCRATCH_SIZE)
+		return EFI_BUFFER_TOO_SMALL;
+
+	ret = cmdline_add(cmdline, first, first_len - tail);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	joined = cmdline->scratch + cmdline->scratch_used;
+	memcpy(joined, (CHAR8 *)first + first_len - tail, tail);
+	memcpy(joined + tail, (CHAR8 *)second, head);
+	cmdline->scratch_used += tail + head;
+
+	ret = add_token(cmdline, joined, tail + head);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	return cmdline_add(cmdline, second + head, second_size - head);
+}
+
+/* Add all the parameters of src to dst, src slices are shared so
+ * src fragments must outlive dst */
+EFI_STATUS cmdline_append(struct cmdline *dst, const struct cmdline *src)
+{
+	EFI_STATUS ret;
+	UINTN i;
+
+	if (!src)
+		return EFI_SUCCESS;
+
+	for (i = 0; i < src->count; i++) {
+		ret = add_token(dst, src->tokens[i].str, src->tokens[i].len);
+		if (EFI_ERROR(ret))
+			return ret;
+	}
+
+	return EFI_SUCCESS;
+}
+
+/* Length of the written command line, without the trailing NUL */
+UINTN cmdline_length(const struct cmdline *cmdline)
+{
+	UINTN i, len = 0;
+
+	for (i = 0; i < cmdline->count; i++)
+		len += cmdline->tokens[i].len + 1;
+
+	return len ? len - 1 : 0;
+}
+
+/* dst must be at least cmdline_length() + 1 bytes long */
+void cmdline_write(const struct cmdline *cmdline, CHAR8 *dst)
+{
+	UINTN i;
+
+	for (i = 0; i < cmdline->count; i++) {
+		if (i)
+			*dst++ = ' ';
+		memcpy(dst, (CHAR8 *)cmdline->tokens[i].str, cmdline->tokens[i].len);
+		dst += cmdline->tokens[i].len;
+	}
+	*dst = '\0';
+}
+
+/**
+ * cmdline_get - look up the value of a key=value kernel parameter, the
+ * init arguments after "--" and the verbatim tokens are not looked at
+ * @len: set to the length of the returned value, which is not NUL
+ *       terminated
+ *
+ * Return NULL if the key is not present, an empty value for a flag.
+ */
+const CHAR8 *cmdline_get(const struct cmdline *cmdline, const CHAR8 *key, UINTN *len)
+{
+	UINTN i, key_len = strlen((CHAR8 *)key);
+	const struct cmdline_token *token;
+
+	for (i = cmdline->kernel_count; i > 0; i--) {
+		token = &cmdline->tokens[i - 1];
+		if (token->key_len != key_len || memcmp(token->str, key, key_len))
+			continue;
+
+		if (token->key_len == token->len) {
+			*len = 0;
+			return token->str + token->len;
+		}
+		*len = token->len - token->key_len - 1;
+		return token->str + token->key_len + 1;
+	}
+
+	return NULL;
+}
+
+BOOLEAN cmdline_has_value(const struct cmdline *cmdline, const CHAR8 *key, const CHAR8 *value)
+{
+	const CHAR8 *found;
+	UINTN len;
+
+	found = cmdline_get(cmdline, key, &len);
+	return found && len == strlen((CHAR8 *)value) && !memcmp(found, value, len);
+}
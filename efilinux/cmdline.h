@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __CMDLINE_H__
+#define __CMDLINE_H__
+
+#include <efi.h>
+
+#define CMDLINE_MAX_TOKENS	128
+/* Slots kept for the verbatim fallback, see add_token() */
+#define CMDLINE_RAW_TOKENS	16
+/* Room for the token straddling the 512 and 1024 bytes cmdline fields
+ * of an Android boot image header */
+#define CMDLINE_SCRATCH_SIZE	(512 + 1024)
+
+/*
+ * A kernel command line is collected as a list of slices pointing into
+ * the fragments it is built from, the fragments must stay valid until
+ * the command line is written. A key=value token replaces any previous
+ * token with the same key (last one wins), the same goes for identical
+ * flags. The keys the kernel accepts several times are kept, and so is
+ * everything from the first "--" on, which the kernel passes to init.
+ * Once the token table is nearly full, the parameters that follow are
+ * kept verbatim, as a plain concatenation would.
+ */
+struct cmdline_token {
+	const CHAR8 *str;
+	UINT16 len;
+	UINT16 key_len;
+};
+
+struct cmdline {
+	struct cmdline_token tokens[CMDLINE_MAX_TOKENS];
+	UINTN count;
+	UINTN kernel_count;	/* Tokens before "--", the rest is for init */
+	BOOLEAN raw;		/* Table full, tokens are kept verbatim */
+	/* Storage for the tokens split across two fragments */
+	CHAR8 scratch[CMDLINE_SCRATCH_SIZE];
+	UINTN scratch_used;
+};
+
+void cmdline_init(struct cmdline *cmdline);
+EFI_STATUS cmdline_add(struct cmdline *cmdline, const CHAR8 *fragment, UINTN size);
+EFI_STATUS cmdline_add_split(struct cmdline *cmdline,
+			     const CHAR8 *first, UINTN first_size,
+			     const CHAR8 *second, UINTN second_size);
+EFI_STATUS cmdline_append(struct cmdline *dst, const struct cmdline *src);
+UINTN cmdline_length(const struct cmdline *cmdline);
+void cmdline_write(const struct cmdline *cmdline, CHAR8 *dst);
+const CHAR8 *cmdline_get(const struct cmdline *cmdline, const CHAR8 *key, UINTN *len);
+BOOLEAN cmdline_has_value(const struct cmdline *cmdline, const CHAR8 *key, const CHAR8 *value);
+
+#endif	/* __CMDLINE_H__ */
@@ -49,6 +49,14 @@ BOOLEAN has_warmdump = TRUE;
 BOOLEAN has_warmdump = FALSE;
 #endif	/* CONFIG_HAS_WARMDUMP */
 
+/* Platforms whose kernel reads the loader state from setup_data can
+ * skip the OSNIB EFI variable writes */
+#ifdef CONFIG_NO_OSNIB_VARIABLES
+BOOLEAN osnib_variables = FALSE;
+#else
+BOOLEAN osnib_variables = TRUE;
+#endif	/* CONFIG_NO_OSNIB_VARIABLES */
+
 EFI_GUID osloader_guid = {
 	0x4a67b082, 0x0a4c, 0x41cf,
 	{ 0xb6, 0xc7, 0x44, 0x0b, 0x29, 0xbb, 0x8c, 0x4f }
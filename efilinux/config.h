@@ -60,6 +60,7 @@
 extern UINTN log_level;
 extern BOOLEAN log_flush_to_variable;
 extern BOOLEAN has_warmdump;
+extern BOOLEAN osnib_variables;
 extern EFI_GUID osloader_guid;
 
 #endif	/* __CONFIG_H__ */
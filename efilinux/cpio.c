@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "stdlib.h"
+#include "cpio.h"
+
+/* Minimal writer of the "newc" (SVR4 without CRC) cpio format, which
+ * is what the kernel initramfs unpacker expects. */
+
+#define CPIO_NEWC_MAGIC		"070701"
+#define CPIO_NEWC_HDR_SIZE	110
+#define CPIO_TRAILER		"TRAILER!!!"
+
+#define ALIGN4(x)		(((x) + 3) & ~3)
+
+static void put_hex(CHAR8 *dst, UINT32 value)
+{
+	static const CHAR8 digits[] = "0123456789abcdef";
+	int i;
+
+	for (i = 7; i >= 0; i--) {
+		dst[i] = digits[value & 0xf];
+		value >>= 4;
+	}
+}
+
+/**
+ * cpio_add_entry - append a newc entry to a buffer
+ * @buf: archive buffer
+ * @size: size of @buf
+ * @offset: current end of the archive, updated on success
+ * @name: path of the entry, without leading '/'
+ * @mode: file type and permissions (CPIO_MODE_*)
+ * @data: file content, NULL for directories
+ * @len: size of @data
+ */
+EFI_STATUS cpio_add_entry(CHAR8 *buf, UINTN size, UINTN *offset,
+			  const CHAR8 *name, UINT32 mode,
+			  const VOID *data, UINTN len)
+{
+	static UINT32 ino = 1;
+	UINT32 fields[13];
+	UINTN namesize, start, end;
+	CHAR8 *p;
+	int i;
+
+	namesize = strlen((CHAR8 *)name) + 1;
+	start = ALIGN4(*offset);
+	end = ALIGN4(start + CPIO_NEWC_HDR_SIZE + namesize) + ALIGN4(len);
+	if (end > size)
+		return EFI_BUFFER_TOO_SMALL;
+
+	fields[0] = ino++;		/* ino */
+	fields[1] = mode;		/* mode */
+	fields[2] = 0;			/* uid */
+	fields[3] = 0;			/* gid */
+	fields[4] = 1;			/* nlink */
+	fields[5] = 0;			/* mtime */
+	fields[6] = len;		/* filesize */
+	fields[7] = 0;			/* devmajor */
+	fields[8] = 0;			/* devminor */
+	fields[9] = 0;			/* rdevmajor */
+	fields[10] = 0;			/* rdevminor */
+	fields[11] = namesize;		/* namesize */
+	fields[12] = 0;			/* check */
+
+	memset(buf + *offset, 0, end - *offset);
+
+	p = buf + start;
+	memcpy(p, (CHAR8 *)CPIO_NEWC_MAGIC, 6);
+	for (i = 0; i < 13; i++)
+		put_hex(p + 6 + i * 8, fields[i]);
+
+	p += CPIO_NEWC_HDR_SIZE;
+	memcpy(p, (CHAR8 *)name, namesize);
+
+	p = buf + ALIGN4(start + CPIO_NEWC_HDR_SIZE + namesize);
+	if (len)
+		memcpy(p, (CHAR8 *)data, len);
+
+	*offset = end;
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS cpio_add_trailer(CHAR8 *buf, UINTN size, UINTN *offset)
+{
+	return cpio_add_entry(buf, size, offset, (CHAR8 *)CPIO_TRAILER, 0, NULL, 0);
+}
+
+/* Space taken by an entry appended at a 4 bytes aligned offset */
+UINTN cpio_entry_size(const CHAR8 *name, UINTN len)
+{
+	return ALIGN4(CPIO_NEWC_HDR_SIZE + strlen((CHAR8 *)name) + 1) + ALIGN4(len);
+}
+
+UINTN cpio_trailer_size(void)
+{
+	return cpio_entry_size((CHAR8 *)CPIO_TRAILER, 0);
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file implements the CRC32C (Castagnoli) checksum, with the SSE4.2
+ * crc32 instruction when the CPU has it and a table otherwise.
+ */
+
+#include <efi.h>
+#include "crc32c.h"
+#include "platform/x86.h"
+
+#define CRC32C_POLY	0x82f63b78	/* Reflected 0x1edc6f41 */
+
+static UINT32 crc_table[256];
+static BOOLEAN has_sse42;
+static BOOLEAN initialized;
+
+static void crc32c_init(void)
+{
+	UINT32 reg[4], crc, i, j;
+
+	cpuid(1, reg);
+	has_sse42 = !!(reg[2] & (1 << 20));
+
+	if (!has_sse42) {
+		for (i = 0; i < 256; i++) {
+			crc = i;
+			for (j = 0; j < 8; j++)
+				crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLY : 0);
+			crc_table[i] = crc;
+		}
+	}
+
+	initialized = TRUE;
+}
+
+static UINT32 crc32c_hw(UINT32 crc, const UINT8 *p, UINTN size)
+{
+#ifdef CONFIG_X86_64
+	UINT64 crc64 = crc;
+
+	for (; size >= 8; size -= 8, p += 8)
+		asm("crc32q %1, %0" : "+r" (crc64) : "rm" (*(const UINT64 *)p));
+	crc = crc64;
+#else
+	for (; size >= 4; size -= 4, p += 4)
+		asm("crc32l %1, %0" : "+r" (crc) : "rm" (*(const UINT32 *)p));
+#endif
+	for (; size; size--, p++)
+		asm("crc32b %1, %0" : "+r" (crc) : "rm" (*p));
+
+	return crc;
+}
+
+static UINT32 crc32c_sw(UINT32 crc, const UINT8 *p, UINTN size)
+{
+	while (size--)
+		crc = crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+/**
+ * crc32c - Update a CRC32C with @size bytes
+ * @crc: CRC of the previous data, 0 to start a new one
+ * @data: data to add to the CRC
+ * @size: size of @data in bytes
+ */
+UINT32 crc32c(UINT32 crc, const void *data, UINTN size)
+{
+	if (!initialized)
+		crc32c_init();
+
+	crc = ~crc;
+	if (has_sse42)
+		crc = crc32c_hw(crc, data, size);
+	else
+		crc = crc32c_sw(crc, data, size);
+
+	return ~crc;
+}
@@ -47,6 +47,14 @@
 #include "watchdog/watchdog.h"
 #include "log.h"
 
+/* Functions called back by the firmware (event and key notifications)
+ * must follow its calling convention, which on x86_64 is not ours */
+#ifdef CONFIG_X86_64
+#define EFI_CALLBACK __attribute__((ms_abi))
+#else
+#define EFI_CALLBACK
+#endif
+
 extern EFI_SYSTEM_TABLE *sys_table;
 extern EFI_BOOT_SERVICES *boot;
 extern EFI_RUNTIME_SERVICES *runtime;
@@ -226,4 +234,35 @@ extern EFI_STATUS memory_map(EFI_MEMORY_DESCRIPTOR **map_buf,
 			     UINTN *map_size, UINTN *map_key,
 			     UINTN *desc_size, UINT32 *desc_version);
 
+#if defined(CONFIG_ALLOC_TRACKER) && !defined(ALLOC_TRACKER_NO_WRAP)
+#include "alloc_tracker.h"
+
+#define allocate_pages(atype, mtype, num_pages, memory) \
+	alloc_tracker_allocate_pages(atype, mtype, num_pages, memory, \
+				     __FILE__, __LINE__)
+#define free_pages(memory, num_pages) \
+	alloc_tracker_free_pages(memory, num_pages, __FILE__, __LINE__)
+#define allocate_pool(type, size, buffer) \
+	alloc_tracker_allocate_pool(type, size, buffer, __FILE__, __LINE__)
+#define free_pool(buffer) \
+	alloc_tracker_free_pool(buffer, __FILE__, __LINE__)
+#define memory_map(map_buf, map_size, map_key, desc_size, desc_version) \
+	alloc_tracker_memory_map(map_buf, map_size, map_key, desc_size, \
+				 desc_version, __FILE__, __LINE__)
+
+/* Only once the gnu-efi prototypes are declared */
+#ifdef _EFILIB_INCLUDE_
+#define AllocatePool(size) \
+	alloc_tracker_lib_allocate_pool(size, FALSE, __FILE__, __LINE__)
+#define AllocateZeroPool(size) \
+	alloc_tracker_lib_allocate_pool(size, TRUE, __FILE__, __LINE__)
+#define FreePool(buffer) \
+	alloc_tracker_lib_free_pool(buffer, __FILE__, __LINE__)
+#define LibGetVariable(name, guid) \
+	alloc_tracker_lib_get_variable(name, guid, NULL, __FILE__, __LINE__)
+#define LibGetVariableAndSize(name, guid, size) \
+	alloc_tracker_lib_get_variable(name, guid, size, __FILE__, __LINE__)
+#endif	/* _EFILIB_INCLUDE_ */
+#endif	/* CONFIG_ALLOC_TRACKER */
+
 #endif /* __EFILINUX_H__ */
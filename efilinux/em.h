@@ -34,12 +34,33 @@
 #include <efi.h>
 #include "bootlogic.h"
 
+struct battery_status {
+	BOOLEAN BatteryPresent;
+	BOOLEAN BatteryValid;
+	BOOLEAN CapacityReadable;
+	UINT16 BatteryVoltageLevel;	/* mV */
+	UINT8 BatteryCapacityLevel;	/* % */
+};
+
+/* Everything the boot logic needs to know about the battery, gathered
+ * with as few firmware calls as possible */
+struct em_snapshot {
+	EFI_STATUS status;		/* Result of the battery status query */
+	struct battery_status battery;
+	enum batt_levels level;
+	BOOLEAN battery_ok;
+	BOOLEAN charger_present;
+	BOOLEAN below_vbattfreqlmt;
+};
+
 struct energy_mgmt_ops {
+	EFI_STATUS (*get_battery_status)(struct battery_status *);
 	enum batt_levels (*get_battery_level)(void);
 	BOOLEAN (*is_battery_ok)(void);
 	BOOLEAN (*is_charger_present)(void);
 	void (*print_battery_infos)(void);
 	BOOLEAN (*is_battery_below_vbattfreqlmt)(void);
+	void (*snapshot)(struct em_snapshot *);
 };
 
 EFI_STATUS em_set_policy(const CHAR16 *name);
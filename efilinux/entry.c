@@ -37,12 +37,19 @@
 #include "acpi.h"
 #include "intel_partitions.h"
 #include "bootlogic.h"
+#include "uefi_keys.h"
 #include "platform/platform.h"
 #include "commands.h"
+#include "bench.h"
 #include "uefi_utils.h"
 #include "utils.h"
 #include "em.h"
 #include "config.h"
+#include "cmdline.h"
+#include "fw_trace.h"
+#include "phase_profiler.h"
+#include "alloc_tracker.h"
+#include "io_stats.h"
 
 #define ERROR_STRING_LENGTH	32
 
@@ -72,12 +79,23 @@ extern EFI_STATUS start_boot_logic(CHAR8 *cmdline);
 struct efilinux_commands {
 	CHAR16 *name;
 	void (*func)(void);
+	/* Commands taking the rest of the command line */
+	void (*func_args)(CHAR8 *args);
 } commands[] = {
 	{L"dump_infos", dump_infos},
 	{L"print_pidv", print_pidv},
 	{L"print_rsci", print_rsci},
 	{L"dump_acpi_tables", dump_acpi_tables},
 	{L"load_dsdt", load_dsdt},
+#ifdef RUNTIME_SETTINGS
+	{L"bench_disk", NULL, bench_disk},
+	{L"bench_mem", NULL, bench_mem},
+	{L"bench_var", NULL, bench_var},
+	{L"bench_gop", NULL, bench_gop},
+	{L"bench_protocol", NULL, bench_protocol},
+	{L"bench_memmap", NULL, bench_memmap},
+	{L"bench_all", NULL, bench_all},
+#endif	/* RUNTIME_SETTINGS */
 };
 
 
@@ -246,6 +264,25 @@ parse_args(CHAR16 *options, UINT32 size, CHAR16 *type, CHAR16 **name, CHAR8 **cm
 					goto usage;
 				break;
 			}
+			case 'k': {
+				CHAR16 *handover, *method;
+				EFI_STATUS status;
+				n++;
+				n = get_argument(n, &handover);
+				if (!*handover)
+					goto usage;
+				/* [<target>:]<method> */
+				for (method = handover; *method && *method != ':'; method++)
+					;
+				if (*method) {
+					*method++ = 0;
+					status = set_target_handover(handover, method);
+				} else
+					status = set_kernel_handover(handover);
+				if (EFI_ERROR(status))
+					goto usage;
+				break;
+			}
 			case 'n': {
 				saved_hook_before_jump = loader_ops.hook_before_jump;
 				loader_ops.hook_before_jump = hook_before_jump_forever_loop;
@@ -302,11 +339,15 @@ usage:
 	Print(L"\t-A:             List ACPI tables\n");
 	Print(L"\t-e <policy>:    Set the energy management policy ('uefi', 'fake')\n");
 	Print(L"\t-f <filename>:  image to load\n");
+	Print(L"\t-k [<target>:]<handover>: kernel handover path ('efi', 'legacy'),\n");
+	Print(L"\t                of all targets or of <target> only\n");
 	Print(L"\t-p <partname>:  partition to load\n");
 	Print(L"\t-t <target>:    target to boot\n");
 	Print(L"\t-n:             do as usual but wait indefinitely instead of jumping to the loaded image (for test purpose only)\n");
 	Print(L"\t-c <command>:   debug commands (dump_infos, print_pidv, print_rsci,\n");
 	Print(L"\t                dump_acpi_tables or load_dsdt)\n");
+	Print(L"\t-c bench_<name> [partition] [csv]: benchmarks (disk, mem, var, gop,\n");
+	Print(L"\t                protocol, memmap or all), csv saves bench_<name>.csv to the ESP\n");
 #endif	/* RUNTIME_SETTINGS */
 
 fail:
@@ -473,6 +514,22 @@ static EFI_STATUS store_osloader_version(char *version)
 	return ret;
 }
 
+/*
+ * Undo what efi_main() installed in the firmware: interposed services
+ * and event notification functions are loader code, they must not
+ * outlive the image. The platform hook_before_exit does it as well
+ * but it is a stub until the platform is initialized, this runs on
+ * every return of efi_main().
+ */
+static void loader_teardown(void)
+{
+	uefi_keys_stop_sampling();
+	phase_profiler_stop();
+#ifdef CONFIG_FW_TRACE
+	fw_trace_stop();
+#endif
+}
+
 /**
  * efi_main - The entry point for the OS loader image.
  * @image: firmware-allocated handle that identifies the image
@@ -489,6 +546,7 @@ efi_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *_table)
 	BOOLEAN options_from_conf_file = FALSE;
 	UINT32 options_size;
 	CHAR8 *cmdline = NULL;
+	struct cmdline shell_cmdline;
 
 	main_image_handle = image;
 	InitializeLib(image, _table);
@@ -499,6 +557,17 @@ efi_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *_table)
 	if (CheckCrc(sys_table->Hdr.HeaderSize, &sys_table->Hdr) != TRUE)
 		return EFI_LOAD_ERROR;
 
+#ifdef CONFIG_ALLOC_TRACKER
+	alloc_tracker_start();
+#endif
+#ifdef CONFIG_FW_TRACE
+	fw_trace_start();
+#endif
+	phase_profiler_start();
+
+	/* The combo keys window covers the whole loader initialization */
+	uefi_keys_start_sampling();
+
 	info(banner, EFILINUX_VERSION_MAJOR, EFILINUX_VERSION_MINOR,
 		EFILINUX_BUILD_STRING, EFILINUX_VERSION_STRING,
 		EFILINUX_VERSION_DATE);
@@ -535,6 +604,7 @@ efi_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *_table)
 		error(L"Failed to initialize platform: %r\n", err);
 		goto fs_deinit;
 	}
+	io_stats_set_clock(loader_ops.get_current_time_us);
 
 	CHAR16 type = '\0';
 	if (options && options_size != 0) {
@@ -546,7 +616,8 @@ efi_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *_table)
 		/* We print the usage message in case of invalid args */
 		if (err == EFI_INVALID_PARAMETER) {
 			fs_exit();
-			return EFI_SUCCESS;
+			err = EFI_SUCCESS;
+			goto out;
 		}
 
 		if (err != EFI_SUCCESS)
@@ -554,6 +625,13 @@ efi_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *_table)
 	}
 
 	debug(L"shell cmdline=%a\n", cmdline);
+	cmdline_init(&shell_cmdline);
+	if (cmdline) {
+		err = cmdline_add(&shell_cmdline, cmdline, strlena(cmdline));
+		if (EFI_ERROR(err))
+			goto free_args;
+	}
+
 	switch(type) {
 	case 'f':
 		if (!name) {
@@ -561,7 +639,7 @@ efi_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *_table)
 			goto free_args;
 		}
 		info(L"Starting file %s\n", name);
-		err = android_image_start_file(image, info->DeviceHandle, name, cmdline);
+		err = android_image_start_file(image, info->DeviceHandle, name, &shell_cmdline);
 		break;
 	case 't': {
 		enum targets target;
@@ -570,7 +648,7 @@ efi_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *_table)
 			goto free_args;
 		}
 		info(L"Starting target %s\n", name);
-		loader_ops.load_target(target, cmdline);
+		loader_ops.load_target(target, &shell_cmdline);
 		break;
 	}
 	case 'p': {
@@ -580,14 +658,20 @@ efi_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *_table)
 			goto free_args;
 		}
 		info(L"Starting partition %s\n", name);
-		err = android_image_start_partition(image, &part_guid, cmdline);
+		err = android_image_start_partition(image, &part_guid, &shell_cmdline,
+						    KERNEL_HANDOVER_DEFAULT);
 		break;
 	}
 	case 'c': {
 		int i;
-		for (i = 0 ; i < sizeof(commands) / sizeof(*commands); i++)
-			if (!StrCmp(commands[i].name, name))
+		for (i = 0 ; i < sizeof(commands) / sizeof(*commands); i++) {
+			if (StrCmp(commands[i].name, name))
+				continue;
+			if (commands[i].func_args)
+				commands[i].func_args(cmdline);
+			else
 				commands[i].func();
+		}
 		err = EFI_SUCCESS;
 	}
 		break;
@@ -600,7 +684,7 @@ efi_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *_table)
 			goto free_args;
 		}
 		debug(L"Loading android image at 0x%x\n", addr);
-		err = android_image_start_buffer(image, addr, cmdline);
+		err = android_image_start_buffer(image, addr, &shell_cmdline);
 		break;
 	}
 	default:
@@ -627,13 +711,17 @@ fs_deinit:
 	if (allocate_pool(EfiLoaderData, ERROR_STRING_LENGTH,
 			  (void **)&error_buf) != EFI_SUCCESS) {
 		error(L"Couldn't allocate pages for error string\n");
-		return err;
+		goto out;
 	}
 
 	StatusToString(error_buf, err);
 	error(L": %s\n", error_buf);
 
 	loader_ops.hook_before_exit();
+	loader_teardown();
 
 	return exit(image, err, ERROR_STRING_LENGTH, error_buf);
+out:
+	loader_teardown();
+	return err;
 }
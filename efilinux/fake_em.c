@@ -31,8 +31,14 @@
 #include <efi.h>
 #include <efilib.h>
 #include "log.h"
+#include "stdlib.h"
 #include "fake_em.h"
 
+static EFI_STATUS fake_get_battery_status(struct battery_status *status)
+{
+	return EFI_UNSUPPORTED;
+}
+
 static enum batt_levels fake_get_battery_level(void)
 {
 	return BATT_BOOT_OS;
@@ -53,15 +59,27 @@ static BOOLEAN fake_is_battery_below_vbattfreqlmt(void)
 	return FALSE;
 }
 
+static void fake_snapshot(struct em_snapshot *s)
+{
+	memset(s, 0, sizeof(*s));
+	s->status = fake_get_battery_status(&s->battery);
+	s->level = fake_get_battery_level();
+	s->battery_ok = fake_is_battery_ok();
+	s->charger_present = fake_is_charger_present();
+	s->below_vbattfreqlmt = fake_is_battery_below_vbattfreqlmt();
+}
+
 static void fake_print_battery_infos(void)
 {
 	info(L"Fake Battery, no info\n");
 }
 
 struct energy_mgmt_ops fake_em_ops = {
+	.get_battery_status = fake_get_battery_status,
 	.get_battery_level = fake_get_battery_level,
 	.is_battery_ok = fake_is_battery_ok,
 	.is_charger_present = fake_is_charger_present,
 	.is_battery_below_vbattfreqlmt = fake_is_battery_below_vbattfreqlmt,
-	.print_battery_infos = fake_print_battery_infos
+	.print_battery_infos = fake_print_battery_infos,
+	.snapshot = fake_snapshot
 };
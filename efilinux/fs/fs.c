@@ -151,6 +151,7 @@ found:
 
 	f->fh = fh;
 	*file = f;
+	io_stats_open_file(fh, filename);
 
 	return err;
 
@@ -33,6 +33,7 @@
 
 #include <efi.h>
 #include <efilib.h>
+#include "io_stats.h"
 
 #define MAX_FILENAME	256
 
@@ -61,7 +62,7 @@ volume_open(EFI_FILE_IO_INTERFACE *vol, EFI_FILE_HANDLE *fh)
 static inline EFI_STATUS
 file_read(struct file *f, UINTN *size, void *buf)
 {
-	return uefi_call_wrapper(f->handle->Read, 3, f->fh, size, buf);
+	return io_file_read(f->fh, size, buf);
 }
 
 /**
@@ -0,0 +1,553 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file records the firmware calls of the loader, in eng builds,
+ * by interposing on the boot and runtime services tables and on the
+ * DiskIo protocols of the partitions the loader opens. The trace is
+ * written to the ESP when the loader is about to hand over, see
+ * fw_trace_format.h.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "stdlib.h"
+#include "uefi_utils.h"
+#include "platform/x86.h"
+#include "fw_trace.h"
+#include "fw_trace_format.h"
+
+#define FW_TRACE_FILE		L"fw_trace.bin"
+#define FW_TRACE_WRITE_SIZE	(256 * 1024)
+#define FW_TRACE_MAX_RECORDS	16384
+#define FW_TRACE_MAX_OBJECTS	256
+#define FW_TRACE_MAX_NAME	64
+#define FW_TRACE_MAX_DISKS	32
+#define FW_TRACE_MEMMAP_SIZE	(16 * 1024)
+
+struct trace_object {
+	struct fw_trace_object hdr;
+	CHAR16 name[FW_TRACE_MAX_NAME];
+};
+
+struct traced_disk {
+	EFI_DISK_IO *disk_io;
+	EFI_DISK_READ read_disk;
+	UINT16 object;
+};
+
+static struct {
+	BOOLEAN recording;
+	UINT64 start_tsc;
+	struct fw_trace_record *records;
+	UINT32 count;
+	UINT32 dropped;
+	struct trace_object objects[FW_TRACE_MAX_OBJECTS];
+	UINT32 object_count;
+	struct traced_disk disks[FW_TRACE_MAX_DISKS];
+	UINTN disk_count;
+	UINT8 memmap[FW_TRACE_MEMMAP_SIZE];
+	UINTN memmap_size;
+	UINTN memmap_desc_size;
+} trace;
+
+/* Original services, called by the interposed ones */
+static EFI_BOOT_SERVICES orig_bs;
+static EFI_RUNTIME_SERVICES orig_rt;
+
+/*
+ * The traced services are also called from event notification
+ * functions running at raised TPL, the trace is only updated at
+ * TPL_HIGH_LEVEL so that they cannot interrupt an update.
+ */
+static EFI_TPL trace_lock(void)
+{
+	return uefi_call_wrapper(orig_bs.RaiseTPL, 1, TPL_HIGH_LEVEL);
+}
+
+static void trace_unlock(EFI_TPL tpl)
+{
+	uefi_call_wrapper(orig_bs.RestoreTPL, 1, tpl);
+}
+
+static UINT16 get_object(UINT8 type, EFI_GUID *guid, CHAR16 *name)
+{
+	struct trace_object *obj;
+	UINT16 object = FW_TRACE_NO_OBJECT;
+	UINTN len = 0;
+	EFI_TPL tpl;
+	UINT32 i;
+
+	if (name)
+		for (len = 0; name[len] && len < FW_TRACE_MAX_NAME; len++)
+			;
+
+	tpl = trace_lock();
+	for (i = 0; i < trace.object_count; i++) {
+		obj = &trace.objects[i];
+		if (obj->hdr.type == type && obj->hdr.name_len == len &&
+		    !CompareGuid(&obj->hdr.guid, guid) &&
+		    !memcmp(obj->name, name, len * sizeof(CHAR16))) {
+			object = i;
+			goto out;
+		}
+	}
+
+	if (trace.object_count == FW_TRACE_MAX_OBJECTS)
+		goto out;
+
+	obj = &trace.objects[trace.object_count];
+	obj->hdr.type = type;
+	obj->hdr.reserved = 0;
+	obj->hdr.name_len = len;
+	obj->hdr.guid = *guid;
+	if (len)
+		memcpy(obj->name, name, len * sizeof(CHAR16));
+	object = trace.object_count++;
+out:
+	trace_unlock(tpl);
+	return object;
+}
+
+static void record(UINT8 op, EFI_STATUS status, UINT16 object, UINT64 size,
+		   UINT64 arg, UINT32 extra, UINT64 start)
+{
+	struct fw_trace_record *r;
+	UINT64 duration = rdtsc() - start;
+	EFI_TPL tpl;
+
+	if (!trace.recording)
+		return;
+
+	tpl = trace_lock();
+	if (trace.count == FW_TRACE_MAX_RECORDS) {
+		trace.dropped++;
+		goto out;
+	}
+
+	r = &trace.records[trace.count++];
+	r->op = op;
+	r->status = FW_TRACE_STATUS(status);
+	r->object = object;
+	r->size = size;
+	r->arg = arg;
+	r->start = start - trace.start_tsc;
+	r->duration = duration > 0xffffffff ? 0xffffffff : duration;
+	r->extra = extra;
+out:
+	trace_unlock(tpl);
+}
+
+static UINT16 protocol_object(EFI_GUID *protocol)
+{
+	return protocol ? get_object(FW_TRACE_OBJECT_PROTOCOL, protocol, NULL) :
+		FW_TRACE_NO_OBJECT;
+}
+
+static EFI_STATUS EFI_CALLBACK trace_allocate_pages(EFI_ALLOCATE_TYPE type,
+						    EFI_MEMORY_TYPE mem_type,
+						    UINTN pages,
+						    EFI_PHYSICAL_ADDRESS *memory)
+{
+	UINT64 start = rdtsc();
+	EFI_STATUS ret;
+
+	ret = uefi_call_wrapper(orig_bs.AllocatePages, 4, type, mem_type,
+				pages, memory);
+	record(FW_TRACE_ALLOCATE_PAGES, ret, FW_TRACE_NO_OBJECT, pages,
+	       EFI_ERROR(ret) ? 0 : *memory, mem_type, start);
+	return ret;
+}
+
+static EFI_STATUS EFI_CALLBACK trace_free_pages(EFI_PHYSICAL_ADDRESS memory,
+						UINTN pages)
+{
+	UINT64 start = rdtsc();
+	EFI_STATUS ret;
+
+	ret = uefi_call_wrapper(orig_bs.FreePages, 2, memory, pages);
+	record(FW_TRACE_FREE_PAGES, ret, FW_TRACE_NO_OBJECT, pages, memory, 0,
+	       start);
+	return ret;
+}
+
+static EFI_STATUS EFI_CALLBACK trace_allocate_pool(EFI_MEMORY_TYPE type,
+						   UINTN size, VOID **buffer)
+{
+	UINT64 start = rdtsc();
+	EFI_STATUS ret;
+
+	ret = uefi_call_wrapper(orig_bs.AllocatePool, 3, type, size, buffer);
+	record(FW_TRACE_ALLOCATE_POOL, ret, FW_TRACE_NO_OBJECT, size,
+	       EFI_ERROR(ret) ? 0 : (UINTN)*buffer, type, start);
+	return ret;
+}
+
+static EFI_STATUS EFI_CALLBACK trace_free_pool(VOID *buffer)
+{
+	UINT64 start = rdtsc();
+	EFI_STATUS ret;
+
+	ret = uefi_call_wrapper(orig_bs.FreePool, 1, buffer);
+	record(FW_TRACE_FREE_POOL, ret, FW_TRACE_NO_OBJECT, 0, (UINTN)buffer,
+	       0, start);
+	return ret;
+}
+
+static EFI_STATUS EFI_CALLBACK trace_get_memory_map(UINTN *size,
+						    EFI_MEMORY_DESCRIPTOR *map,
+						    UINTN *key, UINTN *desc_size,
+						    UINT32 *desc_version)
+{
+	UINT64 start = rdtsc();
+	EFI_STATUS ret;
+
+	ret = uefi_call_wrapper(orig_bs.GetMemoryMap, 5, size, map, key,
+				desc_size, desc_version);
+	if (EFI_ERROR(ret)) {
+		record(FW_TRACE_GET_MEMORY_MAP, ret, FW_TRACE_NO_OBJECT, 0, 0,
+		       0, start);
+		return ret;
+	}
+
+	record(FW_TRACE_GET_MEMORY_MAP, ret, FW_TRACE_NO_OBJECT,
+	       *size / *desc_size, *key, 0, start);
+	if (trace.recording && *size <= sizeof(trace.memmap)) {
+		EFI_TPL tpl = trace_lock();
+
+		memcpy(trace.memmap, map, *size);
+		trace.memmap_size = *size;
+		trace.memmap_desc_size = *desc_size;
+		trace_unlock(tpl);
+	}
+	return ret;
+}
+
+static EFI_STATUS EFI_CALLBACK trace_handle_protocol(EFI_HANDLE handle,
+						     EFI_GUID *protocol,
+						     VOID **interface)
+{
+	UINT64 start = rdtsc();
+	EFI_STATUS ret;
+
+	ret = uefi_call_wrapper(orig_bs.HandleProtocol, 3, handle, protocol,
+				interface);
+	record(FW_TRACE_HANDLE_PROTOCOL, ret, protocol_object(protocol), 0,
+	       (UINTN)handle, 0, start);
+	return ret;
+}
+
+static EFI_STATUS EFI_CALLBACK trace_locate_protocol(EFI_GUID *protocol,
+						     VOID *registration,
+						     VOID **interface)
+{
+	UINT64 start = rdtsc();
+	EFI_STATUS ret;
+
+	ret = uefi_call_wrapper(orig_bs.LocateProtocol, 3, protocol,
+				registration, interface);
+	record(FW_TRACE_LOCATE_PROTOCOL, ret, protocol_object(protocol), 0, 0,
+	       0, start);
+	return ret;
+}
+
+static EFI_STATUS EFI_CALLBACK trace_locate_handle(EFI_LOCATE_SEARCH_TYPE type,
+						   EFI_GUID *protocol,
+						   VOID *key, UINTN *size,
+						   EFI_HANDLE *buffer)
+{
+	UINT64 start = rdtsc();
+	EFI_STATUS ret;
+
+	ret = uefi_call_wrapper(orig_bs.LocateHandle, 5, type, protocol, key,
+				size, buffer);
+	record(FW_TRACE_LOCATE_HANDLE, ret, protocol_object(protocol),
+	       EFI_ERROR(ret) ? 0 : *size / sizeof(EFI_HANDLE), 0, type,
+	       start);
+	return ret;
+}
+
+static EFI_STATUS EFI_CALLBACK trace_locate_handle_buffer(EFI_LOCATE_SEARCH_TYPE type,
+							  EFI_GUID *protocol,
+							  VOID *key, UINTN *count,
+							  EFI_HANDLE **buffer)
+{
+	UINT64 start = rdtsc();
+	EFI_STATUS ret;
+
+	ret = uefi_call_wrapper(orig_bs.LocateHandleBuffer, 5, type, protocol,
+				key, count, buffer);
+	record(FW_TRACE_LOCATE_HANDLE_BUFFER, ret, protocol_object(protocol),
+	       EFI_ERROR(ret) ? 0 : *count, 0, type, start);
+	return ret;
+}
+
+static EFI_STATUS EFI_CALLBACK trace_get_variable(CHAR16 *name, EFI_GUID *guid,
+						  UINT32 *attributes,
+						  UINTN *size, VOID *data)
+{
+	UINT64 start = rdtsc();
+	UINT32 attr = 0;
+	EFI_STATUS ret;
+
+	ret = uefi_call_wrapper(orig_rt.GetVariable, 5, name, guid, &attr,
+				size, data);
+	if (attributes)
+		*attributes = attr;
+	record(FW_TRACE_GET_VARIABLE, ret,
+	       get_object(FW_TRACE_OBJECT_VARIABLE, guid, name), *size, 0, attr,
+	       start);
+	return ret;
+}
+
+static EFI_STATUS EFI_CALLBACK trace_set_variable(CHAR16 *name, EFI_GUID *guid,
+						  UINT32 attributes, UINTN size,
+						  VOID *data)
+{
+	UINT64 start = rdtsc();
+	EFI_STATUS ret;
+
+	ret = uefi_call_wrapper(orig_rt.SetVariable, 5, name, guid, attributes,
+				size, data);
+	record(FW_TRACE_SET_VARIABLE, ret,
+	       get_object(FW_TRACE_OBJECT_VARIABLE, guid, name), size, 0,
+	       attributes, start);
+	return ret;
+}
+
+static EFI_STATUS EFI_CALLBACK trace_read_disk(EFI_DISK_IO *this,
+					       UINT32 media_id, UINT64 offset,
+					       UINTN size, VOID *buffer)
+{
+	UINT64 start = rdtsc();
+	struct traced_disk *disk = NULL;
+	EFI_STATUS ret;
+	UINTN i;
+
+	for (i = 0; i < trace.disk_count; i++)
+		if (trace.disks[i].disk_io == this)
+			disk = &trace.disks[i];
+	if (!disk)
+		return EFI_DEVICE_ERROR;
+
+	ret = uefi_call_wrapper(disk->read_disk, 5, this, media_id, offset,
+				size, buffer);
+	record(FW_TRACE_READ_DISK, ret, disk->object, size, offset, media_id,
+	       start);
+	return ret;
+}
+
+static void update_crc(EFI_TABLE_HEADER *hdr)
+{
+	hdr->CRC32 = 0;
+	uefi_call_wrapper(orig_bs.CalculateCrc32, 3, hdr, hdr->HeaderSize,
+			  &hdr->CRC32);
+}
+
+static void hook_tables(void)
+{
+	BS->AllocatePages = (EFI_ALLOCATE_PAGES)trace_allocate_pages;
+	BS->FreePages = (EFI_FREE_PAGES)trace_free_pages;
+	BS->AllocatePool = (EFI_ALLOCATE_POOL)trace_allocate_pool;
+	BS->FreePool = (EFI_FREE_POOL)trace_free_pool;
+	BS->GetMemoryMap = (EFI_GET_MEMORY_MAP)trace_get_memory_map;
+	BS->HandleProtocol = (EFI_HANDLE_PROTOCOL)trace_handle_protocol;
+	BS->LocateProtocol = (EFI_LOCATE_PROTOCOL)trace_locate_protocol;
+	BS->LocateHandle = (EFI_LOCATE_HANDLE)trace_locate_handle;
+	BS->LocateHandleBuffer = (EFI_LOCATE_HANDLE_BUFFER)trace_locate_handle_buffer;
+	update_crc(&BS->Hdr);
+
+	RT->GetVariable = (EFI_GET_VARIABLE)trace_get_variable;
+	RT->SetVariable = (EFI_SET_VARIABLE)trace_set_variable;
+	update_crc(&RT->Hdr);
+}
+
+static void unhook_tables(void)
+{
+	UINTN i;
+
+	BS->AllocatePages = orig_bs.AllocatePages;
+	BS->FreePages = orig_bs.FreePages;
+	BS->AllocatePool = orig_bs.AllocatePool;
+	BS->FreePool = orig_bs.FreePool;
+	BS->GetMemoryMap = orig_bs.GetMemoryMap;
+	BS->HandleProtocol = orig_bs.HandleProtocol;
+	BS->LocateProtocol = orig_bs.LocateProtocol;
+	BS->LocateHandle = orig_bs.LocateHandle;
+	BS->LocateHandleBuffer = orig_bs.LocateHandleBuffer;
+	update_crc(&BS->Hdr);
+
+	RT->GetVariable = orig_rt.GetVariable;
+	RT->SetVariable = orig_rt.SetVariable;
+	update_crc(&RT->Hdr);
+
+	for (i = 0; i < trace.disk_count; i++)
+		trace.disks[i].disk_io->ReadDisk = trace.disks[i].read_disk;
+}
+
+/**
+ * fw_trace_start - start recording the firmware calls
+ *
+ * To be called as early as possible, the calls made before are not
+ * recorded.
+ */
+void fw_trace_start(void)
+{
+	if (trace.records)
+		return;
+
+	trace.records = AllocatePool(FW_TRACE_MAX_RECORDS * sizeof(*trace.records));
+	if (!trace.records) {
+		error(L"Failed to allocate the firmware trace buffer\n");
+		return;
+	}
+
+	orig_bs = *BS;
+	orig_rt = *RT;
+	trace.start_tsc = rdtsc();
+	hook_tables();
+	trace.recording = TRUE;
+}
+
+/**
+ * fw_trace_disk_io - record the reads of a partition DiskIo protocol
+ * @handle: the partition handle
+ * @disk_io: its DiskIo protocol
+ */
+void fw_trace_disk_io(EFI_HANDLE handle, EFI_DISK_IO *disk_io)
+{
+	static EFI_GUID no_guid;
+	EFI_GUID *guid;
+	struct traced_disk *disk;
+	UINTN i;
+
+	if (!trace.recording)
+		return;
+
+	for (i = 0; i < trace.disk_count; i++)
+		if (trace.disks[i].disk_io == disk_io)
+			return;
+	if (trace.disk_count == FW_TRACE_MAX_DISKS)
+		return;
+
+	guid = get_partition_guid(handle);
+	if (!guid)
+		guid = &no_guid;
+
+	disk = &trace.disks[trace.disk_count++];
+	disk->disk_io = disk_io;
+	disk->read_disk = disk_io->ReadDisk;
+	disk->object = get_object(FW_TRACE_OBJECT_PARTITION, guid, NULL);
+	disk_io->ReadDisk = (EFI_DISK_READ)trace_read_disk;
+}
+
+static UINT64 tsc_khz(void)
+{
+	UINT64 start = rdtsc();
+
+	uefi_call_wrapper(BS->Stall, 1, 1000);
+	return rdtsc() - start;
+}
+
+static EFI_STATUS write_trace(void)
+{
+	struct fw_trace_header header;
+	struct uefi_stream stream;
+	EFI_FILE_IO_INTERFACE *io;
+	UINTN objects_size = 0;
+	EFI_STATUS ret;
+	UINT32 i;
+
+	for (i = 0; i < trace.object_count; i++)
+		objects_size += sizeof(trace.objects[i].hdr) +
+			trace.objects[i].hdr.name_len * sizeof(CHAR16);
+
+	memset(&header, 0, sizeof(header));
+	header.magic = FW_TRACE_MAGIC;
+	header.version = FW_TRACE_VERSION;
+	header.header_size = sizeof(header);
+	header.record_size = sizeof(*trace.records);
+	header.record_count = trace.count;
+	header.dropped = trace.dropped;
+	header.object_count = trace.object_count;
+	header.object_offset = sizeof(header) + trace.count * sizeof(*trace.records);
+	header.memmap_count = trace.memmap_desc_size ?
+		trace.memmap_size / trace.memmap_desc_size : 0;
+	header.memmap_desc_size = trace.memmap_desc_size;
+	header.memmap_offset = header.object_offset + objects_size;
+	header.tsc_khz = tsc_khz();
+
+	ret = get_esp_fs(&io);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	ret = uefi_stream_open(&stream, io, FW_TRACE_FILE, FW_TRACE_WRITE_SIZE);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	uefi_stream_write(&stream, &header, sizeof(header));
+	uefi_stream_write(&stream, trace.records,
+			  trace.count * sizeof(*trace.records));
+	for (i = 0; i < trace.object_count; i++)
+		uefi_stream_write(&stream, &trace.objects[i],
+				  sizeof(trace.objects[i].hdr) +
+				  trace.objects[i].hdr.name_len * sizeof(CHAR16));
+	uefi_stream_write(&stream, trace.memmap, trace.memmap_size);
+
+	return uefi_stream_close(&stream);
+}
+
+/**
+ * fw_trace_stop - stop recording and write the trace to the ESP
+ *
+ * The firmware tables are restored first: the interposed functions
+ * are loader code that the kernel does not preserve. It must be called
+ * on every exit of the loader, it does nothing if not recording.
+ */
+void fw_trace_stop(void)
+{
+	EFI_STATUS ret;
+
+	if (!trace.recording)
+		return;
+
+	trace.recording = FALSE;
+	unhook_tables();
+
+	ret = write_trace();
+	if (EFI_ERROR(ret)) {
+		error(L"Failed to write %s: %r\n", FW_TRACE_FILE, ret);
+	} else {
+		info(L"Firmware trace: %d calls, %d dropped, written to %s\n",
+		     trace.count, trace.dropped, FW_TRACE_FILE);
+	}
+
+	FreePool(trace.records);
+	trace.records = NULL;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file describes the firmware call trace written by fw_trace.c
+ * in eng builds and read by the fw_replay host tool:
+ *
+ *   struct fw_trace_header
+ *   struct fw_trace_record[record_count]
+ *   object table at object_offset: for each object, a struct
+ *     fw_trace_object followed by name_len CHAR16 of name
+ *   memmap_count memory descriptors of memmap_desc_size bytes at
+ *     memmap_offset, the last memory map the loader read
+ *
+ * Times are TSC cycles, relative to the start of the trace for
+ * record start times. All the fields are little endian.
+ */
+
+#ifndef __FW_TRACE_FORMAT_H__
+#define __FW_TRACE_FORMAT_H__
+
+#define FW_TRACE_MAGIC		0x52545746	/* FWTR */
+#define FW_TRACE_VERSION	1
+
+#define FW_TRACE_NO_OBJECT	0xffff
+
+/* Error bit and low bits of an EFI_STATUS */
+#define FW_TRACE_STATUS(s)	((EFI_ERROR(s) ? 0x80 : 0) | ((s) & 0x7f))
+
+/*
+ * Meaning of the record fields for each operation:
+ *
+ *                       object     size          arg        extra
+ * ALLOCATE_PAGES        -          pages         address    memory type
+ * FREE_PAGES            -          pages         address    -
+ * ALLOCATE_POOL         -          bytes         address    memory type
+ * FREE_POOL             -          -             address    -
+ * GET_MEMORY_MAP        -          descriptors   map key    -
+ * HANDLE_PROTOCOL       protocol   -             handle     -
+ * LOCATE_PROTOCOL       protocol   -             -          -
+ * LOCATE_HANDLE         protocol   handles       -          search type
+ * LOCATE_HANDLE_BUFFER  protocol   handles       -          search type
+ * GET_VARIABLE          variable   bytes         -          attributes
+ * SET_VARIABLE          variable   bytes         -          attributes
+ * READ_DISK             partition  bytes         offset     media id
+ */
+enum fw_trace_op {
+	FW_TRACE_ALLOCATE_PAGES,
+	FW_TRACE_FREE_PAGES,
+	FW_TRACE_ALLOCATE_POOL,
+	FW_TRACE_FREE_POOL,
+	FW_TRACE_GET_MEMORY_MAP,
+	FW_TRACE_HANDLE_PROTOCOL,
+	FW_TRACE_LOCATE_PROTOCOL,
+	FW_TRACE_LOCATE_HANDLE,
+	FW_TRACE_LOCATE_HANDLE_BUFFER,
+	FW_TRACE_GET_VARIABLE,
+	FW_TRACE_SET_VARIABLE,
+	FW_TRACE_READ_DISK,
+	FW_TRACE_OP_COUNT
+};
+
+enum fw_trace_object_type {
+	FW_TRACE_OBJECT_PROTOCOL,
+	FW_TRACE_OBJECT_VARIABLE,
+	FW_TRACE_OBJECT_PARTITION,	/* unique partition GUID, or zero */
+};
+
+struct fw_trace_header {
+	UINT32 magic;
+	UINT16 version;
+	UINT16 header_size;
+	UINT32 record_size;
+	UINT32 record_count;
+	UINT32 dropped;		/* Records lost to a full buffer */
+	UINT32 object_count;
+	UINT32 object_offset;
+	UINT32 memmap_count;
+	UINT32 memmap_desc_size;
+	UINT32 memmap_offset;
+	UINT64 tsc_khz;
+} __attribute__((packed));
+
+struct fw_trace_record {
+	UINT8 op;
+	UINT8 status;		/* FW_TRACE_STATUS() of the call */
+	UINT16 object;
+	UINT32 size;
+	UINT64 arg;
+	UINT64 start;
+	UINT32 duration;	/* Saturated at 0xffffffff */
+	UINT32 extra;
+} __attribute__((packed));
+
+struct fw_trace_object {
+	UINT8 type;
+	UINT8 reserved;
+	UINT16 name_len;
+	EFI_GUID guid;
+} __attribute__((packed));
+
+#endif	/* __FW_TRACE_FORMAT_H__ */
@@ -35,6 +35,7 @@
 #include "android/boot.h"
 #include "utils.h"
 #include "uefi_utils.h"
+#include "io_stats.h"
 #include <bootloader.h>
 
 #define BOOT_GUID	{0x80868086, 0x8086, 0x8086, {0x80, 0x86, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00}}
@@ -49,6 +50,7 @@ struct target_entry {
 	CHAR16 *name;
 	EFI_GUID guid;
 	CHAR8 *cmdline;
+	enum kernel_handover handover;
 };
 
 static struct target_entry android_entries[] = {
@@ -85,23 +87,28 @@ static EFI_STATUS intel_go_to_rescue_mode(void)
 	UINT64 value = EFI_OS_INDICATION_RESCUE_MODE;
 	EFI_STATUS status;
 
+	UINT64 *os_indications = NULL;
+
 	UINT64 *supported = LibGetVariableAndSize(OS_INDICATIONS_SUPPORTED_VARNAME,
 						  &EfiGlobalVariable, &size);
 	if (!supported || size != sizeof(*supported)) {
 		error(L"Failed to get %s variable\n", OS_INDICATIONS_SUPPORTED_VARNAME);
-		return EFI_LOAD_ERROR;
+		status = EFI_LOAD_ERROR;
+		goto out;
 	}
 
 	if (!(*supported & EFI_OS_INDICATION_RESCUE_MODE)) {
 		error(L"Rescue mode not supported\n");
-		return EFI_UNSUPPORTED;
+		status = EFI_UNSUPPORTED;
+		goto out;
 	}
 
-	UINT64 *os_indications = LibGetVariableAndSize(OS_INDICATIONS_VARNAME,
-						       &EfiGlobalVariable, &size);
+	os_indications = LibGetVariableAndSize(OS_INDICATIONS_VARNAME,
+					       &EfiGlobalVariable, &size);
 	if (os_indications && size != sizeof(*os_indications)) {
 		error(L"%s has incorrect size\n", OS_INDICATIONS_VARNAME);
-		return EFI_LOAD_ERROR;
+		status = EFI_LOAD_ERROR;
+		goto out;
 	}
 
 	if (os_indications)
@@ -111,17 +118,23 @@ static EFI_STATUS intel_go_to_rescue_mode(void)
 				  sizeof(*os_indications), &value);
 	if (EFI_ERROR(status)) {
 		error(L"Failed to set %s variable\n", OS_INDICATIONS_VARNAME);
-		return status;
+		goto out;
 	}
 
 	uefi_reset_system(EfiResetWarm);
 
-	return EFI_SUCCESS;
+out:
+	if (os_indications)
+		FreePool(os_indications);
+	if (supported)
+		FreePool(supported);
+	return status;
 }
 
-EFI_STATUS intel_load_target(enum targets target, CHAR8 *cmdline)
+EFI_STATUS intel_load_target(enum targets target, struct cmdline *cmdline)
 {
-	CHAR8 *updated_cmdline;
+	struct cmdline target_cmdline;
+	EFI_STATUS ret;
 
 	struct target_entry *entry = get_target_entry(target);
 	if (!entry) {
@@ -132,12 +145,32 @@ EFI_STATUS intel_load_target(enum targets target, CHAR8 *cmdline)
 	if (target == TARGET_DNX)
 		return intel_go_to_rescue_mode();
 
-	updated_cmdline = append_strings(cmdline, entry->cmdline);
+	cmdline_init(&target_cmdline);
+	ret = cmdline_append(&target_cmdline, cmdline);
+	if (EFI_ERROR(ret))
+		return ret;
+	ret = cmdline_add(&target_cmdline, entry->cmdline, strlena(entry->cmdline));
+	if (EFI_ERROR(ret))
+		return ret;
 
-	debug(L"target cmdline = %a\n", updated_cmdline ? updated_cmdline : (CHAR8 *)"");
 	debug(L"Loading target %s\n", entry->name);
 
-	return android_image_start_partition(NULL, &entry->guid, updated_cmdline);
+	return android_image_start_partition(NULL, &entry->guid, &target_cmdline,
+					     entry->handover);
+}
+
+EFI_STATUS intel_check_target(enum targets target)
+{
+	struct target_entry *entry = get_target_entry(target);
+	if (!entry)
+		return EFI_UNSUPPORTED;
+
+	if (target == TARGET_DNX)
+		return EFI_SUCCESS;
+
+	debug(L"Checking target %s\n", entry->name);
+
+	return android_image_check_partition(&entry->guid);
 }
 
 static struct target_entry *name_to_entry(CHAR16 *name)
@@ -149,6 +182,29 @@ static struct target_entry *name_to_entry(CHAR16 *name)
 	return NULL;
 }
 
+/* The handover is set on every entry of the target, e.g. "main" and
+ * "android", since get_target_entry() returns the first one */
+EFI_STATUS set_target_handover(CHAR16 *name, const CHAR16 *handover)
+{
+	struct target_entry *entry = name_to_entry(name);
+	enum kernel_handover value;
+	EFI_STATUS ret;
+	UINTN i;
+
+	if (!entry)
+		return EFI_INVALID_PARAMETER;
+
+	ret = kernel_handover_from_name(handover, &value);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	for (i = 0; i < sizeof(android_entries) / sizeof(*android_entries); i++)
+		if (android_entries[i].target == entry->target)
+			android_entries[i].handover = value;
+
+	return EFI_SUCCESS;
+}
+
 EFI_STATUS name_to_guid(CHAR16 *name, EFI_GUID *guid) {
 	struct target_entry *entry = name_to_entry(name);
 
@@ -204,8 +260,7 @@ static EFI_STATUS read_bcb(struct bootloader_message *bcb)
 		return EFI_NOT_FOUND;
 	}
 
-	ret = uefi_call_wrapper(DiskIo->ReadDisk, 5, DiskIo, MediaId, 0,
-				sizeof(*bcb), bcb);
+	ret = io_read_disk(DiskIo, MediaId, 0, sizeof(*bcb), bcb);
 	if (EFI_ERROR(ret)) {
 		warning(L"Could not read Misc partition: %r\n", ret);
 		return ret;
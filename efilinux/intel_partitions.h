@@ -31,12 +31,17 @@
 #define _INTEL_PARTITIONS_H_
 
 #include "bootlogic.h"
+#include "cmdline.h"
 
 EFI_STATUS name_to_guid(CHAR16 *name, EFI_GUID *guid);
 EFI_STATUS name_to_target(CHAR16 *name, enum targets *target);
 EFI_STATUS target_to_name(enum targets target, CHAR16 **name);
+/* Kernel handover ("efi" or "legacy") of the target NAME, overriding
+ * the global set_kernel_handover() one */
+EFI_STATUS set_target_handover(CHAR16 *name, const CHAR16 *handover);
 EFI_STATUS check_gpt(void);
-EFI_STATUS intel_load_target(enum targets target, CHAR8 *cmdline);
+EFI_STATUS intel_load_target(enum targets target, struct cmdline *cmdline);
+EFI_STATUS intel_check_target(enum targets target);
 enum targets load_bcb(void);
 
 #endif /* _INTEL_PARTITIONS_H_ */
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file implements the storage I/O accounting. Partitions and
+ * files are attached to their statistics entry when they are opened,
+ * the read and write wrappers find the entry back from the protocol
+ * or file handle so the callers only swap the firmware call.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "uefi_utils.h"
+#include "io_stats.h"
+
+/* Handles remembered at once, the oldest one is replaced when full */
+#define IO_STATS_MAX_HANDLES	32
+
+static struct io_stats entries[IO_STATS_MAX_ENTRIES];
+static UINTN entry_count;
+
+static struct {
+	VOID *handle;
+	struct io_stats *stats;
+} handles[IO_STATS_MAX_HANDLES];
+static UINTN handle_next;
+
+static UINT64 (*clock_us)(void);
+
+/**
+ * io_stats_set_clock - set the time source of the latencies, they are
+ * not measured until it is set
+ * @clock: returns the current time in microseconds
+ */
+void io_stats_set_clock(UINT64 (*clock)(void))
+{
+	clock_us = clock;
+}
+
+static UINT64 now_us(void)
+{
+	return clock_us ? clock_us() : 0;
+}
+
+/* The last entry collects everything once the table is full */
+static struct io_stats *get_entry(const CHAR16 *name)
+{
+	struct io_stats *s;
+	UINTN i, len;
+
+	len = StrLen((CHAR16 *)name);
+	if (len >= IO_STATS_NAME_LEN)
+		name += len - (IO_STATS_NAME_LEN - 1);
+
+	for (i = 0; i < entry_count; i++)
+		if (!StrCmp(entries[i].name, (CHAR16 *)name))
+			return &entries[i];
+
+	if (entry_count == IO_STATS_MAX_ENTRIES - 1) {
+		s = &entries[entry_count];
+		StrCpy(s->name, L"other");
+		return s;
+	}
+
+	s = &entries[entry_count++];
+	StrCpy(s->name, (CHAR16 *)name);
+	return s;
+}
+
+static void attach(VOID *handle, struct io_stats *s)
+{
+	UINTN i;
+
+	for (i = 0; i < IO_STATS_MAX_HANDLES; i++) {
+		if (handles[i].handle == handle) {
+			handles[i].stats = s;
+			return;
+		}
+	}
+
+	handles[handle_next].handle = handle;
+	handles[handle_next].stats = s;
+	handle_next = (handle_next + 1) % IO_STATS_MAX_HANDLES;
+}
+
+static struct io_stats *lookup(VOID *handle)
+{
+	UINTN i;
+
+	for (i = 0; i < IO_STATS_MAX_HANDLES; i++)
+		if (handles[i].handle == handle)
+			return handles[i].stats;
+
+	return get_entry(L"unknown");
+}
+
+static void account(struct io_stats *s, enum io_op op, UINTN requested,
+		    UINTN done, UINT64 start, EFI_STATUS ret)
+{
+	UINT64 elapsed = now_us() - start;
+	UINTN bucket, limit;
+
+	for (bucket = 0, limit = 4096; bucket < IO_STATS_BUCKETS - 1 &&
+		     requested >= limit; bucket++)
+		limit <<= 2;
+
+	s->calls[op]++;
+	s->bytes[op] += done;
+	s->time_us[op] += elapsed;
+	s->sizes[bucket]++;
+	if (elapsed > s->max_us)
+		s->max_us = elapsed;
+	if (EFI_ERROR(ret))
+		s->errors++;
+}
+
+/**
+ * io_stats_open_partition - attach @disk_io to the entry of the
+ * partition @handle, named after its GPT unique GUID
+ */
+void io_stats_open_partition(EFI_HANDLE handle, EFI_DISK_IO *disk_io)
+{
+	CHAR16 name[IO_STATS_NAME_LEN];
+	EFI_GUID *guid;
+
+	guid = get_partition_guid(handle);
+	if (guid)
+		SPrint(name, sizeof(name), L"%g", guid);
+	else
+		StrCpy(name, L"disk");
+
+	attach(disk_io, get_entry(name));
+}
+
+/**
+ * io_stats_open_file - attach the open @file to the entry of @name,
+ * the reopened files share their entry
+ */
+void io_stats_open_file(EFI_FILE *file, const CHAR16 *name)
+{
+	attach(file, get_entry(name));
+}
+
+EFI_STATUS io_read_disk(EFI_DISK_IO *disk_io, UINT32 media_id, UINT64 offset,
+			UINTN size, VOID *buf)
+{
+	struct io_stats *s = lookup(disk_io);
+	UINT64 start = now_us();
+	EFI_STATUS ret;
+
+	ret = uefi_call_wrapper(disk_io->ReadDisk, 5, disk_io, media_id,
+				offset, size, buf);
+	account(s, IO_READ, size, EFI_ERROR(ret) ? 0 : size, start, ret);
+	return ret;
+}
+
+EFI_STATUS io_file_read(EFI_FILE *file, UINTN *size, VOID *buf)
+{
+	struct io_stats *s = lookup(file);
+	UINTN requested = *size;
+	UINT64 start = now_us();
+	EFI_STATUS ret;
+
+	ret = uefi_call_wrapper(file->Read, 3, file, size, buf);
+	account(s, IO_READ, requested, EFI_ERROR(ret) ? 0 : *size, start, ret);
+	return ret;
+}
+
+EFI_STATUS io_file_write(EFI_FILE *file, UINTN *size, VOID *buf)
+{
+	struct io_stats *s = lookup(file);
+	UINTN requested = *size;
+	UINT64 start = now_us();
+	EFI_STATUS ret;
+
+	ret = uefi_call_wrapper(file->Write, 3, file, size, buf);
+	account(s, IO_WRITE, requested, EFI_ERROR(ret) ? 0 : *size, start, ret);
+	return ret;
+}
+
+/**
+ * io_stats_get - return the entries
+ * @count: number of entries in use
+ */
+struct io_stats *io_stats_get(UINTN *count)
+{
+	*count = entry_count;
+	if (entry_count == IO_STATS_MAX_ENTRIES - 1 &&
+	    entries[entry_count].calls[IO_READ] + entries[entry_count].calls[IO_WRITE])
+		(*count)++;
+	return entries;
+}
+
+static UINT64 kbps(UINT64 bytes, UINT64 time_us)
+{
+	return time_us ? bytes * 1000 / time_us : 0;
+}
+
+/**
+ * io_stats_log - log the I/O summary, one entry per partition or file
+ */
+void io_stats_log(void)
+{
+	struct io_stats *s;
+	UINTN i, count;
+
+	s = io_stats_get(&count);
+	for (i = 0; i < count; i++, s++) {
+		info(L"I/O %s: read %ld calls %ld bytes %ld us %ld KB/s, write %ld calls %ld bytes %ld us %ld KB/s\n",
+		     s->name, s->calls[IO_READ], s->bytes[IO_READ],
+		     s->time_us[IO_READ], kbps(s->bytes[IO_READ], s->time_us[IO_READ]),
+		     s->calls[IO_WRITE], s->bytes[IO_WRITE], s->time_us[IO_WRITE],
+		     kbps(s->bytes[IO_WRITE], s->time_us[IO_WRITE]));
+		info(L"  max %ld us, %d errors, sizes <4K:%d <16K:%d <64K:%d <256K:%d <1M:%d <4M:%d >=4M:%d\n",
+		     s->max_us, s->errors, s->sizes[0], s->sizes[1], s->sizes[2],
+		     s->sizes[3], s->sizes[4], s->sizes[5], s->sizes[6]);
+	}
+}
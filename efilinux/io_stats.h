@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file defines the storage I/O accounting: partition and file
+ * reads and writes go through thin wrappers recording the calls,
+ * bytes, size histogram and latency per partition or file.
+ */
+
+#ifndef __IO_STATS_H__
+#define __IO_STATS_H__
+
+#define IO_STATS_MAX_ENTRIES	16
+#define IO_STATS_NAME_LEN	40
+
+/* Request size buckets: < 4K, < 16K, < 64K, < 256K, < 1M, < 4M, >= 4M */
+#define IO_STATS_BUCKETS	7
+
+enum io_op {
+	IO_READ,
+	IO_WRITE,
+	IO_OP_COUNT
+};
+
+struct io_stats {
+	CHAR16 name[IO_STATS_NAME_LEN];	/* Partition GUID or file path */
+	UINT64 calls[IO_OP_COUNT];
+	UINT64 bytes[IO_OP_COUNT];
+	UINT64 time_us[IO_OP_COUNT];
+	UINT64 max_us;
+	UINT32 errors;
+	UINT32 sizes[IO_STATS_BUCKETS];
+};
+
+void io_stats_set_clock(UINT64 (*clock_us)(void));
+void io_stats_open_partition(EFI_HANDLE handle, EFI_DISK_IO *disk_io);
+void io_stats_open_file(EFI_FILE *file, const CHAR16 *name);
+
+EFI_STATUS io_read_disk(EFI_DISK_IO *disk_io, UINT32 media_id, UINT64 offset,
+			UINTN size, VOID *buf);
+EFI_STATUS io_file_read(EFI_FILE *file, UINTN *size, VOID *buf);
+EFI_STATUS io_file_write(EFI_FILE *file, UINTN *size, VOID *buf);
+
+struct io_stats *io_stats_get(UINTN *count);
+void io_stats_log(void);
+
+#endif /* __IO_STATS_H__ */
@@ -0,0 +1,377 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "stdlib.h"
+#include "acpi.h"
+#include "em.h"
+#include "pmic.h"
+#include "platform/platform.h"
+#include "cpio.h"
+#include "loader_state.h"
+#include "boot_inputs.h"
+#include "io_stats.h"
+
+struct setup_data_hdr {
+	UINT64 next;
+	UINT32 type;
+	UINT32 len;
+} __attribute__((packed));
+
+#define TIMELINE_MAX_EVENTS	16
+
+/* Worst case of a loader/io_stats line */
+#define IO_STATS_LINE_SIZE	(IO_STATS_NAME_LEN + 21 * (8 + IO_STATS_BUCKETS))
+
+static enum targets loader_target = TARGET_UNKNOWN;
+static struct boot_state state;
+static BOOLEAN state_collected;
+
+static struct {
+	const CHAR8 *event;
+	UINT64 time_us;
+} timeline[TIMELINE_MAX_EVENTS];
+static UINTN timeline_len;
+
+void loader_state_mark(const CHAR8 *event)
+{
+	if (timeline_len == TIMELINE_MAX_EVENTS)
+		return;
+
+	timeline[timeline_len].event = event;
+	timeline[timeline_len].time_us = loader_ops.get_current_time_us();
+	timeline_len++;
+}
+
+void loader_state_set_target(enum targets target)
+{
+	loader_target = target;
+	state.target = target;
+}
+
+static void collect_battery(struct boot_state *s, struct em_snapshot *em)
+{
+	if (EFI_ERROR(em->status))
+		return;
+
+	s->flags |= BOOT_STATE_BATTERY_VALID;
+	s->battery_present = em->battery.BatteryPresent;
+	s->battery_valid = em->battery.BatteryValid;
+	s->capacity_readable = em->battery.CapacityReadable;
+	s->battery_voltage = em->battery.BatteryVoltageLevel;
+	s->battery_capacity = em->battery.BatteryCapacityLevel;
+	s->charger_present = em->charger_present;
+}
+
+/* Collect the state once, values do not change during a boot and
+ * several consumers share them. */
+struct boot_state *loader_state_get(void)
+{
+	struct boot_inputs *inputs;
+	enum pmic_types pmic;
+	int wdt_counter;
+
+	if (state_collected)
+		return &state;
+
+	memset((CHAR8 *)&state, 0, sizeof(state));
+	state.magic = BOOT_STATE_MAGIC;
+	state.version = BOOT_STATE_VERSION;
+	state.size = sizeof(state);
+	state.target = loader_target;
+
+	/* The reset source and the watchdog counter are read back, the boot
+	 * logic may have updated them after the boot inputs snapshot */
+	inputs = boot_inputs_get();
+	state.wake_source = inputs->wake_source;
+	state.reset_source = loader_ops.get_reset_source();
+	state.reset_type = inputs->reset_type;
+	state.shutdown_source = inputs->shutdown_source;
+	if ((enum reset_sources)state.reset_source != RESET_ERROR) {
+		state.flags |= BOOT_STATE_RSCI_VALID;
+		state.rsci_indicators = rsci_get_indicators();
+	}
+
+	wdt_counter = loader_ops.get_wdt_counter();
+	state.wdt_counter = wdt_counter > 0 ? wdt_counter : 0;
+
+	collect_battery(&state, &inputs->em);
+
+	pmic = pmic_get_type_from_smbios();
+	state.pmic_type = pmic;
+	if (pmic != PMIC_TYPE_UNKNOWN)
+		state.flags |= BOOT_STATE_PMIC_VALID;
+
+	state_collected = TRUE;
+	return &state;
+}
+
+/**
+ * loader_state_setup_data - chain the loader state to the setup_data
+ * list of @bp.
+ * @bp: boot_params handed over to the kernel
+ * @addr: where the allocated page address is stored, so the caller can
+ *        release it if the kernel can't be started
+ */
+EFI_STATUS loader_state_setup_data(struct boot_params *bp, EFI_PHYSICAL_ADDRESS *addr)
+{
+	struct setup_data_hdr *data;
+	struct boot_state *s;
+	EFI_STATUS ret;
+
+	/* setup_data appeared with the 2.09 boot protocol */
+	if (bp->hdr.version < 0x209)
+		return EFI_UNSUPPORTED;
+
+	s = loader_state_get();
+
+	*addr = 0x3fffffff;
+	ret = allocate_pages(AllocateMaxAddress, EfiLoaderData,
+			     EFI_SIZE_TO_PAGES(sizeof(*data) + sizeof(*s)), addr);
+	if (EFI_ERROR(ret)) {
+		*addr = 0;
+		return ret;
+	}
+
+	data = (struct setup_data_hdr *)(UINTN)*addr;
+	data->next = bp->hdr.setup_data;
+	data->type = SETUP_EFILINUX_STATE;
+	data->len = sizeof(*s);
+	memcpy((CHAR8 *)(data + 1), (CHAR8 *)s, sizeof(*s));
+
+	bp->hdr.setup_data = *addr;
+	return EFI_SUCCESS;
+}
+
+struct text {
+	CHAR8 *buf;
+	UINTN len;
+	UINTN size;
+};
+
+static void text_puts(struct text *t, const CHAR8 *str)
+{
+	while (*str && t->len < t->size)
+		t->buf[t->len++] = *str++;
+}
+
+static void text_puts16(struct text *t, const CHAR16 *str)
+{
+	while (*str && t->len < t->size)
+		t->buf[t->len++] = (CHAR8)*str++;
+}
+
+static void text_putu(struct text *t, UINT64 value)
+{
+	CHAR8 digits[21];
+	int i = sizeof(digits) - 1;
+
+	digits[i] = '\0';
+	do {
+		digits[--i] = '0' + (value % 10);
+		value /= 10;
+	} while (value);
+
+	text_puts(t, digits + i);
+}
+
+static void text_put_field(struct text *t, const CHAR8 *key, INT64 value)
+{
+	text_puts(t, key);
+	text_puts(t, (CHAR8 *)"=");
+	if (value < 0) {
+		text_puts(t, (CHAR8 *)"-");
+		value = -value;
+	}
+	text_putu(t, value);
+	text_puts(t, (CHAR8 *)"\n");
+}
+
+static UINTN format_boot_reason(struct boot_state *s, CHAR8 *buf, UINTN size)
+{
+	struct text t = { buf, 0, size };
+
+	text_put_field(&t, (CHAR8 *)"target", s->target);
+	text_put_field(&t, (CHAR8 *)"wake_source", s->wake_source);
+	text_put_field(&t, (CHAR8 *)"reset_source", s->reset_source);
+	text_put_field(&t, (CHAR8 *)"reset_type", s->reset_type);
+	text_put_field(&t, (CHAR8 *)"shutdown_source", s->shutdown_source);
+	text_put_field(&t, (CHAR8 *)"wdt_counter", s->wdt_counter);
+	text_put_field(&t, (CHAR8 *)"pmic_type", s->pmic_type);
+
+	return t.len;
+}
+
+static UINTN format_battery(struct boot_state *s, CHAR8 *buf, UINTN size)
+{
+	struct text t = { buf, 0, size };
+
+	if (!(s->flags & BOOT_STATE_BATTERY_VALID))
+		return 0;
+
+	text_put_field(&t, (CHAR8 *)"present", s->battery_present);
+	text_put_field(&t, (CHAR8 *)"valid", s->battery_valid);
+	text_put_field(&t, (CHAR8 *)"capacity_readable", s->capacity_readable);
+	text_put_field(&t, (CHAR8 *)"voltage_mv", s->battery_voltage);
+	text_put_field(&t, (CHAR8 *)"capacity", s->battery_capacity);
+	text_put_field(&t, (CHAR8 *)"charger_present", s->charger_present);
+
+	return t.len;
+}
+
+static UINTN format_boot_inputs(CHAR8 *buf, UINTN size)
+{
+	struct boot_inputs *inputs = boot_inputs_get();
+	struct text t = { buf, 0, size };
+
+	text_put_field(&t, (CHAR8 *)"fw_calls", inputs->fw_calls);
+	text_put_field(&t, (CHAR8 *)"collect_us", inputs->collect_time_us);
+
+	return t.len;
+}
+
+static UINTN format_timeline(CHAR8 *buf, UINTN size)
+{
+	struct text t = { buf, 0, size };
+	UINTN i;
+
+	for (i = 0; i < timeline_len; i++)
+		text_put_field(&t, timeline[i].event, timeline[i].time_us);
+
+	return t.len;
+}
+
+/*
+ * One line per partition GUID or file: name, read calls, bytes and
+ * microseconds, write calls, bytes and microseconds, longest call in
+ * microseconds, errors, then the count of requests of less than 4K,
+ * 16K, 64K, 256K, 1M, 4M and the larger ones.
+ */
+static UINTN format_io_stats(CHAR8 *buf, UINTN size)
+{
+	struct text t = { buf, 0, size };
+	struct io_stats *s;
+	UINTN i, j, count;
+
+	s = io_stats_get(&count);
+	for (i = 0; i < count; i++, s++) {
+		UINT64 values[] = {
+			s->calls[IO_READ], s->bytes[IO_READ], s->time_us[IO_READ],
+			s->calls[IO_WRITE], s->bytes[IO_WRITE], s->time_us[IO_WRITE],
+			s->max_us, s->errors
+		};
+
+		text_puts16(&t, s->name);
+		for (j = 0; j < sizeof(values) / sizeof(*values); j++) {
+			text_puts(&t, (CHAR8 *)" ");
+			text_putu(&t, values[j]);
+		}
+		for (j = 0; j < IO_STATS_BUCKETS; j++) {
+			text_puts(&t, (CHAR8 *)" ");
+			text_putu(&t, s->sizes[j]);
+		}
+		text_puts(&t, (CHAR8 *)"\n");
+	}
+
+	return t.len;
+}
+
+/**
+ * loader_state_cpio - build a newc cpio archive exposing the loader
+ * state as plain files under /loader, so that init can read them at
+ * first stage without going through efivarfs.
+ * @buf: destination buffer, appended to the ramdisk
+ * @size: size of @buf
+ * @len: size of the generated archive
+ */
+EFI_STATUS loader_state_cpio(CHAR8 *buf, UINTN size, UINTN *len)
+{
+	static const struct {
+		const CHAR8 *name;
+		UINTN (*format)(struct boot_state *, CHAR8 *, UINTN);
+	} files[] = {
+		{ (CHAR8 *)"loader/boot_reason", format_boot_reason },
+		{ (CHAR8 *)"loader/battery", format_battery },
+	};
+	static CHAR8 io_stats_text[IO_STATS_MAX_ENTRIES * IO_STATS_LINE_SIZE];
+	static const CHAR8 *io_stats_name = (CHAR8 *)"loader/io_stats";
+	struct boot_state *s = loader_state_get();
+	CHAR8 content[512];
+	UINTN i, content_len, room;
+	EFI_STATUS ret;
+
+	*len = 0;
+	ret = cpio_add_entry(buf, size, len, (CHAR8 *)"loader", CPIO_MODE_DIR, NULL, 0);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	for (i = 0; i < sizeof(files) / sizeof(*files); i++) {
+		content_len = files[i].format(s, content, sizeof(content));
+		ret = cpio_add_entry(buf, size, len, files[i].name,
+				     CPIO_MODE_FILE, content, content_len);
+		if (EFI_ERROR(ret))
+			return ret;
+	}
+
+	content_len = format_boot_inputs(content, sizeof(content));
+	ret = cpio_add_entry(buf, size, len, (CHAR8 *)"loader/boot_inputs",
+			     CPIO_MODE_FILE, content, content_len);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	content_len = format_timeline(content, sizeof(content));
+	ret = cpio_add_entry(buf, size, len, (CHAR8 *)"loader/timeline",
+			     CPIO_MODE_FILE, content, content_len);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	/* The I/O statistics can outgrow the archive on their own, they get
+	 * what is left, cut at a line boundary, so that the files above
+	 * and the trailer always make it */
+	room = cpio_entry_size(io_stats_name, 0) + cpio_trailer_size();
+	if (*len + room <= size) {
+		room = size - *len - room;
+		content_len = format_io_stats(io_stats_text, sizeof(io_stats_text));
+		if (content_len > room) {
+			warning(L"I/O statistics truncated to %d bytes\n", room);
+			for (content_len = room; content_len > 0; content_len--)
+				if (io_stats_text[content_len - 1] == '\n')
+					break;
+		}
+		ret = cpio_add_entry(buf, size, len, io_stats_name,
+				     CPIO_MODE_FILE, io_stats_text, content_len);
+		if (EFI_ERROR(ret))
+			return ret;
+	}
+
+	return cpio_add_trailer(buf, size, len);
+}
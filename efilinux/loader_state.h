@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __LOADER_STATE_H__
+#define __LOADER_STATE_H__
+
+#include <efi.h>
+#include <asm/bootparam.h>
+#include "bootlogic.h"
+#include "boot_state.h"
+
+/* Size reserved after the ramdisk for the loader cpio archive. The
+ * files of at most 512 bytes and the cpio headers take less than 3K,
+ * loader/io_stats is cut to fit in the rest. */
+#define LOADER_CPIO_MAX_SIZE	8192
+
+void loader_state_set_target(enum targets target);
+void loader_state_mark(const CHAR8 *event);
+struct boot_state *loader_state_get(void);
+EFI_STATUS loader_state_setup_data(struct boot_params *bp, EFI_PHYSICAL_ADDRESS *addr);
+EFI_STATUS loader_state_cpio(CHAR8 *buf, UINTN size, UINTN *len);
+
+#endif	/* __LOADER_STATE_H__ */
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file implements a greedy compressor and a bounds checked
+ * decompressor for the LZ4 block format, as documented in
+ * lz4_Block_format.md of the LZ4 project.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "lz4.h"
+#include "stdlib.h"
+
+#define MINMATCH	4
+#define LASTLITERALS	5	/* The last 5 bytes are always literals */
+#define MFLIMIT		12	/* The last match starts 12 bytes before the end */
+#define MAX_DISTANCE	0xffff
+#define HASH_BITS	12
+#define RUN_MASK	0xf
+#define SKIP_TRIGGER	6	/* Speed up the search on incompressible data */
+
+static UINT16 hash_table[1 << HASH_BITS];
+
+static inline UINT32 read32(const UINT8 *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((UINT32)p[3] << 24);
+}
+
+static inline UINT32 hash(UINT32 seq)
+{
+	return (seq * 2654435761U) >> (32 - HASH_BITS);
+}
+
+static UINT8 *put_length(UINT8 *op, UINTN len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = len;
+	return op;
+}
+
+/* Emit a sequence, a null @offset marks the last literals */
+static UINT8 *put_sequence(UINT8 *op, UINT8 *oend, const UINT8 *literals,
+			   UINTN lit_len, UINTN offset, UINTN match_len)
+{
+	UINT8 *token;
+
+	if (op + 1 + lit_len / 255 + 1 + lit_len + 2 + match_len / 255 + 1 > oend)
+		return NULL;
+
+	token = op++;
+	*token = (lit_len < RUN_MASK ? lit_len : RUN_MASK) << 4;
+	if (lit_len >= RUN_MASK)
+		op = put_length(op, lit_len - RUN_MASK);
+	memcpy(op, literals, lit_len);
+	op += lit_len;
+
+	if (!offset)
+		return op;
+
+	*op++ = offset & 0xff;
+	*op++ = offset >> 8;
+	match_len -= MINMATCH;
+	*token |= match_len < RUN_MASK ? match_len : RUN_MASK;
+	if (match_len >= RUN_MASK)
+		op = put_length(op, match_len - RUN_MASK);
+
+	return op;
+}
+
+/**
+ * lz4_compress - Compress a buffer to a LZ4 block
+ * @src: data to compress, at most LZ4_MAX_INPUT_SIZE bytes
+ * @src_size: size of @src
+ * @dst: output buffer
+ * @dst_size: size of @dst
+ *
+ * Return the size of the block, or 0 if it doesn't fit in @dst in
+ * which case the data should be stored uncompressed.
+ */
+UINTN lz4_compress(const void *src, UINTN src_size, void *dst, UINTN dst_size)
+{
+	const UINT8 *base = src, *anchor = src, *ip = src, *ref;
+	const UINT8 *iend = base + src_size;
+	UINT8 *op = dst, *oend = op + dst_size;
+	UINTN misses = 0, len;
+	UINT32 seq, h;
+
+	if (src_size > LZ4_MAX_INPUT_SIZE)
+		return 0;
+
+	if (src_size < MFLIMIT + 1)
+		goto last_literals;
+
+	memset(hash_table, 0, sizeof(hash_table));
+
+	while (ip + MFLIMIT <= iend) {
+		seq = read32(ip);
+		h = hash(seq);
+		ref = base + hash_table[h];
+		hash_table[h] = ip - base;
+
+		if (ref >= ip || ip - ref > MAX_DISTANCE || read32(ref) != seq) {
+			ip += 1 + (misses++ >> SKIP_TRIGGER);
+			continue;
+		}
+		misses = 0;
+
+		len = MINMATCH;
+		while (ip + len < iend - LASTLITERALS && ref[len] == ip[len])
+			len++;
+
+		op = put_sequence(op, oend, anchor, ip - anchor, ip - ref, len);
+		if (!op)
+			return 0;
+
+		ip += len;
+		anchor = ip;
+	}
+
+last_literals:
+	op = put_sequence(op, oend, anchor, iend - anchor, 0, 0);
+	if (!op)
+		return 0;
+
+	return op - (UINT8 *)dst;
+}
+
+static const UINT8 *get_length(const UINT8 *ip, const UINT8 *iend, UINTN *len)
+{
+	UINT8 b;
+
+	do {
+		if (ip >= iend)
+			return NULL;
+		b = *ip++;
+		*len += b;
+	} while (b == 255);
+
+	return ip;
+}
+
+/**
+ * lz4_decompress - Decompress a LZ4 block
+ * @src: the block
+ * @src_size: size of the block
+ * @dst: output buffer
+ * @dst_size: size of @dst, updated with the decompressed size
+ *
+ * Return EFI_COMPROMISED_DATA if the block is malformed or doesn't fit
+ * in @dst.
+ */
+EFI_STATUS lz4_decompress(const void *src, UINTN src_size,
+			  void *dst, UINTN *dst_size)
+{
+	const UINT8 *ip = src, *iend = ip + src_size;
+	UINT8 *op = dst, *oend = op + *dst_size, *match;
+	UINTN len, offset;
+	UINT8 token;
+
+	while (ip < iend) {
+		token = *ip++;
+
+		len = token >> 4;
+		if (len == RUN_MASK) {
+			ip = get_length(ip, iend, &len);
+			if (!ip)
+				return EFI_COMPROMISED_DATA;
+		}
+		if (len > (UINTN)(iend - ip) || len > (UINTN)(oend - op))
+			return EFI_COMPROMISED_DATA;
+		memcpy(op, ip, len);
+		ip += len;
+		op += len;
+
+		/* The last sequence has no match */
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return EFI_COMPROMISED_DATA;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (!offset || offset > (UINTN)(op - (UINT8 *)dst))
+			return EFI_COMPROMISED_DATA;
+
+		len = token & RUN_MASK;
+		if (len == RUN_MASK) {
+			ip = get_length(ip, iend, &len);
+			if (!ip)
+				return EFI_COMPROMISED_DATA;
+		}
+		len += MINMATCH;
+		if (len > (UINTN)(oend - op))
+			return EFI_COMPROMISED_DATA;
+
+		/* The match may overlap the output */
+		match = op - offset;
+		if (offset >= len) {
+			memcpy(op, match, len);
+			op += len;
+		} else {
+			while (len--)
+				*op++ = *match++;
+		}
+	}
+
+	*dst_size = op - (UINT8 *)dst;
+	return EFI_SUCCESS;
+}
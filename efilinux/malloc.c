@@ -27,6 +27,9 @@
  * OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/* The tracker wraps these allocators, not their implementation */
+#define ALLOC_TRACKER_NO_WRAP
+
 #include <efi.h>
 #include <efilib.h>
 #include "efilinux.h"
@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* The loops below must not be turned into calls to memcpy/memset */
+#pragma GCC optimize ("no-tree-loop-distribute-patterns")
+
+#include <efi.h>
+#include "mem.h"
+#include "platform/x86.h"
+
+#define MEM_DETECTED		(1 << 0)
+#define MEM_HAS_ERMS		(1 << 1)
+#define MEM_HAS_SSE2		(1 << 2)
+
+#define MEM_SMALL_SIZE		64
+/* Used when the last level cache size can't be read from CPUID */
+#define MEM_DEFAULT_LLC_SIZE	(1024 * 1024)
+
+#ifdef CONFIG_X86_64
+#define MOVS_WORD	"rep movsq"
+#define STOS_WORD	"rep stosq"
+#define WORD_PATTERN	0x0101010101010101ULL
+#else
+#define MOVS_WORD	"rep movsl"
+#define STOS_WORD	"rep stosl"
+#define WORD_PATTERN	0x01010101UL
+#endif
+
+static UINT32 mem_features;
+/* Destinations larger than this are written with non-temporal stores
+ * so that they don't evict the whole cache */
+static UINTN nt_threshold = MEM_DEFAULT_LLC_SIZE;
+
+static UINTN llc_size(void)
+{
+	UINT32 reg[4], i, type;
+	UINTN size = 0, cache_size;
+
+	cpuid(0, reg);
+	if (reg[0] < 4)
+		return 0;
+
+	/* Deterministic cache parameters leaf */
+	for (i = 0; i < 8; i++) {
+		cpuid_count(4, i, reg);
+		type = reg[0] & 0x1f;
+		if (!type)
+			break;
+		if (type == 2)		/* Instruction cache */
+			continue;
+
+		cache_size = (((reg[1] >> 22) & 0x3ff) + 1)	/* Ways */
+			* (((reg[1] >> 12) & 0x3ff) + 1)	/* Partitions */
+			* ((reg[1] & 0xfff) + 1)		/* Line size */
+			* (reg[2] + 1);				/* Sets */
+		if (cache_size > size)
+			size = cache_size;
+	}
+
+	return size;
+}
+
+static void mem_detect(void)
+{
+	UINT32 reg[4];
+	UINTN llc;
+
+	mem_features = MEM_DETECTED;
+
+	cpuid(0, reg);
+	if (reg[0] >= 7) {
+		cpuid_count(7, 0, reg);
+		if (reg[1] & (1 << 9))
+			mem_features |= MEM_HAS_ERMS;
+	}
+
+#ifdef CONFIG_X86_64
+	/* SSE2 is architectural on x86_64 and UEFI enables it, it may
+	 * not be enabled by 32 bits firmwares so it is never used there */
+	cpuid(1, reg);
+	if (reg[3] & (1 << 26))
+		mem_features |= MEM_HAS_SSE2;
+#endif
+
+	llc = llc_size();
+	if (llc)
+		nt_threshold = llc;
+}
+
+static inline UINT32 features(void)
+{
+	if (!mem_features)
+		mem_detect();
+	return mem_features;
+}
+
+/* Machine words with an overlapping last word, used below
+ * MEM_SMALL_SIZE where the string instructions startup cost dominates */
+static void copy_small(CHAR8 *dst, const CHAR8 *src, UINTN size)
+{
+	UINTN i;
+
+	if (size < sizeof(UINTN)) {
+		while (size--)
+			*dst++ = *src++;
+		return;
+	}
+
+	for (i = 0; i < size - sizeof(UINTN); i += sizeof(UINTN))
+		*(UINTN *)(dst + i) = *(const UINTN *)(src + i);
+	*(UINTN *)(dst + size - sizeof(UINTN)) =
+		*(const UINTN *)(src + size - sizeof(UINTN));
+}
+
+static void set_small(CHAR8 *dst, CHAR8 c, UINTN size)
+{
+	UINTN i, pattern;
+
+	if (size < sizeof(UINTN)) {
+		while (size--)
+			*dst++ = c;
+		return;
+	}
+
+	pattern = (UINTN)WORD_PATTERN * (UINT8)c;
+	for (i = 0; i < size - sizeof(UINTN); i += sizeof(UINTN))
+		*(UINTN *)(dst + i) = pattern;
+	*(UINTN *)(dst + size - sizeof(UINTN)) = pattern;
+}
+
+static void copy_movsb(void *dst, const void *src, UINTN size)
+{
+	asm volatile("rep movsb"
+		     : "+D" (dst), "+S" (src), "+c" (size)
+		     : : "memory");
+}
+
+static void set_stosb(void *dst, CHAR8 c, UINTN size)
+{
+	asm volatile("rep stosb"
+		     : "+D" (dst), "+c" (size)
+		     : "a" (c) : "memory");
+}
+
+static void copy_movs(void *dst, const void *src, UINTN size)
+{
+	UINTN words = size / sizeof(UINTN);
+	UINTN tail = size % sizeof(UINTN);
+
+	asm volatile(MOVS_WORD
+		     : "+D" (dst), "+S" (src), "+c" (words)
+		     : : "memory");
+	copy_movsb(dst, src, tail);
+}
+
+static void set_stos(void *dst, CHAR8 c, UINTN size)
+{
+	UINTN words = size / sizeof(UINTN);
+	UINTN tail = size % sizeof(UINTN);
+	UINTN pattern = (UINTN)WORD_PATTERN * (UINT8)c;
+
+	asm volatile(STOS_WORD
+		     : "+D" (dst), "+c" (words)
+		     : "a" (pattern) : "memory");
+	set_stosb(dst, c, tail);
+}
+
+#ifdef CONFIG_X86_64
+/*
+ * The xmm registers are not known to the compiler, they only carry
+ * data within a single asm statement. The memory operands tell it
+ * which bytes are read and written.
+ */
+#define BLOCK_64(p)	(*(CHAR8 (*)[64])(p))
+#define PATTERN_16(p)	(*(const UINT64 (*)[2])(p))
+
+#define COPY_64(insn, dst, src)						\
+	asm volatile("movdqu   (%[s]), %%xmm0\n\t"			\
+		     "movdqu 16(%[s]), %%xmm1\n\t"			\
+		     "movdqu 32(%[s]), %%xmm2\n\t"			\
+		     "movdqu 48(%[s]), %%xmm3\n\t"			\
+		     insn " %%xmm0,   (%[d])\n\t"			\
+		     insn " %%xmm1, 16(%[d])\n\t"			\
+		     insn " %%xmm2, 32(%[d])\n\t"			\
+		     insn " %%xmm3, 48(%[d])\n\t"			\
+		     : "=m" (BLOCK_64(dst))				\
+		     : [d] "r" (dst), [s] "r" (src),			\
+		       "m" (BLOCK_64(src))				\
+		     : "xmm0", "xmm1", "xmm2", "xmm3", "memory")
+
+#define SET_64(insn, dst, pattern)					\
+	asm volatile("movdqa %[p], %%xmm0\n\t"				\
+		     insn " %%xmm0,   (%[d])\n\t"			\
+		     insn " %%xmm0, 16(%[d])\n\t"			\
+		     insn " %%xmm0, 32(%[d])\n\t"			\
+		     insn " %%xmm0, 48(%[d])\n\t"			\
+		     : "=m" (BLOCK_64(dst))				\
+		     : [d] "r" (dst), [p] "m" (PATTERN_16(pattern))	\
+		     : "xmm0", "memory")
+
+#define SET_16(dst, pattern)						\
+	asm volatile("movdqa %[p], %%xmm0\n\t"				\
+		     "movdqu %%xmm0, (%[d])\n\t"			\
+		     : "=m" (*(CHAR8 (*)[16])(dst))			\
+		     : [d] "r" (dst), [p] "m" (PATTERN_16(pattern))	\
+		     : "xmm0", "memory")
+
+static inline void copy_16(CHAR8 *dst, const CHAR8 *src)
+{
+	asm volatile("movdqu (%[s]), %%xmm0\n\t"
+		     "movdqu %%xmm0, (%[d])\n\t"
+		     : "=m" (*(CHAR8 (*)[16])dst)
+		     : [d] "r" (dst), [s] "r" (src), "m" (*(const CHAR8 (*)[16])src)
+		     : "xmm0", "memory");
+}
+
+/* size must be at least 64 bytes */
+static void copy_sse2(CHAR8 *dst, const CHAR8 *src, UINTN size, BOOLEAN nt)
+{
+	CHAR8 *end = dst + size;
+	const CHAR8 *src_end = src + size;
+	UINTN head;
+
+	/* Unaligned head, then realign the destination */
+	copy_16(dst, src);
+	head = 16 - ((UINTN)dst & 15);
+	dst += head;
+	src += head;
+	size -= head;
+
+	if (nt) {
+		for (; size >= 64; size -= 64, dst += 64, src += 64)
+			COPY_64("movntdq", dst, src);
+		asm volatile("sfence" : : : "memory");
+	} else {
+		for (; size >= 64; size -= 64, dst += 64, src += 64)
+			COPY_64("movdqa", dst, src);
+	}
+
+	for (; size >= 16; size -= 16, dst += 16, src += 16)
+		copy_16(dst, src);
+
+	/* Overlapping unaligned tail */
+	if (size)
+		copy_16(end - 16, src_end - 16);
+}
+
+/* size must be at least 64 bytes */
+static void set_sse2(CHAR8 *dst, CHAR8 c, UINTN size, BOOLEAN nt)
+{
+	UINT64 pattern[2] __attribute__((aligned(16)));
+	CHAR8 *end = dst + size;
+	UINTN head;
+
+	pattern[0] = pattern[1] = WORD_PATTERN * (UINT8)c;
+	SET_16(dst, pattern);
+
+	head = 16 - ((UINTN)dst & 15);
+	dst += head;
+	size -= head;
+
+	if (nt) {
+		for (; size >= 64; size -= 64, dst += 64)
+			SET_64("movntdq", dst, pattern);
+		asm volatile("sfence" : : : "memory");
+	} else {
+		for (; size >= 64; size -= 64, dst += 64)
+			SET_64("movdqa", dst, pattern);
+	}
+
+	for (; size >= 16; size -= 16, dst += 16)
+		SET_16(dst, pattern);
+
+	if (size)
+		SET_16(end - 16, pattern);
+}
+#endif	/* CONFIG_X86_64 */
+
+static enum mem_method pick_method(UINTN size)
+{
+	UINT32 f = features();
+
+	if ((f & MEM_HAS_SSE2) && size >= nt_threshold)
+		return MEM_METHOD_SSE2_NT;
+	if (f & MEM_HAS_ERMS)
+		return MEM_METHOD_ERMS;
+	if (f & MEM_HAS_SSE2)
+		return MEM_METHOD_SSE2;
+	return MEM_METHOD_MOVS;
+}
+
+BOOLEAN mem_method_supported(enum mem_method method)
+{
+	UINT32 f = features();
+
+	switch (method) {
+	case MEM_METHOD_AUTO:
+	case MEM_METHOD_MOVS:
+		return TRUE;
+	case MEM_METHOD_ERMS:
+		return !!(f & MEM_HAS_ERMS);
+	case MEM_METHOD_SSE2:
+	case MEM_METHOD_SSE2_NT:
+		return !!(f & MEM_HAS_SSE2);
+	default:
+		return FALSE;
+	}
+}
+
+const CHAR16 *mem_method_name(enum mem_method method)
+{
+	static const CHAR16 *names[] = {
+		[MEM_METHOD_AUTO] = L"auto",
+		[MEM_METHOD_MOVS] = L"movs",
+		[MEM_METHOD_ERMS] = L"erms",
+		[MEM_METHOD_SSE2] = L"sse2",
+		[MEM_METHOD_SSE2_NT] = L"sse2-nt",
+	};
+
+	return method < MEM_METHOD_MAX ? names[method] : L"unknown";
+}
+
+void *mem_copy_method(enum mem_method method, void *dst, const void *src, UINTN size)
+{
+	if (size < MEM_SMALL_SIZE) {
+		copy_small(dst, src, size);
+		return dst;
+	}
+
+	if (method == MEM_METHOD_AUTO || !mem_method_supported(method))
+		method = pick_method(size);
+
+	switch (method) {
+#ifdef CONFIG_X86_64
+	case MEM_METHOD_SSE2:
+		copy_sse2(dst, src, size, FALSE);
+		break;
+	case MEM_METHOD_SSE2_NT:
+		copy_sse2(dst, src, size, TRUE);
+		break;
+#endif
+	case MEM_METHOD_ERMS:
+		copy_movsb(dst, src, size);
+		break;
+	default:
+		copy_movs(dst, src, size);
+	}
+
+	return dst;
+}
+
+void *mem_set_method(enum mem_method method, void *dst, int c, UINTN size)
+{
+	if (size < MEM_SMALL_SIZE) {
+		set_small(dst, c, size);
+		return dst;
+	}
+
+	if (method == MEM_METHOD_AUTO || !mem_method_supported(method))
+		method = pick_method(size);
+
+	switch (method) {
+#ifdef CONFIG_X86_64
+	case MEM_METHOD_SSE2:
+		set_sse2(dst, c, size, FALSE);
+		break;
+	case MEM_METHOD_SSE2_NT:
+		set_sse2(dst, c, size, TRUE);
+		break;
+#endif
+	case MEM_METHOD_ERMS:
+		set_stosb(dst, c, size);
+		break;
+	default:
+		set_stos(dst, c, size);
+	}
+
+	return dst;
+}
+
+void *mem_copy(void *dst, const void *src, UINTN size)
+{
+	return mem_copy_method(MEM_METHOD_AUTO, dst, src, size);
+}
+
+void *mem_set(void *dst, int c, UINTN size)
+{
+	return mem_set_method(MEM_METHOD_AUTO, dst, c, size);
+}
+
+int mem_cmp(const void *s1, const void *s2, UINTN size)
+{
+	const CHAR8 *p1 = s1, *p2 = s2;
+
+	/* Skip the identical words, the first different byte is found
+	 * by the byte loop */
+	for (; size >= sizeof(UINTN); size -= sizeof(UINTN)) {
+		if (*(const UINTN *)p1 != *(const UINTN *)p2)
+			break;
+		p1 += sizeof(UINTN);
+		p2 += sizeof(UINTN);
+	}
+
+	for (; size; size--, p1++, p2++)
+		if (*p1 != *p2)
+			return (UINT8)*p1 - (UINT8)*p2;
+
+	return 0;
+}
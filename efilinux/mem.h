@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __MEM_H__
+#define __MEM_H__
+
+#include <efi.h>
+
+enum mem_method {
+	MEM_METHOD_AUTO,	/* Pick the best method by size and CPU */
+	MEM_METHOD_MOVS,	/* rep movs/stos by machine words */
+	MEM_METHOD_ERMS,	/* rep movsb/stosb, Enhanced REP MOVSB/STOSB */
+	MEM_METHOD_SSE2,	/* unaligned head, 16 bytes aligned body */
+	MEM_METHOD_SSE2_NT,	/* same with non-temporal stores */
+	MEM_METHOD_MAX
+};
+
+void *mem_copy(void *dst, const void *src, UINTN size);
+void *mem_set(void *dst, int c, UINTN size);
+int mem_cmp(const void *s1, const void *s2, UINTN size);
+
+BOOLEAN mem_method_supported(enum mem_method method);
+const CHAR16 *mem_method_name(enum mem_method method);
+void *mem_copy_method(enum mem_method method, void *dst, const void *src, UINTN size);
+void *mem_set_method(enum mem_method method, void *dst, int c, UINTN size);
+
+#endif	/* __MEM_H__ */
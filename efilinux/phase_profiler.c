@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "platform/x86.h"
+#include "phase_profiler.h"
+
+/*
+ * Period of the sampling timer, in 100ns units. The firmware timer
+ * tick may be coarser, the effective period is measured at stop.
+ */
+#define PHASE_SAMPLING_PERIOD	(1 * 1000 * 10)
+
+volatile UINT8 phase_current = PHASE_INIT;
+
+static const CHAR16 *phase_names[PHASE_COUNT] = {
+	[PHASE_OTHER] = L"other",
+	[PHASE_INIT] = L"init",
+	[PHASE_BOOT_INPUTS] = L"boot_inputs",
+	[PHASE_PARTITIONS] = L"partitions",
+	[PHASE_BOOTLOGIC] = L"bootlogic",
+	[PHASE_SPLASH] = L"splash",
+	[PHASE_LOAD_IMAGE] = L"load_image",
+	[PHASE_VERIFY] = L"verify",
+	[PHASE_RAMDISK] = L"ramdisk",
+	[PHASE_HANDOVER] = L"handover",
+};
+
+static EFI_EVENT sampling_timer;
+static volatile UINT32 samples[PHASE_COUNT];
+static UINT64 start_tsc;
+
+/*
+ * Runs at TPL_NOTIFY so that it interrupts the loader and the firmware
+ * code running at TPL_CALLBACK. Firmware code raising the TPL to
+ * TPL_NOTIFY or above delays the samples to the next phase.
+ */
+static VOID EFI_CALLBACK sampling_tick(EFI_EVENT event, VOID *context)
+{
+	UINT8 phase = phase_current;
+
+	samples[phase < PHASE_COUNT ? phase : PHASE_OTHER]++;
+}
+
+/**
+ * phase_profiler_start - sample the current boot phase periodically
+ * until phase_profiler_stop()
+ */
+EFI_STATUS phase_profiler_start(void)
+{
+	EFI_STATUS ret;
+
+	if (sampling_timer)
+		return EFI_SUCCESS;
+
+	ret = uefi_call_wrapper(BS->CreateEvent, 5, EVT_TIMER | EVT_NOTIFY_SIGNAL,
+				TPL_NOTIFY, sampling_tick, NULL, &sampling_timer);
+	if (EFI_ERROR(ret)) {
+		error(L"Failed to create the phase sampling timer: %r\n", ret);
+		return ret;
+	}
+
+	ret = uefi_call_wrapper(BS->SetTimer, 3, sampling_timer, TimerPeriodic,
+				PHASE_SAMPLING_PERIOD);
+	if (EFI_ERROR(ret)) {
+		error(L"Failed to start the phase sampling timer: %r\n", ret);
+		uefi_call_wrapper(BS->CloseEvent, 1, sampling_timer);
+		sampling_timer = NULL;
+		return ret;
+	}
+
+	/* The platform time source is not set up yet */
+	start_tsc = rdtsc();
+	return EFI_SUCCESS;
+}
+
+static UINT64 elapsed_us(UINT64 cycles)
+{
+	UINT64 start = rdtsc(), khz;
+
+	uefi_call_wrapper(BS->Stall, 1, 1000);
+	khz = rdtsc() - start;
+	return khz ? cycles * 1000 / khz : 0;
+}
+
+/**
+ * phase_profiler_stop - stop the sampling and log the time spent in
+ * each phase. It must be stopped before exiting boot services, and
+ * before the loader image returns.
+ */
+void phase_profiler_stop(void)
+{
+	UINT64 elapsed;
+	UINT32 total = 0;
+	UINTN i;
+
+	if (!sampling_timer)
+		return;
+
+	uefi_call_wrapper(BS->CloseEvent, 1, sampling_timer);
+	sampling_timer = NULL;
+	elapsed = elapsed_us(rdtsc() - start_tsc);
+
+	for (i = 0; i < PHASE_COUNT; i++)
+		total += samples[i];
+	if (!total) {
+		warning(L"No phase samples\n");
+		return;
+	}
+
+	info(L"Phase profile: %d samples over %ld us\n", total, elapsed);
+	for (i = 0; i < PHASE_COUNT; i++) {
+		if (!samples[i])
+			continue;
+		info(L"  %-12s %6d samples %3d%% ~%ld us\n", phase_names[i],
+		     samples[i], samples[i] * 100 / total,
+		     elapsed * samples[i] / total);
+	}
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file declares the boot phase markers and the sampling profiler
+ * reading them. A marker is a single store, cheap enough to be left in
+ * every build: without CONFIG_PHASE_PROFILER it compiles to nothing.
+ */
+
+#ifndef __PHASE_PROFILER_H__
+#define __PHASE_PROFILER_H__
+
+enum boot_phase {
+	PHASE_OTHER,		/* Not covered by a marker */
+	PHASE_INIT,		/* efi_main, up to the boot logic */
+	PHASE_BOOT_INPUTS,	/* Wake/reset sources, battery, keys */
+	PHASE_PARTITIONS,	/* Partition table check */
+	PHASE_BOOTLOGIC,	/* Target decision and command line */
+	PHASE_SPLASH,
+	PHASE_LOAD_IMAGE,	/* Boot image read */
+	PHASE_VERIFY,		/* Boot image signature check */
+	PHASE_RAMDISK,
+	PHASE_HANDOVER,		/* Kernel placement and boot params */
+	PHASE_COUNT
+};
+
+#ifdef CONFIG_PHASE_PROFILER
+extern volatile UINT8 phase_current;
+
+/* Returns the previous phase, to restore it in nested sections */
+static inline enum boot_phase phase_set(enum boot_phase phase)
+{
+	enum boot_phase prev = phase_current;
+
+	phase_current = phase;
+	return prev;
+}
+
+EFI_STATUS phase_profiler_start(void);
+void phase_profiler_stop(void);
+#else
+static inline enum boot_phase phase_set(enum boot_phase phase)
+{
+	return PHASE_OTHER;
+}
+
+static inline EFI_STATUS phase_profiler_start(void)
+{
+	return EFI_SUCCESS;
+}
+
+static inline void phase_profiler_stop(void)
+{
+}
+#endif	/* CONFIG_PHASE_PROFILER */
+
+#endif /* __PHASE_PROFILER_H__ */
@@ -80,12 +80,17 @@ static EFI_STATUS stub_populate_indicators(void)
 	return EFI_SUCCESS;
 }
 
-static EFI_STATUS stub_load_target(enum targets target, CHAR8 *cmdline)
+static EFI_STATUS stub_load_target(enum targets target, struct cmdline *cmdline)
 {
 	warning(L"stubbed!\n");
 	return EFI_LOAD_ERROR;
 }
 
+static EFI_STATUS stub_check_target(enum targets target)
+{
+	return EFI_SUCCESS;
+}
+
 static enum wake_sources stub_get_wake_source(void)
 {
 	warning(L"stubbed!\n");
@@ -233,6 +238,7 @@ struct osloader_ops loader_ops = {
 	.do_cold_off = stub_do_cold_off,
 	.populate_indicators = stub_populate_indicators,
 	.load_target = stub_load_target,
+	.check_target = stub_check_target,
 	.get_wake_source = stub_get_wake_source,
 	.get_reset_source = stub_get_reset_source,
 	.set_reset_source = stub_set_reset_source,
@@ -33,13 +33,21 @@
 #include <efi.h>
 #include "bootlogic.h"
 #include "em.h"
+#include "cmdline.h"
+
+/* The platform loses its debug buffers over a warm reset after a
+ * watchdog, so the recovery needs a warmdump backup, a cold reset and
+ * a restore on the next boot. Other platforms only back the dumps up,
+ * the files are overwritten on each watchdog boot. */
+#define QUIRK_WATCHDOG_COLD_RESET	(1 << 0)
 
 struct osloader_ops {
 	EFI_STATUS (*check_partition_table)(void);
 	enum flow_types (*read_flow_type)(void);
 	void (*do_cold_off)(void);
 	EFI_STATUS (*populate_indicators)(void);
-	EFI_STATUS (*load_target)(enum targets, CHAR8 *cmdline);
+	EFI_STATUS (*load_target)(enum targets, struct cmdline *cmdline);
+	EFI_STATUS (*check_target)(enum targets);
 	enum wake_sources (*get_wake_source)(void);
 	enum reset_sources (*get_reset_source)(void);
 	EFI_STATUS (*set_reset_source)(enum reset_sources);
@@ -64,6 +72,7 @@ struct osloader_ops {
 	CHAR8* (*get_extra_cmdline)(void);
 	UINT64 (*get_current_time_us)(void);
 	enum targets (*load_bcb)(void);
+	UINT32 quirks;
 };
 
 extern struct osloader_ops loader_ops;
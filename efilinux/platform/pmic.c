@@ -29,52 +29,27 @@
 #include "pmic.h"
 #include "efilinux.h"
 
-EFI_GUID DeviceSmbiosProtocolGuid = EFI_SMBIOS_PROTOCOL_GUID;
-
 enum pmic_types pmic_get_type_from_smbios()
 {
-	EFI_STATUS ret;
-	EFI_SMBIOS_PROTOCOL *smbios;
-	EFI_SMBIOS_HANDLE smbios_handle;
-	EFI_SMBIOS_TYPE smbios_type = TYPE_INTEL_SMBIOS;
-	SMBIOS_TABLE_TYPE94 *smbios_table;
-	char *buffer_str, *buffer_ptr;
-	enum pmic_types pmic_type = PMIC_TYPE_UNKNOWN;
-	int i;
+	static BOOLEAN cached;
+	static enum pmic_types pmic_type = PMIC_TYPE_UNKNOWN;
+	CHAR8 *version;
 
-	ret = LibLocateProtocol(&DeviceSmbiosProtocolGuid, (VOID **)&smbios);
-	if (EFI_ERROR(ret) || !smbios)
-	{
-		error(L"Failed to get smbios protocol: %r\n", ret);
+	if (cached)
 		return pmic_type;
-	}
+	cached = TRUE;
 
-	ret = uefi_call_wrapper(smbios->GetNext, 5, smbios, &smbios_handle,
-				&smbios_type, &smbios_table, NULL);
-	if (EFI_ERROR(ret))
-	{
-		error(L"Failed to call smbios getNext: %r\n", ret);
+	version = smbios_get_pmic_version();
+	if (!version) {
+		error(L"Failed to get PMIC version from SMBIOS\n");
 		return pmic_type;
 	}
 
-	buffer_str = buffer_ptr =((char *)smbios_table) + smbios_table->hdr.Length;
-	i = 1;
-	while (i < smbios_table->PmicVersion)
-	{
-		if (*buffer_str == 0)
-			break;
-		while (*buffer_ptr != 0)
-			buffer_ptr++;
-		buffer_ptr++;
-		buffer_str = buffer_ptr;
-		i++;
-	}
-
-	if (buffer_str[0] == 0x31 && buffer_str[1] == 0x46) //1F
+	if (!strncmpa(version, (CHAR8 *)"1F", 2))
 		pmic_type = CRYSTAL_ROHM;
-	else if (buffer_str[0] == 0x34 && buffer_str[1] == 0x31) //41
+	else if (!strncmpa(version, (CHAR8 *)"41", 2))
 		pmic_type = DOLLAR_XPOWER;
-	else if (buffer_str[0] == 0x30 && buffer_str[1] == 0x33) //03
+	else if (!strncmpa(version, (CHAR8 *)"03", 2))
 		pmic_type = DOLLAR_TI;
 
 	return pmic_type;
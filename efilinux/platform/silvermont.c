@@ -69,4 +69,5 @@ void init_silvermont(void)
 	x86_ops(&loader_ops);
 
 	loader_ops.get_current_time_us = silvermont_get_current_time_us;
+	loader_ops.quirks |= QUIRK_WATCHDOG_COLD_RESET;
 }
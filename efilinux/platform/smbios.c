@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file indexes the SMBIOS structures published by the firmware
+ * so that typed lookups do not walk the table on every call.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "utils.h"
+#include "uefi_utils.h"
+#include "smbios.h"
+
+#define SMBIOS_MAX_STRUCTURES	256
+#define SMBIOS_MAX_STRINGS	1024
+#define SMBIOS_MAX_STRUCT_SIZE	0xFFFF
+
+#define SMBIOS_HAS_FIELD(table, field)					\
+	((table)->hdr.Length >= offsetof(typeof(*(table)), field) +	\
+	 sizeof((table)->field))
+
+struct smbios_entry_point {
+	UINT8 anchor[4];
+	UINT8 checksum;
+	UINT8 length;
+	UINT8 major;
+	UINT8 minor;
+	UINT16 max_struct_size;
+	UINT8 revision;
+	UINT8 formatted[5];
+	UINT8 dmi_anchor[5];
+	UINT8 dmi_checksum;
+	UINT16 table_length;
+	UINT32 table_address;
+	UINT16 struct_count;
+	UINT8 bcd_revision;
+} __attribute__((packed));
+
+static EFI_GUID smbios_protocol_guid = EFI_SMBIOS_PROTOCOL_GUID;
+
+static struct {
+	BOOLEAN built;
+	EFI_STATUS status;
+	UINTN count;
+	UINTN string_count;
+	struct smbios_entry entries[SMBIOS_MAX_STRUCTURES];
+	CHAR8 *strings[SMBIOS_MAX_STRINGS];
+	struct smbios_entry *first[256];
+	struct smbios_entry *last[256];
+	UINT8 type_count[256];
+} idx;
+
+/*
+ * Record the structure at HDR and split its string set.  END bounds
+ * the walk for tables whose total size is known.  Returns a pointer
+ * past the structure's terminating double NUL, or NULL if the
+ * structure is malformed or the index is full.
+ */
+static CHAR8 *index_structure(EFI_SMBIOS_TABLE_HEADER *hdr, CHAR8 *end)
+{
+	struct smbios_entry *entry;
+	CHAR8 *s;
+
+	if ((CHAR8 *)hdr + sizeof(*hdr) > end || hdr->Length < sizeof(*hdr))
+		return NULL;
+	if (idx.count == SMBIOS_MAX_STRUCTURES) {
+		warning(L"SMBIOS index full, ignoring remaining structures\n");
+		return NULL;
+	}
+
+	entry = &idx.entries[idx.count];
+	entry->hdr = hdr;
+	entry->strings = &idx.strings[idx.string_count];
+	entry->string_count = 0;
+	entry->next = NULL;
+
+	s = (CHAR8 *)hdr + hdr->Length;
+	if (s + 1 >= end)
+		return NULL;
+	if (s[0] == '\0' && s[1] == '\0') {
+		s += 2;
+		goto record;
+	}
+
+	while (s < end && *s != '\0') {
+		if (idx.string_count < SMBIOS_MAX_STRINGS &&
+		    entry->string_count < 0xFF) {
+			idx.strings[idx.string_count++] = s;
+			entry->string_count++;
+		}
+		while (s < end && *s != '\0')
+			s++;
+		s++;
+	}
+	if (s >= end)
+		return NULL;
+	s++;
+
+record:
+	if (idx.last[hdr->Type])
+		idx.last[hdr->Type]->next = entry;
+	else
+		idx.first[hdr->Type] = entry;
+	idx.last[hdr->Type] = entry;
+	if (idx.type_count[hdr->Type] < 0xFF)
+		idx.type_count[hdr->Type]++;
+	idx.count++;
+
+	return s;
+}
+
+static EFI_STATUS index_from_protocol(void)
+{
+	EFI_STATUS ret;
+	EFI_SMBIOS_PROTOCOL *smbios;
+	EFI_SMBIOS_HANDLE handle = 0xFFFE;
+	EFI_SMBIOS_TABLE_HEADER *record;
+
+	ret = uefi_locate_protocol(&smbios_protocol_guid, (VOID **)&smbios);
+	if (EFI_ERROR(ret) || !smbios)
+		return EFI_NOT_FOUND;
+
+	for (;;) {
+		ret = uefi_call_wrapper(smbios->GetNext, 5, smbios, &handle,
+					NULL, &record, NULL);
+		if (EFI_ERROR(ret))
+			break;
+		if (!index_structure(record, (CHAR8 *)record + SMBIOS_MAX_STRUCT_SIZE))
+			break;
+	}
+
+	return idx.count ? EFI_SUCCESS : EFI_NOT_FOUND;
+}
+
+static EFI_STATUS index_from_entry_point(void)
+{
+	EFI_STATUS ret;
+	struct smbios_entry_point *ep;
+	CHAR8 *table, *end;
+	UINTN i;
+
+	ret = LibGetSystemConfigurationTable(&SMBIOSTableGuid, (VOID **)&ep);
+	if (EFI_ERROR(ret) || !ep)
+		return EFI_NOT_FOUND;
+
+	if (CompareMem(ep->anchor, "_SM_", sizeof(ep->anchor)) ||
+	    CompareMem(ep->dmi_anchor, "_DMI_", sizeof(ep->dmi_anchor))) {
+		error(L"Invalid SMBIOS entry point anchor\n");
+		return EFI_COMPROMISED_DATA;
+	}
+
+	table = (CHAR8 *)(UINTN)ep->table_address;
+	end = table + ep->table_length;
+	for (i = 0; i < ep->struct_count && table < end; i++) {
+		EFI_SMBIOS_TABLE_HEADER *hdr = (EFI_SMBIOS_TABLE_HEADER *)table;
+
+		table = index_structure(hdr, end);
+		if (!table || hdr->Type == EFI_SMBIOS_TYPE_END_OF_TABLE)
+			break;
+	}
+
+	return idx.count ? EFI_SUCCESS : EFI_NOT_FOUND;
+}
+
+/**
+ * smbios_index_build - index the firmware SMBIOS structures
+ *
+ * Uses the SMBIOS protocol when the firmware provides it and falls
+ * back to the SMBIOS entry point configuration table otherwise.  The
+ * index is built only once; later calls return the first result.
+ */
+EFI_STATUS smbios_index_build(void)
+{
+	if (idx.built)
+		return idx.status;
+	idx.built = TRUE;
+
+	idx.status = index_from_protocol();
+	if (EFI_ERROR(idx.status))
+		idx.status = index_from_entry_point();
+
+	if (EFI_ERROR(idx.status)) {
+		error(L"Failed to index SMBIOS structures: %r\n", idx.status);
+	} else {
+		debug(L"SMBIOS index: %d structures, %d strings\n",
+		      idx.count, idx.string_count);
+	}
+
+	return idx.status;
+}
+
+struct smbios_entry *smbios_find(EFI_SMBIOS_TYPE type)
+{
+	if (EFI_ERROR(smbios_index_build()))
+		return NULL;
+	return idx.first[type];
+}
+
+UINTN smbios_count(EFI_SMBIOS_TYPE type)
+{
+	if (EFI_ERROR(smbios_index_build()))
+		return 0;
+	return idx.type_count[type];
+}
+
+/**
+ * smbios_get_string - return string INDEX of ENTRY's string set
+ *
+ * SMBIOS string references are 1-based, 0 meaning "no string".
+ * Returns NULL for a missing string.
+ */
+CHAR8 *smbios_get_string(struct smbios_entry *entry, EFI_SMBIOS_STRING index)
+{
+	if (!entry || index == 0 || index > entry->string_count)
+		return NULL;
+	return entry->strings[index - 1];
+}
+
+CHAR8 *smbios_get_pmic_version(void)
+{
+	struct smbios_entry *entry;
+	SMBIOS_TABLE_TYPE94 *table;
+
+	entry = smbios_find(TYPE_INTEL_SMBIOS);
+	if (!entry)
+		return NULL;
+
+	table = (SMBIOS_TABLE_TYPE94 *)entry->hdr;
+	if (!SMBIOS_HAS_FIELD(table, PmicVersion))
+		return NULL;
+
+	return smbios_get_string(entry, table->PmicVersion);
+}
+
+EFI_STATUS smbios_get_board_ids(struct smbios_board_ids *ids)
+{
+	struct smbios_entry *entry;
+
+	if (!ids)
+		return EFI_INVALID_PARAMETER;
+	ZeroMem(ids, sizeof(*ids));
+
+	entry = smbios_find(EFI_SMBIOS_TYPE_BASEBOARD_INFORMATION);
+	if (entry) {
+		SMBIOS_TABLE_TYPE2 *table = (SMBIOS_TABLE_TYPE2 *)entry->hdr;
+
+		if (SMBIOS_HAS_FIELD(table, Manufacturer))
+			ids->vendor = smbios_get_string(entry, table->Manufacturer);
+		if (SMBIOS_HAS_FIELD(table, ProductName))
+			ids->product = smbios_get_string(entry, table->ProductName);
+		if (SMBIOS_HAS_FIELD(table, Version))
+			ids->version = smbios_get_string(entry, table->Version);
+	}
+
+	entry = smbios_find(TYPE_INTEL_SMBIOS);
+	if (entry) {
+		SMBIOS_TABLE_TYPE94 *table = (SMBIOS_TABLE_TYPE94 *)entry->hdr;
+
+		if (!ids->version && SMBIOS_HAS_FIELD(table, BoardVersion))
+			ids->version = smbios_get_string(entry, table->BoardVersion);
+		if (SMBIOS_HAS_FIELD(table, FabVersion))
+			ids->fab = smbios_get_string(entry, table->FabVersion);
+	}
+
+	if (!ids->vendor && !ids->product && !ids->version && !ids->fab)
+		return EFI_NOT_FOUND;
+	return EFI_SUCCESS;
+}
+
+/**
+ * smbios_get_memory_info - sum the installed memory devices
+ *
+ * Sizes are taken from the type 17 memory device structures and
+ * returned in bytes.  The reported speed is the lowest non-zero
+ * speed among the installed devices.
+ */
+EFI_STATUS smbios_get_memory_info(struct smbios_memory_info *info)
+{
+	struct smbios_entry *entry;
+
+	if (!info)
+		return EFI_INVALID_PARAMETER;
+	ZeroMem(info, sizeof(*info));
+
+	for (entry = smbios_find(EFI_SMBIOS_TYPE_MEMORY_DEVICE); entry;
+	     entry = entry->next) {
+		SMBIOS_TABLE_TYPE17 *table = (SMBIOS_TABLE_TYPE17 *)entry->hdr;
+		UINT64 size;
+
+		if (!SMBIOS_HAS_FIELD(table, Size))
+			continue;
+		if (table->Size == 0 || table->Size == SMBIOS_MEMORY_SIZE_UNKNOWN)
+			continue;
+
+		if (table->Size == SMBIOS_MEMORY_SIZE_EXTENDED &&
+		    SMBIOS_HAS_FIELD(table, ExtendedSize))
+			size = (UINT64)(table->ExtendedSize & 0x7FFFFFFF) << 20;
+		else if (table->Size & SMBIOS_MEMORY_SIZE_KB)
+			size = (UINT64)(table->Size & ~SMBIOS_MEMORY_SIZE_KB) << 10;
+		else
+			size = (UINT64)table->Size << 20;
+
+		info->total_size += size;
+		info->device_count++;
+
+		if (SMBIOS_HAS_FIELD(table, Speed) && table->Speed &&
+		    (!info->speed || table->Speed < info->speed))
+			info->speed = table->Speed;
+	}
+
+	return info->device_count ? EFI_SUCCESS : EFI_NOT_FOUND;
+}
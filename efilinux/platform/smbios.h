@@ -171,4 +171,91 @@ typedef struct _SMBIOS_TABLE_TYPE94 {
 	EFI_SMBIOS_STRING RC6;
 }SMBIOS_TABLE_TYPE94;
 
+typedef struct {
+	EFI_SMBIOS_TABLE_HEADER hdr;
+	EFI_SMBIOS_STRING Manufacturer;
+	EFI_SMBIOS_STRING ProductName;
+	EFI_SMBIOS_STRING Version;
+	EFI_SMBIOS_STRING SerialNumber;
+	EFI_GUID          Uuid;
+	UINT8             WakeUpType;
+	EFI_SMBIOS_STRING SKUNumber;
+	EFI_SMBIOS_STRING Family;
+} __attribute__((packed)) SMBIOS_TABLE_TYPE1;
+
+typedef struct {
+	EFI_SMBIOS_TABLE_HEADER hdr;
+	EFI_SMBIOS_STRING Manufacturer;
+	EFI_SMBIOS_STRING ProductName;
+	EFI_SMBIOS_STRING Version;
+	EFI_SMBIOS_STRING SerialNumber;
+	EFI_SMBIOS_STRING AssetTag;
+	UINT8             FeatureFlag;
+	EFI_SMBIOS_STRING LocationInChassis;
+	UINT16            ChassisHandle;
+	UINT8             BoardType;
+} __attribute__((packed)) SMBIOS_TABLE_TYPE2;
+
+#define SMBIOS_MEMORY_SIZE_UNKNOWN	0xFFFF
+#define SMBIOS_MEMORY_SIZE_EXTENDED	0x7FFF
+#define SMBIOS_MEMORY_SIZE_KB		0x8000
+
+typedef struct {
+	EFI_SMBIOS_TABLE_HEADER hdr;
+	UINT16            MemoryArrayHandle;
+	UINT16            MemoryErrorInformationHandle;
+	UINT16            TotalWidth;
+	UINT16            DataWidth;
+	UINT16            Size;
+	UINT8             FormFactor;
+	UINT8             DeviceSet;
+	EFI_SMBIOS_STRING DeviceLocator;
+	EFI_SMBIOS_STRING BankLocator;
+	UINT8             MemoryType;
+	UINT16            TypeDetail;
+	UINT16            Speed;
+	EFI_SMBIOS_STRING Manufacturer;
+	EFI_SMBIOS_STRING SerialNumber;
+	EFI_SMBIOS_STRING AssetTag;
+	EFI_SMBIOS_STRING PartNumber;
+	UINT8             Attributes;
+	UINT32            ExtendedSize;
+	UINT16            ConfiguredMemoryClockSpeed;
+} __attribute__((packed)) SMBIOS_TABLE_TYPE17;
+
+/*
+ * SMBIOS structure index.  The table is walked once, on first use,
+ * and each structure is recorded with its string set already split
+ * so that lookups by type and string accesses do not rescan the
+ * table.
+ */
+struct smbios_entry {
+	EFI_SMBIOS_TABLE_HEADER *hdr;
+	CHAR8 **strings;
+	UINT8 string_count;
+	struct smbios_entry *next;
+};
+
+struct smbios_board_ids {
+	CHAR8 *vendor;
+	CHAR8 *product;
+	CHAR8 *version;
+	CHAR8 *fab;
+};
+
+struct smbios_memory_info {
+	UINT64 total_size;
+	UINTN device_count;
+	UINT16 speed;
+};
+
+EFI_STATUS smbios_index_build(void);
+struct smbios_entry *smbios_find(EFI_SMBIOS_TYPE type);
+UINTN smbios_count(EFI_SMBIOS_TYPE type);
+CHAR8 *smbios_get_string(struct smbios_entry *entry, EFI_SMBIOS_STRING index);
+
+CHAR8 *smbios_get_pmic_version(void);
+EFI_STATUS smbios_get_board_ids(struct smbios_board_ids *ids);
+EFI_STATUS smbios_get_memory_info(struct smbios_memory_info *info);
+
 #endif // __SMBIOS_PROTOCOL_H__
@@ -39,6 +39,11 @@
 #include "uefi_em.h"
 #include "fake_em.h"
 #include "log.h"
+#include "config.h"
+#include "fw_trace.h"
+#include "phase_profiler.h"
+#include "alloc_tracker.h"
+#include "io_stats.h"
 
 #if USE_INTEL_OS_VERIFICATION
 #include "os_verification.h"
@@ -52,6 +57,16 @@
 
 static void x86_hook_before_exit()
 {
+	uefi_keys_stop_sampling();
+	uefi_protocol_cache_invalidate();
+	phase_profiler_stop();
+	io_stats_log();
+#ifdef CONFIG_FW_TRACE
+	fw_trace_stop();
+#endif
+#ifdef CONFIG_ALLOC_TRACKER
+	alloc_tracker_report();
+#endif
 	log_save_to_variable();
 }
 
@@ -61,31 +76,13 @@ static void x86_hook_bootlogic_begin()
 
 static void x86_hook_bootlogic_end()
 {
-	uefi_populate_osnib_variables();
+	if (osnib_variables)
+		uefi_populate_osnib_variables();
 }
 
 #define STR_TO_UINTN(a, b, c, d) ((a) + ((b) << 8) + ((c) << 16) + ((d) << 24))
 #define CPUID_MASK	0xffff0
 
-static inline void cpuid(uint32_t op, uint32_t reg[4])
-{
-#ifdef CONFIG_X86
-	asm volatile("pushl %%ebx      \n\t" /* save %ebx */
-		     "cpuid            \n\t"
-		     "movl %%ebx, %1   \n\t" /* save what cpuid just put in %ebx */
-		     "popl %%ebx       \n\t" /* restore the old %ebx */
-		     : "=a"(reg[0]), "=r"(reg[1]), "=c"(reg[2]), "=d"(reg[3])
-		     : "a"(op)
-		     : "cc");
-#elif CONFIG_X86_64
-	asm volatile("xchg{q}\t{%%}rbx, %q1\n\t"
-		     "cpuid\n\t"
-		     "xchg{q}\t{%%}rbx, %q1\n\t"
-		     : "=a" (reg[0]), "=&r" (reg[1]), "=c" (reg[2]), "=d" (reg[3])
-		     : "a" (op));
-#endif
-}
-
 enum cpu_id x86_identify_cpu()
 {
 	uint32_t reg[4];
@@ -109,6 +106,7 @@ void x86_ops(struct osloader_ops *ops)
 	ops->do_cold_off = uefi_shutdown;
 	ops->populate_indicators = rsci_populate_indicators;
 	ops->load_target = intel_load_target;
+	ops->check_target = intel_check_target;
 	ops->get_wake_source = rsci_get_wake_source;
 	ops->get_reset_source = rsci_get_reset_source;
 	ops->set_reset_source = rsci_set_reset_source;
@@ -57,6 +57,31 @@ static inline uint64_t rdmsr(unsigned int msr)
 	return x;
 }
 
+static inline void cpuid_count(uint32_t op, uint32_t count, uint32_t reg[4])
+{
+#ifdef CONFIG_X86
+	asm volatile("pushl %%ebx      \n\t" /* save %ebx */
+		     "cpuid            \n\t"
+		     "movl %%ebx, %1   \n\t" /* save what cpuid just put in %ebx */
+		     "popl %%ebx       \n\t" /* restore the old %ebx */
+		     : "=a"(reg[0]), "=r"(reg[1]), "=c"(reg[2]), "=d"(reg[3])
+		     : "a"(op), "c"(count)
+		     : "cc");
+#elif CONFIG_X86_64
+	asm volatile("xchg{q}\t{%%}rbx, %q1\n\t"
+		     "cpuid\n\t"
+		     "xchg{q}\t{%%}rbx, %q1\n\t"
+		     : "=a" (reg[0]), "=&r" (reg[1]), "=c" (reg[2]), "=d" (reg[3])
+		     : "a" (op), "c" (count));
+#endif
+}
+
+static inline void cpuid(uint32_t op, uint32_t reg[4])
+{
+	cpuid_count(op, 0, reg);
+}
+
+struct osloader_ops;
 void x86_ops(struct osloader_ops *ops);
 
 enum cpu_id {
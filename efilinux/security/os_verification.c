@@ -32,6 +32,7 @@
 #include <efilib.h>
 #include <stdlib.h>
 #include <utils.h>
+#include <uefi_utils.h>
 #include "os_verification.h"
 
 EFI_GUID gOsVerificationProtocolGuid = INTEL_OS_VERIFICATION_PROTOCOL_GUID;
@@ -42,7 +43,7 @@ EFI_STATUS intel_os_verify(IN VOID *os, IN UINTN os_size,
 	OS_VERIFICATION_PROTOCOL *ovp;
 	EFI_STATUS ret;
 
-	ret = LibLocateProtocol(&gOsVerificationProtocolGuid, (void **)&ovp);
+	ret = uefi_locate_protocol(&gOsVerificationProtocolGuid, (void **)&ovp);
 	if (EFI_ERROR(ret) || !ovp) {
 		error(L"%x failure\n", __func__);
 		goto out;
@@ -62,7 +63,7 @@ BOOLEAN is_secure_boot_enabled(void)
 	EFI_STATUS ret;
 	BOOLEAN unsigned_allowed;
 
-	ret = LibLocateProtocol(&gOsVerificationProtocolGuid, (void **)&ovp);
+	ret = uefi_locate_protocol(&gOsVerificationProtocolGuid, (void **)&ovp);
 	if (EFI_ERROR(ret) || !ovp) {
 		error(L"%x failure\n", __func__);
 		goto out;
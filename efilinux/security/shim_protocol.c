@@ -31,6 +31,7 @@
 #include <efi.h>
 #include <efilib.h>
 #include <utils.h>
+#include <uefi_utils.h>
 #include <stdlib.h>
 #include <shim.h>
 #include "shim_protocol.h"
@@ -42,7 +43,7 @@ EFI_STATUS shim_blob_verify(IN VOID *blob, IN UINTN blob_size,
 
 	SHIM_LOCK *shim_lock;
 	EFI_STATUS ret;
-	ret = LibLocateProtocol(&gShimLockProtocolGuid, (VOID **)&shim_lock);
+	ret = uefi_locate_protocol(&gShimLockProtocolGuid, (VOID **)&shim_lock);
 	if (EFI_ERROR(ret)) {
 		error(L"Couldn't instantiate shim protocol", ret);
 		return ret;
@@ -1,26 +1,27 @@
 #ifndef __STDLIB_H__
 #define __STDLIB_H__
 
+#include "mem.h"
+
 extern void *malloc(UINTN size);
 extern void free(void *buf);
 
 extern EFI_STATUS emalloc(UINTN, UINTN, EFI_PHYSICAL_ADDRESS *);
 extern void efree(EFI_PHYSICAL_ADDRESS, UINTN);
 
-static inline void memset(CHAR8 *dst, CHAR8 ch, UINTN size)
+static inline void *memset(void *dst, int ch, UINTN size)
 {
-	int i;
-
-	for (i = 0; i < size; i++)
-		dst[i] = ch;
+	return mem_set(dst, ch, size);
 }
 
-static inline void memcpy(CHAR8 *dst, CHAR8 *src, UINTN size)
+static inline void *memcpy(void *dst, const void *src, UINTN size)
 {
-	int i;
+	return mem_copy(dst, src, size);
+}
 
-	for (i = 0; i < size; i++)
-		*dst++ = *src++;
+static inline int memcmp(const void *s1, const void *s2, UINTN size)
+{
+	return mem_cmp(s1, s2, size);
 }
 
 static inline int strlen(char *str)
@@ -55,4 +56,15 @@ static inline char *strstr(char *haystack, char *needle)
 	return word;
 }
 
+#if defined(CONFIG_ALLOC_TRACKER) && !defined(ALLOC_TRACKER_NO_WRAP)
+#include "alloc_tracker.h"
+
+#define malloc(size)	alloc_tracker_malloc(size, __FILE__, __LINE__)
+#define free(buf)	alloc_tracker_free(buf, __FILE__, __LINE__)
+#define emalloc(size, align, addr) \
+	alloc_tracker_emalloc(size, align, addr, __FILE__, __LINE__)
+#define efree(memory, size) \
+	alloc_tracker_efree(memory, size, __FILE__, __LINE__)
+#endif	/* CONFIG_ALLOC_TRACKER */
+
 #endif /* __STDLIB_H__ */
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file is a host tool listing the tables of an ACPI archive
+ * written by the dump_acpi_tables command and splitting it back to one
+ * file per table, named the way acpixtract does so that the files can
+ * be given to iasl.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <efi.h>
+#include "acpi_archive.h"
+
+#define MAX_TABLES	256
+
+static unsigned char *read_file(const char *path, size_t *size)
+{
+	FILE *f;
+	unsigned char *data;
+	long len;
+
+	f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		return NULL;
+	}
+
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	data = malloc(len ? len : 1);
+	if (data && fread(data, 1, len, f) != (size_t)len) {
+		fprintf(stderr, "%s: short read\n", path);
+		free(data);
+		data = NULL;
+	}
+
+	fclose(f);
+	*size = len;
+	return data;
+}
+
+static int checksum_ok(const unsigned char *table, UINT32 length)
+{
+	unsigned char sum = 0;
+	UINT32 i;
+
+	for (i = 0; i < length; i++)
+		sum += table[i];
+
+	return sum == 0;
+}
+
+/* dsdt.dat, ssdt.dat, ssdt1.dat, ssdt2.dat... */
+static void table_filename(char *buf, size_t size, const char *dir,
+			   const CHAR8 *signature, unsigned int instance)
+{
+	char sig[5];
+	int i;
+
+	for (i = 0; i < 4; i++)
+		sig[i] = isalnum(signature[i]) ? tolower(signature[i]) : '_';
+	sig[4] = '\0';
+
+	if (instance)
+		snprintf(buf, size, "%s/%s%u.dat", dir, sig, instance);
+	else
+		snprintf(buf, size, "%s/%s.dat", dir, sig);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char *file;
+	struct acpi_archive_header *h;
+	struct acpi_archive_entry *e;
+	unsigned int instances[MAX_TABLES];
+	char path[4096];
+	size_t size;
+	unsigned int i, j, errors = 0;
+	FILE *out;
+
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "Usage: %s ARCHIVE [OUTPUT_DIR]\n", argv[0]);
+		fprintf(stderr, "List the tables of ARCHIVE and split them "
+			"to OUTPUT_DIR/<signature>.dat\n");
+		return EXIT_FAILURE;
+	}
+
+	file = read_file(argv[1], &size);
+	if (!file)
+		return EXIT_FAILURE;
+
+	h = (struct acpi_archive_header *)file;
+	if (size < sizeof(*h) || h->magic != ACPI_ARCHIVE_MAGIC ||
+	    h->version != ACPI_ARCHIVE_VERSION || h->header_size != sizeof(*h)) {
+		fprintf(stderr, "%s: not an ACPI archive\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	if (h->count > MAX_TABLES ||
+	    h->count > (size - sizeof(*h)) / sizeof(*e)) {
+		fprintf(stderr, "%s: truncated index\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	if (h->size != size)
+		fprintf(stderr, "%s: size 0x%zx, expected 0x%x\n", argv[1], size, h->size);
+
+	e = (struct acpi_archive_entry *)(h + 1);
+	printf("%-4s %-6s %-8s %-10s %s\n", "Sig", "OEM", "Table ID", "Length", "Checksum");
+	for (i = 0; i < h->count; i++) {
+		int in_file = e[i].offset <= size && e[i].length <= size - e[i].offset;
+		int valid = in_file && checksum_ok(file + e[i].offset, e[i].length);
+
+		printf("%.4s %-6.6s %-8.8s 0x%08x 0x%02x %s\n", e[i].signature,
+		       e[i].oem_id, e[i].oem_table_id, e[i].length, e[i].checksum,
+		       !in_file ? "TRUNCATED" : valid ? "OK" : "BAD");
+		if (!valid)
+			errors++;
+
+		instances[i] = 0;
+		for (j = 0; j < i; j++)
+			if (!memcmp(e[i].signature, e[j].signature, 4))
+				instances[i]++;
+
+		if (argc < 3 || !in_file)
+			continue;
+
+		table_filename(path, sizeof(path), argv[2], e[i].signature, instances[i]);
+		out = fopen(path, "wb");
+		if (!out || fwrite(file + e[i].offset, 1, e[i].length, out) != e[i].length) {
+			perror(path);
+			errors++;
+		}
+		if (out)
+			fclose(out);
+	}
+
+	free(file);
+	return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
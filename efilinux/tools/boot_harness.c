@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file is a host tool running the loader on the mock firmware.
+ * The boot logic, or a given target, is started on a disk image up to
+ * the kernel jump, and the firmware costs of the boot are reported so
+ * that loader changes can be measured without hardware.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mockfw/mockfw.h"
+#include "loader_host.h"
+
+static double to_ms(UINT64 ns)
+{
+	return ns / 1000000.0;
+}
+
+static void print_report(enum mockfw_exit reason, EFI_STATUS status)
+{
+	struct mockfw_stats stats;
+
+	mockfw_get_stats(&stats);
+	printf("\n%s, status %#llx, %.3f ms\n", loader_host_exit_name(reason),
+	       (unsigned long long)status, to_ms(mockfw_now_ns()));
+	printf("%-20s %10llu reads %10llu bytes %10.3f ms\n", "Disk",
+	       (unsigned long long)stats.disk_reads,
+	       (unsigned long long)stats.disk_read_bytes, to_ms(stats.disk_ns));
+	printf("%-20s %10llu reads %10llu writes %9.3f ms\n", "Variables",
+	       (unsigned long long)stats.var_reads,
+	       (unsigned long long)stats.var_writes, to_ms(stats.nv_ns));
+	printf("%-20s %10.3f ms\n", "Stall", to_ms(stats.stall_ns));
+	printf("%-20s %10llu pages peak %7llu bytes pool peak\n", "Memory",
+	       (unsigned long long)stats.pages_peak,
+	       (unsigned long long)stats.pool_peak);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-q] [-b BLOCK_SIZE] [-m LATENCY_US,MB_PER_S] "
+		"[-w NV_WRITE_US] [-v VAR_STORE] [-g WIDTHxHEIGHT] "
+		"[-r WAKE,RESET[,TYPE,SHUTDOWN]] [-t TARGET] [-c CMDLINE] "
+		"DISK_IMAGE\n", name);
+	fprintf(stderr, "Boot the loader on DISK_IMAGE with the mock firmware.\n"
+		"  -q  discard the loader console output\n"
+		"  -m  disk model, instantaneous by default\n"
+		"  -w  cost of a non-volatile SetVariable (0)\n"
+		"  -v  variable store file, kept in memory by default\n"
+		"  -g  framebuffer size, no GOP by default\n"
+		"  -r  boot sources of an RSCI table, none by default\n"
+		"  -t  target to start instead of running the boot logic\n"
+		"  -c  extra kernel command line\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct mockfw_config config = { 0 };
+	struct mockfw_disk_model model = { 0 };
+	struct loader_host_args args = { 0 };
+	unsigned int block_size = 512, wake, reset, type = 0, shutdown = 0;
+	unsigned long latency_us, mbps;
+	enum mockfw_exit reason;
+	EFI_STATUS status;
+	int c;
+
+	while ((c = getopt(argc, argv, "b:c:g:m:qr:t:v:w:")) != -1) {
+		switch (c) {
+		case 'b':
+			block_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			args.cmdline = optarg;
+			break;
+		case 'g':
+			if (sscanf(optarg, "%ux%u", &config.fb_width,
+				   &config.fb_height) != 2) {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'm':
+			if (sscanf(optarg, "%lu,%lu", &latency_us, &mbps) != 2) {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			model.latency_ns = latency_us * 1000ULL;
+			model.bandwidth = mbps << 20;
+			break;
+		case 'q':
+			config.quiet = TRUE;
+			break;
+		case 'r':
+			if (sscanf(optarg, "%u,%u,%u,%u", &wake, &reset, &type,
+				   &shutdown) < 2) {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			args.rsci = TRUE;
+			args.wake_source = wake;
+			args.reset_source = reset;
+			args.reset_type = type;
+			args.shutdown_source = shutdown;
+			break;
+		case 't':
+			args.target = optarg;
+			break;
+		case 'v':
+			config.var_store = optarg;
+			break;
+		case 'w':
+			config.nv_write_ns = strtoull(optarg, NULL, 0) * 1000ULL;
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (mockfw_init(&config)) {
+		fprintf(stderr, "Failed to start the mock firmware\n");
+		return EXIT_FAILURE;
+	}
+	if (mockfw_add_disk(argv[optind], block_size, &model, NULL)) {
+		fprintf(stderr, "%s: failed to attach the disk image\n",
+			argv[optind]);
+		mockfw_shutdown();
+		return EXIT_FAILURE;
+	}
+
+	reason = loader_host_run(&args, &status);
+	print_report(reason, status);
+
+	mockfw_shutdown();
+	return reason == MOCKFW_EXIT_JUMP ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,842 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file is a host tool reading the firmware call trace written by
+ * eng builds of the loader. It summarizes where the firmware time went
+ * and runs the loader built for the host on the mock firmware, with the
+ * disk costs and variables taken from the trace, so that loader changes
+ * can be profiled against the I/O pattern of a given device. The
+ * recorded calls can also be re-issued as is, to compare disk models.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mockfw/mockfw.h"
+#include "loader_host.h"
+#include "fw_trace_format.h"
+
+#define MAX_NAME	64
+
+enum disk_cost_mode {
+	COST_RECORDED,	/* recorded duration of the matching read */
+	COST_FITTED,	/* per partition latency and bandwidth fit */
+	COST_MODEL,	/* the mock disk model given on the command line */
+};
+
+struct object {
+	UINT8 type;
+	EFI_GUID guid;
+	CHAR16 name[MAX_NAME + 1];
+	char ascii[MAX_NAME + 1];
+	/* Partitions */
+	EFI_HANDLE handle;
+	double latency_ns;
+	double ns_per_byte;
+	UINT32 cursor;
+};
+
+struct allocation {
+	UINT64 recorded;
+	EFI_PHYSICAL_ADDRESS replayed;
+	BOOLEAN pool;
+};
+
+static const char *op_names[FW_TRACE_OP_COUNT] = {
+	[FW_TRACE_ALLOCATE_PAGES] = "AllocatePages",
+	[FW_TRACE_FREE_PAGES] = "FreePages",
+	[FW_TRACE_ALLOCATE_POOL] = "AllocatePool",
+	[FW_TRACE_FREE_POOL] = "FreePool",
+	[FW_TRACE_GET_MEMORY_MAP] = "GetMemoryMap",
+	[FW_TRACE_HANDLE_PROTOCOL] = "HandleProtocol",
+	[FW_TRACE_LOCATE_PROTOCOL] = "LocateProtocol",
+	[FW_TRACE_LOCATE_HANDLE] = "LocateHandle",
+	[FW_TRACE_LOCATE_HANDLE_BUFFER] = "LocateHandleBuffer",
+	[FW_TRACE_GET_VARIABLE] = "GetVariable",
+	[FW_TRACE_SET_VARIABLE] = "SetVariable",
+	[FW_TRACE_READ_DISK] = "ReadDisk",
+};
+
+static struct fw_trace_header *header;
+static unsigned char *records;
+static struct object *objects;
+static enum disk_cost_mode cost_mode = COST_RECORDED;
+
+static struct allocation *allocations;
+static UINT32 allocation_count;
+static UINT64 replay_ns[FW_TRACE_OP_COUNT];
+static UINT32 replayed, skipped;
+static UINT32 matched_reads, unmatched_reads;
+
+static struct fw_trace_record *record(UINT32 i)
+{
+	return (struct fw_trace_record *)(records + (size_t)i * header->record_size);
+}
+
+static UINT64 to_ns(UINT64 cycles)
+{
+	if (!header->tsc_khz)
+		return cycles;
+	return cycles * 1000000ULL / header->tsc_khz;
+}
+
+static double to_ms(UINT64 ns)
+{
+	return ns / 1000000.0;
+}
+
+static struct object *record_object(struct fw_trace_record *r)
+{
+	if (r->object == FW_TRACE_NO_OBJECT || r->object >= header->object_count)
+		return NULL;
+	return &objects[r->object];
+}
+
+static const char *object_name(struct fw_trace_record *r)
+{
+	struct object *o = record_object(r);
+
+	return o ? o->ascii : "-";
+}
+
+static void format_guid(char *buf, size_t size, EFI_GUID *g)
+{
+	snprintf(buf, size, "%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+		 g->Data1, g->Data2, g->Data3, g->Data4[0], g->Data4[1],
+		 g->Data4[2], g->Data4[3], g->Data4[4], g->Data4[5],
+		 g->Data4[6], g->Data4[7]);
+}
+
+static unsigned char *read_file(const char *path, size_t *size)
+{
+	FILE *f;
+	unsigned char *data;
+	long len;
+
+	f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		return NULL;
+	}
+
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	data = malloc(len ? len : 1);
+	if (data && fread(data, 1, len, f) != (size_t)len) {
+		fprintf(stderr, "%s: short read\n", path);
+		free(data);
+		data = NULL;
+	}
+
+	fclose(f);
+	*size = len;
+	return data;
+}
+
+static int load_trace(const char *path)
+{
+	unsigned char *file, *p;
+	size_t size;
+	UINT32 i, j;
+
+	file = read_file(path, &size);
+	if (!file)
+		return -1;
+
+	header = (struct fw_trace_header *)file;
+	if (size < sizeof(*header) || header->magic != FW_TRACE_MAGIC ||
+	    header->version != FW_TRACE_VERSION ||
+	    header->header_size < sizeof(*header) ||
+	    header->record_size < sizeof(struct fw_trace_record)) {
+		fprintf(stderr, "%s: not a firmware trace\n", path);
+		return -1;
+	}
+	if (header->header_size > size ||
+	    header->record_count > (size - header->header_size) / header->record_size ||
+	    header->object_offset > size) {
+		fprintf(stderr, "%s: truncated trace\n", path);
+		return -1;
+	}
+	records = file + header->header_size;
+
+	objects = calloc(header->object_count + 1, sizeof(*objects));
+	if (!objects)
+		return -1;
+
+	p = file + header->object_offset;
+	for (i = 0; i < header->object_count; i++) {
+		struct fw_trace_object *o = (struct fw_trace_object *)p;
+		CHAR16 *name = (CHAR16 *)(o + 1);
+
+		if ((size_t)(p - file) + sizeof(*o) > size ||
+		    (size_t)(p - file) + sizeof(*o) + o->name_len * sizeof(CHAR16) > size) {
+			fprintf(stderr, "%s: truncated object table\n", path);
+			return -1;
+		}
+
+		objects[i].type = o->type;
+		memcpy(&objects[i].guid, &o->guid, sizeof(EFI_GUID));
+		for (j = 0; j < o->name_len && j < MAX_NAME; j++) {
+			memcpy(&objects[i].name[j], &name[j], sizeof(CHAR16));
+			objects[i].ascii[j] = objects[i].name[j] < 0x80 ?
+				objects[i].name[j] : '?';
+		}
+		if (!j)
+			format_guid(objects[i].ascii, sizeof(objects[i].ascii),
+				    &objects[i].guid);
+
+		p += sizeof(*o) + o->name_len * sizeof(CHAR16);
+	}
+
+	return 0;
+}
+
+/*
+ * Least squares fit of duration = latency + size * ns_per_byte over the
+ * reads of each partition.
+ */
+static void fit_partitions(void)
+{
+	UINT32 i, j;
+
+	for (i = 0; i < header->object_count; i++) {
+		double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0, d;
+		struct object *o = &objects[i];
+
+		if (o->type != FW_TRACE_OBJECT_PARTITION)
+			continue;
+
+		for (j = 0; j < header->record_count; j++) {
+			struct fw_trace_record *r = record(j);
+			double x = r->size, y = to_ns(r->duration);
+
+			if (r->op != FW_TRACE_READ_DISK || r->object != i ||
+			    r->status)
+				continue;
+			n++;
+			sx += x;
+			sy += y;
+			sxx += x * x;
+			sxy += x * y;
+		}
+		if (!n)
+			continue;
+
+		d = n * sxx - sx * sx;
+		o->ns_per_byte = d > 0 ? (n * sxy - sx * sy) / d : 0;
+		if (o->ns_per_byte < 0)
+			o->ns_per_byte = 0;
+		o->latency_ns = (sy - o->ns_per_byte * sx) / n;
+		if (o->latency_ns < 0)
+			o->latency_ns = 0;
+	}
+}
+
+static UINT64 trace_span_ns(void)
+{
+	struct fw_trace_record *last;
+
+	if (!header->record_count)
+		return 0;
+	last = record(header->record_count - 1);
+	return to_ns(last->start + last->duration);
+}
+
+static int compare_duration(const void *a, const void *b)
+{
+	UINT32 da = record(*(const UINT32 *)a)->duration;
+	UINT32 db = record(*(const UINT32 *)b)->duration;
+
+	return da < db ? 1 : da > db ? -1 : 0;
+}
+
+static void print_summary(unsigned int slowest)
+{
+	UINT64 total[FW_TRACE_OP_COUNT] = { 0 }, max[FW_TRACE_OP_COUNT] = { 0 };
+	UINT32 calls[FW_TRACE_OP_COUNT] = { 0 }, errors[FW_TRACE_OP_COUNT] = { 0 };
+	UINT32 *order, i, j;
+	char guid[40];
+
+	printf("%u records, %u objects, %u memory map descriptors, ",
+	       header->record_count, header->object_count, header->memmap_count);
+	if (header->tsc_khz)
+		printf("TSC %llu kHz\n", (unsigned long long)header->tsc_khz);
+	else
+		printf("no TSC frequency, times are in cycles\n");
+	if (header->dropped)
+		printf("WARNING: %u records dropped, the trace is incomplete\n",
+		       header->dropped);
+	printf("Span %.3f ms\n\n", to_ms(trace_span_ns()));
+
+	for (i = 0; i < header->record_count; i++) {
+		struct fw_trace_record *r = record(i);
+		UINT64 ns = to_ns(r->duration);
+
+		if (r->op >= FW_TRACE_OP_COUNT)
+			continue;
+		calls[r->op]++;
+		if (r->status & 0x80)
+			errors[r->op]++;
+		total[r->op] += ns;
+		if (ns > max[r->op])
+			max[r->op] = ns;
+	}
+
+	printf("%-20s %8s %7s %12s %10s %10s\n", "Call", "Count", "Errors",
+	       "Total ms", "Avg us", "Max us");
+	for (i = 0; i < FW_TRACE_OP_COUNT; i++) {
+		if (!calls[i])
+			continue;
+		printf("%-20s %8u %7u %12.3f %10.1f %10.1f\n", op_names[i],
+		       calls[i], errors[i], to_ms(total[i]),
+		       total[i] / 1000.0 / calls[i], max[i] / 1000.0);
+	}
+
+	printf("\n%-36s %8s %10s %10s %8s %10s %8s\n", "Partition", "Reads",
+	       "KB", "ms", "MB/s", "Fit lat us", "Fit MB/s");
+	for (i = 0; i < header->object_count; i++) {
+		UINT64 bytes = 0, ns = 0;
+		UINT32 reads = 0;
+
+		if (objects[i].type != FW_TRACE_OBJECT_PARTITION)
+			continue;
+		for (j = 0; j < header->record_count; j++) {
+			struct fw_trace_record *r = record(j);
+
+			if (r->op != FW_TRACE_READ_DISK || r->object != i)
+				continue;
+			reads++;
+			bytes += r->size;
+			ns += to_ns(r->duration);
+		}
+		format_guid(guid, sizeof(guid), &objects[i].guid);
+		printf("%-36s %8u %10llu %10.3f %8.1f %10.1f %8.1f\n", guid,
+		       reads, (unsigned long long)bytes / 1024, to_ms(ns),
+		       ns ? bytes * 1000.0 / ns : 0, objects[i].latency_ns / 1000,
+		       objects[i].ns_per_byte ? 1000.0 / objects[i].ns_per_byte : 0);
+	}
+
+	printf("\n%-32s %6s %6s %10s %10s\n", "Variable", "Gets", "Sets",
+	       "Bytes", "ms");
+	for (i = 0; i < header->object_count; i++) {
+		UINT64 bytes = 0, ns = 0;
+		UINT32 gets = 0, sets = 0;
+
+		if (objects[i].type != FW_TRACE_OBJECT_VARIABLE)
+			continue;
+		for (j = 0; j < header->record_count; j++) {
+			struct fw_trace_record *r = record(j);
+
+			if (r->object != i)
+				continue;
+			if (r->op == FW_TRACE_GET_VARIABLE)
+				gets++;
+			else if (r->op == FW_TRACE_SET_VARIABLE)
+				sets++;
+			else
+				continue;
+			bytes += r->size;
+			ns += to_ns(r->duration);
+		}
+		printf("%-32s %6u %6u %10llu %10.3f\n", objects[i].ascii, gets,
+		       sets, (unsigned long long)bytes, to_ms(ns));
+	}
+
+	if (!slowest || !header->record_count)
+		return;
+
+	order = malloc(header->record_count * sizeof(*order));
+	if (!order)
+		return;
+	for (i = 0; i < header->record_count; i++)
+		order[i] = i;
+	qsort(order, header->record_count, sizeof(*order), compare_duration);
+
+	printf("\n%-8s %10s %-20s %-36s %10s %10s\n", "Record", "Start ms",
+	       "Call", "Object", "Size", "us");
+	for (i = 0; i < slowest && i < header->record_count; i++) {
+		struct fw_trace_record *r = record(order[i]);
+
+		printf("%-8u %10.3f %-20s %-36s %10u %10.1f\n", order[i],
+		       to_ms(to_ns(r->start)),
+		       r->op < FW_TRACE_OP_COUNT ? op_names[r->op] : "?",
+		       object_name(r), r->size, to_ns(r->duration) / 1000.0);
+	}
+	free(order);
+}
+
+static UINT64 disk_cost(void *ctx, EFI_HANDLE handle, BOOLEAN write,
+			UINT64 offset, UINTN size, UINT64 model_ns)
+{
+	struct object *o = NULL;
+	UINT32 i;
+
+	for (i = 0; i < header->object_count; i++)
+		if (objects[i].handle == handle)
+			o = &objects[i];
+	if (!o || write || cost_mode == COST_MODEL)
+		return model_ns;
+
+	if (cost_mode == COST_RECORDED) {
+		/*
+		 * Reads usually come in the recorded order, start looking
+		 * after the last match.
+		 */
+		for (i = 0; i < header->record_count; i++) {
+			UINT32 n = (o->cursor + i) % header->record_count;
+			struct fw_trace_record *r = record(n);
+
+			if (r->op == FW_TRACE_READ_DISK && record_object(r) == o &&
+			    r->arg == offset && r->size == size) {
+				o->cursor = n + 1;
+				matched_reads++;
+				return to_ns(r->duration);
+			}
+		}
+		unmatched_reads++;
+	}
+
+	return o->latency_ns + o->ns_per_byte * size;
+}
+
+static void find_partitions(EFI_BOOT_SERVICES *bs)
+{
+	EFI_GUID block_io = BLOCK_IO_PROTOCOL, device_path = DEVICE_PATH_PROTOCOL;
+	EFI_HANDLE *handles;
+	UINTN count, i;
+	UINT32 j;
+
+	if (uefi_call_wrapper(bs->LocateHandleBuffer, 5, ByProtocol, &block_io,
+			      NULL, &count, &handles))
+		return;
+
+	for (i = 0; i < count; i++) {
+		EFI_DEVICE_PATH *node;
+		HARDDRIVE_DEVICE_PATH *hd = NULL;
+
+		if (uefi_call_wrapper(bs->HandleProtocol, 3, handles[i],
+				      &device_path, (VOID **)&node))
+			continue;
+		for (; !IsDevicePathEnd(node); node = NextDevicePathNode(node))
+			if (DevicePathType(node) == MEDIA_DEVICE_PATH &&
+			    DevicePathSubType(node) == MEDIA_HARDDRIVE_DP)
+				hd = (HARDDRIVE_DEVICE_PATH *)node;
+		if (!hd || hd->SignatureType != SIGNATURE_TYPE_GUID)
+			continue;
+
+		for (j = 0; j < header->object_count; j++)
+			if (objects[j].type == FW_TRACE_OBJECT_PARTITION &&
+			    !memcmp(&objects[j].guid, hd->Signature, sizeof(EFI_GUID)))
+				objects[j].handle = handles[i];
+	}
+
+	uefi_call_wrapper(bs->FreePool, 1, handles);
+}
+
+static struct allocation *find_allocation(UINT64 address, BOOLEAN pool)
+{
+	UINT32 i;
+
+	for (i = allocation_count; i-- > 0; )
+		if (allocations[i].recorded == address &&
+		    allocations[i].pool == pool)
+			return &allocations[i];
+	return NULL;
+}
+
+/*
+ * Variables the loader read successfully are created beforehand with
+ * the recorded size and attributes so that the replayed reads find
+ * them.
+ */
+static void seed_variables(EFI_RUNTIME_SERVICES *rt)
+{
+	static UINT8 zero[64 * 1024];
+	UINT32 i;
+
+	for (i = 0; i < header->record_count; i++) {
+		struct fw_trace_record *r = record(i);
+		struct object *o = record_object(r);
+
+		if (r->op != FW_TRACE_GET_VARIABLE || r->status || !o ||
+		    r->size > sizeof(zero))
+			continue;
+		uefi_call_wrapper(rt->SetVariable, 5, o->name, &o->guid,
+				  r->extra, r->size, zero);
+	}
+}
+
+static BOOLEAN replay_record(EFI_SYSTEM_TABLE *st, struct fw_trace_record *r)
+{
+	EFI_BOOT_SERVICES *bs = st->BootServices;
+	EFI_RUNTIME_SERVICES *rt = st->RuntimeServices;
+	EFI_GUID disk_io_guid = DISK_IO_PROTOCOL;
+	EFI_GUID block_io_guid = BLOCK_IO_PROTOCOL;
+	struct object *o = record_object(r);
+	struct allocation *a;
+	EFI_PHYSICAL_ADDRESS address;
+	EFI_DISK_IO *disk_io;
+	EFI_BLOCK_IO *block_io;
+	UINTN size, key, desc_size;
+	UINT32 desc_version, attributes;
+	VOID *buffer;
+
+	switch (r->op) {
+	case FW_TRACE_ALLOCATE_PAGES:
+	case FW_TRACE_ALLOCATE_POOL:
+		if (r->status)
+			return FALSE;
+		a = &allocations[allocation_count];
+		a->recorded = r->arg;
+		a->pool = r->op == FW_TRACE_ALLOCATE_POOL;
+		if (a->pool) {
+			if (uefi_call_wrapper(bs->AllocatePool, 3, r->extra,
+					      r->size, &buffer))
+				return FALSE;
+			a->replayed = (EFI_PHYSICAL_ADDRESS)(UINTN)buffer;
+		} else if (uefi_call_wrapper(bs->AllocatePages, 4,
+					     AllocateAnyPages, r->extra,
+					     r->size, &a->replayed))
+			return FALSE;
+		allocation_count++;
+		return TRUE;
+
+	case FW_TRACE_FREE_PAGES:
+	case FW_TRACE_FREE_POOL:
+		a = find_allocation(r->arg, r->op == FW_TRACE_FREE_POOL);
+		if (!a)
+			return FALSE;
+		if (a->pool)
+			uefi_call_wrapper(bs->FreePool, 1,
+					  (VOID *)(UINTN)a->replayed);
+		else
+			uefi_call_wrapper(bs->FreePages, 2, a->replayed,
+					  r->size);
+		a->recorded = 0;
+		return TRUE;
+
+	case FW_TRACE_GET_MEMORY_MAP:
+		size = 0;
+		uefi_call_wrapper(bs->GetMemoryMap, 5, &size, NULL, &key,
+				  &desc_size, &desc_version);
+		buffer = malloc(size);
+		if (!buffer)
+			return FALSE;
+		uefi_call_wrapper(bs->GetMemoryMap, 5, &size, buffer, &key,
+				  &desc_size, &desc_version);
+		free(buffer);
+		return TRUE;
+
+	case FW_TRACE_GET_VARIABLE:
+	case FW_TRACE_SET_VARIABLE:
+		if (!o)
+			return FALSE;
+		size = r->size;
+		buffer = calloc(1, size ? size : 1);
+		if (!buffer)
+			return FALSE;
+		if (r->op == FW_TRACE_GET_VARIABLE)
+			uefi_call_wrapper(rt->GetVariable, 5, o->name, &o->guid,
+					  &attributes, &size, buffer);
+		else
+			uefi_call_wrapper(rt->SetVariable, 5, o->name, &o->guid,
+					  r->extra, size, buffer);
+		free(buffer);
+		return TRUE;
+
+	case FW_TRACE_READ_DISK:
+		if (!o || !o->handle || r->status)
+			return FALSE;
+		if (uefi_call_wrapper(bs->HandleProtocol, 3, o->handle,
+				      &disk_io_guid, (VOID **)&disk_io) ||
+		    uefi_call_wrapper(bs->HandleProtocol, 3, o->handle,
+				      &block_io_guid, (VOID **)&block_io))
+			return FALSE;
+		buffer = malloc(r->size ? r->size : 1);
+		if (!buffer)
+			return FALSE;
+		address = r->arg;
+		/* The recorded media id is the device's one */
+		uefi_call_wrapper(disk_io->ReadDisk, 5, disk_io,
+				  block_io->Media->MediaId, address, r->size,
+				  buffer);
+		free(buffer);
+		return TRUE;
+
+	default:
+		/* Protocols of the device do not exist on the host */
+		return FALSE;
+	}
+}
+
+static EFI_STATUS replay(EFI_HANDLE image, EFI_SYSTEM_TABLE *st)
+{
+	UINT64 start;
+	UINT32 i;
+
+	find_partitions(st->BootServices);
+	seed_variables(st->RuntimeServices);
+	mockfw_reset_stats();
+
+	for (i = 0; i < header->record_count; i++) {
+		struct fw_trace_record *r = record(i);
+
+		if (r->op >= FW_TRACE_OP_COUNT) {
+			skipped++;
+			continue;
+		}
+
+		start = mockfw_now_ns();
+		if (replay_record(st, r)) {
+			replay_ns[r->op] += mockfw_now_ns() - start;
+			replayed++;
+		} else
+			skipped++;
+	}
+
+	return EFI_SUCCESS;
+}
+
+static void print_replay(void)
+{
+	UINT64 recorded[FW_TRACE_OP_COUNT] = { 0 };
+	UINT64 recorded_total = 0, replay_total = 0, loader_ns = 0;
+	struct fw_trace_record *r, *prev = NULL;
+	UINT32 i;
+
+	for (i = 0; i < header->record_count; i++) {
+		r = record(i);
+		if (prev && r->start > prev->start + prev->duration)
+			loader_ns += to_ns(r->start - prev->start - prev->duration);
+		prev = r;
+		if (r->op >= FW_TRACE_OP_COUNT)
+			continue;
+		recorded[r->op] += to_ns(r->duration);
+	}
+
+	printf("\nReplayed %u records, %u skipped\n", replayed, skipped);
+	printf("%-20s %12s %12s\n", "Call", "Recorded ms", "Replay ms");
+	for (i = 0; i < FW_TRACE_OP_COUNT; i++) {
+		if (!recorded[i] && !replay_ns[i])
+			continue;
+		printf("%-20s %12.3f %12.3f\n", op_names[i], to_ms(recorded[i]),
+		       to_ms(replay_ns[i]));
+		recorded_total += recorded[i];
+		replay_total += replay_ns[i];
+	}
+	printf("%-20s %12.3f %12.3f\n", "Total", to_ms(recorded_total),
+	       to_ms(replay_total));
+	printf("%-20s %12.3f %12.3f\n", "With loader time",
+	       to_ms(recorded_total + loader_ns),
+	       to_ms(replay_total + loader_ns));
+}
+
+static void print_loader_run(enum mockfw_exit reason, EFI_STATUS status,
+			     UINT64 elapsed_ns)
+{
+	UINT64 reads = 0, read_bytes = 0, read_ns = 0, total_ns = 0;
+	UINT64 var_reads = 0, var_writes = 0;
+	struct mockfw_stats stats;
+	UINT32 i;
+
+	for (i = 0; i < header->record_count; i++) {
+		struct fw_trace_record *r = record(i);
+
+		total_ns += to_ns(r->duration);
+		if (r->op == FW_TRACE_READ_DISK) {
+			reads++;
+			read_bytes += r->size;
+			read_ns += to_ns(r->duration);
+		} else if (r->op == FW_TRACE_GET_VARIABLE)
+			var_reads++;
+		else if (r->op == FW_TRACE_SET_VARIABLE)
+			var_writes++;
+	}
+
+	mockfw_get_stats(&stats);
+	printf("\nLoader run: %s, status %#llx\n",
+	       loader_host_exit_name(reason), (unsigned long long)status);
+	printf("%-20s %12s %12s\n", "", "Recorded", "Host run");
+	printf("%-20s %12llu %12llu\n", "ReadDisk calls",
+	       (unsigned long long)reads,
+	       (unsigned long long)stats.disk_reads);
+	printf("%-20s %12llu %12llu\n", "ReadDisk bytes",
+	       (unsigned long long)read_bytes,
+	       (unsigned long long)stats.disk_read_bytes);
+	printf("%-20s %12.3f %12.3f\n", "ReadDisk ms", to_ms(read_ns),
+	       to_ms(stats.disk_ns));
+	printf("%-20s %12llu %12llu\n", "GetVariable calls",
+	       (unsigned long long)var_reads,
+	       (unsigned long long)stats.var_reads);
+	printf("%-20s %12llu %12llu\n", "SetVariable calls",
+	       (unsigned long long)var_writes,
+	       (unsigned long long)stats.var_writes);
+	printf("%-20s %12.3f %12.3f\n", "Firmware ms", to_ms(total_ns),
+	       to_ms(elapsed_ns));
+	if (cost_mode == COST_RECORDED)
+		printf("%u of %u reads matched a recorded read, the others "
+		       "use the partition fit\n", matched_reads,
+		       matched_reads + unmatched_reads);
+}
+
+/*
+ * The variables the loader read are seeded with their recorded sizes
+ * but not their contents, which the trace does not keep: the boot
+ * logic may pick another target than on the device, -t forces it.
+ */
+static void run_loader(const struct loader_host_args *args)
+{
+	EFI_SYSTEM_TABLE *st = mockfw_system_table();
+	enum mockfw_exit reason;
+	EFI_STATUS status;
+	UINT64 start;
+
+	find_partitions(st->BootServices);
+	seed_variables(st->RuntimeServices);
+	mockfw_reset_stats();
+
+	start = mockfw_now_ns();
+	reason = loader_host_run(args, &status);
+	print_loader_run(reason, status, mockfw_now_ns() - start);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-n COUNT] [-d DISK_IMAGE [-b BLOCK_SIZE] "
+		"[-m recorded|fitted|LATENCY_US,MB_PER_S] [-w NV_WRITE_US] "
+		"[-r | [-t TARGET] [-c CMDLINE]]] TRACE\n", name);
+	fprintf(stderr, "Summarize a firmware call trace and optionally run "
+		"the loader on DISK_IMAGE\nwith the recorded costs.\n"
+		"  -n  number of slowest calls to list (10)\n"
+		"  -m  cost of the replayed reads: the recorded durations "
+		"(default), a per\n"
+		"      partition fit of the recorded reads, or a fixed disk "
+		"model\n"
+		"  -w  cost of a non-volatile SetVariable (0)\n"
+		"  -r  re-issue the recorded calls instead of running the "
+		"loader\n"
+		"  -t  target to start instead of running the boot logic\n"
+		"  -c  extra kernel command line\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct mockfw_config config = { .quiet = TRUE };
+	struct mockfw_disk_model model = { 0 };
+	struct loader_host_args args = { 0 };
+	const char *disk = NULL;
+	BOOLEAN raw = FALSE;
+	unsigned int slowest = 10, block_size = 512;
+	unsigned long latency_us, mbps;
+	EFI_STATUS status;
+	int c;
+
+	while ((c = getopt(argc, argv, "b:c:d:m:n:rt:w:")) != -1) {
+		switch (c) {
+		case 'b':
+			block_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			args.cmdline = optarg;
+			break;
+		case 'd':
+			disk = optarg;
+			break;
+		case 'm':
+			if (!strcmp(optarg, "recorded"))
+				cost_mode = COST_RECORDED;
+			else if (!strcmp(optarg, "fitted"))
+				cost_mode = COST_FITTED;
+			else if (sscanf(optarg, "%lu,%lu", &latency_us, &mbps) == 2) {
+				cost_mode = COST_MODEL;
+				model.latency_ns = latency_us * 1000ULL;
+				model.bandwidth = mbps << 20;
+			} else {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'n':
+			slowest = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			raw = TRUE;
+			break;
+		case 't':
+			args.target = optarg;
+			break;
+		case 'w':
+			config.nv_write_ns = strtoull(optarg, NULL, 0) * 1000ULL;
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (load_trace(argv[optind]))
+		return EXIT_FAILURE;
+
+	fit_partitions();
+	print_summary(slowest);
+
+	if (!disk)
+		return EXIT_SUCCESS;
+
+	allocations = calloc(header->record_count + 1, sizeof(*allocations));
+	if (!allocations)
+		return EXIT_FAILURE;
+
+	if (mockfw_init(&config)) {
+		fprintf(stderr, "Failed to start the mock firmware\n");
+		return EXIT_FAILURE;
+	}
+	if (mockfw_add_disk(disk, block_size, &model, NULL)) {
+		fprintf(stderr, "%s: failed to attach the disk image\n", disk);
+		mockfw_shutdown();
+		return EXIT_FAILURE;
+	}
+
+	mockfw_set_disk_cost(disk_cost, NULL);
+	if (raw) {
+		mockfw_run(replay, &status);
+		print_replay();
+	} else
+		run_loader(&args);
+
+	mockfw_shutdown();
+	return EXIT_SUCCESS;
+}
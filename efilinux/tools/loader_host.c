@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file replaces entry.c in the host build of the loader. It sets
+ * up the platform ops on top of the mock firmware and starts the boot
+ * logic or a target, as efi_main() does on the device.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "efilinux.h"
+#include "protocol.h"
+#include "platform.h"
+#include "x86.h"
+#include "acpi.h"
+#include "fake_em.h"
+#include "intel_partitions.h"
+#include "cmdline.h"
+#include "fs.h"
+#include "io_stats.h"
+#include "watchdog.h"
+#include "utils.h"
+#include "loader_host.h"
+
+EFI_HANDLE efilinux_image;
+void *efilinux_image_base;
+EFI_HANDLE main_image_handle;
+
+EFI_SYSTEM_TABLE *sys_table;
+EFI_BOOT_SERVICES *boot;
+EFI_RUNTIME_SERVICES *runtime;
+
+extern EFI_STATUS start_boot_logic(CHAR8 *cmdline);
+
+static const struct loader_host_args *host_args;
+
+/*
+ * The image verification protocols of the device do not exist on the
+ * mock firmware, images are started as with secure boot disabled.
+ */
+BOOLEAN is_secure_boot_enabled(void)
+{
+	return FALSE;
+}
+
+static EFI_STATUS host_watchdog_start(struct watchdog *wd)
+{
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS host_watchdog_stop(struct watchdog *wd)
+{
+	return EFI_SUCCESS;
+}
+
+static void host_watchdog_set_timeout(struct watchdog *wd, UINT32 timeout)
+{
+}
+
+/* The TCO watchdog is programmed through I/O ports */
+static struct watchdog host_watchdog = {
+	.ops = {
+		.start = host_watchdog_start,
+		.stop = host_watchdog_stop,
+		.set_timeout = host_watchdog_set_timeout,
+	},
+};
+
+static UINT64 host_get_current_time_us(void)
+{
+	return mockfw_now_ns() / 1000;
+}
+
+/*
+ * The x86 platform ops only use UEFI services and ACPI tables, they
+ * run as is on the mock firmware. What probes the hardware is stubbed:
+ * the CPU identification of init_platform_functions() is skipped, the
+ * time comes from the mock firmware clock, the battery from the fake
+ * energy management and the kernel jump returns to mockfw_run().
+ */
+static void host_platform_ops(void)
+{
+	x86_ops(&loader_ops);
+	loader_ops.get_current_time_us = host_get_current_time_us;
+	loader_ops.em_ops = &fake_em_ops;
+	loader_ops.hook_before_jump = mockfw_hook_before_jump;
+	watchdog = &host_watchdog;
+}
+
+struct host_acpi_tables {
+	struct RSDP_TABLE rsdp;
+	struct RSDT_TABLE rsdt;
+	struct RSCI_TABLE rsci;
+};
+
+static UINT8 acpi_checksum(VOID *table, UINTN size)
+{
+	UINT8 *p = table, sum = 0;
+
+	while (size--)
+		sum += *p++;
+	return sum;
+}
+
+static void acpi_set_header(struct ACPI_DESC_HEADER *header,
+			    const char *signature, UINT32 length)
+{
+	memcpy(header->signature, signature, sizeof(header->signature));
+	header->length = length;
+	header->revision = 1;
+	memcpy(header->oem_id, "HOST  ", sizeof(header->oem_id));
+	header->checksum = -acpi_checksum(header, length);
+}
+
+/*
+ * The RSDT entries are 32 bits addresses, the tables are allocated
+ * below 4GB in the mock firmware memory.
+ */
+static EFI_STATUS install_rsci(void)
+{
+	EFI_GUID acpi2_guid = ACPI_20_TABLE_GUID;
+	EFI_PHYSICAL_ADDRESS addr = 0xffffffff;
+	struct host_acpi_tables *tables;
+	EFI_STATUS ret;
+
+	ret = allocate_pages(AllocateMaxAddress, EfiACPIReclaimMemory,
+			     EFI_SIZE_TO_PAGES(sizeof(*tables)), &addr);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	tables = (struct host_acpi_tables *)(UINTN)addr;
+	memset(tables, 0, sizeof(*tables));
+
+	tables->rsci.wake_source = host_args->wake_source;
+	tables->rsci.reset_source = host_args->reset_source;
+	tables->rsci.reset_type = host_args->reset_type;
+	tables->rsci.shutdown_source = host_args->shutdown_source;
+	acpi_set_header(&tables->rsci.header, "RSCI", sizeof(tables->rsci));
+
+	tables->rsdt.entry[0] = (UINT32)(UINTN)&tables->rsci;
+	acpi_set_header(&tables->rsdt.header, "RSDT", sizeof(tables->rsdt));
+
+	memcpy(tables->rsdp.signature, "RSD PTR ", sizeof(tables->rsdp.signature));
+	tables->rsdp.revision = 2;
+	tables->rsdp.rsdt_address = (UINT32)(UINTN)&tables->rsdt;
+	tables->rsdp.length = sizeof(tables->rsdp);
+	tables->rsdp.checksum = -acpi_checksum(&tables->rsdp, 20);
+	tables->rsdp.extended_checksum = -acpi_checksum(&tables->rsdp,
+							sizeof(tables->rsdp));
+
+	return mockfw_install_table(&acpi2_guid, &tables->rsdp);
+}
+
+static EFI_STATUS start_target(const char *name, CHAR8 *extra)
+{
+	struct cmdline cmdline;
+	enum targets target;
+	CHAR16 *name16;
+	EFI_STATUS ret;
+
+	name16 = stra_to_str((CHAR8 *)name);
+	if (!name16)
+		return EFI_OUT_OF_RESOURCES;
+
+	ret = name_to_target(name16, &target);
+	free(name16);
+	if (EFI_ERROR(ret)) {
+		error(L"Unknown target name %a\n", name);
+		return ret;
+	}
+
+	cmdline_init(&cmdline);
+	if (extra) {
+		ret = cmdline_add(&cmdline, extra, strlena(extra));
+		if (EFI_ERROR(ret))
+			return ret;
+	}
+
+	info(L"Starting target %a\n", name);
+	return loader_ops.load_target(target, &cmdline);
+}
+
+static EFI_STATUS loader_host_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *table)
+{
+	CHAR8 *extra = (CHAR8 *)host_args->cmdline;
+	EFI_LOADED_IMAGE *info;
+	EFI_STATUS ret;
+
+	main_image_handle = image;
+	InitializeLib(image, table);
+	sys_table = table;
+	boot = sys_table->BootServices;
+	runtime = sys_table->RuntimeServices;
+
+	ret = handle_protocol(image, &LoadedImageProtocol, (void **)&info);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	efilinux_image_base = info->ImageBase;
+	efilinux_image = info->DeviceHandle;
+
+	/* No file system on the mock firmware, the loader files are optional */
+	ret = fs_init();
+	if (EFI_ERROR(ret))
+		debug(L"Running without file system\n");
+
+	host_platform_ops();
+	io_stats_set_clock(loader_ops.get_current_time_us);
+
+	if (host_args->rsci) {
+		ret = install_rsci();
+		if (EFI_ERROR(ret)) {
+			error(L"Failed to install the RSCI table: %r\n", ret);
+			goto out;
+		}
+	}
+
+	if (host_args->target)
+		ret = start_target(host_args->target, extra);
+	else
+		ret = start_boot_logic(extra);
+	error(L"Boot failed: %r\n", ret);
+
+out:
+	fs_exit();
+	loader_ops.hook_before_exit();
+	return ret;
+}
+
+enum mockfw_exit loader_host_run(const struct loader_host_args *args,
+				 EFI_STATUS *status)
+{
+	host_args = args;
+	return mockfw_run(loader_host_main, status);
+}
+
+const char *loader_host_exit_name(enum mockfw_exit reason)
+{
+	switch (reason) {
+	case MOCKFW_EXIT_RETURN:
+		return "loader returned";
+	case MOCKFW_EXIT_EXIT:
+		return "loader exited";
+	case MOCKFW_EXIT_JUMP:
+		return "kernel reached";
+	case MOCKFW_EXIT_RESET:
+		return "system reset";
+	}
+	return "unknown exit";
+}
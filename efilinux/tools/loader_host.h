@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file declares the host build of the loader: the loader sources
+ * run on the mock firmware, from the platform setup to the kernel jump.
+ * Only EFI types are used here so that host tools can include it next
+ * to the C library headers.
+ */
+
+#ifndef __LOADER_HOST_H__
+#define __LOADER_HOST_H__
+
+#include "mockfw/mockfw.h"
+
+struct loader_host_args {
+	/* Target name as for "efilinux -t", NULL to run the boot logic */
+	const char *target;
+	/* Extra kernel command line, may be NULL */
+	const char *cmdline;
+	/* Install an RSCI table with these boot sources */
+	BOOLEAN rsci;
+	UINT8 wake_source;
+	UINT8 reset_source;
+	UINT8 reset_type;
+	UINT8 shutdown_source;
+};
+
+/*
+ * Run the loader on the mock firmware, which must be initialized with
+ * the boot disk attached. A boot that reaches the kernel returns
+ * MOCKFW_EXIT_JUMP.
+ */
+enum mockfw_exit loader_host_run(const struct loader_host_args *args,
+				 EFI_STATUS *status);
+
+const char *loader_host_exit_name(enum mockfw_exit reason);
+
+#endif /* __LOADER_HOST_H__ */
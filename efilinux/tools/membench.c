@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file is a host benchmark of the loader memory primitives. It
+ * links the loader mem.c with the host libc and reports the bandwidth
+ * of each copy/set method against the libc implementation, for sizes
+ * from 64 bytes to 64MB.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mem.h"
+
+#define MIN_SIZE	64UL
+#define MAX_SIZE	(64UL << 20)
+/* Each measurement moves at least this amount of data */
+#define BYTES_PER_RUN	(256UL << 20)
+
+static const char *method_names[] = {
+	[MEM_METHOD_AUTO] = "auto",
+	[MEM_METHOD_MOVS] = "movs",
+	[MEM_METHOD_ERMS] = "erms",
+	[MEM_METHOD_SSE2] = "sse2",
+	[MEM_METHOD_SSE2_NT] = "sse2-nt",
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long iterations(size_t size)
+{
+	unsigned long n = BYTES_PER_RUN / size;
+
+	return n < 4 ? 4 : n;
+}
+
+static double gbps(size_t size, unsigned long n, double elapsed)
+{
+	return (double)size * n / elapsed / 1e9;
+}
+
+/* Check that the method copies and sets exactly the requested range
+ * at a few misalignments */
+static int check_method(enum mem_method m, char *dst, char *src)
+{
+	size_t sizes[] = { 1, 7, 8, 9, 31, 63, 64, 65, 127, 4096 + 17, 1 << 20 };
+	size_t i, off, size;
+
+	for (i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+		for (off = 0; off < 16; off += 5) {
+			size = sizes[i];
+			memset(dst, 0x5a, size + 64);
+			mem_copy_method(m, dst + off, src + 3, size);
+			if (memcmp(dst + off, src + 3, size) ||
+			    dst[off + size] != 0x5a ||
+			    (off && dst[off - 1] != 0x5a))
+				return -1;
+
+			mem_set_method(m, dst + off, 0xa5, size);
+			if (dst[off + size] != 0x5a ||
+			    (unsigned char)dst[off + size - 1] != 0xa5 ||
+			    (unsigned char)dst[off] != 0xa5)
+				return -1;
+		}
+		if (mem_cmp(src, src, size) ||
+		    !mem_cmp(dst, src, size) != !memcmp(dst, src, size))
+			return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	char *src, *dst;
+	size_t size;
+	unsigned long i, n;
+	double start;
+	int m;
+
+	src = aligned_alloc(4096, MAX_SIZE + 4096);
+	dst = aligned_alloc(4096, MAX_SIZE + 4096);
+	if (!src || !dst) {
+		fprintf(stderr, "Failed to allocate the buffers\n");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < MAX_SIZE + 4096; i++)
+		src[i] = i * 7;
+	memset(dst, 0, MAX_SIZE + 4096);
+
+	for (m = MEM_METHOD_AUTO; m < MEM_METHOD_MAX; m++) {
+		if (!mem_method_supported(m))
+			continue;
+		if (check_method(m, dst, src)) {
+			fprintf(stderr, "%s: wrong result\n", method_names[m]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("%-8s %-6s", "size", "op");
+	printf(" %9s", "libc");
+	for (m = MEM_METHOD_AUTO; m < MEM_METHOD_MAX; m++)
+		if (mem_method_supported(m))
+			printf(" %9s", method_names[m]);
+	printf("   (GB/s)\n");
+
+	for (size = MIN_SIZE; size <= MAX_SIZE; size <<= 1) {
+		n = iterations(size);
+
+		printf("%-8zu %-6s", size, "copy");
+		start = now();
+		for (i = 0; i < n; i++) {
+			memcpy(dst, src, size);
+			asm volatile("" : : "r" (dst) : "memory");
+		}
+		printf(" %9.2f", gbps(size, n, now() - start));
+		for (m = MEM_METHOD_AUTO; m < MEM_METHOD_MAX; m++) {
+			if (!mem_method_supported(m))
+				continue;
+			start = now();
+			for (i = 0; i < n; i++)
+				mem_copy_method(m, dst, src, size);
+			printf(" %9.2f", gbps(size, n, now() - start));
+		}
+		printf("\n");
+
+		printf("%-8zu %-6s", size, "set");
+		start = now();
+		for (i = 0; i < n; i++) {
+			memset(dst, i, size);
+			asm volatile("" : : "r" (dst) : "memory");
+		}
+		printf(" %9.2f", gbps(size, n, now() - start));
+		for (m = MEM_METHOD_AUTO; m < MEM_METHOD_MAX; m++) {
+			if (!mem_method_supported(m))
+				continue;
+			start = now();
+			for (i = 0; i < n; i++)
+				mem_set_method(m, dst, i, size);
+			printf(" %9.2f", gbps(size, n, now() - start));
+		}
+		printf("\n");
+	}
+
+	free(src);
+	free(dst);
+	return EXIT_SUCCESS;
+}
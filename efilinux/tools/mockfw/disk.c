@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file implements mock block devices backed by disk image files.
+ * Every request is charged a fixed latency plus its size over the
+ * configured bandwidth. A GPT on the image gets one child handle per
+ * partition, with a hard drive device path node carrying the unique
+ * partition GUID, as the firmware partition driver would do.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mockfw_private.h"
+
+#define GPT_SIGNATURE	"EFI PART"
+#define GPT_MAX_ENTRIES	256
+
+struct gpt_header {
+	CHAR8 signature[8];
+	UINT32 revision;
+	UINT32 header_size;
+	UINT32 header_crc;
+	UINT32 reserved;
+	UINT64 my_lba;
+	UINT64 alternate_lba;
+	UINT64 first_usable_lba;
+	UINT64 last_usable_lba;
+	EFI_GUID disk_guid;
+	UINT64 entries_lba;
+	UINT32 entry_count;
+	UINT32 entry_size;
+	UINT32 entries_crc;
+} __attribute__((packed));
+
+struct gpt_entry {
+	EFI_GUID type;
+	EFI_GUID unique;
+	UINT64 start_lba;
+	UINT64 end_lba;
+	UINT64 attributes;
+	CHAR16 name[36];
+} __attribute__((packed));
+
+struct mock_disk {
+	struct mock_disk *next;
+	int fd;
+	BOOLEAN owns_fd;
+	UINT64 offset;
+	UINT64 size;
+	struct mockfw_disk_model model;
+	EFI_BLOCK_IO_MEDIA media;
+	EFI_BLOCK_IO block_io;
+	EFI_DISK_IO disk_io;
+	EFI_DEVICE_PATH *path;
+	EFI_HANDLE handle;
+};
+
+static EFI_GUID vendor_guid = { 0x6d6f636b, 0x6677, 0x6469, { 0x73, 0x6b, 0, 0, 0, 0, 0, 0 } };
+
+static struct mock_disk *disks;
+static UINT32 disk_count;
+
+static mockfw_disk_cost_t disk_cost;
+static void *disk_cost_ctx;
+
+void mockfw_set_disk_cost(mockfw_disk_cost_t cost, void *ctx)
+{
+	disk_cost = cost;
+	disk_cost_ctx = ctx;
+}
+
+static EFI_STATUS transfer(struct mock_disk *disk, BOOLEAN write,
+			   UINT64 offset, UINTN size, VOID *buffer)
+{
+	UINT64 cost;
+	UINTN done = 0;
+
+	if (!buffer || offset > disk->size || size > disk->size - offset)
+		return EFI_INVALID_PARAMETER;
+	if (write && disk->media.ReadOnly)
+		return EFI_WRITE_PROTECTED;
+
+	while (done < size) {
+		ssize_t n;
+
+		if (write)
+			n = pwrite(disk->fd, (UINT8 *)buffer + done, size - done,
+				   disk->offset + offset + done);
+		else
+			n = pread(disk->fd, (UINT8 *)buffer + done, size - done,
+				  disk->offset + offset + done);
+		if (n <= 0)
+			return EFI_DEVICE_ERROR;
+		done += n;
+	}
+
+	cost = disk->model.latency_ns;
+	if (disk->model.bandwidth)
+		cost += size * 1000000000ULL / disk->model.bandwidth;
+	if (disk_cost)
+		cost = disk_cost(disk_cost_ctx, disk->handle, write, offset,
+				 size, cost);
+
+	if (write) {
+		mockfw_stats.disk_writes++;
+		mockfw_stats.disk_write_bytes += size;
+	} else {
+		mockfw_stats.disk_reads++;
+		mockfw_stats.disk_read_bytes += size;
+	}
+	mockfw_stats.disk_ns += cost;
+	mockfw_charge_ns(cost);
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS block_transfer(EFI_BLOCK_IO *this, BOOLEAN write,
+				 UINT32 media_id, EFI_LBA lba, UINTN size,
+				 VOID *buffer)
+{
+	struct mock_disk *disk = container_of(this, struct mock_disk, block_io);
+
+	if (media_id != disk->media.MediaId)
+		return EFI_MEDIA_CHANGED;
+	if (size % disk->media.BlockSize)
+		return EFI_BAD_BUFFER_SIZE;
+	if (lba > disk->media.LastBlock)
+		return EFI_INVALID_PARAMETER;
+
+	return transfer(disk, write, lba * disk->media.BlockSize, size, buffer);
+}
+
+static EFI_STATUS EFIAPI read_blocks(EFI_BLOCK_IO *this, UINT32 media_id,
+				     EFI_LBA lba, UINTN size, VOID *buffer)
+{
+	return block_transfer(this, FALSE, media_id, lba, size, buffer);
+}
+
+static EFI_STATUS EFIAPI write_blocks(EFI_BLOCK_IO *this, UINT32 media_id,
+				      EFI_LBA lba, UINTN size, VOID *buffer)
+{
+	return block_transfer(this, TRUE, media_id, lba, size, buffer);
+}
+
+static EFI_STATUS EFIAPI block_reset(EFI_BLOCK_IO *this, BOOLEAN extended)
+{
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI flush_blocks(EFI_BLOCK_IO *this)
+{
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI read_disk(EFI_DISK_IO *this, UINT32 media_id,
+				   UINT64 offset, UINTN size, VOID *buffer)
+{
+	struct mock_disk *disk = container_of(this, struct mock_disk, disk_io);
+
+	if (media_id != disk->media.MediaId)
+		return EFI_MEDIA_CHANGED;
+	return transfer(disk, FALSE, offset, size, buffer);
+}
+
+static EFI_STATUS EFIAPI write_disk(EFI_DISK_IO *this, UINT32 media_id,
+				    UINT64 offset, UINTN size, VOID *buffer)
+{
+	struct mock_disk *disk = container_of(this, struct mock_disk, disk_io);
+
+	if (media_id != disk->media.MediaId)
+		return EFI_MEDIA_CHANGED;
+	return transfer(disk, TRUE, offset, size, buffer);
+}
+
+/* Return a copy of PARENT, without its end node, followed by NODE */
+static EFI_DEVICE_PATH *append_node(EFI_DEVICE_PATH *parent,
+				    EFI_DEVICE_PATH *node)
+{
+	UINTN parent_size = 0, node_size = DevicePathNodeLength(node);
+	EFI_DEVICE_PATH *path, *end;
+
+	if (parent) {
+		for (end = parent; !IsDevicePathEnd(end);
+		     end = NextDevicePathNode(end))
+			;
+		parent_size = (UINT8 *)end - (UINT8 *)parent;
+	}
+
+	path = malloc(parent_size + node_size + sizeof(*end));
+	if (!path)
+		return NULL;
+
+	if (parent_size)
+		memcpy(path, parent, parent_size);
+	memcpy((UINT8 *)path + parent_size, node, node_size);
+	end = (EFI_DEVICE_PATH *)((UINT8 *)path + parent_size + node_size);
+	end->Type = END_DEVICE_PATH_TYPE;
+	end->SubType = END_ENTIRE_DEVICE_PATH_SUBTYPE;
+	SetDevicePathNodeLength(end, sizeof(*end));
+	return path;
+}
+
+static EFI_STATUS install_disk(struct mock_disk *disk)
+{
+	EFI_GUID block_io_guid = BLOCK_IO_PROTOCOL;
+	EFI_GUID disk_io_guid = DISK_IO_PROTOCOL;
+	EFI_GUID dp_guid = DEVICE_PATH_PROTOCOL;
+	EFI_STATUS ret;
+
+	disk->block_io.Revision = EFI_BLOCK_IO_INTERFACE_REVISION;
+	disk->block_io.Media = &disk->media;
+	disk->block_io.Reset = block_reset;
+	disk->block_io.ReadBlocks = read_blocks;
+	disk->block_io.WriteBlocks = write_blocks;
+	disk->block_io.FlushBlocks = flush_blocks;
+
+	disk->disk_io.Revision = EFI_DISK_IO_INTERFACE_REVISION;
+	disk->disk_io.ReadDisk = read_disk;
+	disk->disk_io.WriteDisk = write_disk;
+
+	disk->handle = NULL;
+	ret = mockfw_install_protocol(&disk->handle, &dp_guid, disk->path);
+	if (EFI_ERROR(ret))
+		return ret;
+	ret = mockfw_install_protocol(&disk->handle, &block_io_guid,
+				      &disk->block_io);
+	if (EFI_ERROR(ret))
+		return ret;
+	ret = mockfw_install_protocol(&disk->handle, &disk_io_guid,
+				      &disk->disk_io);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	disk->next = disks;
+	disks = disk;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS add_partition(struct mock_disk *parent, UINT32 number,
+				struct gpt_entry *entry)
+{
+	struct mock_disk *part;
+	HARDDRIVE_DEVICE_PATH hd;
+	UINT32 bs = parent->media.BlockSize;
+	EFI_STATUS ret;
+
+	if (entry->end_lba < entry->start_lba ||
+	    (entry->end_lba + 1) * bs > parent->size)
+		return EFI_VOLUME_CORRUPTED;
+
+	part = calloc(1, sizeof(*part));
+	if (!part)
+		return EFI_OUT_OF_RESOURCES;
+
+	part->fd = parent->fd;
+	part->offset = parent->offset + entry->start_lba * bs;
+	part->size = (entry->end_lba - entry->start_lba + 1) * bs;
+	part->model = parent->model;
+	part->media = parent->media;
+	part->media.LogicalPartition = TRUE;
+	part->media.LastBlock = part->size / bs - 1;
+
+	memset(&hd, 0, sizeof(hd));
+	hd.Header.Type = MEDIA_DEVICE_PATH;
+	hd.Header.SubType = MEDIA_HARDDRIVE_DP;
+	SetDevicePathNodeLength(&hd.Header,
+				offsetof(HARDDRIVE_DEVICE_PATH, SignatureType) +
+				sizeof(hd.SignatureType));
+	hd.PartitionNumber = number;
+	hd.PartitionStart = entry->start_lba;
+	hd.PartitionSize = entry->end_lba - entry->start_lba + 1;
+	memcpy(hd.Signature, &entry->unique, sizeof(hd.Signature));
+	hd.MBRType = MBR_TYPE_EFI_PARTITION_TABLE_HEADER;
+	hd.SignatureType = SIGNATURE_TYPE_GUID;
+
+	part->path = append_node(parent->path, &hd.Header);
+	if (!part->path) {
+		free(part);
+		return EFI_OUT_OF_RESOURCES;
+	}
+
+	ret = install_disk(part);
+	if (EFI_ERROR(ret)) {
+		free(part->path);
+		free(part);
+	}
+	return ret;
+}
+
+static EFI_STATUS add_partitions(struct mock_disk *disk)
+{
+	static const EFI_GUID unused;
+	struct gpt_header hdr;
+	UINT32 bs = disk->media.BlockSize;
+	UINT8 *entries;
+	EFI_STATUS ret = EFI_SUCCESS;
+	UINTN size;
+	UINT32 i;
+
+	/* Enumeration happens before the loader runs and is not charged */
+	if (pread(disk->fd, &hdr, sizeof(hdr), bs) != sizeof(hdr) ||
+	    memcmp(hdr.signature, GPT_SIGNATURE, sizeof(hdr.signature)))
+		return EFI_SUCCESS;
+
+	if (hdr.entry_size < sizeof(struct gpt_entry) ||
+	    hdr.entry_count > GPT_MAX_ENTRIES)
+		return EFI_VOLUME_CORRUPTED;
+
+	size = hdr.entry_count * hdr.entry_size;
+	entries = malloc(size);
+	if (!entries)
+		return EFI_OUT_OF_RESOURCES;
+	if (pread(disk->fd, entries, size, hdr.entries_lba * bs) != (ssize_t)size) {
+		ret = EFI_VOLUME_CORRUPTED;
+		goto out;
+	}
+
+	for (i = 0; i < hdr.entry_count; i++) {
+		struct gpt_entry *entry =
+			(struct gpt_entry *)(entries + i * hdr.entry_size);
+
+		if (!memcmp(&entry->type, &unused, sizeof(unused)))
+			continue;
+		ret = add_partition(disk, i + 1, entry);
+		if (EFI_ERROR(ret))
+			goto out;
+	}
+
+out:
+	free(entries);
+	return ret;
+}
+
+EFI_STATUS mockfw_add_disk(const char *path, UINT32 block_size,
+			   const struct mockfw_disk_model *model,
+			   EFI_HANDLE *handle)
+{
+	struct mock_disk *disk;
+	VENDOR_DEVICE_PATH vendor;
+	BOOLEAN read_only = FALSE;
+	EFI_STATUS ret;
+	off_t size;
+	int fd;
+
+	if (!block_size)
+		block_size = 512;
+
+	fd = open(path, O_RDWR);
+	if (fd < 0) {
+		fd = open(path, O_RDONLY);
+		read_only = TRUE;
+	}
+	if (fd < 0) {
+		perror(path);
+		return EFI_NOT_FOUND;
+	}
+
+	size = lseek(fd, 0, SEEK_END);
+	if (size < block_size) {
+		close(fd);
+		return EFI_VOLUME_CORRUPTED;
+	}
+
+	disk = calloc(1, sizeof(*disk));
+	if (!disk) {
+		close(fd);
+		return EFI_OUT_OF_RESOURCES;
+	}
+
+	disk->fd = fd;
+	disk->owns_fd = TRUE;
+	disk->size = size - size % block_size;
+	if (model)
+		disk->model = *model;
+	disk->media.MediaId = ++disk_count;
+	disk->media.MediaPresent = TRUE;
+	disk->media.ReadOnly = read_only;
+	disk->media.BlockSize = block_size;
+	disk->media.IoAlign = 1;
+	disk->media.LastBlock = disk->size / block_size - 1;
+
+	memset(&vendor, 0, sizeof(vendor));
+	vendor.Header.Type = HARDWARE_DEVICE_PATH;
+	vendor.Header.SubType = HW_VENDOR_DP;
+	SetDevicePathNodeLength(&vendor.Header, sizeof(vendor));
+	vendor.Guid = vendor_guid;
+	vendor.Guid.Data4[7] = disk_count;
+
+	disk->path = append_node(NULL, &vendor.Header);
+	if (!disk->path) {
+		ret = EFI_OUT_OF_RESOURCES;
+		goto err;
+	}
+
+	ret = install_disk(disk);
+	if (EFI_ERROR(ret))
+		goto err;
+
+	if (handle)
+		*handle = disk->handle;
+	return add_partitions(disk);
+
+err:
+	free(disk->path);
+	free(disk);
+	close(fd);
+	return ret;
+}
+
+void mockfw_disks_shutdown(void)
+{
+	struct mock_disk *disk, *next;
+
+	for (disk = disks; disk; disk = next) {
+		next = disk->next;
+		if (disk->owns_fd)
+			close(disk->fd);
+		free(disk->path);
+		free(disk);
+	}
+	disks = NULL;
+	disk_count = 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file implements a Graphics Output Protocol backed by a
+ * framebuffer in host memory, with a single 32 bits per pixel mode.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "mockfw_private.h"
+
+static EFI_GRAPHICS_OUTPUT_PROTOCOL gop;
+static EFI_GRAPHICS_OUTPUT_PROTOCOL_MODE gop_mode;
+static EFI_GRAPHICS_OUTPUT_MODE_INFORMATION gop_info;
+static EFI_GRAPHICS_OUTPUT_BLT_PIXEL *framebuffer;
+
+static EFI_STATUS EFIAPI query_mode(EFI_GRAPHICS_OUTPUT_PROTOCOL *this,
+				    UINT32 mode, UINTN *size,
+				    EFI_GRAPHICS_OUTPUT_MODE_INFORMATION **info)
+{
+	if (mode >= gop_mode.MaxMode || !size || !info)
+		return EFI_INVALID_PARAMETER;
+
+	if (EFI_ERROR(mockfw_allocate_pool(EfiBootServicesData,
+					   sizeof(gop_info), (VOID **)info)))
+		return EFI_OUT_OF_RESOURCES;
+	**info = gop_info;
+	*size = sizeof(gop_info);
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI set_mode(EFI_GRAPHICS_OUTPUT_PROTOCOL *this,
+				  UINT32 mode)
+{
+	if (mode >= gop_mode.MaxMode)
+		return EFI_UNSUPPORTED;
+
+	memset(framebuffer, 0, gop_mode.FrameBufferSize);
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI blt(EFI_GRAPHICS_OUTPUT_PROTOCOL *this,
+			     EFI_GRAPHICS_OUTPUT_BLT_PIXEL *buffer,
+			     EFI_GRAPHICS_OUTPUT_BLT_OPERATION op,
+			     UINTN src_x, UINTN src_y, UINTN dst_x, UINTN dst_y,
+			     UINTN width, UINTN height, UINTN delta)
+{
+	UINTN w = gop_info.HorizontalResolution;
+	UINTN h = gop_info.VerticalResolution;
+	UINTN stride = gop_info.PixelsPerScanLine;
+	UINTN x, y;
+
+	if (!width || !height)
+		return EFI_INVALID_PARAMETER;
+	if (!delta)
+		delta = width * sizeof(*buffer);
+
+	switch (op) {
+	case EfiBltVideoFill:
+		if (dst_x + width > w || dst_y + height > h)
+			return EFI_INVALID_PARAMETER;
+		for (y = 0; y < height; y++)
+			for (x = 0; x < width; x++)
+				framebuffer[(dst_y + y) * stride + dst_x + x] =
+					*buffer;
+		break;
+	case EfiBltVideoToBltBuffer:
+		if (src_x + width > w || src_y + height > h)
+			return EFI_INVALID_PARAMETER;
+		for (y = 0; y < height; y++)
+			memcpy((UINT8 *)buffer + (dst_y + y) * delta +
+			       dst_x * sizeof(*buffer),
+			       &framebuffer[(src_y + y) * stride + src_x],
+			       width * sizeof(*buffer));
+		break;
+	case EfiBltBufferToVideo:
+		if (dst_x + width > w || dst_y + height > h)
+			return EFI_INVALID_PARAMETER;
+		for (y = 0; y < height; y++)
+			memcpy(&framebuffer[(dst_y + y) * stride + dst_x],
+			       (UINT8 *)buffer + (src_y + y) * delta +
+			       src_x * sizeof(*buffer),
+			       width * sizeof(*buffer));
+		break;
+	case EfiBltVideoToVideo:
+		if (src_x + width > w || src_y + height > h ||
+		    dst_x + width > w || dst_y + height > h)
+			return EFI_INVALID_PARAMETER;
+		if (dst_y <= src_y) {
+			for (y = 0; y < height; y++)
+				memmove(&framebuffer[(dst_y + y) * stride + dst_x],
+					&framebuffer[(src_y + y) * stride + src_x],
+					width * sizeof(*buffer));
+		} else {
+			for (y = height; y-- > 0;)
+				memmove(&framebuffer[(dst_y + y) * stride + dst_x],
+					&framebuffer[(src_y + y) * stride + src_x],
+					width * sizeof(*buffer));
+		}
+		break;
+	default:
+		return EFI_INVALID_PARAMETER;
+	}
+
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS mockfw_gop_init(UINT32 width, UINT32 height)
+{
+	EFI_GUID gop_guid = EFI_GRAPHICS_OUTPUT_PROTOCOL_GUID;
+	EFI_HANDLE handle = NULL;
+	EFI_STATUS ret;
+
+	framebuffer = calloc((UINTN)width * height, sizeof(*framebuffer));
+	if (!framebuffer)
+		return EFI_OUT_OF_RESOURCES;
+
+	memset(&gop_info, 0, sizeof(gop_info));
+	gop_info.HorizontalResolution = width;
+	gop_info.VerticalResolution = height;
+	gop_info.PixelFormat = PixelBlueGreenRedReserved8BitPerColor;
+	gop_info.PixelsPerScanLine = width;
+
+	gop_mode.MaxMode = 1;
+	gop_mode.Mode = 0;
+	gop_mode.Info = &gop_info;
+	gop_mode.SizeOfInfo = sizeof(gop_info);
+	gop_mode.FrameBufferBase = (EFI_PHYSICAL_ADDRESS)(UINTN)framebuffer;
+	gop_mode.FrameBufferSize = (UINTN)width * height * sizeof(*framebuffer);
+
+	gop.QueryMode = query_mode;
+	gop.SetMode = set_mode;
+	gop.Blt = blt;
+	gop.Mode = &gop_mode;
+
+	ret = mockfw_install_protocol(&handle, &gop_guid, &gop);
+	if (EFI_ERROR(ret)) {
+		free(framebuffer);
+		framebuffer = NULL;
+	}
+	return ret;
+}
+
+void mockfw_gop_shutdown(void)
+{
+	free(framebuffer);
+	framebuffer = NULL;
+}
+
+int mockfw_gop_dump(const char *path)
+{
+	UINTN x, y;
+	FILE *f;
+
+	if (!framebuffer)
+		return -1;
+
+	f = fopen(path, "wb");
+	if (!f)
+		return -1;
+
+	fprintf(f, "P6\n%u %u\n255\n", gop_info.HorizontalResolution,
+		gop_info.VerticalResolution);
+	for (y = 0; y < gop_info.VerticalResolution; y++) {
+		for (x = 0; x < gop_info.HorizontalResolution; x++) {
+			EFI_GRAPHICS_OUTPUT_BLT_PIXEL *p =
+				&framebuffer[y * gop_info.PixelsPerScanLine + x];
+
+			fputc(p->Red, f);
+			fputc(p->Green, f);
+			fputc(p->Blue, f);
+		}
+	}
+
+	return fclose(f) ? -1 : 0;
+}
@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file simulates the firmware memory map. Conventional memory is
+ * a host mapping at its physical address, so that pointers and
+ * physical addresses are interchangeable as they are under UEFI.
+ * Pool allocations come from the host heap and do not appear in the
+ * memory map.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "mockfw_private.h"
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE	0x100000
+#endif
+
+#define MAX_REGIONS	512
+#define POOL_MAGIC	0x4c4f4f50434f4d00ULL
+
+struct region {
+	UINT32 type;
+	UINT64 start;
+	UINT64 pages;
+};
+
+struct pool_header {
+	UINT64 magic;
+	UINT64 size;
+};
+
+static struct region regions[MAX_REGIONS];
+static UINTN region_count;
+static UINTN map_key;
+static VOID *ram;
+static UINT64 ram_size;
+
+static UINT64 region_end(struct region *r)
+{
+	return r->start + r->pages * MOCKFW_PAGE_SIZE;
+}
+
+EFI_STATUS mockfw_memmap_init(UINT64 base, UINT64 size)
+{
+	if ((base | size) & (MOCKFW_PAGE_SIZE - 1))
+		return EFI_INVALID_PARAMETER;
+
+	ram = mmap((VOID *)base, size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE |
+		   MAP_FIXED_NOREPLACE, -1, 0);
+	if (ram == MAP_FAILED || ram != (VOID *)base) {
+		fprintf(stderr, "mockfw: cannot map RAM at 0x%llx-0x%llx\n",
+			(unsigned long long)base,
+			(unsigned long long)(base + size));
+		if (ram != MAP_FAILED)
+			munmap(ram, size);
+		ram = NULL;
+		return EFI_OUT_OF_RESOURCES;
+	}
+	ram_size = size;
+
+	regions[0].type = EfiConventionalMemory;
+	regions[0].start = base;
+	regions[0].pages = size / MOCKFW_PAGE_SIZE;
+	region_count = 1;
+	map_key = 1;
+	return EFI_SUCCESS;
+}
+
+void mockfw_memmap_shutdown(void)
+{
+	if (ram)
+		munmap(ram, ram_size);
+	ram = NULL;
+	region_count = 0;
+}
+
+static void coalesce(void)
+{
+	UINTN i = 0;
+
+	while (i + 1 < region_count) {
+		struct region *r = &regions[i];
+
+		if (r[0].type != r[1].type || region_end(r) != r[1].start) {
+			i++;
+			continue;
+		}
+		r[0].pages += r[1].pages;
+		memmove(&r[1], &r[2], (region_count - i - 2) * sizeof(*r));
+		region_count--;
+	}
+}
+
+static INTN find_region(UINT64 addr)
+{
+	UINTN i;
+
+	for (i = 0; i < region_count; i++)
+		if (addr >= regions[i].start && addr < region_end(&regions[i]))
+			return i;
+	return -1;
+}
+
+/* Retype [START, START + PAGES) which must lie within region I */
+static EFI_STATUS set_range(UINTN i, UINT64 start, UINT64 pages, UINT32 type)
+{
+	struct region r = regions[i];
+	UINT64 end = start + pages * MOCKFW_PAGE_SIZE;
+	UINTN extra = (start > r.start) + (end < region_end(&r));
+	UINTN n = i;
+
+	if (region_count + extra > MAX_REGIONS)
+		return EFI_OUT_OF_RESOURCES;
+
+	memmove(&regions[i + 1 + extra], &regions[i + 1],
+		(region_count - i - 1) * sizeof(r));
+	region_count += extra;
+
+	if (start > r.start) {
+		regions[n].type = r.type;
+		regions[n].start = r.start;
+		regions[n].pages = (start - r.start) / MOCKFW_PAGE_SIZE;
+		n++;
+	}
+	regions[n].type = type;
+	regions[n].start = start;
+	regions[n].pages = pages;
+	n++;
+	if (end < region_end(&r)) {
+		regions[n].type = r.type;
+		regions[n].start = end;
+		regions[n].pages = (region_end(&r) - end) / MOCKFW_PAGE_SIZE;
+	}
+
+	coalesce();
+	map_key++;
+	mockfw_stats.memory_map_changes++;
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI mockfw_allocate_pages(EFI_ALLOCATE_TYPE type,
+					EFI_MEMORY_TYPE memory_type,
+					UINTN pages, EFI_PHYSICAL_ADDRESS *memory)
+{
+	UINT64 size = pages * MOCKFW_PAGE_SIZE;
+	UINT64 addr = 0, max = ~0ULL;
+	EFI_STATUS ret;
+	INTN i;
+
+	if (mockfw_boot_services_exited)
+		return EFI_UNSUPPORTED;
+	if (!memory || !pages || memory_type == EfiConventionalMemory ||
+	    (memory_type >= EfiMaxMemoryType && memory_type < 0x80000000))
+		return EFI_INVALID_PARAMETER;
+
+	switch (type) {
+	case AllocateAddress:
+		addr = *memory;
+		if (addr & (MOCKFW_PAGE_SIZE - 1))
+			return EFI_INVALID_PARAMETER;
+		i = find_region(addr);
+		if (i < 0 || regions[i].type != EfiConventionalMemory ||
+		    addr + size > region_end(&regions[i]))
+			return EFI_NOT_FOUND;
+		break;
+	case AllocateMaxAddress:
+		max = *memory;
+		/* fall through */
+	case AllocateAnyPages:
+		/* Top-down, as most firmware implementations do */
+		for (i = region_count - 1; i >= 0; i--) {
+			UINT64 top = region_end(&regions[i]);
+
+			if (regions[i].type != EfiConventionalMemory)
+				continue;
+			if (max != ~0ULL && top > max + 1)
+				top = (max + 1) & ~(MOCKFW_PAGE_SIZE - 1);
+			if (top < regions[i].start + size)
+				continue;
+			addr = top - size;
+			break;
+		}
+		if (i < 0)
+			return EFI_OUT_OF_RESOURCES;
+		break;
+	default:
+		return EFI_INVALID_PARAMETER;
+	}
+
+	ret = set_range(i, addr, pages, memory_type);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	mockfw_stats.pages_allocated += pages;
+	if (mockfw_stats.pages_allocated > mockfw_stats.pages_peak)
+		mockfw_stats.pages_peak = mockfw_stats.pages_allocated;
+
+	*memory = addr;
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI mockfw_free_pages(EFI_PHYSICAL_ADDRESS memory, UINTN pages)
+{
+	EFI_STATUS ret;
+	INTN i;
+
+	if (memory & (MOCKFW_PAGE_SIZE - 1))
+		return EFI_INVALID_PARAMETER;
+
+	i = find_region(memory);
+	if (i < 0 || regions[i].type == EfiConventionalMemory ||
+	    memory + pages * MOCKFW_PAGE_SIZE > region_end(&regions[i]))
+		return EFI_NOT_FOUND;
+
+	ret = set_range(i, memory, pages, EfiConventionalMemory);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	mockfw_stats.pages_allocated -= pages;
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI mockfw_get_memory_map(UINTN *size, EFI_MEMORY_DESCRIPTOR *map,
+					UINTN *key, UINTN *desc_size,
+					UINT32 *desc_version)
+{
+	UINTN i, needed = region_count * sizeof(*map);
+
+	if (!size)
+		return EFI_INVALID_PARAMETER;
+	if (*size < needed) {
+		*size = needed;
+		return EFI_BUFFER_TOO_SMALL;
+	}
+	if (!map)
+		return EFI_INVALID_PARAMETER;
+
+	for (i = 0; i < region_count; i++) {
+		memset(&map[i], 0, sizeof(map[i]));
+		map[i].Type = regions[i].type;
+		map[i].PhysicalStart = regions[i].start;
+		map[i].NumberOfPages = regions[i].pages;
+		map[i].Attribute = EFI_MEMORY_WB;
+	}
+
+	*size = needed;
+	if (key)
+		*key = map_key;
+	if (desc_size)
+		*desc_size = sizeof(*map);
+	if (desc_version)
+		*desc_version = EFI_MEMORY_DESCRIPTOR_VERSION;
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI mockfw_allocate_pool(EFI_MEMORY_TYPE type, UINTN size,
+				       VOID **buffer)
+{
+	struct pool_header *hdr;
+
+	if (mockfw_boot_services_exited)
+		return EFI_UNSUPPORTED;
+	if (!buffer)
+		return EFI_INVALID_PARAMETER;
+
+	hdr = malloc(sizeof(*hdr) + size);
+	if (!hdr)
+		return EFI_OUT_OF_RESOURCES;
+
+	hdr->magic = POOL_MAGIC;
+	hdr->size = size;
+	mockfw_stats.pool_bytes += size;
+	if (mockfw_stats.pool_bytes > mockfw_stats.pool_peak)
+		mockfw_stats.pool_peak = mockfw_stats.pool_bytes;
+
+	*buffer = hdr + 1;
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI mockfw_free_pool(VOID *buffer)
+{
+	struct pool_header *hdr;
+
+	if (!buffer)
+		return EFI_INVALID_PARAMETER;
+
+	hdr = (struct pool_header *)buffer - 1;
+	if (hdr->magic != POOL_MAGIC) {
+		fprintf(stderr, "mockfw: FreePool of a non-pool buffer %p\n",
+			buffer);
+		abort();
+	}
+
+	hdr->magic = 0;
+	mockfw_stats.pool_bytes -= hdr->size;
+	free(hdr);
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI mockfw_exit_boot_services(EFI_HANDLE image, UINTN key)
+{
+	if (mockfw_boot_services_exited)
+		return EFI_INVALID_PARAMETER;
+	if (key != map_key)
+		return EFI_INVALID_PARAMETER;
+
+	mockfw_signal_exit_boot_services();
+	mockfw_boot_services_exited = TRUE;
+	return EFI_SUCCESS;
+}
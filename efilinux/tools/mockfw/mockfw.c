@@ -0,0 +1,1150 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file implements the mock firmware core: system table, boot
+ * services other than memory, events and timers, the handle database
+ * and the console.
+ */
+
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "mockfw_private.h"
+
+#define MAX_HANDLES		128
+#define MAX_PROTOCOLS		8
+#define MAX_EVENTS		64
+#define MAX_CONFIG_TABLES	16
+#define MAX_KEYS		32
+
+struct mockfw_config mockfw_config;
+struct mockfw_stats mockfw_stats;
+BOOLEAN mockfw_boot_services_exited;
+
+/*
+ * Clock
+ *
+ * The virtual clock is the host time elapsed since mockfw_init() plus
+ * every simulated cost that was not actually slept for.
+ */
+static UINT64 host_start_ns;
+static UINT64 charged_ns;
+
+static UINT64 host_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void fire_timers(void);
+
+UINT64 mockfw_now_ns(void)
+{
+	return host_ns() - host_start_ns + charged_ns;
+}
+
+static UINT64 next_deadline(void);
+
+void mockfw_advance_ns(UINT64 ns)
+{
+	UINT64 target = charged_ns + ns;
+
+	/*
+	 * Stop at every timer deadline on the way so that periodic
+	 * timers fire as many times as they would in real time.
+	 */
+	for (;;) {
+		UINT64 next = next_deadline();
+
+		if (next > mockfw_now_ns() - charged_ns + target)
+			break;
+		if (next > mockfw_now_ns())
+			charged_ns += next - mockfw_now_ns();
+		fire_timers();
+	}
+	charged_ns = target;
+	fire_timers();
+}
+
+void mockfw_charge_ns(UINT64 ns)
+{
+	if (mockfw_config.realtime) {
+		struct timespec ts = {
+			.tv_sec = ns / 1000000000ULL,
+			.tv_nsec = ns % 1000000000ULL,
+		};
+		nanosleep(&ts, NULL);
+		fire_timers();
+	} else {
+		mockfw_advance_ns(ns);
+	}
+}
+
+/*
+ * Events and task priority levels
+ */
+struct mock_event {
+	BOOLEAN used;
+	UINT32 type;
+	EFI_TPL tpl;
+	EFI_EVENT_NOTIFY notify;
+	VOID *context;
+	BOOLEAN signaled;
+	BOOLEAN pending;
+	EFI_TIMER_DELAY timer;
+	UINT64 period_ns;
+	UINT64 deadline_ns;
+};
+
+static struct mock_event events[MAX_EVENTS];
+static EFI_TPL current_tpl = TPL_APPLICATION;
+
+static void dispatch_pending(void)
+{
+	BOOLEAN again;
+	UINTN i;
+
+	do {
+		again = FALSE;
+		for (i = 0; i < MAX_EVENTS; i++) {
+			struct mock_event *ev = &events[i];
+			EFI_TPL saved;
+
+			if (!ev->used || !ev->pending || ev->tpl <= current_tpl)
+				continue;
+			ev->pending = FALSE;
+			ev->signaled = FALSE;
+			saved = current_tpl;
+			current_tpl = ev->tpl;
+			ev->notify(ev, ev->context);
+			current_tpl = saved;
+			again = TRUE;
+		}
+	} while (again);
+}
+
+static void signal_event(struct mock_event *ev)
+{
+	if (ev->signaled)
+		return;
+	ev->signaled = TRUE;
+	if ((ev->type & EVT_NOTIFY_SIGNAL) && ev->notify) {
+		ev->pending = TRUE;
+		dispatch_pending();
+	}
+}
+
+static void fire_timers(void)
+{
+	UINT64 now = mockfw_now_ns();
+	UINTN i;
+
+	for (i = 0; i < MAX_EVENTS; i++) {
+		struct mock_event *ev = &events[i];
+
+		if (!ev->used || ev->timer == TimerCancel || now < ev->deadline_ns)
+			continue;
+		if (ev->timer == TimerPeriodic) {
+			/* Missed periods are coalesced, like a real timer tick */
+			ev->deadline_ns += ((now - ev->deadline_ns) / ev->period_ns + 1) *
+				ev->period_ns;
+		} else {
+			ev->timer = TimerCancel;
+		}
+		signal_event(ev);
+	}
+}
+
+static UINT64 next_deadline(void)
+{
+	UINT64 next = ~0ULL;
+	UINTN i;
+
+	for (i = 0; i < MAX_EVENTS; i++)
+		if (events[i].used && events[i].timer != TimerCancel &&
+		    events[i].deadline_ns < next)
+			next = events[i].deadline_ns;
+	return next;
+}
+
+static EFI_TPL EFIAPI raise_tpl(EFI_TPL tpl)
+{
+	EFI_TPL old = current_tpl;
+
+	current_tpl = tpl;
+	return old;
+}
+
+static VOID EFIAPI restore_tpl(EFI_TPL tpl)
+{
+	current_tpl = tpl;
+	fire_timers();
+	dispatch_pending();
+}
+
+static EFI_STATUS EFIAPI create_event(UINT32 type, EFI_TPL tpl,
+				      EFI_EVENT_NOTIFY notify, VOID *context,
+				      EFI_EVENT *event)
+{
+	UINTN i;
+
+	if (!event)
+		return EFI_INVALID_PARAMETER;
+	if ((type & (EVT_NOTIFY_SIGNAL | EVT_NOTIFY_WAIT)) && !notify)
+		return EFI_INVALID_PARAMETER;
+
+	for (i = 0; i < MAX_EVENTS; i++) {
+		if (events[i].used)
+			continue;
+		memset(&events[i], 0, sizeof(events[i]));
+		events[i].used = TRUE;
+		events[i].type = type;
+		events[i].tpl = tpl;
+		events[i].notify = notify;
+		events[i].context = context;
+		events[i].timer = TimerCancel;
+		*event = &events[i];
+		return EFI_SUCCESS;
+	}
+
+	return EFI_OUT_OF_RESOURCES;
+}
+
+static EFI_STATUS EFIAPI set_timer(EFI_EVENT event, EFI_TIMER_DELAY type,
+				   UINT64 trigger)
+{
+	struct mock_event *ev = event;
+
+	if (!ev || !ev->used || !(ev->type & EVT_TIMER))
+		return EFI_INVALID_PARAMETER;
+
+	ev->timer = type;
+	/* TriggerTime is in 100ns units, 0 means the next timer tick */
+	ev->period_ns = trigger ? trigger * 100 : 1000000;
+	ev->deadline_ns = mockfw_now_ns() + ev->period_ns;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI signal_event_api(EFI_EVENT event)
+{
+	struct mock_event *ev = event;
+
+	if (!ev || !ev->used)
+		return EFI_INVALID_PARAMETER;
+	signal_event(ev);
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI close_event(EFI_EVENT event)
+{
+	struct mock_event *ev = event;
+
+	if (!ev || !ev->used)
+		return EFI_INVALID_PARAMETER;
+	ev->used = FALSE;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI check_event(EFI_EVENT event)
+{
+	struct mock_event *ev = event;
+
+	if (!ev || !ev->used || (ev->type & EVT_NOTIFY_SIGNAL))
+		return EFI_INVALID_PARAMETER;
+
+	fire_timers();
+	if (!ev->signaled && (ev->type & EVT_NOTIFY_WAIT))
+		ev->notify(ev, ev->context);
+	if (!ev->signaled)
+		return EFI_NOT_READY;
+	ev->signaled = FALSE;
+	return EFI_SUCCESS;
+}
+
+/*
+ * Nothing else runs while the loader waits, so waiting skips the
+ * virtual clock to the next timer deadline. A wait that no armed
+ * timer can ever satisfy fails instead of hanging the host.
+ */
+static EFI_STATUS EFIAPI wait_for_event(UINTN count, EFI_EVENT *list,
+					UINTN *index)
+{
+	UINTN i;
+
+	if (current_tpl != TPL_APPLICATION)
+		return EFI_UNSUPPORTED;
+
+	for (;;) {
+		UINT64 next;
+
+		for (i = 0; i < count; i++) {
+			EFI_STATUS ret = check_event(list[i]);
+
+			if (ret == EFI_SUCCESS) {
+				*index = i;
+				return EFI_SUCCESS;
+			}
+			if (ret != EFI_NOT_READY) {
+				*index = i;
+				return ret;
+			}
+		}
+
+		next = next_deadline();
+		if (next == ~0ULL) {
+			fprintf(stderr, "mockfw: WaitForEvent would never return\n");
+			return EFI_DEVICE_ERROR;
+		}
+		if (next > mockfw_now_ns())
+			mockfw_advance_ns(next - mockfw_now_ns());
+	}
+}
+
+void mockfw_signal_exit_boot_services(void)
+{
+	UINTN i;
+
+	for (i = 0; i < MAX_EVENTS; i++)
+		if (events[i].used &&
+		    events[i].type == EVT_SIGNAL_EXIT_BOOT_SERVICES)
+			signal_event(&events[i]);
+}
+
+/*
+ * Handle database
+ */
+struct mock_handle {
+	BOOLEAN used;
+	UINTN count;
+	struct {
+		EFI_GUID guid;
+		VOID *interface;
+	} protocols[MAX_PROTOCOLS];
+};
+
+static struct mock_handle handles[MAX_HANDLES];
+
+static BOOLEAN guid_equal(EFI_GUID *a, EFI_GUID *b)
+{
+	return !memcmp(a, b, sizeof(*a));
+}
+
+static struct mock_handle *to_handle(EFI_HANDLE handle)
+{
+	struct mock_handle *h = handle;
+
+	if (h < handles || h >= handles + MAX_HANDLES || !h->used)
+		return NULL;
+	return h;
+}
+
+static VOID *find_protocol(struct mock_handle *h, EFI_GUID *guid)
+{
+	UINTN i;
+
+	for (i = 0; i < h->count; i++)
+		if (guid_equal(&h->protocols[i].guid, guid))
+			return h->protocols[i].interface;
+	return NULL;
+}
+
+static EFI_STATUS EFIAPI install_protocol(EFI_HANDLE *handle, EFI_GUID *guid,
+					  EFI_INTERFACE_TYPE type,
+					  VOID *interface)
+{
+	struct mock_handle *h;
+	UINTN i;
+
+	if (!handle || !guid || type != EFI_NATIVE_INTERFACE)
+		return EFI_INVALID_PARAMETER;
+
+	if (*handle) {
+		h = to_handle(*handle);
+		if (!h)
+			return EFI_INVALID_PARAMETER;
+	} else {
+		for (i = 0; i < MAX_HANDLES && handles[i].used; i++)
+			;
+		if (i == MAX_HANDLES)
+			return EFI_OUT_OF_RESOURCES;
+		h = &handles[i];
+		memset(h, 0, sizeof(*h));
+		h->used = TRUE;
+	}
+
+	if (find_protocol(h, guid))
+		return EFI_INVALID_PARAMETER;
+	if (h->count == MAX_PROTOCOLS)
+		return EFI_OUT_OF_RESOURCES;
+
+	h->protocols[h->count].guid = *guid;
+	h->protocols[h->count].interface = interface;
+	h->count++;
+	*handle = h;
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS mockfw_install_protocol(EFI_HANDLE *handle, EFI_GUID *guid,
+				   VOID *interface)
+{
+	return install_protocol(handle, guid, EFI_NATIVE_INTERFACE, interface);
+}
+
+static EFI_STATUS EFIAPI uninstall_protocol(EFI_HANDLE handle, EFI_GUID *guid,
+					    VOID *interface)
+{
+	struct mock_handle *h = to_handle(handle);
+	UINTN i;
+
+	if (!h || !guid)
+		return EFI_INVALID_PARAMETER;
+
+	for (i = 0; i < h->count; i++) {
+		if (!guid_equal(&h->protocols[i].guid, guid) ||
+		    h->protocols[i].interface != interface)
+			continue;
+		memmove(&h->protocols[i], &h->protocols[i + 1],
+			(h->count - i - 1) * sizeof(h->protocols[0]));
+		if (--h->count == 0)
+			h->used = FALSE;
+		return EFI_SUCCESS;
+	}
+
+	return EFI_NOT_FOUND;
+}
+
+static EFI_STATUS EFIAPI handle_protocol(EFI_HANDLE handle, EFI_GUID *guid,
+					 VOID **interface)
+{
+	struct mock_handle *h = to_handle(handle);
+
+	if (!h || !guid || !interface)
+		return EFI_INVALID_PARAMETER;
+
+	*interface = find_protocol(h, guid);
+	return *interface ? EFI_SUCCESS : EFI_UNSUPPORTED;
+}
+
+static EFI_STATUS EFIAPI open_protocol(EFI_HANDLE handle, EFI_GUID *guid,
+				       VOID **interface, EFI_HANDLE agent,
+				       EFI_HANDLE controller, UINT32 attributes)
+{
+	VOID *dummy;
+
+	return handle_protocol(handle, guid, interface ? interface : &dummy);
+}
+
+static EFI_STATUS EFIAPI close_protocol(EFI_HANDLE handle, EFI_GUID *guid,
+					EFI_HANDLE agent, EFI_HANDLE controller)
+{
+	struct mock_handle *h = to_handle(handle);
+
+	if (!h || !guid)
+		return EFI_INVALID_PARAMETER;
+	return find_protocol(h, guid) ? EFI_SUCCESS : EFI_NOT_FOUND;
+}
+
+static UINTN collect_handles(EFI_LOCATE_SEARCH_TYPE type, EFI_GUID *guid,
+			     EFI_HANDLE *buffer, UINTN max)
+{
+	UINTN i, n = 0;
+
+	for (i = 0; i < MAX_HANDLES; i++) {
+		if (!handles[i].used)
+			continue;
+		if (type == ByProtocol && !find_protocol(&handles[i], guid))
+			continue;
+		if (n < max)
+			buffer[n] = &handles[i];
+		n++;
+	}
+
+	return n;
+}
+
+static EFI_STATUS EFIAPI locate_handle(EFI_LOCATE_SEARCH_TYPE type,
+				       EFI_GUID *guid, VOID *key,
+				       UINTN *size, EFI_HANDLE *buffer)
+{
+	UINTN n;
+
+	if (!size || (type == ByProtocol && !guid))
+		return EFI_INVALID_PARAMETER;
+	if (type != AllHandles && type != ByProtocol)
+		return EFI_UNSUPPORTED;
+
+	n = collect_handles(type, guid, buffer, *size / sizeof(EFI_HANDLE));
+	if (!n)
+		return EFI_NOT_FOUND;
+	if (*size < n * sizeof(EFI_HANDLE)) {
+		*size = n * sizeof(EFI_HANDLE);
+		return EFI_BUFFER_TOO_SMALL;
+	}
+	*size = n * sizeof(EFI_HANDLE);
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI locate_handle_buffer(EFI_LOCATE_SEARCH_TYPE type,
+					      EFI_GUID *guid, VOID *key,
+					      UINTN *count, EFI_HANDLE **buffer)
+{
+	EFI_STATUS ret;
+	UINTN size = 0;
+
+	if (!count || !buffer)
+		return EFI_INVALID_PARAMETER;
+
+	ret = locate_handle(type, guid, key, &size, NULL);
+	if (ret != EFI_BUFFER_TOO_SMALL)
+		return ret;
+
+	ret = mockfw_allocate_pool(EfiBootServicesData, size, (VOID **)buffer);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	ret = locate_handle(type, guid, key, &size, *buffer);
+	*count = size / sizeof(EFI_HANDLE);
+	return ret;
+}
+
+static EFI_STATUS EFIAPI locate_protocol(EFI_GUID *guid, VOID *registration,
+					 VOID **interface)
+{
+	UINTN i;
+
+	if (!guid || !interface)
+		return EFI_INVALID_PARAMETER;
+
+	for (i = 0; i < MAX_HANDLES; i++) {
+		if (!handles[i].used)
+			continue;
+		*interface = find_protocol(&handles[i], guid);
+		if (*interface)
+			return EFI_SUCCESS;
+	}
+
+	return EFI_NOT_FOUND;
+}
+
+static UINTN device_path_size(EFI_DEVICE_PATH *path)
+{
+	EFI_DEVICE_PATH *node = path;
+
+	while (!IsDevicePathEnd(node))
+		node = NextDevicePathNode(node);
+	return (UINT8 *)node - (UINT8 *)path;
+}
+
+/* Pick the handle whose device path is the longest prefix of PATH */
+static EFI_STATUS EFIAPI locate_device_path(EFI_GUID *guid,
+					    EFI_DEVICE_PATH **path,
+					    EFI_HANDLE *device)
+{
+	EFI_GUID dp_guid = DEVICE_PATH_PROTOCOL;
+	UINTN i, best_size = 0, path_size;
+	struct mock_handle *best = NULL;
+
+	if (!guid || !path || !*path || !device)
+		return EFI_INVALID_PARAMETER;
+
+	path_size = device_path_size(*path);
+	for (i = 0; i < MAX_HANDLES; i++) {
+		EFI_DEVICE_PATH *dp;
+		UINTN size;
+
+		if (!handles[i].used || !find_protocol(&handles[i], guid))
+			continue;
+		dp = find_protocol(&handles[i], &dp_guid);
+		if (!dp)
+			continue;
+		size = device_path_size(dp);
+		if (size > path_size || size < best_size || memcmp(dp, *path, size))
+			continue;
+		best = &handles[i];
+		best_size = size;
+	}
+
+	if (!best)
+		return EFI_NOT_FOUND;
+
+	*device = best;
+	*path = (EFI_DEVICE_PATH *)((UINT8 *)*path + best_size);
+	return EFI_SUCCESS;
+}
+
+/*
+ * Miscellaneous boot services
+ */
+static jmp_buf run_env;
+static BOOLEAN running;
+static EFI_STATUS exit_status;
+
+static EFI_STATUS EFIAPI exit_image(EFI_HANDLE image, EFI_STATUS status,
+				    UINTN size, CHAR16 *data)
+{
+	if (!running)
+		return EFI_INVALID_PARAMETER;
+	exit_status = status;
+	longjmp(run_env, MOCKFW_EXIT_EXIT);
+}
+
+void mockfw_hook_before_jump(void)
+{
+	if (!running) {
+		fprintf(stderr, "mockfw: kernel jump outside of mockfw_run()\n");
+		abort();
+	}
+	exit_status = EFI_SUCCESS;
+	longjmp(run_env, MOCKFW_EXIT_JUMP);
+}
+
+static EFI_STATUS EFIAPI stall(UINTN us)
+{
+	mockfw_stats.stall_ns += us * 1000ULL;
+	mockfw_charge_ns(us * 1000ULL);
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI set_watchdog_timer(UINTN timeout, UINT64 code,
+					    UINTN size, CHAR16 *data)
+{
+	return EFI_SUCCESS;
+}
+
+static UINT64 monotonic_count;
+
+static EFI_STATUS EFIAPI get_next_monotonic_count(UINT64 *count)
+{
+	if (!count)
+		return EFI_INVALID_PARAMETER;
+	*count = monotonic_count++;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI connect_controller(EFI_HANDLE controller,
+					    EFI_HANDLE *driver,
+					    EFI_DEVICE_PATH *remaining,
+					    BOOLEAN recursive)
+{
+	return to_handle(controller) ? EFI_SUCCESS : EFI_INVALID_PARAMETER;
+}
+
+static EFI_STATUS EFIAPI calculate_crc32(VOID *data, UINTN size, UINT32 *crc)
+{
+	UINT32 c = 0xffffffff;
+	UINT8 *p = data;
+	int k;
+
+	if (!data || !size || !crc)
+		return EFI_INVALID_PARAMETER;
+
+	while (size--) {
+		c ^= *p++;
+		for (k = 0; k < 8; k++)
+			c = (c >> 1) ^ (0xedb88320 & -(c & 1));
+	}
+	*crc = ~c;
+	return EFI_SUCCESS;
+}
+
+static VOID EFIAPI copy_mem(VOID *dst, VOID *src, UINTN size)
+{
+	memmove(dst, src, size);
+}
+
+static VOID EFIAPI set_mem(VOID *buffer, UINTN size, UINT8 value)
+{
+	memset(buffer, value, size);
+}
+
+EFI_STATUS EFIAPI mockfw_unsupported(void)
+{
+	return EFI_UNSUPPORTED;
+}
+
+/*
+ * Configuration tables
+ */
+static EFI_CONFIGURATION_TABLE config_tables[MAX_CONFIG_TABLES];
+
+static EFI_SYSTEM_TABLE system_table;
+
+static EFI_STATUS EFIAPI install_configuration_table(EFI_GUID *guid,
+						     VOID *table)
+{
+	UINTN i, n = system_table.NumberOfTableEntries;
+
+	if (!guid)
+		return EFI_INVALID_PARAMETER;
+
+	for (i = 0; i < n; i++)
+		if (guid_equal(&config_tables[i].VendorGuid, guid))
+			break;
+
+	if (!table) {
+		if (i == n)
+			return EFI_NOT_FOUND;
+		config_tables[i] = config_tables[n - 1];
+		system_table.NumberOfTableEntries--;
+		return EFI_SUCCESS;
+	}
+
+	if (i == MAX_CONFIG_TABLES)
+		return EFI_OUT_OF_RESOURCES;
+	config_tables[i].VendorGuid = *guid;
+	config_tables[i].VendorTable = table;
+	if (i == n)
+		system_table.NumberOfTableEntries++;
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS mockfw_install_table(EFI_GUID *guid, VOID *table)
+{
+	return install_configuration_table(guid, table);
+}
+
+/*
+ * Console
+ */
+static EFI_STATUS EFIAPI output_string(SIMPLE_TEXT_OUTPUT_INTERFACE *this,
+				       CHAR16 *str)
+{
+	if (mockfw_config.quiet)
+		return EFI_SUCCESS;
+
+	/* Non-ASCII characters are not needed for loader logs */
+	for (; *str; str++) {
+		if (*str == '\r')
+			continue;
+		putchar(*str < 0x80 ? *str : '?');
+	}
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI text_reset(SIMPLE_TEXT_OUTPUT_INTERFACE *this,
+				    BOOLEAN extended)
+{
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI text_set_attribute(SIMPLE_TEXT_OUTPUT_INTERFACE *this,
+					    UINTN attribute)
+{
+	this->Mode->Attribute = attribute;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI text_clear_screen(SIMPLE_TEXT_OUTPUT_INTERFACE *this)
+{
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI text_enable_cursor(SIMPLE_TEXT_OUTPUT_INTERFACE *this,
+					    BOOLEAN visible)
+{
+	this->Mode->CursorVisible = visible;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI text_query_mode(SIMPLE_TEXT_OUTPUT_INTERFACE *this,
+					 UINTN mode, UINTN *columns,
+					 UINTN *rows)
+{
+	if (mode != 0)
+		return EFI_UNSUPPORTED;
+	*columns = 80;
+	*rows = 25;
+	return EFI_SUCCESS;
+}
+
+static SIMPLE_TEXT_OUTPUT_MODE text_mode = {
+	.MaxMode = 1,
+	.CursorVisible = TRUE,
+};
+
+static SIMPLE_TEXT_OUTPUT_INTERFACE text_out;
+
+static EFI_INPUT_KEY keys[MAX_KEYS];
+static UINTN key_head, key_count;
+
+void mockfw_push_key(UINT16 scan_code, CHAR16 unicode_char)
+{
+	if (key_count == MAX_KEYS)
+		return;
+	keys[(key_head + key_count) % MAX_KEYS].ScanCode = scan_code;
+	keys[(key_head + key_count) % MAX_KEYS].UnicodeChar = unicode_char;
+	key_count++;
+}
+
+static EFI_STATUS EFIAPI input_reset(SIMPLE_INPUT_INTERFACE *this,
+				     BOOLEAN extended)
+{
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI read_key_stroke(SIMPLE_INPUT_INTERFACE *this,
+					 EFI_INPUT_KEY *key)
+{
+	if (!key_count)
+		return EFI_NOT_READY;
+	*key = keys[key_head];
+	key_head = (key_head + 1) % MAX_KEYS;
+	key_count--;
+	return EFI_SUCCESS;
+}
+
+static VOID EFIAPI wait_for_key_notify(EFI_EVENT event, VOID *context)
+{
+	if (key_count)
+		signal_event(event);
+}
+
+static SIMPLE_INPUT_INTERFACE text_in;
+
+/*
+ * Runtime services other than variables
+ */
+static EFI_STATUS EFIAPI get_time(EFI_TIME *time, EFI_TIME_CAPABILITIES *cap)
+{
+	struct timespec ts;
+	struct tm tm;
+
+	if (!time)
+		return EFI_INVALID_PARAMETER;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	gmtime_r(&ts.tv_sec, &tm);
+	memset(time, 0, sizeof(*time));
+	time->Year = tm.tm_year + 1900;
+	time->Month = tm.tm_mon + 1;
+	time->Day = tm.tm_mday;
+	time->Hour = tm.tm_hour;
+	time->Minute = tm.tm_min;
+	time->Second = tm.tm_sec;
+	time->Nanosecond = ts.tv_nsec;
+	time->TimeZone = EFI_UNSPECIFIED_TIMEZONE;
+
+	if (cap) {
+		cap->Resolution = 1;
+		cap->Accuracy = 50000000;
+		cap->SetsToZero = FALSE;
+	}
+	return EFI_SUCCESS;
+}
+
+static VOID EFIAPI reset_system(EFI_RESET_TYPE type, EFI_STATUS status,
+				UINTN size, CHAR16 *data)
+{
+	if (!running) {
+		fprintf(stderr, "mockfw: reset outside of mockfw_run()\n");
+		abort();
+	}
+	exit_status = status;
+	longjmp(run_env, MOCKFW_EXIT_RESET);
+}
+
+static EFI_STATUS EFIAPI get_next_high_monotonic_count(UINT32 *count)
+{
+	if (!count)
+		return EFI_INVALID_PARAMETER;
+	monotonic_count += 1ULL << 32;
+	*count = monotonic_count >> 32;
+	return EFI_SUCCESS;
+}
+
+/*
+ * Tables
+ */
+static EFI_BOOT_SERVICES boot_services;
+static EFI_RUNTIME_SERVICES runtime_services;
+static EFI_LOADED_IMAGE loaded_image;
+static EFI_HANDLE image_handle;
+
+static void init_boot_services(void)
+{
+	EFI_BOOT_SERVICES *bs = &boot_services;
+
+	memset(bs, 0, sizeof(*bs));
+	bs->Hdr.Signature = EFI_BOOT_SERVICES_SIGNATURE;
+	bs->Hdr.Revision = EFI_BOOT_SERVICES_REVISION;
+	bs->Hdr.HeaderSize = sizeof(*bs);
+
+	bs->RaiseTPL = raise_tpl;
+	bs->RestoreTPL = restore_tpl;
+	bs->AllocatePages = mockfw_allocate_pages;
+	bs->FreePages = mockfw_free_pages;
+	bs->GetMemoryMap = mockfw_get_memory_map;
+	bs->AllocatePool = mockfw_allocate_pool;
+	bs->FreePool = mockfw_free_pool;
+	bs->CreateEvent = create_event;
+	bs->SetTimer = set_timer;
+	bs->WaitForEvent = wait_for_event;
+	bs->SignalEvent = signal_event_api;
+	bs->CloseEvent = close_event;
+	bs->CheckEvent = check_event;
+	bs->InstallProtocolInterface = install_protocol;
+	bs->ReinstallProtocolInterface = (VOID *)mockfw_unsupported;
+	bs->UninstallProtocolInterface = uninstall_protocol;
+	bs->HandleProtocol = handle_protocol;
+	bs->PCHandleProtocol = handle_protocol;
+	bs->RegisterProtocolNotify = (VOID *)mockfw_unsupported;
+	bs->LocateHandle = locate_handle;
+	bs->LocateDevicePath = locate_device_path;
+	bs->InstallConfigurationTable = install_configuration_table;
+	bs->LoadImage = (VOID *)mockfw_unsupported;
+	bs->StartImage = (VOID *)mockfw_unsupported;
+	bs->Exit = exit_image;
+	bs->UnloadImage = (VOID *)mockfw_unsupported;
+	bs->ExitBootServices = mockfw_exit_boot_services;
+	bs->GetNextMonotonicCount = get_next_monotonic_count;
+	bs->Stall = stall;
+	bs->SetWatchdogTimer = set_watchdog_timer;
+	bs->ConnectController = connect_controller;
+	bs->DisconnectController = (VOID *)mockfw_unsupported;
+	bs->OpenProtocol = open_protocol;
+	bs->CloseProtocol = close_protocol;
+	bs->OpenProtocolInformation = (VOID *)mockfw_unsupported;
+	bs->ProtocolsPerHandle = (VOID *)mockfw_unsupported;
+	bs->LocateHandleBuffer = locate_handle_buffer;
+	bs->LocateProtocol = locate_protocol;
+	bs->InstallMultipleProtocolInterfaces = (VOID *)mockfw_unsupported;
+	bs->UninstallMultipleProtocolInterfaces = (VOID *)mockfw_unsupported;
+	bs->CalculateCrc32 = calculate_crc32;
+	bs->CopyMem = copy_mem;
+	bs->SetMem = set_mem;
+	bs->CreateEventEx = (VOID *)mockfw_unsupported;
+}
+
+static void init_runtime_services(void)
+{
+	EFI_RUNTIME_SERVICES *rt = &runtime_services;
+
+	memset(rt, 0, sizeof(*rt));
+	rt->Hdr.Signature = EFI_RUNTIME_SERVICES_SIGNATURE;
+	rt->Hdr.Revision = EFI_RUNTIME_SERVICES_REVISION;
+	rt->Hdr.HeaderSize = sizeof(*rt);
+
+	rt->GetTime = get_time;
+	rt->SetTime = (VOID *)mockfw_unsupported;
+	rt->GetWakeupTime = (VOID *)mockfw_unsupported;
+	rt->SetWakeupTime = (VOID *)mockfw_unsupported;
+	rt->SetVirtualAddressMap = (VOID *)mockfw_unsupported;
+	rt->ConvertPointer = (VOID *)mockfw_unsupported;
+	rt->GetVariable = mockfw_get_variable;
+	rt->GetNextVariableName = mockfw_get_next_variable_name;
+	rt->SetVariable = mockfw_set_variable;
+	rt->GetNextHighMonotonicCount = get_next_high_monotonic_count;
+	rt->ResetSystem = reset_system;
+}
+
+static EFI_STATUS init_console(void)
+{
+	EFI_GUID text_in_guid = SIMPLE_TEXT_INPUT_PROTOCOL;
+	EFI_GUID text_out_guid = SIMPLE_TEXT_OUTPUT_PROTOCOL;
+	EFI_HANDLE handle = NULL;
+	EFI_STATUS ret;
+
+	text_out.Reset = text_reset;
+	text_out.OutputString = output_string;
+	text_out.TestString = (VOID *)mockfw_unsupported;
+	text_out.QueryMode = text_query_mode;
+	text_out.SetMode = (VOID *)mockfw_unsupported;
+	text_out.SetAttribute = text_set_attribute;
+	text_out.ClearScreen = text_clear_screen;
+	text_out.SetCursorPosition = (VOID *)mockfw_unsupported;
+	text_out.EnableCursor = text_enable_cursor;
+	text_out.Mode = &text_mode;
+
+	text_in.Reset = input_reset;
+	text_in.ReadKeyStroke = read_key_stroke;
+	ret = create_event(EVT_NOTIFY_WAIT, TPL_NOTIFY, wait_for_key_notify,
+			   NULL, &text_in.WaitForKey);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	ret = install_protocol(&handle, &text_in_guid, EFI_NATIVE_INTERFACE,
+			       &text_in);
+	if (EFI_ERROR(ret))
+		return ret;
+	ret = install_protocol(&handle, &text_out_guid, EFI_NATIVE_INTERFACE,
+			       &text_out);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	system_table.ConsoleInHandle = handle;
+	system_table.ConIn = &text_in;
+	system_table.ConsoleOutHandle = handle;
+	system_table.ConOut = &text_out;
+	system_table.StandardErrorHandle = handle;
+	system_table.StdErr = &text_out;
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS init_image(void)
+{
+	EFI_GUID loaded_image_guid = LOADED_IMAGE_PROTOCOL;
+
+	memset(&loaded_image, 0, sizeof(loaded_image));
+	loaded_image.Revision = EFI_IMAGE_INFORMATION_REVISION;
+	loaded_image.SystemTable = &system_table;
+	loaded_image.ImageCodeType = EfiLoaderCode;
+	loaded_image.ImageDataType = EfiLoaderData;
+	if (mockfw_config.load_options) {
+		CHAR16 *p = mockfw_config.load_options;
+
+		while (*p)
+			p++;
+		loaded_image.LoadOptions = mockfw_config.load_options;
+		loaded_image.LoadOptionsSize =
+			(p - mockfw_config.load_options + 1) * sizeof(CHAR16);
+	}
+
+	image_handle = NULL;
+	return install_protocol(&image_handle, &loaded_image_guid,
+				EFI_NATIVE_INTERFACE, &loaded_image);
+}
+
+EFI_HANDLE mockfw_image_handle(void)
+{
+	return image_handle;
+}
+
+EFI_SYSTEM_TABLE *mockfw_system_table(void)
+{
+	return &system_table;
+}
+
+EFI_STATUS mockfw_init(const struct mockfw_config *config)
+{
+	EFI_STATUS ret;
+
+	memset(&mockfw_config, 0, sizeof(mockfw_config));
+	if (config)
+		mockfw_config = *config;
+	if (!mockfw_config.ram_size) {
+		mockfw_config.ram_base = MOCKFW_DEFAULT_RAM_BASE;
+		mockfw_config.ram_size = MOCKFW_DEFAULT_RAM_SIZE;
+	}
+
+	memset(&mockfw_stats, 0, sizeof(mockfw_stats));
+	memset(handles, 0, sizeof(handles));
+	memset(events, 0, sizeof(events));
+	host_start_ns = host_ns();
+	charged_ns = 0;
+	current_tpl = TPL_APPLICATION;
+	mockfw_boot_services_exited = FALSE;
+	key_head = key_count = 0;
+
+	init_boot_services();
+	init_runtime_services();
+
+	memset(&system_table, 0, sizeof(system_table));
+	system_table.Hdr.Signature = EFI_SYSTEM_TABLE_SIGNATURE;
+	system_table.Hdr.Revision = EFI_SYSTEM_TABLE_REVISION;
+	system_table.Hdr.HeaderSize = sizeof(system_table);
+	system_table.FirmwareVendor = L"mockfw";
+	system_table.FirmwareRevision = 0x10000;
+	system_table.BootServices = &boot_services;
+	system_table.RuntimeServices = &runtime_services;
+	system_table.ConfigurationTable = config_tables;
+
+	ret = mockfw_memmap_init(mockfw_config.ram_base, mockfw_config.ram_size);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	ret = init_console();
+	if (EFI_ERROR(ret))
+		goto out;
+
+	ret = init_image();
+	if (EFI_ERROR(ret))
+		goto out;
+
+	ret = mockfw_variables_init(mockfw_config.var_store);
+	if (EFI_ERROR(ret))
+		goto out;
+
+	if (mockfw_config.fb_width && mockfw_config.fb_height) {
+		ret = mockfw_gop_init(mockfw_config.fb_width,
+				      mockfw_config.fb_height);
+		if (EFI_ERROR(ret))
+			goto out;
+	}
+
+	return EFI_SUCCESS;
+
+out:
+	mockfw_shutdown();
+	return ret;
+}
+
+void mockfw_shutdown(void)
+{
+	mockfw_gop_shutdown();
+	mockfw_disks_shutdown();
+	mockfw_variables_shutdown();
+	mockfw_memmap_shutdown();
+	fflush(stdout);
+}
+
+enum mockfw_exit mockfw_run(mockfw_entry_t entry, EFI_STATUS *status)
+{
+	enum mockfw_exit reason;
+
+	reason = setjmp(run_env);
+	if (reason == MOCKFW_EXIT_RETURN) {
+		running = TRUE;
+		exit_status = entry(image_handle, &system_table);
+	}
+	running = FALSE;
+	fflush(stdout);
+
+	if (status)
+		*status = exit_status;
+	return reason;
+}
+
+void mockfw_get_stats(struct mockfw_stats *stats)
+{
+	*stats = mockfw_stats;
+}
+
+void mockfw_reset_stats(void)
+{
+	UINT64 pages = mockfw_stats.pages_allocated;
+	UINT64 pool = mockfw_stats.pool_bytes;
+
+	memset(&mockfw_stats, 0, sizeof(mockfw_stats));
+	mockfw_stats.pages_allocated = mockfw_stats.pages_peak = pages;
+	mockfw_stats.pool_bytes = mockfw_stats.pool_peak = pool;
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file declares a mock UEFI firmware for the Linux host. It
+ * provides system, boot services and runtime services tables so that
+ * loader sources can be linked and run off-target, for benchmarks and
+ * debugging. Simulated costs (disk transfers, NV variable writes,
+ * stalls) advance a virtual clock that benchmarks can read back.
+ */
+
+#ifndef __MOCKFW_H__
+#define __MOCKFW_H__
+
+#include <efi.h>
+#include <efilib.h>
+
+#define MOCKFW_DEFAULT_RAM_BASE		0x100000ULL
+#define MOCKFW_DEFAULT_RAM_SIZE		(512ULL << 20)
+
+struct mockfw_config {
+	/* Identity mapped conventional memory handed out by AllocatePages */
+	UINT64 ram_base;
+	UINT64 ram_size;
+	/* Variable store file, NULL for a store that lives in memory only */
+	const char *var_store;
+	/* Cost of a non-volatile SetVariable: fixed part and per byte */
+	UINT64 nv_write_ns;
+	UINT64 nv_write_ns_per_kb;
+	/* Framebuffer size, 0 to not install a GOP */
+	UINT32 fb_width;
+	UINT32 fb_height;
+	/* Actually sleep for the simulated latencies */
+	BOOLEAN realtime;
+	/* Discard console output */
+	BOOLEAN quiet;
+	/* Loaded image options, the loader command line */
+	CHAR16 *load_options;
+};
+
+struct mockfw_disk_model {
+	/* Fixed cost of each request */
+	UINT64 latency_ns;
+	/* Transfer rate in bytes per second, 0 for instantaneous */
+	UINT64 bandwidth;
+};
+
+struct mockfw_stats {
+	UINT64 disk_reads;
+	UINT64 disk_read_bytes;
+	UINT64 disk_writes;
+	UINT64 disk_write_bytes;
+	UINT64 disk_ns;
+	UINT64 var_reads;
+	UINT64 var_writes;
+	UINT64 nv_writes;
+	UINT64 nv_ns;
+	UINT64 stall_ns;
+	UINT64 pages_allocated;
+	UINT64 pages_peak;
+	UINT64 pool_bytes;
+	UINT64 pool_peak;
+	UINT64 memory_map_changes;
+};
+
+enum mockfw_exit {
+	MOCKFW_EXIT_RETURN,	/* the entry point returned */
+	MOCKFW_EXIT_EXIT,	/* BS->Exit() was called */
+	MOCKFW_EXIT_JUMP,	/* mockfw_hook_before_jump() was called */
+	MOCKFW_EXIT_RESET,	/* RT->ResetSystem() was called */
+};
+
+typedef EFI_STATUS (*mockfw_entry_t)(EFI_HANDLE image, EFI_SYSTEM_TABLE *table);
+
+EFI_STATUS mockfw_init(const struct mockfw_config *config);
+void mockfw_shutdown(void);
+
+EFI_HANDLE mockfw_image_handle(void);
+EFI_SYSTEM_TABLE *mockfw_system_table(void);
+
+/*
+ * Run ENTRY as a loaded image. Exits through BS->Exit(),
+ * RT->ResetSystem() and mockfw_hook_before_jump() unwind back here.
+ */
+enum mockfw_exit mockfw_run(mockfw_entry_t entry, EFI_STATUS *status);
+
+/*
+ * Install as loader_ops.hook_before_jump to get control back from
+ * mockfw_run() instead of jumping to the kernel.
+ */
+void mockfw_hook_before_jump(void) __attribute__((noreturn));
+
+/* Virtual clock, advanced by every simulated cost */
+UINT64 mockfw_now_ns(void);
+void mockfw_advance_ns(UINT64 ns);
+
+void mockfw_get_stats(struct mockfw_stats *stats);
+void mockfw_reset_stats(void);
+
+EFI_STATUS mockfw_install_protocol(EFI_HANDLE *handle, EFI_GUID *guid,
+				   VOID *interface);
+EFI_STATUS mockfw_install_table(EFI_GUID *guid, VOID *table);
+
+/* Queue a key for ConIn->ReadKeyStroke() */
+void mockfw_push_key(UINT16 scan_code, CHAR16 unicode_char);
+
+/*
+ * Attach a disk image file. The whole disk and each GPT partition get
+ * a handle with DevicePath, BlockIo and DiskIo protocols.
+ */
+EFI_STATUS mockfw_add_disk(const char *path, UINT32 block_size,
+			   const struct mockfw_disk_model *model,
+			   EFI_HANDLE *handle);
+
+/*
+ * Override the cost of disk requests. COST gets the handle the request
+ * was made on and the cost given by the disk model, and returns the
+ * time to charge. NULL restores the disk models.
+ */
+typedef UINT64 (*mockfw_disk_cost_t)(void *ctx, EFI_HANDLE handle,
+				     BOOLEAN write, UINT64 offset,
+				     UINTN size, UINT64 model_ns);
+
+void mockfw_set_disk_cost(mockfw_disk_cost_t cost, void *ctx);
+
+/* Write the GOP framebuffer to a binary PPM file */
+int mockfw_gop_dump(const char *path);
+
+#endif /* __MOCKFW_H__ */
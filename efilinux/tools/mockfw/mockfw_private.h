@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __MOCKFW_PRIVATE_H__
+#define __MOCKFW_PRIVATE_H__
+
+#include <stddef.h>
+#include <stdio.h>
+#include "mockfw.h"
+
+#define MOCKFW_PAGE_SIZE	4096ULL
+
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+extern struct mockfw_config mockfw_config;
+extern struct mockfw_stats mockfw_stats;
+extern BOOLEAN mockfw_boot_services_exited;
+
+/* mockfw.c */
+void mockfw_charge_ns(UINT64 ns);
+EFI_STATUS EFIAPI mockfw_unsupported(void);
+void mockfw_signal_exit_boot_services(void);
+
+/* memmap.c */
+EFI_STATUS mockfw_memmap_init(UINT64 base, UINT64 size);
+void mockfw_memmap_shutdown(void);
+EFI_STATUS EFIAPI mockfw_allocate_pages(EFI_ALLOCATE_TYPE type,
+					EFI_MEMORY_TYPE memory_type,
+					UINTN pages, EFI_PHYSICAL_ADDRESS *memory);
+EFI_STATUS EFIAPI mockfw_free_pages(EFI_PHYSICAL_ADDRESS memory, UINTN pages);
+EFI_STATUS EFIAPI mockfw_get_memory_map(UINTN *size, EFI_MEMORY_DESCRIPTOR *map,
+					UINTN *key, UINTN *desc_size,
+					UINT32 *desc_version);
+EFI_STATUS EFIAPI mockfw_allocate_pool(EFI_MEMORY_TYPE type, UINTN size,
+				       VOID **buffer);
+EFI_STATUS EFIAPI mockfw_free_pool(VOID *buffer);
+EFI_STATUS EFIAPI mockfw_exit_boot_services(EFI_HANDLE image, UINTN key);
+
+/* variables.c */
+EFI_STATUS mockfw_variables_init(const char *path);
+void mockfw_variables_shutdown(void);
+EFI_STATUS EFIAPI mockfw_get_variable(CHAR16 *name, EFI_GUID *guid,
+				      UINT32 *attributes, UINTN *size,
+				      VOID *data);
+EFI_STATUS EFIAPI mockfw_get_next_variable_name(UINTN *name_size,
+						CHAR16 *name, EFI_GUID *guid);
+EFI_STATUS EFIAPI mockfw_set_variable(CHAR16 *name, EFI_GUID *guid,
+				      UINT32 attributes, UINTN size,
+				      VOID *data);
+
+/* disk.c */
+void mockfw_disks_shutdown(void);
+
+/* gop.c */
+EFI_STATUS mockfw_gop_init(UINT32 width, UINT32 height);
+void mockfw_gop_shutdown(void);
+
+#endif /* __MOCKFW_PRIVATE_H__ */
@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file implements the mock variable store. Variables live in
+ * memory and non-volatile ones are written back to the store file on
+ * every change, each write being charged the configured NV cost.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "mockfw_private.h"
+
+#define STORE_MAGIC	"MOCKVARS"
+
+struct variable {
+	struct variable *next;
+	CHAR16 *name;
+	UINTN name_size;
+	EFI_GUID guid;
+	UINT32 attributes;
+	UINTN size;
+	UINT8 *data;
+};
+
+struct store_record {
+	UINT32 name_size;
+	UINT32 attributes;
+	UINT32 size;
+	EFI_GUID guid;
+} __attribute__((packed));
+
+static struct variable *variables;
+static const char *store_path;
+
+static UINTN name_size(CHAR16 *name)
+{
+	UINTN n = 0;
+
+	while (name[n])
+		n++;
+	return (n + 1) * sizeof(CHAR16);
+}
+
+static struct variable *find_variable(CHAR16 *name, EFI_GUID *guid)
+{
+	struct variable *var;
+	UINTN size = name_size(name);
+
+	for (var = variables; var; var = var->next)
+		if (var->name_size == size && !memcmp(var->name, name, size) &&
+		    !memcmp(&var->guid, guid, sizeof(*guid)))
+			return var;
+	return NULL;
+}
+
+static BOOLEAN visible(struct variable *var)
+{
+	return !mockfw_boot_services_exited ||
+		(var->attributes & EFI_VARIABLE_RUNTIME_ACCESS);
+}
+
+static void free_variable(struct variable *var)
+{
+	free(var->name);
+	free(var->data);
+	free(var);
+}
+
+static struct variable *new_variable(CHAR16 *name, UINTN nsize, EFI_GUID *guid,
+				     UINT32 attributes, UINTN size, VOID *data)
+{
+	struct variable *var;
+
+	var = calloc(1, sizeof(*var));
+	if (!var)
+		return NULL;
+
+	var->name = malloc(nsize);
+	var->data = malloc(size ? size : 1);
+	if (!var->name || !var->data) {
+		free_variable(var);
+		return NULL;
+	}
+
+	memcpy(var->name, name, nsize);
+	var->name_size = nsize;
+	var->guid = *guid;
+	var->attributes = attributes;
+	memcpy(var->data, data, size);
+	var->size = size;
+	return var;
+}
+
+static EFI_STATUS save_store(void)
+{
+	struct variable *var;
+	FILE *f;
+
+	if (!store_path)
+		return EFI_SUCCESS;
+
+	f = fopen(store_path, "wb");
+	if (!f) {
+		perror(store_path);
+		return EFI_DEVICE_ERROR;
+	}
+
+	fwrite(STORE_MAGIC, 1, strlen(STORE_MAGIC), f);
+	for (var = variables; var; var = var->next) {
+		struct store_record rec;
+
+		if (!(var->attributes & EFI_VARIABLE_NON_VOLATILE))
+			continue;
+		rec.name_size = var->name_size;
+		rec.attributes = var->attributes;
+		rec.size = var->size;
+		rec.guid = var->guid;
+		fwrite(&rec, sizeof(rec), 1, f);
+		fwrite(var->name, var->name_size, 1, f);
+		fwrite(var->data, var->size, 1, f);
+	}
+
+	if (fclose(f)) {
+		perror(store_path);
+		return EFI_DEVICE_ERROR;
+	}
+	return EFI_SUCCESS;
+}
+
+static EFI_STATUS load_store(void)
+{
+	EFI_STATUS ret = EFI_SUCCESS;
+	char magic[sizeof(STORE_MAGIC) - 1];
+	struct store_record rec;
+	struct variable **tail = &variables;
+	FILE *f;
+
+	f = fopen(store_path, "rb");
+	if (!f)
+		return EFI_SUCCESS;	/* created on the first NV write */
+
+	if (fread(magic, sizeof(magic), 1, f) != 1 ||
+	    memcmp(magic, STORE_MAGIC, sizeof(magic))) {
+		fprintf(stderr, "mockfw: %s is not a variable store\n",
+			store_path);
+		ret = EFI_VOLUME_CORRUPTED;
+		goto out;
+	}
+
+	while (fread(&rec, sizeof(rec), 1, f) == 1) {
+		EFI_GUID guid = rec.guid;
+		CHAR16 *name = malloc(rec.name_size);
+		UINT8 *data = malloc(rec.size ? rec.size : 1);
+
+		if (!name || !data ||
+		    fread(name, rec.name_size, 1, f) != 1 ||
+		    (rec.size && fread(data, rec.size, 1, f) != 1)) {
+			free(name);
+			free(data);
+			ret = EFI_VOLUME_CORRUPTED;
+			goto out;
+		}
+
+		*tail = new_variable(name, rec.name_size, &guid,
+				     rec.attributes, rec.size, data);
+		free(name);
+		free(data);
+		if (!*tail) {
+			ret = EFI_OUT_OF_RESOURCES;
+			goto out;
+		}
+		tail = &(*tail)->next;
+	}
+
+out:
+	fclose(f);
+	return ret;
+}
+
+EFI_STATUS mockfw_variables_init(const char *path)
+{
+	variables = NULL;
+	store_path = path;
+	return path ? load_store() : EFI_SUCCESS;
+}
+
+void mockfw_variables_shutdown(void)
+{
+	struct variable *var, *next;
+
+	for (var = variables; var; var = next) {
+		next = var->next;
+		free_variable(var);
+	}
+	variables = NULL;
+}
+
+EFI_STATUS EFIAPI mockfw_get_variable(CHAR16 *name, EFI_GUID *guid,
+				      UINT32 *attributes, UINTN *size,
+				      VOID *data)
+{
+	struct variable *var;
+
+	if (!name || !guid || !size)
+		return EFI_INVALID_PARAMETER;
+
+	mockfw_stats.var_reads++;
+	var = find_variable(name, guid);
+	if (!var || !visible(var))
+		return EFI_NOT_FOUND;
+
+	if (*size < var->size) {
+		*size = var->size;
+		return EFI_BUFFER_TOO_SMALL;
+	}
+	if (!data)
+		return EFI_INVALID_PARAMETER;
+
+	memcpy(data, var->data, var->size);
+	*size = var->size;
+	if (attributes)
+		*attributes = var->attributes;
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI mockfw_get_next_variable_name(UINTN *nsize, CHAR16 *name,
+						EFI_GUID *guid)
+{
+	struct variable *var = variables;
+
+	if (!nsize || !name || !guid)
+		return EFI_INVALID_PARAMETER;
+
+	if (name[0]) {
+		var = find_variable(name, guid);
+		if (!var)
+			return EFI_INVALID_PARAMETER;
+		var = var->next;
+	}
+	while (var && !visible(var))
+		var = var->next;
+	if (!var)
+		return EFI_NOT_FOUND;
+
+	if (*nsize < var->name_size) {
+		*nsize = var->name_size;
+		return EFI_BUFFER_TOO_SMALL;
+	}
+
+	memcpy(name, var->name, var->name_size);
+	*nsize = var->name_size;
+	*guid = var->guid;
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS EFIAPI mockfw_set_variable(CHAR16 *name, EFI_GUID *guid,
+				      UINT32 attributes, UINTN size,
+				      VOID *data)
+{
+	struct variable *var, **link;
+	BOOLEAN nv;
+	UINT64 cost;
+
+	if (!name || !name[0] || !guid || (size && !data))
+		return EFI_INVALID_PARAMETER;
+	if (mockfw_boot_services_exited &&
+	    size && !(attributes & EFI_VARIABLE_RUNTIME_ACCESS))
+		return EFI_INVALID_PARAMETER;
+	if (size && !(attributes & EFI_VARIABLE_BOOTSERVICE_ACCESS))
+		return EFI_INVALID_PARAMETER;
+
+	mockfw_stats.var_writes++;
+	var = find_variable(name, guid);
+	if (var && size && var->attributes != attributes)
+		return EFI_INVALID_PARAMETER;
+	if (!var && !size)
+		return EFI_NOT_FOUND;
+
+	nv = var ? (var->attributes & EFI_VARIABLE_NON_VOLATILE) :
+		(attributes & EFI_VARIABLE_NON_VOLATILE);
+
+	if (var) {
+		for (link = &variables; *link != var; link = &(*link)->next)
+			;
+		*link = var->next;
+		free_variable(var);
+	}
+
+	if (size) {
+		var = new_variable(name, name_size(name), guid, attributes,
+				   size, data);
+		if (!var)
+			return EFI_OUT_OF_RESOURCES;
+		for (link = &variables; *link; link = &(*link)->next)
+			;
+		*link = var;
+	}
+
+	if (!nv)
+		return EFI_SUCCESS;
+
+	cost = mockfw_config.nv_write_ns +
+		mockfw_config.nv_write_ns_per_kb * ((size + 1023) / 1024);
+	mockfw_stats.nv_writes++;
+	mockfw_stats.nv_ns += cost;
+	mockfw_charge_ns(cost);
+
+	return save_store();
+}
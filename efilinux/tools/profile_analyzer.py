@@ -0,0 +1,257 @@
+#!/usr/bin/env python3
+# Copyright (c) 2014, Intel Corporation
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+#    * Redistributions of source code must retain the above copyright
+#      notice, this list of conditions and the following disclaimer.
+#    * Redistributions in binary form must reproduce the above
+#      copyright notice, this list of conditions and the following
+#      disclaimer in the documentation and/or other materials provided
+#      with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+# FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+# COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+# INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+# BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+# ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+# Host tool analyzing the function traces of profiling builds. Every
+# function entry and exit logs a line such as
+#
+#   [    1.234567] PROFILE [__cyg_profile_func_enter:38] func=1a2b caller=3c4d
+#
+# where the offsets are relative to the loader image base and the
+# timestamp is only present with CONFIG_LOG_TIMESTAMP. The lines are read
+# from a serial capture or from a dump of the EfilinuxLogs variable
+# (UTF-16, with or without the efivarfs attributes header). Call stacks
+# are rebuilt from the enter/exit pairs and symbolized with nm on
+# efilinux.so. The tool writes folded stacks for flamegraph.pl and
+# prints per-function call counts, plus inclusive and exclusive times
+# when timestamps are present.
+#
+# Timings include the cost of logging each entry and exit, which
+# dominates for small functions: use them to compare runs, not as
+# absolute values.
+#
+
+import argparse
+import bisect
+import re
+import subprocess
+import sys
+from collections import defaultdict
+
+PROFILE_RE = re.compile(
+    r'(?:\[\s*(?P<sec>\d+)\.(?P<usec>\d{6})\]\s+)?'
+    r'PROFILE \[(?P<hook>[A-Za-z0-9_]+):\d+\]\s+'
+    r'func=(?P<func>[0-9a-fA-F]+) caller=(?P<caller>[0-9a-fA-F]+)')
+
+
+class Symbols(object):
+    """Resolve image offsets to function names with nm."""
+
+    def __init__(self, image=None, nm='nm'):
+        self.addresses = []
+        self.names = []
+        if not image:
+            return
+        out = subprocess.check_output([nm, '-n', '--defined-only', image],
+                                      universal_newlines=True)
+        for line in out.splitlines():
+            fields = line.split()
+            if len(fields) != 3 or fields[1] not in 'tTwW':
+                continue
+            self.addresses.append(int(fields[0], 16))
+            self.names.append(fields[2])
+
+    def name(self, offset, exact=False):
+        i = bisect.bisect_right(self.addresses, offset) - 1
+        if i < 0 or (exact and self.addresses[i] != offset):
+            return '0x%x' % offset
+        if self.addresses[i] == offset:
+            return self.names[i]
+        return '%s+0x%x' % (self.names[i], offset - self.addresses[i])
+
+
+def read_log(path):
+    """Return the text of a serial capture or of a log variable dump."""
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    # efivarfs files start with the 4 bytes of the variable attributes
+    for skip in (0, 4):
+        body = data[skip:]
+        if len(body) >= 4 and body[1] == 0 and body[3] == 0:
+            if len(body) % 2:
+                body = body[:-1]
+            return body.decode('utf-16-le', 'replace')
+    return data.decode('latin-1')
+
+
+class Frame(object):
+    __slots__ = ('func', 'caller', 'start', 'children')
+
+    def __init__(self, func, caller, start):
+        self.func = func
+        self.caller = caller
+        self.start = start
+        self.children = 0
+
+
+class Analyzer(object):
+
+    def __init__(self, symbols):
+        self.symbols = symbols
+        self.stack = []
+        self.calls = defaultdict(int)
+        self.inclusive = defaultdict(int)
+        self.exclusive = defaultdict(int)
+        self.folded = defaultdict(int)
+        self.timed = False
+        self.unmatched = 0
+        self.last = None
+
+    def stack_names(self):
+        return [self.symbols.name(f.func, True) for f in self.stack]
+
+    def enter(self, func, caller, time):
+        self.calls[func] += 1
+        self.stack.append(Frame(func, caller, time))
+        if time is None:
+            self.folded[';'.join(self.stack_names())] += 1
+
+    def leave(self, func, time):
+        # Exits lost to the log ring wrapping around or to a longjmp
+        # unwind all the frames up to the function
+        for depth in range(len(self.stack) - 1, -1, -1):
+            if self.stack[depth].func == func:
+                break
+        else:
+            self.unmatched += 1
+            return
+
+        while len(self.stack) > depth:
+            self.close(time)
+
+    def close(self, time):
+        names = self.stack_names()
+        frame = self.stack.pop()
+        if time is None or frame.start is None:
+            return
+
+        elapsed = max(time - frame.start, 0)
+        own = max(elapsed - frame.children, 0)
+        self.exclusive[frame.func] += own
+        if all(f.func != frame.func for f in self.stack):
+            self.inclusive[frame.func] += elapsed
+        if self.stack:
+            self.stack[-1].children += elapsed
+        self.folded[';'.join(names)] += own
+
+    def feed(self, text):
+        for match in PROFILE_RE.finditer(text):
+            time = None
+            if match.group('sec') is not None:
+                time = int(match.group('sec')) * 1000000 + \
+                    int(match.group('usec'))
+                self.timed = True
+            func = int(match.group('func'), 16)
+            caller = int(match.group('caller'), 16)
+            hook = match.group('hook')
+
+            if hook.endswith('_exit'):
+                self.leave(func, time)
+            elif hook.endswith('_enter'):
+                self.enter(func, caller, time)
+            elif self.stack and self.stack[-1].func == func and \
+                    self.stack[-1].caller == caller:
+                # Logs without the hook name: a line matching the
+                # innermost frame is its exit
+                self.leave(func, time)
+            else:
+                self.enter(func, caller, time)
+            if time is not None:
+                self.last = time
+
+    def finish(self):
+        """Close the frames still open at the end of the log."""
+        open_frames = len(self.stack)
+        while self.stack:
+            self.close(self.last)
+        return open_frames
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Rebuild call stacks from the PROFILE lines of '
+        'profiling builds logs.')
+    parser.add_argument('logs', nargs='+', metavar='LOG',
+                        help='serial capture or EfilinuxLogs variable dump')
+    parser.add_argument('-s', '--symbols', metavar='EFILINUX_SO',
+                        help='efilinux.so of the build that produced the logs')
+    parser.add_argument('--nm', default='nm', help='nm to use (default: nm)')
+    parser.add_argument('-f', '--folded', metavar='FILE',
+                        help='write folded stacks for flamegraph.pl, '
+                        'weighted by exclusive time in us when the logs '
+                        'have timestamps, by calls otherwise')
+    parser.add_argument('--sort', choices=('calls', 'inclusive', 'exclusive'),
+                        help='sort key of the statistics (default: '
+                        'exclusive with timestamps, calls otherwise)')
+    parser.add_argument('-n', '--top', type=int, default=50,
+                        help='number of functions listed, 0 for all '
+                        '(default: 50)')
+    args = parser.parse_args()
+
+    symbols = Symbols(args.symbols, args.nm)
+    analyzer = Analyzer(symbols)
+    for path in args.logs:
+        analyzer.feed(read_log(path))
+        open_frames = analyzer.finish()
+        if open_frames:
+            sys.stderr.write('%s: %d frames still open at the end\n' %
+                             (path, open_frames))
+    if analyzer.unmatched:
+        sys.stderr.write('%d exits without a matching entry\n' %
+                         analyzer.unmatched)
+
+    if args.folded:
+        with open(args.folded, 'w') as f:
+            for stack, value in sorted(analyzer.folded.items()):
+                if value:
+                    f.write('%s %d\n' % (stack, value))
+
+    sort = args.sort or ('exclusive' if analyzer.timed else 'calls')
+    key = {'calls': analyzer.calls, 'inclusive': analyzer.inclusive,
+           'exclusive': analyzer.exclusive}[sort]
+    funcs = sorted(analyzer.calls, key=lambda f: key.get(f, 0), reverse=True)
+    if args.top:
+        funcs = funcs[:args.top]
+
+    if analyzer.timed:
+        print('%-40s %10s %14s %14s' % ('Function', 'Calls', 'Inclusive us',
+                                         'Exclusive us'))
+        for func in funcs:
+            print('%-40s %10d %14d %14d' % (
+                symbols.name(func, True), analyzer.calls[func],
+                analyzer.inclusive.get(func, 0),
+                analyzer.exclusive.get(func, 0)))
+    else:
+        print('%-40s %10s' % ('Function', 'Calls'))
+        for func in funcs:
+            print('%-40s %10d' % (symbols.name(func, True),
+                                  analyzer.calls[func]))
+
+
+if __name__ == '__main__':
+    main()
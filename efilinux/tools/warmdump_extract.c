@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file is a host tool listing the regions of a warmdump container
+ * and extracting each of them as a raw image of the memory region, the
+ * parts of the region that were not dumped are zero filled.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <efi.h>
+#include "warmdump_format.h"
+#include "lz4.h"
+#include "crc32c.h"
+
+static unsigned char *read_file(const char *path, size_t *size)
+{
+	FILE *f;
+	unsigned char *data;
+	long len;
+
+	f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		return NULL;
+	}
+
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	data = malloc(len ? len : 1);
+	if (data && fread(data, 1, len, f) != (size_t)len) {
+		fprintf(stderr, "%s: short read\n", path);
+		free(data);
+		data = NULL;
+	}
+
+	fclose(f);
+	*size = len;
+	return data;
+}
+
+static int check_header(struct wd_header *h, size_t size)
+{
+	struct wd_header copy = *h;
+
+	copy.header_crc = 0;
+	if (size < sizeof(*h) || h->magic != WD_MAGIC) {
+		fprintf(stderr, "Not a warmdump container\n");
+		return -1;
+	}
+	if (h->version != WD_VERSION) {
+		fprintf(stderr, "Unsupported version %u\n", h->version);
+		return -1;
+	}
+	if (crc32c(0, &copy, sizeof(copy)) != h->header_crc) {
+		fprintf(stderr, "Header CRC mismatch\n");
+		return -1;
+	}
+	if (h->region_table > size ||
+	    (size - h->region_table) / sizeof(struct wd_region) < h->region_count ||
+	    h->chunk_table > size ||
+	    (size - h->chunk_table) / sizeof(struct wd_chunk) < h->chunk_count) {
+		fprintf(stderr, "Tables out of the file\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Restore the chunks of @region in @image, return the number of
+ * chunks that failed */
+static unsigned int extract_region(unsigned char *file, size_t size,
+				   struct wd_header *h, struct wd_region *region,
+				   unsigned char *image, size_t *stored)
+{
+	struct wd_chunk *chunks = (struct wd_chunk *)(file + h->chunk_table);
+	struct wd_chunk *c;
+	unsigned int i, errors = 0;
+	UINTN out_size;
+
+	*stored = 0;
+	if (region->first_chunk > h->chunk_count ||
+	    region->chunk_count > h->chunk_count - region->first_chunk)
+		return region->chunk_count;
+
+	for (i = 0; i < region->chunk_count; i++) {
+		c = &chunks[region->first_chunk + i];
+		*stored += c->stored_size;
+
+		if (c->offset > region->size || c->size > region->size - c->offset ||
+		    c->file_offset > size || c->stored_size > size - c->file_offset) {
+			fprintf(stderr, "  chunk %u: out of bounds\n", i);
+			errors++;
+			continue;
+		}
+
+		out_size = c->size;
+		if (c->flags & WD_CHUNK_LZ4) {
+			if (EFI_ERROR(lz4_decompress(file + c->file_offset, c->stored_size,
+						     image + c->offset, &out_size)) ||
+			    out_size != c->size) {
+				fprintf(stderr, "  chunk %u: corrupted LZ4 block\n", i);
+				errors++;
+				continue;
+			}
+		} else
+			memcpy(image + c->offset, file + c->file_offset, c->size);
+
+		if (crc32c(0, image + c->offset, c->size) != c->crc) {
+			fprintf(stderr, "  chunk %u: CRC mismatch\n", i);
+			errors++;
+		}
+	}
+
+	return errors;
+}
+
+static int write_image(const char *dir, struct wd_region *region,
+		       unsigned char *image)
+{
+	char path[4096], name[WD_NAME_SIZE + 1];
+	FILE *f;
+	int ret = 0;
+
+	memcpy(name, region->name, WD_NAME_SIZE);
+	name[WD_NAME_SIZE] = '\0';
+	snprintf(path, sizeof(path), "%s/%s.bin", dir, name);
+
+	f = fopen(path, "wb");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	if (fwrite(image, 1, region->size, f) != region->size) {
+		perror(path);
+		ret = -1;
+	}
+	fclose(f);
+
+	printf("  written to %s\n", path);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char *file, *image;
+	struct wd_header *h;
+	struct wd_region *regions;
+	size_t size, stored;
+	unsigned int i, errors, total_errors = 0;
+
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "Usage: %s DUMP_FILE [OUTPUT_DIR]\n", argv[0]);
+		fprintf(stderr, "List the regions of DUMP_FILE and extract them "
+			"to OUTPUT_DIR/<region>.bin\n");
+		return EXIT_FAILURE;
+	}
+
+	file = read_file(argv[1], &size);
+	if (!file)
+		return EXIT_FAILURE;
+
+	h = (struct wd_header *)file;
+	if (check_header(h, size))
+		return EXIT_FAILURE;
+
+	regions = (struct wd_region *)(file + h->region_table);
+	if (crc32c(crc32c(0, regions, h->region_count * sizeof(*regions)),
+		   file + h->chunk_table,
+		   h->chunk_count * sizeof(struct wd_chunk)) != h->table_crc) {
+		fprintf(stderr, "Table CRC mismatch\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%s: %u regions, %u chunks, %zu bytes\n", argv[1],
+	       h->region_count, h->chunk_count, size);
+
+	for (i = 0; i < h->region_count; i++) {
+		image = calloc(1, regions[i].size ? regions[i].size : 1);
+		if (!image) {
+			fprintf(stderr, "Out of memory\n");
+			return EXIT_FAILURE;
+		}
+
+		errors = extract_region(file, size, h, &regions[i], image, &stored);
+		printf("%-*.*s address 0x%llx size 0x%x chunks %u stored 0x%zx%s\n",
+		       WD_NAME_SIZE, WD_NAME_SIZE, regions[i].name,
+		       (unsigned long long)regions[i].address, regions[i].size,
+		       regions[i].chunk_count, stored, errors ? " CORRUPTED" : "");
+		total_errors += errors;
+
+		if (argc == 3 && write_image(argv[2], &regions[i], image))
+			total_errors++;
+
+		free(image);
+	}
+
+	free(file);
+	return total_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -69,11 +69,15 @@ static enum targets get_target_from_var(const CHAR16 *varname)
 {
 	CHAR16 *name;
 	enum targets target;
+	EFI_STATUS ret;
 
+	uefi_fw_calls++;
 	name = LibGetVariable((CHAR16 *)varname, (EFI_GUID *)&osloader_guid);
 	if (!name)
 		return TARGET_UNKNOWN;
-	return EFI_ERROR(name_to_target(name, &target)) ? TARGET_UNKNOWN : target;
+	ret = name_to_target(name, &target);
+	FreePool(name);
+	return EFI_ERROR(ret) ? TARGET_UNKNOWN : target;
 }
 
 enum targets get_entry_oneshot(void)
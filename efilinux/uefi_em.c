@@ -31,6 +31,8 @@
 #include <efi.h>
 #include <efilib.h>
 #include "efilinux.h"
+#include "uefi_utils.h"
+#include "stdlib.h"
 #include "bootlogic.h"
 #include "acpi.h"
 #include "em.h"
@@ -68,14 +70,6 @@ struct _DEVICE_INFO_PROTOCOL {
 	GET_USB_CHARGER_STATUS GetUsbChargerStatus;
 };
 
-struct battery_status {
-	BOOLEAN BatteryPresent;
-	BOOLEAN BatteryValid;
-	BOOLEAN CapacityReadable;
-	BATT_VOLTAGE BatteryVoltageLevel;
-	BATT_CAPACITY BatteryCapacityLevel;
-};
-
 static BOOLEAN uefi_is_charger_present(void)
 {
 	struct _DEVICE_INFO_PROTOCOL *dev_info;
@@ -83,10 +77,11 @@ static BOOLEAN uefi_is_charger_present(void)
 	USB_CHARGER_TYPE type;
 	EFI_STATUS ret;
 
-	ret = LibLocateProtocol(&DeviceInfoProtocolGuid, (VOID **)&dev_info);
+	ret = uefi_locate_protocol(&DeviceInfoProtocolGuid, (VOID **)&dev_info);
 	if (EFI_ERROR(ret) || !dev_info)
 		goto error;
 
+	uefi_fw_calls++;
 	ret = uefi_call_wrapper(dev_info->GetUsbChargerStatus, 2, &present, &type);
 	if (EFI_ERROR(ret))
 		goto error;
@@ -102,10 +97,11 @@ static EFI_STATUS uefi_get_battery_status(struct battery_status *status)
 	struct _DEVICE_INFO_PROTOCOL *dev_info;
 	EFI_STATUS ret;
 
-	ret = LibLocateProtocol(&DeviceInfoProtocolGuid, (VOID **)&dev_info);
+	ret = uefi_locate_protocol(&DeviceInfoProtocolGuid, (VOID **)&dev_info);
 	if (EFI_ERROR(ret) || !dev_info)
 		goto error;
 
+	uefi_fw_calls++;
 	ret = uefi_call_wrapper(dev_info->GetBatteryStatus, 5,
 		&status->BatteryPresent,
 		&status->BatteryValid,
@@ -122,28 +118,34 @@ error:
 	return ret;
 }
 
-static enum batt_levels uefi_get_battery_level(void)
+static enum batt_levels battery_level(struct battery_status *status)
 {
-	struct battery_status status;
-	EFI_STATUS ret;
 	UINTN value, threshold;
 
-	ret = uefi_get_battery_status(&status);
-	if (EFI_ERROR(ret))
-		goto error;
-
 	if (oem1_get_ia_apps_to_use() == OEM1_USE_IA_APPS_CAP) {
-		value = status.BatteryCapacityLevel;
+		value = status->BatteryCapacityLevel;
 		threshold = oem1_get_ia_apps_cap();
 		debug(L"Battery: %d%% Threshold: %d%%\n", value, threshold);
 	}
 	else {
-		value = status.BatteryVoltageLevel;
+		value = status->BatteryVoltageLevel;
 		threshold = oem1_get_ia_apps_run();
 		debug(L"Battery: %dmV Threshold: %dmV\n", value, threshold);
 	}
 
 	return value > threshold ? BATT_BOOT_OS : BATT_BOOT_CHARGING;
+}
+
+static enum batt_levels uefi_get_battery_level(void)
+{
+	struct battery_status status;
+	EFI_STATUS ret;
+
+	ret = uefi_get_battery_status(&status);
+	if (EFI_ERROR(ret))
+		goto error;
+
+	return battery_level(&status);
 
 error:
 	error(L"Failed to get battery level: %r\n", ret);
@@ -164,11 +166,21 @@ static BOOLEAN uefi_is_battery_ok(void)
 	return status.BatteryPresent;
 }
 
+static BOOLEAN battery_below_vbattfreqlmt(struct battery_status *status)
+{
+	UINT16 vbattfreqlmt, value;
+
+	value = status->BatteryVoltageLevel;
+	vbattfreqlmt = oem1_get_ia_vbattfreqlmt();
+	debug(L"Battery: %dmV Vbattfreqlmt: %dmV\n", value, vbattfreqlmt);
+
+	return value < vbattfreqlmt;
+}
+
 static BOOLEAN uefi_is_battery_below_vbattfreqlmt(void)
 {
 	struct battery_status status;
 	EFI_STATUS ret;
-	UINT16 vbattfreqlmt, value;
 
 	ret = uefi_get_battery_status(&status);
 	if (EFI_ERROR(ret)) {
@@ -176,11 +188,50 @@ static BOOLEAN uefi_is_battery_below_vbattfreqlmt(void)
 		return FALSE;
 	}
 
-	value = status.BatteryVoltageLevel;
-	vbattfreqlmt = oem1_get_ia_vbattfreqlmt();
-	debug(L"Battery: %dmV Vbattfreqlmt: %dmV\n", value, vbattfreqlmt);
+	return battery_below_vbattfreqlmt(&status);
+}
 
-	return value < vbattfreqlmt;
+/* Same answers as the individual operations, with a single lookup of
+ * the device info protocol and a single call of each of its services */
+static void uefi_snapshot(struct em_snapshot *s)
+{
+	struct _DEVICE_INFO_PROTOCOL *dev_info;
+	USB_CHARGER_TYPE type;
+	BOOLEAN present;
+	EFI_STATUS ret;
+
+	memset(s, 0, sizeof(*s));
+	s->level = BATT_ERROR;
+
+	s->status = uefi_locate_protocol(&DeviceInfoProtocolGuid, (VOID **)&dev_info);
+	if (EFI_ERROR(s->status) || !dev_info) {
+		error(L"Failed to get device info protocol: %r\n", s->status);
+		if (!EFI_ERROR(s->status))
+			s->status = EFI_NOT_FOUND;
+		return;
+	}
+
+	uefi_fw_calls++;
+	s->status = uefi_call_wrapper(dev_info->GetBatteryStatus, 5,
+		&s->battery.BatteryPresent,
+		&s->battery.BatteryValid,
+		&s->battery.CapacityReadable,
+		&s->battery.BatteryVoltageLevel,
+		&s->battery.BatteryCapacityLevel);
+	if (EFI_ERROR(s->status)) {
+		error(L"Failed to get battery status: %r\n", s->status);
+	} else {
+		s->battery_ok = s->battery.BatteryPresent;
+		s->level = battery_level(&s->battery);
+		s->below_vbattfreqlmt = battery_below_vbattfreqlmt(&s->battery);
+	}
+
+	uefi_fw_calls++;
+	ret = uefi_call_wrapper(dev_info->GetUsbChargerStatus, 2, &present, &type);
+	if (EFI_ERROR(ret)) {
+		error(L"Failed to get charger status: %r\n", ret);
+	} else
+		s->charger_present = present;
 }
 
 static void uefi_print_battery_infos(void)
@@ -211,9 +262,11 @@ error:
 }
 
 struct energy_mgmt_ops uefi_em_ops = {
+	.get_battery_status = uefi_get_battery_status,
 	.get_battery_level = uefi_get_battery_level,
 	.is_battery_ok = uefi_is_battery_ok,
 	.is_charger_present = uefi_is_charger_present,
 	.is_battery_below_vbattfreqlmt = uefi_is_battery_below_vbattfreqlmt,
-	.print_battery_infos = uefi_print_battery_infos
+	.print_battery_infos = uefi_print_battery_infos,
+	.snapshot = uefi_snapshot
 };
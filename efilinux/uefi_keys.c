@@ -31,41 +31,215 @@
 #include <efilib.h>
 #include "efilinux.h"
 #include "bootlogic.h"
+#include "uefi_utils.h"
 
 #define VOLUME_UP	0x1
 #define VOLUME_DOWN	0x2
 
+/* Period of the key sampling timer, in 100ns units */
+#define KEY_SAMPLING_PERIOD	(10 * 1000 * 10)
+
 struct _pressed_scancodes {
 	UINT16 scancode;
-	CHAR8 pressed;
+	volatile CHAR8 pressed;
+	VOID *notify_handle;
 };
 
 static struct _pressed_scancodes pressed_scancodes[] = {
-	{VOLUME_UP, 0},
-	{VOLUME_DOWN, 0},
+	{VOLUME_UP, 0, NULL},
+	{VOLUME_DOWN, 0, NULL},
+};
+
+#define TEXT_INPUT_EX_PROTOCOL {0xdd9e7534, 0x7762, 0x4698, {0x8c, 0x14, 0xf5, 0x85, 0x17, 0xa6, 0x25, 0xaa}}
+static EFI_GUID TextInputExProtocolGuid = TEXT_INPUT_EX_PROTOCOL;
+
+struct key_data {
+	EFI_INPUT_KEY Key;
+	UINT32 KeyShiftState;
+	UINT8 KeyToggleState;
+};
+
+typedef EFI_STATUS (EFI_CALLBACK *KEY_NOTIFY_FUNCTION) (
+	IN struct key_data *KeyData);
+
+struct _TEXT_INPUT_EX_PROTOCOL;
+
+typedef EFI_STATUS (EFIAPI *REGISTER_KEY_NOTIFY) (
+	IN struct _TEXT_INPUT_EX_PROTOCOL *This,
+	IN struct key_data *KeyData,
+	IN KEY_NOTIFY_FUNCTION KeyNotificationFunction,
+	OUT VOID **NotifyHandle);
+
+typedef EFI_STATUS (EFIAPI *UNREGISTER_KEY_NOTIFY) (
+	IN struct _TEXT_INPUT_EX_PROTOCOL *This,
+	IN VOID *NotificationHandle);
+
+struct _TEXT_INPUT_EX_PROTOCOL {
+	VOID *Reset;
+	VOID *ReadKeyStrokeEx;
+	EFI_EVENT WaitForKeyEx;
+	VOID *SetState;
+	REGISTER_KEY_NOTIFY RegisterKeyNotify;
+	UNREGISTER_KEY_NOTIFY UnregisterKeyNotify;
 };
 
+/* Keys are sampled in the background from efi_main() to the boot
+ * decision, either through key notifications or with a periodic timer
+ * draining the console input when those are not supported. */
+static struct _TEXT_INPUT_EX_PROTOCOL *text_input_ex;
+static EFI_EVENT sampling_timer;
+static BOOLEAN sampling;
+
 EFI_STATUS uefi_get_key(EFI_INPUT_KEY *key)
 {
+	/* The background sampling is not issued by any decision */
+	if (!sampling)
+		uefi_fw_calls++;
 	return uefi_call_wrapper(ST->ConIn->ReadKeyStroke, 2, ST->ConIn, key);
 }
 
+static void latch_key(UINT16 scancode)
+{
+	UINTN i;
+
+	for (i = 0 ; i < sizeof(pressed_scancodes) / sizeof(*pressed_scancodes); i++)
+		if (scancode == pressed_scancodes[i].scancode) {
+			pressed_scancodes[i].pressed = 1;
+			break;
+		}
+}
+
 void get_key_pressed(void)
 {
 	EFI_INPUT_KEY key;
-	UINTN i;
+
 	while (!EFI_ERROR(uefi_get_key(&key)))
-		for (i = 0 ; i < sizeof(pressed_scancodes) / sizeof(*pressed_scancodes); i++)
-			if (key.ScanCode == pressed_scancodes[i].scancode) {
-				pressed_scancodes[i].pressed = 1;
-				break;
-			}
+		latch_key(key.ScanCode);
+}
+
+static EFI_STATUS EFI_CALLBACK key_notify(struct key_data *key_data)
+{
+	latch_key(key_data->Key.ScanCode);
+	return EFI_SUCCESS;
+}
+
+static VOID EFI_CALLBACK sampling_tick(EFI_EVENT event, VOID *context)
+{
+	get_key_pressed();
+}
+
+static EFI_STATUS register_key_notify(void)
+{
+	struct key_data key_data;
+	EFI_STATUS ret;
+	UINTN i;
+
+	ret = uefi_call_wrapper(BS->HandleProtocol, 3, ST->ConsoleInHandle,
+				&TextInputExProtocolGuid, (VOID **)&text_input_ex);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	memset(&key_data, 0, sizeof(key_data));
+	for (i = 0 ; i < sizeof(pressed_scancodes) / sizeof(*pressed_scancodes); i++) {
+		key_data.Key.ScanCode = pressed_scancodes[i].scancode;
+		ret = uefi_call_wrapper(text_input_ex->RegisterKeyNotify, 4,
+					text_input_ex, &key_data, key_notify,
+					&pressed_scancodes[i].notify_handle);
+		if (EFI_ERROR(ret))
+			return ret;
+	}
+
+	return EFI_SUCCESS;
+}
+
+static void unregister_key_notify(void)
+{
+	UINTN i;
+
+	for (i = 0 ; i < sizeof(pressed_scancodes) / sizeof(*pressed_scancodes); i++) {
+		if (!pressed_scancodes[i].notify_handle)
+			continue;
+		uefi_call_wrapper(text_input_ex->UnregisterKeyNotify, 2,
+				  text_input_ex, pressed_scancodes[i].notify_handle);
+		pressed_scancodes[i].notify_handle = NULL;
+	}
+	text_input_ex = NULL;
+}
+
+/**
+ * uefi_keys_start_sampling - latch the combo keys in the background
+ * until uefi_keys_stop_sampling(), so that the detection window overlaps
+ * the loader work instead of being a wait at decision time.
+ */
+EFI_STATUS uefi_keys_start_sampling(void)
+{
+	EFI_STATUS ret;
+
+	if (sampling)
+		return EFI_SUCCESS;
+
+	/* Keys pressed before the loader started */
+	get_key_pressed();
+
+	ret = register_key_notify();
+	if (!EFI_ERROR(ret)) {
+		debug(L"Sampling keys with key notifications\n");
+		sampling = TRUE;
+		return EFI_SUCCESS;
+	}
+	if (text_input_ex)
+		unregister_key_notify();
+
+	ret = uefi_call_wrapper(BS->CreateEvent, 5, EVT_TIMER | EVT_NOTIFY_SIGNAL,
+				TPL_CALLBACK, sampling_tick, NULL, &sampling_timer);
+	if (EFI_ERROR(ret)) {
+		error(L"Failed to create the key sampling timer: %r\n", ret);
+		return ret;
+	}
+
+	ret = uefi_call_wrapper(BS->SetTimer, 3, sampling_timer, TimerPeriodic,
+				KEY_SAMPLING_PERIOD);
+	if (EFI_ERROR(ret)) {
+		error(L"Failed to start the key sampling timer: %r\n", ret);
+		uefi_call_wrapper(BS->CloseEvent, 1, sampling_timer);
+		sampling_timer = NULL;
+		return ret;
+	}
+
+	debug(L"Sampling keys with a periodic timer\n");
+	sampling = TRUE;
+	return EFI_SUCCESS;
+}
+
+/**
+ * uefi_keys_stop_sampling - stop the background sampling, the latched
+ * state is kept. It must be stopped before exiting boot services.
+ */
+void uefi_keys_stop_sampling(void)
+{
+	if (!sampling)
+		return;
+
+	if (text_input_ex)
+		unregister_key_notify();
+
+	if (sampling_timer) {
+		uefi_call_wrapper(BS->CloseEvent, 1, sampling_timer);
+		sampling_timer = NULL;
+		/* Keys pressed since the last tick */
+		get_key_pressed();
+	}
+
+	sampling = FALSE;
 }
 
 int is_key_pressed(int key)
 {
 	int i;
-	get_key_pressed();
+
+	/* Latched in the background while sampling */
+	if (!sampling)
+		get_key_pressed();
 
 	for (i = 0; i < sizeof(pressed_scancodes) / sizeof(*pressed_scancodes); i++)
 		if (pressed_scancodes[i].scancode == key)
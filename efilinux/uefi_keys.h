@@ -31,5 +31,7 @@
 #define __UEFI_KEYS_H__
 
 int uefi_combo_key(enum combo_keys combo);
+EFI_STATUS uefi_keys_start_sampling(void);
+void uefi_keys_stop_sampling(void);
 
 #endif /* __UEFI_KEYS_H__ */
@@ -32,6 +32,9 @@
 #include <fs.h>
 #include "efilinux.h"
 #include "protocol.h"
+#include "uefi_utils.h"
+#include "io_stats.h"
+#include "platform/x86.h"
 
 extern EFI_GUID GraphicsOutputProtocol;
 
@@ -294,6 +297,30 @@ EFI_STATUS find_device_partition(const EFI_GUID *guid, EFI_HANDLE **handles, UIN
 	return ret;
 }
 
+/**
+ * get_partition_guid - return the GPT unique GUID of the partition
+ * @handle, from its hard drive device path node
+ *
+ * The GUID points into the device path, NULL when @handle is not a
+ * GPT partition.
+ */
+EFI_GUID *get_partition_guid(EFI_HANDLE handle)
+{
+	EFI_DEVICE_PATH *path;
+
+	for (path = DevicePathFromHandle(handle); path && !IsDevicePathEnd(path);
+	     path = NextDevicePathNode(path)) {
+		HARDDRIVE_DEVICE_PATH *hd = (HARDDRIVE_DEVICE_PATH *)path;
+
+		if (DevicePathType(path) == MEDIA_DEVICE_PATH &&
+		    DevicePathSubType(path) == MEDIA_HARDDRIVE_DP &&
+		    hd->SignatureType == SIGNATURE_TYPE_GUID)
+			return (EFI_GUID *)hd->Signature;
+	}
+
+	return NULL;
+}
+
 EFI_STATUS get_esp_handle(EFI_HANDLE **esp)
 {
 	EFI_STATUS ret;
@@ -367,47 +394,85 @@ EFI_STATUS get_esp_fs(EFI_FILE_IO_INTERFACE **esp_fs)
 	return ret;
 }
 
-EFI_STATUS uefi_read_file(EFI_FILE_IO_INTERFACE *io, CHAR16 *filename, void **data, UINTN *size)
+/* Size of the reads issued to the file system by uefi_file_read_at() */
+#define READ_CHUNK_SIZE		(1024 * 1024)
+
+EFI_STATUS uefi_file_size(EFI_FILE *file, UINT64 *size)
 {
-	EFI_STATUS ret;
 	EFI_FILE_INFO *info;
-	UINTN info_size;
-	EFI_FILE *file;
 
-	ret = uefi_call_wrapper(io->OpenVolume, 2, io, &file);
-	if (EFI_ERROR(ret))
-		goto out;
+	info = LibFileInfo(file);
+	if (!info)
+		return EFI_UNSUPPORTED;
+
+	*size = info->FileSize;
+	FreePool(info);
+
+	return EFI_SUCCESS;
+}
 
-	ret = uefi_call_wrapper(file->Open, 5, file, &file, filename, EFI_FILE_MODE_READ, 0);
+/**
+ * uefi_file_read_at - Read part of a file into a caller supplied buffer
+ * @file: the file to read
+ * @offset: file offset to read from
+ * @buf: destination buffer
+ * @size: size of @buf, updated with the number of bytes read
+ *
+ * Reads stop at the end of the file, they are issued in pieces of at
+ * most READ_CHUNK_SIZE bytes.
+ */
+EFI_STATUS uefi_file_read_at(EFI_FILE *file, UINT64 offset, void *buf, UINTN *size)
+{
+	EFI_STATUS ret;
+	UINTN done = 0, len;
+
+	ret = uefi_call_wrapper(file->SetPosition, 2, file, offset);
 	if (EFI_ERROR(ret))
 		goto out;
 
-	info_size = SIZE_OF_EFI_FILE_INFO + 200;
+	while (done < *size) {
+		len = *size - done;
+		if (len > READ_CHUNK_SIZE)
+			len = READ_CHUNK_SIZE;
 
-	info = malloc(info_size);
-	if (!info)
-		goto close;
+		ret = io_file_read(file, &len, (CHAR8 *)buf + done);
+		if (EFI_ERROR(ret) || !len)
+			break;
+		done += len;
+	}
+
+out:
+	*size = done;
+	return ret;
+}
+
+EFI_STATUS uefi_read_file(EFI_FILE_IO_INTERFACE *io, CHAR16 *filename, void **data, UINTN *size)
+{
+	EFI_STATUS ret;
+	EFI_FILE *file;
+	UINT64 file_size;
 
-	ret = uefi_call_wrapper(file->GetInfo, 4, file, &GenericFileInfo, &info_size, info);
+	ret = uefi_open_file(io, filename, EFI_FILE_MODE_READ, &file);
 	if (EFI_ERROR(ret))
-		goto free_info;
+		goto out;
 
-	*size = info->FileSize;
-	*data = malloc(*size);
+	ret = uefi_file_size(file, &file_size);
+	if (EFI_ERROR(ret))
+		goto close;
 
-retry:
-	ret = uefi_call_wrapper(file->Read, 3, file, size, *data);
-	if (ret == EFI_BUFFER_TOO_SMALL) {
-		free(*data);
-		*data = malloc(*size);
-		goto retry;
+	*size = file_size;
+	*data = malloc(*size ? *size : 1);
+	if (!*data) {
+		ret = EFI_OUT_OF_RESOURCES;
+		goto close;
 	}
 
+	ret = uefi_file_read_at(file, 0, *data, size);
+	if (!EFI_ERROR(ret) && *size != file_size)
+		ret = EFI_END_OF_FILE;
 	if (EFI_ERROR(ret))
 		free(*data);
 
-free_info:
-	free(info);
 close:
 	uefi_call_wrapper(file->Close, 1, file);
 out:
@@ -424,7 +489,7 @@ EFI_STATUS gop_display_blt(EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Blt, UINTN blt_size, U
 	UINTN posx, posy = 0;
 	EFI_STATUS ret;
 
-	ret = LibLocateProtocol(&GraphicsOutputProtocol, (void **)&gop);
+	ret = uefi_locate_protocol(&GraphicsOutputProtocol, (void **)&gop);
  	if (EFI_ERROR(ret) || !gop)
 		goto out;
 
@@ -445,6 +510,27 @@ out:
 	return ret;
 }
 
+EFI_STATUS uefi_open_file(EFI_FILE_IO_INTERFACE *io, CHAR16 *filename,
+			  UINT64 mode, EFI_FILE **file)
+{
+	EFI_STATUS ret;
+	EFI_FILE *root;
+
+	ret = uefi_call_wrapper(io->OpenVolume, 2, io, &root);
+	if (EFI_ERROR(ret))
+		goto out;
+
+	ret = uefi_call_wrapper(root->Open, 5, root, file, filename, mode, 0);
+	uefi_call_wrapper(root->Close, 1, root);
+	if (!EFI_ERROR(ret))
+		io_stats_open_file(*file, filename);
+
+out:
+	if (EFI_ERROR(ret))
+		error(L"Failed to open file %s:%r\n", filename, ret);
+	return ret;
+}
+
 EFI_STATUS uefi_write_file(EFI_FILE_IO_INTERFACE *io, CHAR16 *filename, void *data, UINTN *size)
 {
 	EFI_STATUS ret;
@@ -458,7 +544,8 @@ EFI_STATUS uefi_write_file(EFI_FILE_IO_INTERFACE *io, CHAR16 *filename, void *da
 	if (EFI_ERROR(ret))
 		goto out;
 
-	ret = uefi_call_wrapper(file->Write, 3, file, size, data);
+	io_stats_open_file(file, filename);
+	ret = io_file_write(file, size, data);
 	uefi_call_wrapper(file->Close, 1, file);
 
 out:
@@ -467,6 +554,124 @@ out:
 	return ret;
 }
 
+/**
+ * uefi_stream_open - Create @filename and open it for buffered writes
+ * @stream: the stream to initialize
+ * @io: file system of the file
+ * @filename: path of the file, a previous file is replaced
+ * @buf_size: size of the writes issued to the file system
+ */
+EFI_STATUS uefi_stream_open(struct uefi_stream *stream, EFI_FILE_IO_INTERFACE *io,
+			    CHAR16 *filename, UINTN buf_size)
+{
+	EFI_STATUS ret;
+
+	memset(stream, 0, sizeof(*stream));
+
+	/* A file opened with EFI_FILE_MODE_CREATE keeps its old content */
+	if (uefi_exist_file_root(io, filename))
+		uefi_delete_file(io, filename);
+
+	stream->buf = malloc(buf_size);
+	if (!stream->buf)
+		return EFI_OUT_OF_RESOURCES;
+	stream->buf_size = buf_size;
+
+	ret = uefi_open_file(io, filename, EFI_FILE_MODE_READ |
+			     EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE,
+			     &stream->file);
+	if (EFI_ERROR(ret)) {
+		free(stream->buf);
+		stream->buf = NULL;
+	}
+
+	return ret;
+}
+
+static EFI_STATUS uefi_stream_flush(struct uefi_stream *stream)
+{
+	EFI_STATUS ret;
+	UINTN size = stream->used;
+
+	if (EFI_ERROR(stream->status) || !size)
+		return stream->status;
+
+	ret = io_file_write(stream->file, &size, stream->buf);
+	if (!EFI_ERROR(ret) && size != stream->used)
+		ret = EFI_VOLUME_FULL;
+
+	stream->used = 0;
+	stream->status = ret;
+	return ret;
+}
+
+EFI_STATUS uefi_stream_write(struct uefi_stream *stream, const void *data, UINTN size)
+{
+	const CHAR8 *p = data;
+	UINTN len;
+
+	while (size && !EFI_ERROR(stream->status)) {
+		len = stream->buf_size - stream->used;
+		if (len > size)
+			len = size;
+		memcpy(stream->buf + stream->used, p, len);
+		stream->used += len;
+		stream->offset += len;
+		p += len;
+		size -= len;
+
+		if (stream->used == stream->buf_size)
+			uefi_stream_flush(stream);
+	}
+
+	return stream->status;
+}
+
+/**
+ * uefi_stream_write_at - Overwrite already streamed data
+ * @stream: the stream
+ * @offset: file offset of the data to overwrite
+ * @data: new data
+ * @size: size of @data
+ *
+ * The stream is flushed first and the stream position is left
+ * unchanged, this is meant for headers completed at the end.
+ */
+EFI_STATUS uefi_stream_write_at(struct uefi_stream *stream, UINT64 offset,
+				const void *data, UINTN size)
+{
+	EFI_STATUS ret;
+	UINTN written = size;
+
+	ret = uefi_stream_flush(stream);
+	if (EFI_ERROR(ret))
+		return ret;
+
+	ret = uefi_call_wrapper(stream->file->SetPosition, 2, stream->file, offset);
+	if (!EFI_ERROR(ret))
+		ret = io_file_write(stream->file, &written, (void *)data);
+	if (!EFI_ERROR(ret) && written != size)
+		ret = EFI_VOLUME_FULL;
+	if (!EFI_ERROR(ret))
+		ret = uefi_call_wrapper(stream->file->SetPosition, 2,
+					stream->file, stream->offset);
+
+	stream->status = ret;
+	return ret;
+}
+
+EFI_STATUS uefi_stream_close(struct uefi_stream *stream)
+{
+	EFI_STATUS ret;
+
+	ret = uefi_stream_flush(stream);
+	uefi_call_wrapper(stream->file->Close, 1, stream->file);
+	free(stream->buf);
+	stream->buf = NULL;
+
+	return ret;
+}
+
 void uefi_reset_system(EFI_RESET_TYPE reset_type)
 {
 	uefi_call_wrapper(RT->ResetSystem, 4, reset_type,
@@ -595,6 +800,81 @@ EFI_STATUS uefi_file_get_size(EFI_HANDLE image, CHAR16 *filename, UINT64 *size)
 	return ret;
 }
 
+/* The last image called by uefi_call_image(), kept in memory so that
+ * calling it again does not read it from the file system again */
+static struct {
+	CHAR16 *filename;
+	VOID *data;
+	UINTN size;
+} image_cache;
+
+static EFI_STATUS image_cache_load(EFI_HANDLE parent_image, CHAR16 *filename)
+{
+	EFI_STATUS ret;
+	EFI_LOADED_IMAGE *info;
+	struct file *file;
+	UINT64 fsize;
+	UINTN size;
+	VOID *data;
+	CHAR16 *name;
+
+	if (image_cache.filename && !StrCmp(image_cache.filename, filename))
+		return EFI_SUCCESS;
+
+	ret = handle_protocol(parent_image, &LoadedImageProtocol, (void **)&info);
+	if (EFI_ERROR(ret)) {
+		error(L"HandleProtocol %s (%r)\n", filename, ret);
+		return ret;
+	}
+
+	ret = file_open(info, filename, &file);
+	if (EFI_ERROR(ret)) {
+		error(L"FileOpen %s (%r)\n", filename, ret);
+		return ret;
+	}
+
+	ret = file_size(file, &fsize);
+	if (EFI_ERROR(ret)) {
+		error(L"FileSize %s (%r)\n", filename, ret);
+		goto close;
+	}
+
+	size = fsize;
+	data = malloc(size);
+	if (!data) {
+		ret = EFI_OUT_OF_RESOURCES;
+		goto close;
+	}
+
+	ret = file_read(file, &size, data);
+	if (EFI_ERROR(ret) || size != fsize) {
+		error(L"FileRead %s (%r)\n", filename, ret);
+		free(data);
+		if (!EFI_ERROR(ret))
+			ret = EFI_END_OF_FILE;
+		goto close;
+	}
+
+	name = StrDuplicate(filename);
+	if (!name) {
+		free(data);
+		ret = EFI_OUT_OF_RESOURCES;
+		goto close;
+	}
+
+	if (image_cache.filename) {
+		FreePool(image_cache.filename);
+		free(image_cache.data);
+	}
+	image_cache.filename = name;
+	image_cache.data = data;
+	image_cache.size = size;
+
+close:
+	file_close(file);
+	return ret;
+}
+
 EFI_STATUS uefi_call_image(
 	IN EFI_HANDLE parent_image,
 	IN EFI_HANDLE device,
@@ -604,7 +884,6 @@ EFI_STATUS uefi_call_image(
 {
 	EFI_STATUS ret;
 	EFI_DEVICE_PATH *path;
-	UINT64 size;
 	EFI_HANDLE image;
 
 	debug(L"Call image file %s\n", filename);
@@ -614,14 +893,12 @@ EFI_STATUS uefi_call_image(
 		return EFI_INVALID_PARAMETER;
 	}
 
-	ret = uefi_file_get_size(parent_image, filename, &size);
-	if (EFI_ERROR(ret)) {
-		error(L"GetSize %s (%r)\n", filename, ret);
+	ret = image_cache_load(parent_image, filename);
+	if (EFI_ERROR(ret))
 		goto out;
-	}
 
 	ret = uefi_call_wrapper(BS->LoadImage, 6, FALSE, parent_image, path,
-				NULL, size, &image);
+				image_cache.data, image_cache.size, &image);
 	if (EFI_ERROR(ret)) {
 		error(L"LoadImage %s (%r)\n", filename, ret);
 		goto out;
@@ -632,6 +909,9 @@ EFI_STATUS uefi_call_image(
 	if (EFI_ERROR(ret))
 		info(L"StartImage returned error %s (%r)\n", filename, ret);
 
+	/* The image may have uninstalled or reinstalled protocols */
+	uefi_protocol_cache_invalidate();
+
 out:
 	if (path)
 		FreePool(path);
@@ -639,12 +919,15 @@ out:
 	return ret;
 }
 
+UINT32 uefi_fw_calls;
+
 EFI_STATUS uefi_set_simple_var(char *name, EFI_GUID *guid, int size, void *data,
 			       BOOLEAN persistent)
 {
 	EFI_STATUS ret;
 	CHAR16 *name16 = stra_to_str((CHAR8 *)name);
 
+	uefi_fw_calls++;
 	if (persistent)
 		ret = LibSetNVVariable(name16, guid, size, data);
 	else
@@ -660,6 +943,8 @@ INT8 uefi_get_simple_var(char *name, EFI_GUID *guid)
 	UINT64 ret;
 	UINTN size;
 	CHAR16 *name16 = stra_to_str((CHAR8 *)name);
+
+	uefi_fw_calls++;
 	buffer = LibGetVariableAndSize(name16, guid, &size);
 
 	if (buffer == NULL) {
@@ -682,3 +967,81 @@ out:
 		free(buffer);
 	return ret;
 }
+
+/* Protocols are looked up again and again and each lookup walks the
+ * firmware handle database. The interfaces do not change while the
+ * loader runs alone, the cache is dropped when another image is started
+ * and at ExitBootServices. Failed lookups are not cached, the protocol
+ * may be installed later. The graphics output is never cached, it is
+ * reinstalled whenever the consoles are reconnected. */
+#define PROTOCOL_CACHE_SIZE	16
+
+static struct {
+	EFI_GUID guid;
+	VOID *interface;
+} protocol_cache[PROTOCOL_CACHE_SIZE];
+static UINTN protocol_cache_len;
+
+static struct {
+	UINTN hits;
+	UINTN misses;
+	UINT64 miss_cycles;
+} protocol_cache_stats;
+
+/**
+ * uefi_locate_protocol - LibLocateProtocol() through the protocol cache
+ * @guid: protocol GUID
+ * @interface: where the first interface found is stored
+ */
+EFI_STATUS uefi_locate_protocol(EFI_GUID *guid, VOID **interface)
+{
+	EFI_STATUS ret;
+	UINT64 start;
+	UINTN i;
+
+	for (i = 0; i < protocol_cache_len; i++)
+		if (!memcmp(&protocol_cache[i].guid, guid, sizeof(*guid))) {
+			protocol_cache_stats.hits++;
+			*interface = protocol_cache[i].interface;
+			return EFI_SUCCESS;
+		}
+
+	uefi_fw_calls++;
+	start = rdtsc();
+	ret = LibLocateProtocol(guid, interface);
+	protocol_cache_stats.miss_cycles += rdtsc() - start;
+	protocol_cache_stats.misses++;
+	if (EFI_ERROR(ret) || !*interface)
+		return ret;
+
+	if (!memcmp(guid, &GraphicsOutputProtocol, sizeof(*guid)))
+		return EFI_SUCCESS;
+
+	if (protocol_cache_len < PROTOCOL_CACHE_SIZE) {
+		memcpy(&protocol_cache[protocol_cache_len].guid, guid, sizeof(*guid));
+		protocol_cache[protocol_cache_len].interface = *interface;
+		protocol_cache_len++;
+	}
+
+	return EFI_SUCCESS;
+}
+
+/**
+ * uefi_protocol_cache_invalidate - drop the cached interfaces, they are
+ * not valid anymore once another image has run or boot services are
+ * exited
+ */
+void uefi_protocol_cache_invalidate(void)
+{
+	UINT64 saved = 0;
+
+	if (protocol_cache_stats.misses)
+		saved = protocol_cache_stats.hits *
+			(protocol_cache_stats.miss_cycles / protocol_cache_stats.misses);
+
+	debug(L"Protocol cache: %d lookups, %d hits, %ld cycles spent, ~%ld cycles saved\n",
+	      protocol_cache_stats.hits + protocol_cache_stats.misses,
+	      protocol_cache_stats.hits, protocol_cache_stats.miss_cycles, saved);
+
+	protocol_cache_len = 0;
+}
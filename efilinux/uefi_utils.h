@@ -35,14 +35,36 @@ struct EFI_LOAD_OPTION {
 	UINT16 FilePathListLength;
 } __attribute__((packed));
 
+/* Buffered sequential writer, the file is written in writes of the
+ * buffer size whatever the size of the individual stream writes */
+struct uefi_stream {
+	EFI_FILE *file;
+	CHAR8 *buf;
+	UINTN buf_size;
+	UINTN used;
+	UINT64 offset;		/* Stream position, buffered data included */
+	EFI_STATUS status;	/* First error, later writes are dropped */
+};
+
 EFI_STATUS ConvertBmpToGopBlt (VOID *BmpImage, UINTN BmpImageSize,
 			       VOID **GopBlt, UINTN *GopBltSize,
 			       UINTN *PixelHeight, UINTN *PixelWidth);
 EFI_STATUS gop_display_blt(EFI_GRAPHICS_OUTPUT_BLT_PIXEL *Blt, UINTN blt_size, UINTN height, UINTN width);
+EFI_GUID *get_partition_guid(EFI_HANDLE handle);
 EFI_STATUS get_esp_handle(EFI_HANDLE **esp);
 EFI_STATUS get_esp_fs(EFI_FILE_IO_INTERFACE **esp_fs);
+EFI_STATUS uefi_file_size(EFI_FILE *file, UINT64 *size);
+EFI_STATUS uefi_file_read_at(EFI_FILE *file, UINT64 offset, void *buf, UINTN *size);
 EFI_STATUS uefi_read_file(EFI_FILE_IO_INTERFACE *io, CHAR16 *filename, void **data, UINTN *size);
+EFI_STATUS uefi_open_file(EFI_FILE_IO_INTERFACE *io, CHAR16 *filename,
+			  UINT64 mode, EFI_FILE **file);
 EFI_STATUS uefi_write_file(EFI_FILE_IO_INTERFACE *io, CHAR16 *filename, void *data, UINTN *size);
+EFI_STATUS uefi_stream_open(struct uefi_stream *stream, EFI_FILE_IO_INTERFACE *io,
+			    CHAR16 *filename, UINTN buf_size);
+EFI_STATUS uefi_stream_write(struct uefi_stream *stream, const void *data, UINTN size);
+EFI_STATUS uefi_stream_write_at(struct uefi_stream *stream, UINT64 offset,
+				const void *data, UINTN size);
+EFI_STATUS uefi_stream_close(struct uefi_stream *stream);
 EFI_STATUS find_device_partition(const EFI_GUID *guid, EFI_HANDLE **handles, UINTN *no_handles);
 void uefi_reset_system(EFI_RESET_TYPE reset_type);
 void uefi_shutdown(void);
@@ -57,5 +79,11 @@ EFI_STATUS uefi_call_image(IN EFI_HANDLE parent_image, IN EFI_HANDLE device,
 EFI_STATUS uefi_set_simple_var(char *name, EFI_GUID *guid, int size, void *data,
 			       BOOLEAN persistent);
 INT8 uefi_get_simple_var(char *name, EFI_GUID *guid);
+EFI_STATUS uefi_locate_protocol(EFI_GUID *guid, VOID **interface);
+
+/* Firmware services called so far, counted at the call sites of the
+ * variable, protocol lookup, device info and key services */
+extern UINT32 uefi_fw_calls;
+void uefi_protocol_cache_invalidate(void);
 
 #endif /* __UEFI_UTILS_H__ */
@@ -29,6 +29,8 @@
  */
 
 #include "utils.h"
+#include "fw_trace.h"
+#include "io_stats.h"
 
 EFI_STATUS str_to_stra(CHAR8 *dst, CHAR16 *src, UINTN len)
 {
@@ -148,16 +150,11 @@ void copy_and_swap_guid(EFI_GUID *dst, const EFI_GUID *src)
         dst->Data3 = swap_bytes16(src->Data3);
 }
 
-EFI_STATUS open_partition(
+EFI_STATUS locate_partition(
                 IN const EFI_GUID *guid,
-                OUT UINT32 *MediaIdPtr,
-                OUT EFI_BLOCK_IO **BlockIoPtr,
-                OUT EFI_DISK_IO **DiskIoPtr)
+                OUT EFI_HANDLE *HandlePtr)
 {
         EFI_STATUS ret;
-        EFI_BLOCK_IO *BlockIo;
-        EFI_DISK_IO *DiskIo;
-        UINT32 MediaId;
         UINTN NoHandles = 0;
         EFI_HANDLE *HandleBuffer = NULL;
 
@@ -191,33 +188,67 @@ EFI_STATUS open_partition(
                 goto out;
         }
 
+        *HandlePtr = HandleBuffer[0];
+out:
+        FreePool(HandleBuffer);
+        return ret;
+}
+
+EFI_STATUS open_partition_handle(
+                IN EFI_HANDLE Handle,
+                OUT UINT32 *MediaIdPtr,
+                OUT EFI_BLOCK_IO **BlockIoPtr,
+                OUT EFI_DISK_IO **DiskIoPtr)
+{
+        EFI_STATUS ret;
+        EFI_BLOCK_IO *BlockIo;
+        EFI_DISK_IO *DiskIo;
+
 	/* In Fast boot mode, only ESP device is connected to protocols.
 	 * We need to specificallty connect the device in order to use it's DiskIoProtocol
 	 */
-	uefi_call_wrapper(BS->ConnectController, 4, HandleBuffer[0], NULL, NULL, TRUE);
+	uefi_call_wrapper(BS->ConnectController, 4, Handle, NULL, NULL, TRUE);
 
         /* Instantiate BlockIO and DiskIO protocols so we can read various data */
-        ret = uefi_call_wrapper(BS->HandleProtocol, 3, HandleBuffer[0],
+        ret = uefi_call_wrapper(BS->HandleProtocol, 3, Handle,
                         &BlockIoProtocol,
                         (void **)&BlockIo);
         if (EFI_ERROR(ret)) {
                 error(L"HandleProtocol (BlockIoProtocol)\n", ret);
-                goto out;;
+                return ret;
         }
-        ret = uefi_call_wrapper(BS->HandleProtocol, 3, HandleBuffer[0],
+        ret = uefi_call_wrapper(BS->HandleProtocol, 3, Handle,
                         &DiskIoProtocol, (void **)&DiskIo);
         if (EFI_ERROR(ret)) {
                 error(L"HandleProtocol (DiskIoProtocol)\n", ret);
-                goto out;
+                return ret;
         }
-        MediaId = BlockIo->Media->MediaId;
 
-        *MediaIdPtr = MediaId;
+        io_stats_open_partition(Handle, DiskIo);
+#ifdef CONFIG_FW_TRACE
+        fw_trace_disk_io(Handle, DiskIo);
+#endif
+
+        *MediaIdPtr = BlockIo->Media->MediaId;
         *BlockIoPtr = BlockIo;
         *DiskIoPtr = DiskIo;
-out:
-        FreePool(HandleBuffer);
-        return ret;
+        return EFI_SUCCESS;
+}
+
+EFI_STATUS open_partition(
+                IN const EFI_GUID *guid,
+                OUT UINT32 *MediaIdPtr,
+                OUT EFI_BLOCK_IO **BlockIoPtr,
+                OUT EFI_DISK_IO **DiskIoPtr)
+{
+        EFI_STATUS ret;
+        EFI_HANDLE Handle;
+
+        ret = locate_partition(guid, &Handle);
+        if (EFI_ERROR(ret))
+                return ret;
+
+        return open_partition_handle(Handle, MediaIdPtr, BlockIoPtr, DiskIoPtr);
 }
 
 void path_to_dos(CHAR16 *path)
@@ -229,47 +260,6 @@ void path_to_dos(CHAR16 *path)
 	}
 }
 
-/* Return a newly allocated string containing the concatenation of the
- * two parameters with a space between them
- *
- * return NULL if the two strings are empty or the allocation failed,
- */
-CHAR8 *append_strings(CHAR8 *s1, CHAR8 *s2)
-{
-	INTN len_s1;
-	INTN len_s2;
-	BOOLEAN space;
-	CHAR8 *new;
-
-	len_s1 = s1 ? strlena(s1) : 0;
-	len_s2 = s2 ? strlena(s2) : 0;
-	space = s1 && s2;
-
-	if (!s1 && !s2)
-		return NULL;
-
-	new = AllocatePool(len_s1 + len_s2 + 1 + space);
-	if (!new) {
-		error(L"Failed to allocate new command line\n");
-		return NULL;
-	}
-
-	UINTN i = 0;
-	if (s1) {
-		memcpy(new, s1, len_s1);
-		i += len_s1;
-	}
-	if (space)
-		new[i++] = ' ';
-	if (s2) {
-		memcpy(new + i, s2, len_s2);
-		i += len_s2;
-	}
-
-	new[i] = '\0';
-	return new;
-}
-
 static INTN to_digit(CHAR16 c, UINTN base)
 {
 	INTN value = -1;
@@ -48,13 +48,20 @@ EFI_STATUS string_to_guid(IN CHAR16 *in_guid_str, OUT EFI_GUID *guid);
 UINT32 swap_bytes32(UINT32 n);
 UINT16 swap_bytes16(UINT16 n);
 void copy_and_swap_guid(EFI_GUID *dst, const EFI_GUID *src);
+EFI_STATUS locate_partition(
+                IN const EFI_GUID *guid,
+                OUT EFI_HANDLE *HandlePtr);
+EFI_STATUS open_partition_handle(
+                IN EFI_HANDLE Handle,
+                OUT UINT32 *MediaIdPtr,
+                OUT EFI_BLOCK_IO **BlockIoPtr,
+                OUT EFI_DISK_IO **DiskIoPtr);
 EFI_STATUS open_partition(
                 IN const EFI_GUID *guid,
                 OUT UINT32 *MediaIdPtr,
                 OUT EFI_BLOCK_IO **BlockIoPtr,
                 OUT EFI_DISK_IO **DiskIoPtr);
 void path_to_dos(CHAR16 *path);
-CHAR8 *append_strings(CHAR8 *s1, CHAR8 *s2);
 UINTN strtoul(const CHAR16 *nptr, CHAR16 **endptr, UINTN base);
 
 /* Basic port I/O */
@@ -37,28 +37,13 @@
 #include "log.h"
 #include "protocol.h"
 #include "config.h"
+#include "stdlib.h"
+#include "crc32c.h"
+#include "lz4.h"
+#include "warmdump_format.h"
 
 #define FILE_SEP L"\\"
 
-#ifndef WARMDUMP_BUILD_STRING
-#define WARMDUMP_BUILD_STRING L"undef"
-#endif
-
-#ifndef WARMDUMP_VERSION_STRING
-#define WARMDUMP_VERSION_STRING L"undef"
-#endif
-
-#ifndef WARMDUMP_VERSION_DATE
-#define WARMDUMP_VERSION_DATE L"undef"
-#endif
-
-#define WARMDUMP_BANNER L"version %d.%d %s %s %s\n"
-
-EFI_SYSTEM_TABLE *sys_table;
-EFI_BOOT_SERVICES *boot;
-EFI_HANDLE efilinux_image;
-EFI_HANDLE main_image_handle;
-
 static BOOLEAN need_backup()
 {
 	enum reset_types rt;
@@ -122,35 +107,253 @@ static enum lm_pdm_dfx_setting lm_get_pdm_dfx_setting(void)
 	return ((BiosConfig & 0x00030000) >> 16);
 }
 
+/*
+ * MemWrPnt and OStat describe the ring at LmOutputAddr, which Lakemore
+ * writes to again since the reset. The ring saved before the reset is
+ * the copy right after it, and no write pointer of that copy survives
+ * the reset, so the whole saved ring is dumped.
+ */
 static void lm_get_backup_data(void **backup_addr, UINT32 *backup_size)
 {
-	UINT32 MemDepth;
+	UINT32 MemDepth, MemWrPnt, OStat;
 	EFI_PHYSICAL_ADDRESS LmOutputAddr;
 
 	MemDepth = VlvMsgBusReadDfxLM(LM_MEMDEPTH);
 	LmOutputAddr = VlvMsgBusReadDfxLM(LM_STORMEMBAR_H);
 	LmOutputAddr = LmOutputAddr << 32;
 	LmOutputAddr |= VlvMsgBusReadDfxLM(LM_STORMEMBAR_L);
+	MemWrPnt = VlvMsgBusReadDfxLM(LM_MEMWRPNT);
+	OStat = VlvMsgBusReadDfxLM(LM_OSTAT);
 
 	info(L"MemDepth:%x\n", MemDepth);
 	info(L"LmOutputAddr:%x\n", LmOutputAddr);
+	info(L"MemWrPnt:%x OStat:%x\n", MemWrPnt, OStat);
 
 	*backup_size = MemDepth << 13; // x 8kB
 	*backup_addr = (void*)(UINTN)(LmOutputAddr + *backup_size); // start after current buffer
 }
 
-static EFI_STATUS data_write_to_file(EFI_FILE_IO_INTERFACE *io, CHAR16 *filename,
-				     void *data, UINTN size)
+/* Size of the writes to the ESP, large sequential writes are much
+ * faster than small ones on eMMC */
+#define DUMP_WRITE_SIZE		(256 * 1024)
+
+/* Live parts of a memory region to dump, directly as the chunk table
+ * of its container */
+struct dump {
+	CHAR8 *name;
+	UINT32 region_size;
+	UINT32 count;
+	UINT32 max;
+	struct wd_chunk *chunks;
+	EFI_STATUS status;
+};
+
+static void dump_init(struct dump *dump, CHAR8 *name, UINT32 region_size)
 {
-	EFI_STATUS ret = EFI_SUCCESS;
-	UINTN written_size = size;
+	memset(dump, 0, sizeof(*dump));
+	dump->name = name;
+	dump->region_size = region_size;
+}
 
-	debug(L"Writing data to ESP in file %s\n", filename);
-	ret = uefi_write_file(io, filename, data, &written_size);
-	if (size != written_size)
-		error(L"Written %d/%d bytes\n", written_size, size);
+static void dump_free(struct dump *dump)
+{
+	if (dump->chunks)
+		free(dump->chunks);
+	dump->chunks = NULL;
+}
+
+static EFI_STATUS dump_grow(struct dump *dump)
+{
+	struct wd_chunk *chunks;
+	UINT32 max = dump->max ? dump->max * 2 : 64;
+
+	chunks = malloc(max * sizeof(*chunks));
+	if (!chunks)
+		return EFI_OUT_OF_RESOURCES;
+
+	if (dump->chunks) {
+		memcpy(chunks, dump->chunks, dump->count * sizeof(*chunks));
+		free(dump->chunks);
+	}
+	dump->chunks = chunks;
+	dump->max = max;
+	return EFI_SUCCESS;
+}
+
+/* Add [@offset, @offset + @size) to the dump, growing the previous
+ * chunk when contiguous and cutting at WD_CHUNK_SIZE */
+static void dump_add(struct dump *dump, UINT32 offset, UINT32 size)
+{
+	struct wd_chunk *chunk;
+	UINT32 len;
+
+	while (size && !EFI_ERROR(dump->status)) {
+		chunk = dump->count ? &dump->chunks[dump->count - 1] : NULL;
+		if (!chunk || chunk->offset + chunk->size != offset ||
+		    chunk->size == WD_CHUNK_SIZE) {
+			if (dump->count == dump->max) {
+				dump->status = dump_grow(dump);
+				if (EFI_ERROR(dump->status))
+					return;
+			}
+			chunk = &dump->chunks[dump->count++];
+			memset(chunk, 0, sizeof(*chunk));
+			chunk->offset = offset;
+		}
+
+		len = WD_CHUNK_SIZE - chunk->size;
+		if (len > size)
+			len = size;
+		chunk->size += len;
+		offset += len;
+		size -= len;
+	}
+}
+
+static void dump_write_chunk(struct uefi_stream *stream, struct wd_chunk *chunk,
+			     CHAR8 *data, UINT8 *lz4_buf)
+{
+	UINTN stored;
+
+	chunk->crc = crc32c(0, data, chunk->size);
+	chunk->file_offset = stream->offset;
+	chunk->flags = 0;
+
+	stored = lz4_compress(data, chunk->size, lz4_buf,
+			      LZ4_COMPRESS_BOUND(WD_CHUNK_SIZE));
+	if (stored && stored < chunk->size) {
+		chunk->flags |= WD_CHUNK_LZ4;
+		chunk->stored_size = stored;
+		uefi_stream_write(stream, lz4_buf, stored);
+	} else {
+		chunk->stored_size = chunk->size;
+		uefi_stream_write(stream, data, chunk->size);
+	}
+}
+
+static EFI_STATUS dump_write_to_file(EFI_FILE_IO_INTERFACE *io, CHAR16 *filename,
+				     struct dump *dump, void *region)
+{
+	EFI_STATUS ret;
+	struct uefi_stream stream;
+	struct wd_header header;
+	struct wd_region wd_region;
+	struct wd_chunk *chunks = dump->chunks;
+	UINT8 *lz4_buf = NULL;
+	UINT32 i, count = dump->count;
+	UINTN chunks_size = count * sizeof(*chunks);
+
+	if (EFI_ERROR(dump->status))
+		return dump->status;
+
+	debug(L"Writing %d chunks to ESP in file %s\n", count, filename);
+
+	lz4_buf = malloc(LZ4_COMPRESS_BOUND(WD_CHUNK_SIZE));
+	if (!lz4_buf)
+		return EFI_OUT_OF_RESOURCES;
+
+	ret = uefi_stream_open(&stream, io, filename, DUMP_WRITE_SIZE);
 	if (EFI_ERROR(ret))
+		goto out;
+
+	// Placeholder, the header is completed once the tables are written
+	memset(&header, 0, sizeof(header));
+	uefi_stream_write(&stream, &header, sizeof(header));
+
+	for (i = 0; i < count; i++)
+		dump_write_chunk(&stream, &chunks[i],
+				 (CHAR8 *)region + chunks[i].offset, lz4_buf);
+
+	memset(&wd_region, 0, sizeof(wd_region));
+	memcpy(wd_region.name, dump->name, strlena(dump->name) + 1);
+	wd_region.address = (UINTN)region;
+	wd_region.size = dump->region_size;
+	wd_region.chunk_count = count;
+
+	header.magic = WD_MAGIC;
+	header.version = WD_VERSION;
+	header.header_size = sizeof(header);
+	header.region_count = 1;
+	header.chunk_count = count;
+	header.region_table = stream.offset;
+	uefi_stream_write(&stream, &wd_region, sizeof(wd_region));
+	header.chunk_table = stream.offset;
+	uefi_stream_write(&stream, chunks, chunks_size);
+	header.table_crc = crc32c(crc32c(0, &wd_region, sizeof(wd_region)),
+				  chunks, chunks_size);
+	header.header_crc = crc32c(0, &header, sizeof(header));
+
+	uefi_stream_write_at(&stream, 0, &header, sizeof(header));
+	ret = uefi_stream_close(&stream);
+
+	if (EFI_ERROR(ret)) {
 		error(L"Failed to write file %s: %r\n", filename, ret);
+	} else {
+		info(L"Dumped %d chunks of 0x%x bytes region to %s, 0x%x bytes\n",
+		     count, dump->region_size, filename, header.chunk_table + chunks_size);
+	}
+
+out:
+	free(lz4_buf);
+	return ret;
+}
+
+static EFI_STATUS check_header(struct wd_header *header, UINT64 file_size)
+{
+	struct wd_header h = *header;
+	UINT32 crc = h.header_crc;
+
+	h.header_crc = 0;
+	if (h.magic != WD_MAGIC || h.version != WD_VERSION ||
+	    h.header_size != sizeof(h) || crc32c(0, &h, sizeof(h)) != crc)
+		return EFI_COMPROMISED_DATA;
+
+	if (h.region_count != 1 ||
+	    file_size < sizeof(h) + sizeof(struct wd_region) ||
+	    h.region_table > file_size - sizeof(struct wd_region) ||
+	    h.chunk_table != h.region_table + sizeof(struct wd_region) ||
+	    h.chunk_count > (file_size - h.chunk_table) / sizeof(struct wd_chunk))
+		return EFI_COMPROMISED_DATA;
+
+	return EFI_SUCCESS;
+}
+
+/* Restore a chunk in place: raw chunks are read straight to RAM, LZ4
+ * chunks go through @staging and are decompressed to RAM */
+static EFI_STATUS restore_chunk(EFI_FILE *file, UINT64 file_size,
+				struct wd_chunk *chunk, CHAR8 *addr, UINTN size,
+				UINT8 *staging)
+{
+	EFI_STATUS ret;
+	UINTN len = chunk->stored_size, out_size = chunk->size;
+	CHAR8 *dst = addr + chunk->offset;
+
+	if (chunk->offset > size || chunk->size > size - chunk->offset ||
+	    chunk->size > WD_CHUNK_SIZE || chunk->file_offset > file_size ||
+	    chunk->stored_size > file_size - chunk->file_offset)
+		return EFI_COMPROMISED_DATA;
+
+	if (chunk->flags & WD_CHUNK_LZ4) {
+		if (chunk->stored_size > LZ4_COMPRESS_BOUND(WD_CHUNK_SIZE))
+			return EFI_COMPROMISED_DATA;
+		ret = uefi_file_read_at(file, chunk->file_offset, staging, &len);
+		if (!EFI_ERROR(ret) && len == chunk->stored_size)
+			ret = lz4_decompress(staging, len, dst, &out_size);
+		else if (!EFI_ERROR(ret))
+			ret = EFI_END_OF_FILE;
+	} else if (chunk->stored_size == chunk->size) {
+		ret = uefi_file_read_at(file, chunk->file_offset, dst, &out_size);
+	} else
+		ret = EFI_COMPROMISED_DATA;
+
+	if (!EFI_ERROR(ret) && out_size != chunk->size)
+		ret = EFI_COMPROMISED_DATA;
+	if (!EFI_ERROR(ret) && crc32c(0, dst, chunk->size) != chunk->crc)
+		ret = EFI_CRC_ERROR;
+
+	// Don't leave half restored data for the kernel to parse
+	if (EFI_ERROR(ret))
+		memset(dst, 0, chunk->size);
 
 	return ret;
 }
@@ -158,24 +361,86 @@ static EFI_STATUS data_write_to_file(EFI_FILE_IO_INTERFACE *io, CHAR16 *filename
 static EFI_STATUS inject_file_ram(EFI_FILE_IO_INTERFACE *io, CHAR16 *filename,
 				  void *addr, UINTN size)
 {
-	EFI_STATUS ret = EFI_SUCCESS;
-	void *buf;
-	UINTN read_size;
+	EFI_STATUS ret;
+	EFI_FILE *file;
+	UINT64 file_size;
+	struct wd_header header;
+	struct wd_region *region;
+	struct wd_chunk *chunks;
+	CHAR8 *tables = NULL;
+	UINT8 *staging = NULL;
+	UINTN len, tables_size, i;
 
 	debug(L"Reading data from ESP file %s\n", filename);
-	ret = uefi_read_file(io, filename, &buf, &read_size);
-	if (size != read_size)
-		error(L"Read %d/%d bytes\n", read_size, size);
-	if (EFI_ERROR(ret)) {
-		error(L"Failed to read file %s: %r\n", filename, ret);
+	ret = uefi_open_file(io, filename, EFI_FILE_MODE_READ, &file);
+	if (EFI_ERROR(ret))
 		return ret;
+
+	ret = uefi_file_size(file, &file_size);
+	if (EFI_ERROR(ret))
+		goto out;
+
+	len = sizeof(header);
+	ret = uefi_file_read_at(file, 0, &header, &len);
+	if (EFI_ERROR(ret))
+		goto out;
+
+	if (len < sizeof(header) || header.magic != WD_MAGIC) {
+		// Raw dump written by a previous version
+		if (size != file_size)
+			error(L"Read %d/%d bytes\n", file_size, size);
+		len = size;
+		ret = uefi_file_read_at(file, 0, addr, &len);
+		goto out;
 	}
 
-	// Copy to ram
-	uefi_call_wrapper(BS->CopyMem, 3, addr, buf, read_size);
+	ret = check_header(&header, file_size);
+	if (EFI_ERROR(ret))
+		goto invalid;
+
+	tables_size = sizeof(*region) + header.chunk_count * sizeof(*chunks);
+	tables = malloc(tables_size);
+	staging = malloc(LZ4_COMPRESS_BOUND(WD_CHUNK_SIZE));
+	if (!tables || !staging) {
+		ret = EFI_OUT_OF_RESOURCES;
+		goto out;
+	}
 
-	FreePool(buf);
+	len = tables_size;
+	ret = uefi_file_read_at(file, header.region_table, tables, &len);
+	if (EFI_ERROR(ret))
+		goto out;
+
+	region = (struct wd_region *)tables;
+	chunks = (struct wd_chunk *)(region + 1);
+	if (len != tables_size ||
+	    crc32c(0, tables, tables_size) != header.table_crc ||
+	    region->size != size || region->first_chunk != 0 ||
+	    region->chunk_count != header.chunk_count) {
+		ret = EFI_COMPROMISED_DATA;
+		goto invalid;
+	}
+
+	for (i = 0; i < region->chunk_count; i++) {
+		EFI_STATUS chunk_ret;
 
+		chunk_ret = restore_chunk(file, file_size, &chunks[i], addr, size,
+					  staging);
+		if (EFI_ERROR(chunk_ret)) {
+			error(L"Chunk %d of %s: %r\n", i, filename, chunk_ret);
+			ret = chunk_ret;
+		}
+	}
+	goto out;
+
+invalid:
+	error(L"Invalid dump file %s: %r\n", filename, ret);
+out:
+	if (tables)
+		free(tables);
+	if (staging)
+		free(staging);
+	uefi_call_wrapper(file->Close, 1, file);
 	return ret;
 }
 
@@ -190,6 +455,7 @@ EFI_STATUS pstore_get_buffer(void **addr, UINTN *size)
 		return EFI_NOT_FOUND;
 	}
 	*addr = *(void**)var;
+	FreePool(var);
 
 	var = LibGetVariable(EFIVAR_PSTORE_SIZE, &global_var_guid);
 	if (!var) {
@@ -197,17 +463,132 @@ EFI_STATUS pstore_get_buffer(void **addr, UINTN *size)
 		return EFI_NOT_FOUND;
 	}
 	*size = *(UINTN*)var;
+	FreePool(var);
 
 	return EFI_SUCCESS;
 }
 
 #define PERSISTENT_RAM_SIG (0x43474244) /* DBGC */
 
+/* Layout of the ramoops region, it must match the ramoops configuration
+ * of the kernel. The defaults are the ramoops module parameters ones. */
+#ifdef CONFIG_PSTORE_RECORD_SIZE
+#define PSTORE_RECORD_SIZE CONFIG_PSTORE_RECORD_SIZE
+#else
+#define PSTORE_RECORD_SIZE 4096
+#endif
+
+#ifdef CONFIG_PSTORE_CONSOLE_SIZE
+#define PSTORE_CONSOLE_SIZE CONFIG_PSTORE_CONSOLE_SIZE
+#else
+#define PSTORE_CONSOLE_SIZE 4096
+#endif
+
+#ifdef CONFIG_PSTORE_FTRACE_SIZE
+#define PSTORE_FTRACE_SIZE CONFIG_PSTORE_FTRACE_SIZE
+#else
+#define PSTORE_FTRACE_SIZE 4096
+#endif
+
+#ifdef CONFIG_PSTORE_PMSG_SIZE
+#define PSTORE_PMSG_SIZE CONFIG_PSTORE_PMSG_SIZE
+#else
+#define PSTORE_PMSG_SIZE 0
+#endif
+
+/* Parity bytes per ECC block, 0 when ramoops runs without ECC */
+#ifdef CONFIG_PSTORE_ECC_SIZE
+#define PSTORE_ECC_SIZE CONFIG_PSTORE_ECC_SIZE
+#else
+#define PSTORE_ECC_SIZE 0
+#endif
+
+#ifdef CONFIG_PSTORE_ECC_BLOCK_SIZE
+#define PSTORE_ECC_BLOCK_SIZE CONFIG_PSTORE_ECC_BLOCK_SIZE
+#else
+#define PSTORE_ECC_BLOCK_SIZE 128
+#endif
+
+/* Header of each zone of the ramoops region, see the Linux
+ * fs/pstore/ram_core.c persistent_ram_buffer */
+struct persistent_ram_buffer {
+	UINT32 sig;
+	UINT32 start;
+	UINT32 size;
+} __attribute__((packed));
+
 static inline BOOLEAN is_pstore_ram_in_ram(void *addr)
 {
 	return *((UINT32*)addr) == PERSISTENT_RAM_SIG;
 }
 
+/*
+ * A zone is its header, its data ring and, with ECC, the parity of each
+ * data block followed by the parity of the header. The header, the used
+ * data and the parity of the used blocks are dumped. The signature is
+ * not checked, the ftrace zone has a kernel version dependent one: a
+ * zone whose header does not describe its data ring is dumped whole.
+ */
+static void pstore_add_zone(struct dump *dump, void *addr, UINT32 offset,
+			    UINT32 zone_size)
+{
+	struct persistent_ram_buffer *prb;
+	UINT32 data_size, ecc_blocks = 0, parity;
+
+	if (zone_size <= sizeof(*prb))
+		return;
+
+	prb = (struct persistent_ram_buffer *)((CHAR8 *)addr + offset);
+	data_size = zone_size - sizeof(*prb);
+	if (PSTORE_ECC_SIZE) {
+		ecc_blocks = (data_size - PSTORE_ECC_SIZE + PSTORE_ECC_BLOCK_SIZE +
+			      PSTORE_ECC_SIZE - 1) /
+			(PSTORE_ECC_BLOCK_SIZE + PSTORE_ECC_SIZE);
+		data_size -= (ecc_blocks + 1) * PSTORE_ECC_SIZE;
+	}
+
+	if (prb->size > data_size || prb->start > prb->size) {
+		debug(L"pstore zone at 0x%x has no valid header\n", offset);
+		dump_add(dump, offset, zone_size);
+		return;
+	}
+
+	debug(L"pstore zone at 0x%x, 0x%x bytes used\n", offset, prb->size);
+	dump_add(dump, offset, sizeof(*prb) + prb->size);
+	if (PSTORE_ECC_SIZE) {
+		parity = offset + sizeof(*prb) + data_size;
+		dump_add(dump, parity, (prb->size + PSTORE_ECC_BLOCK_SIZE - 1) /
+			 PSTORE_ECC_BLOCK_SIZE * PSTORE_ECC_SIZE);
+		dump_add(dump, parity + ecc_blocks * PSTORE_ECC_SIZE,
+			 PSTORE_ECC_SIZE);
+	}
+}
+
+/* The dump records fill the region but the console, ftrace and pmsg
+ * zones, which follow them in this order */
+static void pstore_find_zones(void *addr, UINTN size, struct dump *dump)
+{
+	UINT32 tail = PSTORE_CONSOLE_SIZE + PSTORE_FTRACE_SIZE + PSTORE_PMSG_SIZE;
+	UINT32 offset = 0, count = 0, i;
+
+	if (tail > size) {
+		warning(L"pstore layout larger than the region, dumping it all\n");
+		dump_add(dump, 0, size);
+		return;
+	}
+
+	if (PSTORE_RECORD_SIZE)
+		count = (size - tail) / PSTORE_RECORD_SIZE;
+	for (i = 0; i < count; i++, offset += PSTORE_RECORD_SIZE)
+		pstore_add_zone(dump, addr, offset, PSTORE_RECORD_SIZE);
+
+	pstore_add_zone(dump, addr, offset, PSTORE_CONSOLE_SIZE);
+	offset += PSTORE_CONSOLE_SIZE;
+	pstore_add_zone(dump, addr, offset, PSTORE_FTRACE_SIZE);
+	offset += PSTORE_FTRACE_SIZE;
+	pstore_add_zone(dump, addr, offset, PSTORE_PMSG_SIZE);
+}
+
 #define LM_FILE		BACKUP_DIR FILE_SEP L"lm_dump.bin"
 
 void lm_backup(EFI_FILE_IO_INTERFACE *esp_fs)
@@ -216,13 +597,17 @@ void lm_backup(EFI_FILE_IO_INTERFACE *esp_fs)
 	if (lm_set == LM_PDM_MODE) {
 		void *lm_addr;
 		UINT32 lm_size;
+		struct dump dump;
 
 		lm_get_backup_data(&lm_addr, &lm_size);
 		debug(L"LM addr:0x%x size:0x%x\n", lm_addr, lm_size);
 
-		if (lm_addr && lm_size)
-			data_write_to_file(esp_fs, LM_FILE, lm_addr, lm_size);
-		else
+		if (lm_addr && lm_size) {
+			dump_init(&dump, (CHAR8 *)"lakemore", lm_size);
+			dump_add(&dump, 0, lm_size);
+			dump_write_to_file(esp_fs, LM_FILE, &dump, lm_addr);
+			dump_free(&dump);
+		} else
 			info(L"No Lakemore buffer in RAM\n");
 	} else
 		info(L"Lakemore not in PDM MODE, %d\n", lm_set);
@@ -255,15 +640,19 @@ void pstore_backup(EFI_FILE_IO_INTERFACE *esp_fs)
 	EFI_STATUS ret;
 	void *pstore_addr;
 	UINTN pstore_size;
+	struct dump dump;
 
 	ret = pstore_get_buffer(&pstore_addr, &pstore_size);
 	if (EFI_ERROR(ret))
 		return;
 	debug(L"pstore addr:0x%x size:0x%x\n", pstore_addr, pstore_size);
 
-	if (is_pstore_ram_in_ram(pstore_addr))
-		data_write_to_file(esp_fs, PSTORE_FILE, pstore_addr, pstore_size);
-	else
+	if (is_pstore_ram_in_ram(pstore_addr)) {
+		dump_init(&dump, (CHAR8 *)"pstore", pstore_size);
+		pstore_find_zones(pstore_addr, pstore_size, &dump);
+		dump_write_to_file(esp_fs, PSTORE_FILE, &dump, pstore_addr);
+		dump_free(&dump);
+	} else
 		info(L"No pstore buffer in RAM\n");
 }
 
@@ -290,26 +679,10 @@ void pstore_restore(EFI_FILE_IO_INTERFACE *esp_fs)
 	uefi_delete_file(esp_fs, PSTORE_FILE);
 }
 
-EFI_STATUS efi_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *systab)
+EFI_STATUS warmdump_run(void)
 {
-	EFI_STATUS ret = EFI_SUCCESS;
+	EFI_STATUS ret;
 	EFI_FILE_IO_INTERFACE *esp_fs;
-	EFI_LOADED_IMAGE *info;
-
-	InitializeLib(image, systab);
-	sys_table = systab;
-	boot = sys_table->BootServices;
-	main_image_handle = image;
-
-	ret = handle_protocol(image, &LoadedImageProtocol, (void **)&info);
-	if (ret != EFI_SUCCESS)
-		return ret;
-
-	efilinux_image = info->DeviceHandle;
-
-	info(WARMDUMP_BANNER, WARMDUMP_VERSION_MAJOR, WARMDUMP_VERSION_MINOR,
-	     WARMDUMP_BUILD_STRING, WARMDUMP_VERSION_STRING,
-	     WARMDUMP_VERSION_DATE);
 
 	ret = get_esp_fs(&esp_fs);
 	if (EFI_ERROR(ret))
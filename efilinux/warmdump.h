@@ -36,6 +36,8 @@
 #define EFIVAR_PSTORE_SIZE	L"PstoreSize"
 
 #define WARMDUMP_VERSION_MAJOR 1
-#define WARMDUMP_VERSION_MINOR 0
+#define WARMDUMP_VERSION_MINOR 1
+
+EFI_STATUS warmdump_run(void);
 
 #endif /* _WARMDUMP_H_ */
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file is the entry point of the standalone warmdump image, the
+ * dump logic itself lives in warmdump.c and is also linked in efilinux.
+ */
+
+#include <efi.h>
+#include <efilib.h>
+#include "warmdump.h"
+#include "protocol.h"
+#include "log.h"
+#include "io_stats.h"
+
+#ifndef WARMDUMP_BUILD_STRING
+#define WARMDUMP_BUILD_STRING L"undef"
+#endif
+
+#ifndef WARMDUMP_VERSION_STRING
+#define WARMDUMP_VERSION_STRING L"undef"
+#endif
+
+#ifndef WARMDUMP_VERSION_DATE
+#define WARMDUMP_VERSION_DATE L"undef"
+#endif
+
+#define WARMDUMP_BANNER L"version %d.%d %s %s %s\n"
+
+EFI_SYSTEM_TABLE *sys_table;
+EFI_BOOT_SERVICES *boot;
+EFI_HANDLE efilinux_image;
+EFI_HANDLE main_image_handle;
+
+EFI_STATUS efi_main(EFI_HANDLE image, EFI_SYSTEM_TABLE *systab)
+{
+	EFI_STATUS ret;
+	EFI_LOADED_IMAGE *info;
+
+	InitializeLib(image, systab);
+	sys_table = systab;
+	boot = sys_table->BootServices;
+	main_image_handle = image;
+
+	ret = handle_protocol(image, &LoadedImageProtocol, (void **)&info);
+	if (ret != EFI_SUCCESS)
+		return ret;
+
+	efilinux_image = info->DeviceHandle;
+
+	info(WARMDUMP_BANNER, WARMDUMP_VERSION_MAJOR, WARMDUMP_VERSION_MINOR,
+	     WARMDUMP_BUILD_STRING, WARMDUMP_VERSION_STRING,
+	     WARMDUMP_VERSION_DATE);
+
+	ret = warmdump_run();
+	io_stats_log();
+
+	return ret;
+}
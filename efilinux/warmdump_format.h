@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2014, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * This file describes the warmdump container format. It is shared by
+ * warmdump and the host tools, all the fields are little endian.
+ *
+ *   struct wd_header            at offset 0, rewritten once complete
+ *   chunk data                  LZ4 blocks or raw bytes
+ *   struct wd_region[]          at header.region_table
+ *   struct wd_chunk[]           at header.chunk_table
+ *
+ * A region is a memory area, e.g. the pstore carve-out, and owns the
+ * chunk_count chunks starting at first_chunk. Chunks hold at most
+ * WD_CHUNK_SIZE bytes of the region and only cover the live parts of
+ * it, the rest of the region is not stored.
+ */
+
+#ifndef __WARMDUMP_FORMAT_H__
+#define __WARMDUMP_FORMAT_H__
+
+#define WD_MAGIC		0x504d4457	/* WDMP */
+#define WD_VERSION		1
+#define WD_CHUNK_SIZE		(64 * 1024)
+#define WD_NAME_SIZE		16
+
+struct wd_header {
+	UINT32 magic;
+	UINT16 version;
+	UINT16 header_size;
+	UINT32 region_count;
+	UINT32 chunk_count;
+	UINT32 region_table;	/* File offset of the region table */
+	UINT32 chunk_table;	/* File offset of the chunk table */
+	UINT32 table_crc;	/* CRC32C of the region then chunk tables */
+	UINT32 header_crc;	/* CRC32C of this header, with this field 0 */
+} __attribute__((packed));
+
+struct wd_region {
+	CHAR8 name[WD_NAME_SIZE];
+	UINT64 address;		/* Physical address the region was dumped from */
+	UINT32 size;
+	UINT32 first_chunk;
+	UINT32 chunk_count;
+	UINT32 reserved;
+} __attribute__((packed));
+
+#define WD_CHUNK_LZ4		(1 << 0)
+
+struct wd_chunk {
+	UINT32 offset;		/* Offset of the chunk in its region */
+	UINT32 size;		/* Uncompressed size */
+	UINT32 file_offset;
+	UINT32 stored_size;	/* Size in the file */
+	UINT32 crc;		/* CRC32C of the uncompressed data */
+	UINT32 flags;
+} __attribute__((packed));
+
+#endif	/* __WARMDUMP_FORMAT_H__ */
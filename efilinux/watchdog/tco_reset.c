@@ -32,6 +32,7 @@
 #include <efilib.h>
 #include <stdlib.h>
 #include <utils.h>
+#include <uefi_utils.h>
 #include "tco_reset.h"
 
 
@@ -43,7 +44,7 @@ static EFI_STATUS start_tco_watchdog(struct watchdog *wd)
 	EFI_STATUS ret;
 
 	debug(L"timeout = %d\n", wd->reg);
-	ret = LibLocateProtocol(&gEfiTcoResetProtocolGuid, (void **)&tco);
+	ret = uefi_locate_protocol(&gEfiTcoResetProtocolGuid, (void **)&tco);
 	if (EFI_ERROR(ret) || !tco) {
 		error(L"%x failure\n", __func__);
 		goto out;
@@ -60,7 +61,7 @@ static EFI_STATUS stop_tco_watchdog(struct watchdog *wd)
 	EFI_TCO_RESET_PROTOCOL *tco;
 	EFI_STATUS ret;
 
-	ret = LibLocateProtocol(&gEfiTcoResetProtocolGuid, (void **)&tco);
+	ret = uefi_locate_protocol(&gEfiTcoResetProtocolGuid, (void **)&tco);
 	if (EFI_ERROR(ret) || !tco) {
 		error(L"%x failure\n", __func__);
 		goto out;